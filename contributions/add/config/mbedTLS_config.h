@@ -20,6 +20,73 @@
 
 #define MBEDTLS_CONFIG_VERSION 0x03010000
 
+/* Watson IoT profiles
+ *
+ * IOTF_MBEDTLS_PROFILE selects how the module options at the end of this file trade
+ * memory for handshake time:
+ *   IOTF_MBEDTLS_PROFILE_MIN_RAM    smallest windows, no fixed-point tables; the
+ *                                   settings of pack versions up to 1.0.4
+ *   IOTF_MBEDTLS_PROFILE_BALANCED   the mbed TLS default windows and the P-256
+ *                                   fixed-point tables, which are held in flash
+ *   IOTF_MBEDTLS_PROFILE_MAX_SPEED  large windows, AES tables in RAM and assembly
+ *                                   bignum multiplication
+ */
+#define IOTF_MBEDTLS_PROFILE_MIN_RAM    0
+#define IOTF_MBEDTLS_PROFILE_BALANCED   1
+#define IOTF_MBEDTLS_PROFILE_MAX_SPEED  2
+
+/* MIN_RAM stays the default until the handshake time and heap of the profiles are measured
+ * on a target (iotf_tls_bench_<profile> in host/) */
+#ifndef IOTF_MBEDTLS_PROFILE
+#define IOTF_MBEDTLS_PROFILE            IOTF_MBEDTLS_PROFILE_MIN_RAM
+#endif
+
+/* IOTF_MBEDTLS_ECDSA_ONLY leaves out RSA, PKCS#1, SHA-1, SHA-512 and CBC. It needs a
+ * broker with an ECDSA certificate chain, as setFastHandshake does, and a client
+ * certificate with an EC key, if any.
+ */
+//#define IOTF_MBEDTLS_ECDSA_ONLY
+
+/* IOTF_MBEDTLS_PSK adds the PSK and ECDHE-PSK cipher suites a client with a pre-shared
+ * key (setPreSharedKey, psk in device.cfg) offers. IOTF_MBEDTLS_PSK_ONLY also leaves out
+ * X.509, PEM, PK, RSA and ECDSA, so only clients with a pre-shared key can connect and
+ * no certificate is parsed or held in RAM.
+ */
+//#define IOTF_MBEDTLS_PSK
+//#define IOTF_MBEDTLS_PSK_ONLY
+
+/* Crypto accelerators
+ *
+ * Defined as preprocessor symbols of the project, or in RTE_Components.h by a component
+ * of the device, when it provides the replacement functions listed:
+ *   IOTF_CRYPTO_AES_ALT     aes_alt.h and the mbedtls_aes_* functions
+ *   IOTF_CRYPTO_GCM_ALT     gcm_alt.h and the mbedtls_gcm_* functions
+ *   IOTF_CRYPTO_SHA256_ALT  sha256_alt.h and the mbedtls_sha256_* functions
+ *   IOTF_CRYPTO_ECDSA_ALT   mbedtls_ecdsa_sign() and mbedtls_ecdsa_verify()
+ *   IOTF_CRYPTO_ECDH_ALT    mbedtls_ecdh_gen_public() and mbedtls_ecdh_compute_shared()
+ */
+#ifdef _RTE_
+#include "RTE_Components.h"
+#endif
+
+#ifdef IOTF_CRYPTO_AES_ALT
+#define MBEDTLS_AES_ALT
+#endif
+#ifdef IOTF_CRYPTO_GCM_ALT
+#define MBEDTLS_GCM_ALT
+#endif
+#ifdef IOTF_CRYPTO_SHA256_ALT
+#define MBEDTLS_SHA256_ALT
+#endif
+#ifdef IOTF_CRYPTO_ECDSA_ALT
+#define MBEDTLS_ECDSA_SIGN_ALT
+#define MBEDTLS_ECDSA_VERIFY_ALT
+#endif
+#ifdef IOTF_CRYPTO_ECDH_ALT
+#define MBEDTLS_ECDH_GEN_PUBLIC_ALT
+#define MBEDTLS_ECDH_COMPUTE_SHARED_ALT
+#endif
+
 /* System support */
 //#define MBEDTLS_HAVE_ASM
 //#define MBEDTLS_HAVE_TIME
@@ -29,7 +96,6 @@
 
 /* mbed TLS feature support */
 #define MBEDTLS_ENTROPY_HARDWARE_ALT
-#define MBEDTLS_AES_ROM_TABLES
 //#define MBEDTLS_AES_FEWER_TABLES
 //#define MBEDTLS_CAMELLIA_SMALL_MEMORY
 //#define MBEDTLS_CHECK_RETURN_WARNING
@@ -191,12 +257,63 @@
 
 /* Module configuration options */
 
-/* MPI / BIGNUM options */
+/* Profile dependent options */
+#if IOTF_MBEDTLS_PROFILE == IOTF_MBEDTLS_PROFILE_MIN_RAM
+#define MBEDTLS_AES_ROM_TABLES
 #define MBEDTLS_MPI_WINDOW_SIZE            1 /**< Maximum window size used. */
-
-/* ECP options */
 #define MBEDTLS_ECP_WINDOW_SIZE            2 /**< Maximum window size used */
 #define MBEDTLS_ECP_FIXED_POINT_OPTIM      0 /**< Disable fixed-point speed-up */
+#elif IOTF_MBEDTLS_PROFILE == IOTF_MBEDTLS_PROFILE_BALANCED
+#define MBEDTLS_AES_ROM_TABLES
+#define MBEDTLS_MPI_WINDOW_SIZE            2 /**< Maximum window size used. */
+#define MBEDTLS_ECP_WINDOW_SIZE            4 /**< Maximum window size used */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM      1 /**< Enable fixed-point speed-up */
+#elif IOTF_MBEDTLS_PROFILE == IOTF_MBEDTLS_PROFILE_MAX_SPEED
+#define MBEDTLS_HAVE_ASM
+#define MBEDTLS_MPI_WINDOW_SIZE            6 /**< Maximum window size used. */
+#define MBEDTLS_ECP_WINDOW_SIZE            6 /**< Maximum window size used */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM      1 /**< Enable fixed-point speed-up */
+#else
+#error "IOTF_MBEDTLS_PROFILE must be IOTF_MBEDTLS_PROFILE_MIN_RAM, _BALANCED or _MAX_SPEED"
+#endif
+
+#ifdef IOTF_MBEDTLS_ECDSA_ONLY
+#undef MBEDTLS_CIPHER_MODE_CBC
+#undef MBEDTLS_CIPHER_PADDING_PKCS7
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
+#undef MBEDTLS_PK_RSA_ALT_SUPPORT
+#undef MBEDTLS_PKCS1_V15
+#undef MBEDTLS_PKCS1_V21
+#undef MBEDTLS_RSA_C
+#undef MBEDTLS_SHA1_C
+#undef MBEDTLS_SHA512_C
+#endif
+
+#if defined(IOTF_MBEDTLS_PSK) || defined(IOTF_MBEDTLS_PSK_ONLY)
+#define MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+#endif
+
+#ifdef IOTF_MBEDTLS_PSK_ONLY
+#undef MBEDTLS_ECDSA_DETERMINISTIC
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
+#undef MBEDTLS_PK_RSA_ALT_SUPPORT
+#undef MBEDTLS_PKCS1_V15
+#undef MBEDTLS_PKCS1_V21
+#undef MBEDTLS_SSL_SERVER_NAME_INDICATION
+#undef MBEDTLS_BASE64_C
+#undef MBEDTLS_ECDSA_C
+#undef MBEDTLS_HMAC_DRBG_C
+#undef MBEDTLS_PEM_PARSE_C
+#undef MBEDTLS_PK_C
+#undef MBEDTLS_PK_PARSE_C
+#undef MBEDTLS_RSA_C
+#undef MBEDTLS_SHA1_C
+#undef MBEDTLS_SHA512_C
+#undef MBEDTLS_X509_USE_C
+#undef MBEDTLS_X509_CRT_PARSE_C
+#endif
 
 /* Entropy options */
 #define MBEDTLS_ENTROPY_MAX_SOURCES        2 /**< Maximum number of sources supported */
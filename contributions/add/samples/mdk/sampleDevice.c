@@ -16,6 +16,7 @@
  *******************************************************************************/
 
 #include "deviceclient.h"
+#include "iotf_telemetry.h"
 #include "cmsis_os2.h"
 
 void myCallback (char* commandName, char* format, void* payload)
@@ -32,6 +33,9 @@ int sampleDevice (void)
 {
     int rc = -1;
     int count = 0;
+    int len;
+    char payload[64];
+    tb_builder tb;
 
     iotfclient client;
 
@@ -57,7 +61,12 @@ int sampleDevice (void)
     while (++count <= 10)
     {
         printf("Publishing the event stat with rc ");
-        rc= publishEvent(&client, "status","json", "{\"d\" : {\"temp\" : 34 }}", QOS0);
+        tb_begin(&tb, payload, sizeof(payload));
+        tb_begin_obj(&tb, "d");
+        tb_add_fixed(&tb, "temp", 3400 + count * 5, 2);
+        tb_end_obj(&tb);
+        len = tb_end(&tb);
+        rc= publishEventData(&client, "status","json", payload, len, QOS0);
         printf(" %d\n", rc);
         yield(&client,1000);
         osDelay(2000);
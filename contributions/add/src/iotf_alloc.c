@@ -0,0 +1,261 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the library allocator definitions
+ *******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "cJSON.h"
+#include "iotf_alloc.h"
+
+//Precedes every allocation, keeps the payload 8 byte aligned
+typedef union
+{
+        uint32_t size;
+        uint64_t align;
+} iotf_alloc_header;
+
+typedef struct pool_block
+{
+        struct pool_block *next;
+} pool_block;
+
+typedef struct
+{
+        uint8_t *base;
+        uint8_t *end;
+        uint8_t *unused;        //blocks from here on were never handed out
+        uint32_t size;
+        uint32_t stride;
+        pool_block *free;
+        uint32_t inUse;
+        uint32_t highWater;
+} pool_class;
+
+#define POOL_STRIDE(size)       (((size) + sizeof(iotf_alloc_header) + 7U) & ~7U)
+#define POOL_STORAGE(size, count) static uint64_t poolStorage##size[(count) * POOL_STRIDE(size) / 8U];
+#define POOL_CLASS(size, count) { (uint8_t *)poolStorage##size, (uint8_t *)poolStorage##size + sizeof(poolStorage##size), \
+                                  (uint8_t *)poolStorage##size, (size), POOL_STRIDE(size), NULL, 0, 0 },
+
+IOTF_POOL_CLASS_LIST(POOL_STORAGE)
+
+static pool_class poolClasses[IOTF_POOL_CLASSES] = {
+        IOTF_POOL_CLASS_LIST(POOL_CLASS)
+};
+
+static uint32_t poolFallbacks;
+
+static iotf_alloc_stats allocStats;
+
+static void *heap_alloc(size_t size, void *context)
+{
+        (void)context;
+        return malloc(size);
+}
+
+static void heap_release(void *ptr, size_t size, void *context)
+{
+        (void)size;
+        (void)context;
+        free(ptr);
+}
+
+//Smallest class with a free block, blocks are never split, exhausted classes spill upwards
+static void *pool_alloc(size_t size, void *context)
+{
+        void *block = NULL;
+        int32_t lock;
+        int i;
+
+        (void)context;
+        size -= sizeof(iotf_alloc_header);
+        lock = osKernelLock();
+        for (i = 0; i < IOTF_POOL_CLASSES && block == NULL; i++) {
+                pool_class *pc = &poolClasses[i];
+
+                if (size > pc->size)
+                        continue;
+                if (pc->free != NULL) {
+                        block = pc->free;
+                        pc->free = pc->free->next;
+                }
+                else if (pc->unused < pc->end) {
+                        block = pc->unused;
+                        pc->unused += pc->stride;
+                }
+                else {
+                        continue;
+                }
+                if (++pc->inUse > pc->highWater)
+                        pc->highWater = pc->inUse;
+        }
+        osKernelRestoreLock(lock);
+
+        if (block == NULL) {
+#ifdef IOTF_POOL_STRICT
+                return NULL;
+#else
+                __atomic_fetch_add(&poolFallbacks, 1, __ATOMIC_RELAXED);
+                block = malloc(size + sizeof(iotf_alloc_header));
+#endif
+        }
+        return block;
+}
+
+//Blocks are recognised by address, anything else came from the heap fallback
+static void pool_release(void *ptr, size_t size, void *context)
+{
+        uint8_t *p = (uint8_t *)ptr;
+        int32_t lock;
+        int i;
+
+        (void)size;
+        (void)context;
+        for (i = 0; i < IOTF_POOL_CLASSES; i++) {
+                pool_class *pc = &poolClasses[i];
+
+                if (p >= pc->base && p < pc->end) {
+                        lock = osKernelLock();
+                        ((pool_block *)ptr)->next = pc->free;
+                        pc->free = (pool_block *)ptr;
+                        pc->inUse--;
+                        osKernelRestoreLock(lock);
+                        return;
+                }
+        }
+        free(ptr);
+}
+
+static const iotf_allocator heapAllocator = { heap_alloc, heap_release, NULL };
+static const iotf_allocator poolAllocator = { pool_alloc, pool_release, NULL };
+
+#ifdef IOTF_ALLOC_DEFAULT_POOL
+static iotf_allocator allocator = { pool_alloc, pool_release, NULL };
+#else
+static iotf_allocator allocator = { heap_alloc, heap_release, NULL };
+#endif
+
+const iotf_allocator *iotf_heap_allocator(void)
+{
+        return &heapAllocator;
+}
+
+const iotf_allocator *iotf_pool_allocator(void)
+{
+        return &poolAllocator;
+}
+
+void iotf_alloc_hook_json(void)
+{
+        cJSON_Hooks hooks;
+
+        hooks.malloc_fn = iotf_malloc;
+        hooks.free_fn = iotf_free;
+        cJSON_InitHooks(&hooks);
+}
+
+void iotf_set_allocator(const iotf_allocator *newAllocator)
+{
+#ifdef IOTF_ALLOC_DEFAULT_POOL
+        allocator = (newAllocator != NULL) ? *newAllocator : poolAllocator;
+#else
+        allocator = (newAllocator != NULL) ? *newAllocator : heapAllocator;
+#endif
+        iotf_alloc_hook_json();
+}
+
+void *iotf_malloc(size_t size)
+{
+        iotf_alloc_header *h = NULL;
+        int32_t lock;
+
+        if (size <= UINT32_MAX - sizeof(iotf_alloc_header))
+                h = allocator.alloc(size + sizeof(iotf_alloc_header), allocator.context);
+
+        lock = osKernelLock();
+        if (h == NULL) {
+                allocStats.failures++;
+                osKernelRestoreLock(lock);
+                return NULL;
+        }
+        allocStats.allocations++;
+        allocStats.bytesInUse += (uint32_t)size;
+        if (allocStats.bytesInUse > allocStats.bytesHighWater)
+                allocStats.bytesHighWater = allocStats.bytesInUse;
+        if (++allocStats.blocksInUse > allocStats.blocksHighWater)
+                allocStats.blocksHighWater = allocStats.blocksInUse;
+        osKernelRestoreLock(lock);
+
+        h->size = (uint32_t)size;
+        return h + 1;
+}
+
+void iotf_free(void *ptr)
+{
+        iotf_alloc_header *h;
+        int32_t lock;
+        uint32_t size;
+
+        if (ptr == NULL)
+                return;
+        h = (iotf_alloc_header *)ptr - 1;
+        size = h->size;
+
+        lock = osKernelLock();
+        allocStats.bytesInUse -= size;
+        allocStats.blocksInUse--;
+        osKernelRestoreLock(lock);
+
+        allocator.release(h, size + sizeof(iotf_alloc_header), allocator.context);
+}
+
+void *iotf_realloc(void *ptr, size_t size)
+{
+        void *p;
+        uint32_t oldSize;
+
+        if (ptr == NULL)
+                return iotf_malloc(size);
+        if (size == 0) {
+                iotf_free(ptr);
+                return NULL;
+        }
+        oldSize = ((iotf_alloc_header *)ptr - 1)->size;
+        if ((p = iotf_malloc(size)) == NULL)
+                return NULL;
+        memcpy(p, ptr, (size < oldSize) ? size : oldSize);
+        iotf_free(ptr);
+        return p;
+}
+
+void iotf_alloc_get_stats(iotf_alloc_stats *out, int reset)
+{
+        int32_t lock = osKernelLock();
+        int i;
+
+        *out = allocStats;
+        out->fallbacks = __atomic_load_n(&poolFallbacks, __ATOMIC_RELAXED);
+        for (i = 0; i < IOTF_POOL_CLASSES; i++) {
+                out->classHighWater[i] = poolClasses[i].highWater;
+                if (reset)
+                        poolClasses[i].highWater = poolClasses[i].inUse;
+        }
+        if (reset) {
+                allocStats.bytesHighWater = allocStats.bytesInUse;
+                allocStats.blocksHighWater = allocStats.blocksInUse;
+        }
+        osKernelRestoreLock(lock);
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the library allocator declarations
+ *******************************************************************************/
+
+#ifndef IOTF_ALLOC_H_
+#define IOTF_ALLOC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Classes of the fixed-block pool as CLASS(usable bytes, blocks), smallest first. Each
+ * block carries an 8 byte header on top. The largest class holds a copy of a full MQTT
+ * receive buffer. Requests the pool cannot serve go to the heap and are counted as
+ * fallbacks, or fail if IOTF_POOL_STRICT is defined.
+ */
+#ifndef IOTF_POOL_CLASS_LIST
+#define IOTF_POOL_CLASS_LIST(CLASS) CLASS(32, 48) CLASS(64, 32) CLASS(128, 16) CLASS(256, 8) CLASS(1040, 4)
+#endif
+#define IOTF_POOL_ONE(size, count) + 1
+#define IOTF_POOL_CLASSES       (0 IOTF_POOL_CLASS_LIST(IOTF_POOL_ONE))
+
+//Memory provider. release gets the size that was requested from alloc.
+typedef struct
+{
+        void *(*alloc)(size_t size, void *context);
+        void (*release)(void *ptr, size_t size, void *context);
+        void *context;
+} iotf_allocator;
+
+typedef struct
+{
+        uint32_t allocations;
+        uint32_t failures;
+        uint32_t bytesInUse;
+        uint32_t bytesHighWater;
+        uint32_t blocksInUse;
+        uint32_t blocksHighWater;
+        //Pool only, zero with other allocators
+        uint32_t fallbacks;
+        uint32_t classHighWater[IOTF_POOL_CLASSES];
+} iotf_alloc_stats;
+
+/**
+* Function to select the allocator of the library and of cJSON. Must be called before
+* anything is allocated, e.g. before initialize, as blocks are returned to the allocator
+* that is set when they are freed.
+* The default is the C heap, or the pool if IOTF_ALLOC_DEFAULT_POOL is defined.
+* @param - Allocator, NULL selects the default
+* @return - void
+**/
+void iotf_set_allocator(const iotf_allocator *allocator);
+
+//Fixed-block pool allocator, statically allocated
+const iotf_allocator *iotf_pool_allocator(void);
+
+//C heap allocator
+const iotf_allocator *iotf_heap_allocator(void);
+
+//Allocation entry points used throughout the library
+void *iotf_malloc(size_t size);
+void *iotf_realloc(void *ptr, size_t size);
+void iotf_free(void *ptr);
+
+//Routes cJSON through iotf_malloc and iotf_free
+void iotf_alloc_hook_json(void);
+
+/**
+* Function to read the allocation statistics
+* @param - Address to store the statistics
+*        - Non-zero to restart the high-water marks from the current usage
+* @return - void
+**/
+void iotf_alloc_get_stats(iotf_alloc_stats *out, int reset);
+
+#endif
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the reconnect backoff definitions
+ *******************************************************************************/
+
+#include "cmsis_os2.h"
+#include "iotf_backoff.h"
+
+static uint32_t backoff_random(iotf_backoff *b)
+{
+        uint32_t x = b->seed;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        b->seed = x;
+        return x;
+}
+
+void backoff_init(iotf_backoff *b, uint32_t baseMs, uint32_t capMs, uint32_t seed)
+{
+        b->baseMs = (baseMs == 0U) ? 1U : baseMs;
+        b->capMs = (capMs < b->baseMs) ? b->baseMs : capMs;
+        b->attempt = 0;
+        b->seed = (seed == 0U) ? 0x9E3779B9U : seed;
+}
+
+void backoff_reset(iotf_backoff *b)
+{
+        b->attempt = 0;
+}
+
+void backoff_saturate(iotf_backoff *b)
+{
+        uint32_t window = b->baseMs;
+
+        b->attempt = 0;
+        while (window < b->capMs) {
+                window = (window > b->capMs / 2U) ? b->capMs : window * 2U;
+                b->attempt++;
+        }
+}
+
+uint32_t backoff_next(iotf_backoff *b)
+{
+        uint32_t window = b->baseMs;
+        uint32_t i;
+
+        for (i = 0; i < b->attempt && window < b->capMs; i++)
+                window = (window > b->capMs / 2U) ? b->capMs : window * 2U;
+        //Stop counting once the cap is reached so attempt cannot wrap
+        if (window < b->capMs)
+                b->attempt++;
+
+        return (uint32_t)(((uint64_t)backoff_random(b) * ((uint64_t)window + 1U)) >> 32);
+}
+
+uint32_t backoff_seed(const char *id)
+{
+        uint32_t hash = 2166136261U;
+
+        while (id != NULL && *id != '\0') {
+                hash ^= (uint8_t)*id++;
+                hash *= 16777619U;
+        }
+        hash ^= osKernelGetTickCount();
+        return (hash == 0U) ? 1U : hash;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the reconnect backoff declarations
+ *******************************************************************************/
+
+#ifndef IOTF_BACKOFF_H_
+#define IOTF_BACKOFF_H_
+
+#include <stdint.h>
+
+//Default reconnect window, the first retry waits up to 1 s, later ones up to 10 minutes
+#define BACKOFF_BASE_MS         1000U
+#define BACKOFF_CAP_MS          600000U
+
+//A connection that stayed up this long is retried from the base window again
+#define BACKOFF_STABLE_MS       60000U
+
+//Capped exponential backoff with full jitter
+typedef struct
+{
+        uint32_t baseMs;
+        uint32_t capMs;
+        uint32_t attempt;       //retries since the last reset
+        uint32_t seed;          //xorshift32 state, never 0
+} iotf_backoff;
+
+/**
+* Function to initialize the backoff. Devices of a fleet must use different seeds,
+* otherwise they draw the same delays and reconnect in lockstep again.
+* @param - Backoff to initialize
+*        - Window of the first retry and upper limit of the window in milliseconds
+*        - Seed, see backoff_seed
+* @return - void
+**/
+void backoff_init(iotf_backoff *b, uint32_t baseMs, uint32_t capMs, uint32_t seed);
+
+//Start over from the base window, e.g. after a successful connection
+void backoff_reset(iotf_backoff *b);
+
+//Go straight to the cap window, for errors that retrying soon will not fix
+void backoff_saturate(iotf_backoff *b);
+
+/**
+* Function to draw the next delay, uniformly from [0, min(cap, base * 2^attempt)]
+* @param - Backoff
+* @return - Delay in milliseconds
+**/
+uint32_t backoff_next(iotf_backoff *b);
+
+/**
+* Function to derive a seed from the device identity and the current kernel tick
+* @param - Device id, may be NULL
+* @return - Non-zero seed
+**/
+uint32_t backoff_seed(const char *id);
+
+#endif
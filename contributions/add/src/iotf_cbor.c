@@ -0,0 +1,670 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the CBOR (RFC 7049) encoder/decoder definitions
+ *******************************************************************************/
+
+#include <string.h>
+#include <math.h>
+#include "iotf_cbor.h"
+
+//Maximum nesting handled by iotf_cbor_skip
+#define CBOR_MAX_DEPTH 16
+
+/** Function to append raw bytes to the encoder buffer.
+* Once an overflow happened all further writes are discarded.
+* @param - Address of encoder
+*        - Data to append
+*        - Number of bytes
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+static int cbor_put(iotf_cbor_encoder *enc, const void *data, size_t len)
+{
+        if (enc->error)
+                return enc->error;
+        if (len > enc->size - enc->len) {
+                enc->error = CBOR_BUFFER_OVERFLOW;
+                return enc->error;
+        }
+        memcpy(&enc->buf[enc->len], data, len);
+        enc->len += len;
+        return 0;
+}
+
+/** Function to write the initial byte and argument of a data item using the
+* shortest possible encoding.
+* @param - Address of encoder
+*        - Major type
+*        - Argument (value, length or count)
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+static int cbor_head(iotf_cbor_encoder *enc, int major, uint64_t value)
+{
+        unsigned char head[9];
+        size_t len;
+        int i;
+
+        head[0] = (unsigned char)(major << 5);
+        if (value < 24) {
+                head[0] |= (unsigned char)value;
+                len = 1;
+        }
+        else if (value <= 0xFFU) {
+                head[0] |= 24;
+                len = 2;
+        }
+        else if (value <= 0xFFFFU) {
+                head[0] |= 25;
+                len = 3;
+        }
+        else if (value <= 0xFFFFFFFFU) {
+                head[0] |= 26;
+                len = 5;
+        }
+        else {
+                head[0] |= 27;
+                len = 9;
+        }
+        for (i = (int)len - 1; i > 0; i--) {
+                head[i] = (unsigned char)(value & 0xFFU);
+                value >>= 8;
+        }
+        return cbor_put(enc, head, len);
+}
+
+/** Function to convert a single precision float to half precision when it can be
+* done without loss.
+* @param - IEEE 754 single precision bit pattern
+*        - Address to store the half precision bit pattern
+* @return - 1 if the conversion is exact
+*         - 0 otherwise
+**/
+static int cbor_float_to_half(uint32_t bits, uint16_t *half)
+{
+        uint16_t sign = (uint16_t)((bits >> 16) & 0x8000U);
+        int exp = (int)((bits >> 23) & 0xFFU);
+        uint32_t mant = bits & 0x7FFFFFU;
+        int e;
+
+        if (exp == 0xFF) {
+                *half = (mant == 0) ? (uint16_t)(sign | 0x7C00U) : (uint16_t)0x7E00U;
+                return 1;
+        }
+        if (exp == 0 && mant == 0) {
+                *half = sign;
+                return 1;
+        }
+        e = exp - 127 + 15;
+        if (e >= 31)
+                return 0;
+        if (e <= 0) {
+                //Half precision subnormal: value = m * 2^-24
+                uint32_t full = mant | 0x800000U;
+                int shift = 14 - e;
+                if (exp == 0 || shift > 24 || (full & ((1U << shift) - 1U)) != 0)
+                        return 0;
+                *half = (uint16_t)(sign | (full >> shift));
+                return 1;
+        }
+        if (mant & 0x1FFFU)
+                return 0;
+        *half = (uint16_t)(sign | (e << 10) | (mant >> 13));
+        return 1;
+}
+
+/** Function to initialize the encoder with the output buffer
+* @param - Address of encoder
+*        - Output buffer
+*        - Size of output buffer
+* @return - void
+**/
+void iotf_cbor_encoder_init(iotf_cbor_encoder *enc, unsigned char *buf, size_t size)
+{
+        enc->buf = buf;
+        enc->size = size;
+        enc->len = 0;
+        enc->error = 0;
+}
+
+/** Function to encode an unsigned integer
+* @param - Address of encoder
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_uint(iotf_cbor_encoder *enc, uint64_t value)
+{
+        return cbor_head(enc, CBOR_UINT, value);
+}
+
+/** Function to encode a signed integer
+* @param - Address of encoder
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_int(iotf_cbor_encoder *enc, int64_t value)
+{
+        if (value >= 0)
+                return cbor_head(enc, CBOR_UINT, (uint64_t)value);
+        return cbor_head(enc, CBOR_NEGINT, (uint64_t)(-(value + 1)));
+}
+
+/** Function to encode a floating point number. The smallest of half, single or
+* double precision which represents the value exactly is used.
+* @param - Address of encoder
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_float(iotf_cbor_encoder *enc, double value)
+{
+        unsigned char out[9];
+        float f = (float)value;
+        uint16_t half;
+        uint32_t bits32;
+        uint64_t bits64;
+        int i;
+
+        if ((double)f == value || value != value) {
+                memcpy(&bits32, &f, sizeof(bits32));
+                if (cbor_float_to_half(bits32, &half)) {
+                        out[0] = 0xF9;
+                        out[1] = (unsigned char)(half >> 8);
+                        out[2] = (unsigned char)half;
+                        return cbor_put(enc, out, 3);
+                }
+                out[0] = 0xFA;
+                for (i = 4; i > 0; i--) {
+                        out[i] = (unsigned char)(bits32 & 0xFFU);
+                        bits32 >>= 8;
+                }
+                return cbor_put(enc, out, 5);
+        }
+
+        memcpy(&bits64, &value, sizeof(bits64));
+        out[0] = 0xFB;
+        for (i = 8; i > 0; i--) {
+                out[i] = (unsigned char)(bits64 & 0xFFU);
+                bits64 >>= 8;
+        }
+        return cbor_put(enc, out, 9);
+}
+
+/** Function to encode a boolean
+* @param - Address of encoder
+*        - 0 for false, any other value for true
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_bool(iotf_cbor_encoder *enc, int value)
+{
+        unsigned char b = value ? 0xF5 : 0xF4;
+        return cbor_put(enc, &b, 1);
+}
+
+/** Function to encode null
+* @param - Address of encoder
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_null(iotf_cbor_encoder *enc)
+{
+        unsigned char b = 0xF6;
+        return cbor_put(enc, &b, 1);
+}
+
+/** Function to encode a UTF-8 text string of given length
+* @param - Address of encoder
+*        - String
+*        - Length of string in bytes
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_text(iotf_cbor_encoder *enc, const char *str, size_t len)
+{
+        if (cbor_head(enc, CBOR_TEXT, len) != 0)
+                return enc->error;
+        return cbor_put(enc, str, len);
+}
+
+/** Function to encode a NUL terminated UTF-8 text string
+* @param - Address of encoder
+*        - String
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_cstr(iotf_cbor_encoder *enc, const char *str)
+{
+        return iotf_cbor_text(enc, str, strlen(str));
+}
+
+/** Function to encode a byte string
+* @param - Address of encoder
+*        - Data
+*        - Length of data in bytes
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_bytes(iotf_cbor_encoder *enc, const void *data, size_t len)
+{
+        if (cbor_head(enc, CBOR_BYTES, len) != 0)
+                return enc->error;
+        return cbor_put(enc, data, len);
+}
+
+/** Function to start an array with known number of items
+* @param - Address of encoder
+*        - Number of items following
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_array(iotf_cbor_encoder *enc, size_t count)
+{
+        return cbor_head(enc, CBOR_ARRAY, count);
+}
+
+/** Function to start a map with known number of key/value pairs
+* @param - Address of encoder
+*        - Number of pairs following
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_map(iotf_cbor_encoder *enc, size_t pairs)
+{
+        return cbor_head(enc, CBOR_MAP, pairs);
+}
+
+/** Function to start an array of unknown size, terminated by iotf_cbor_break
+* @param - Address of encoder
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_array_indefinite(iotf_cbor_encoder *enc)
+{
+        unsigned char b = (CBOR_ARRAY << 5) | 31;
+        return cbor_put(enc, &b, 1);
+}
+
+/** Function to start a map of unknown size, terminated by iotf_cbor_break
+* @param - Address of encoder
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_map_indefinite(iotf_cbor_encoder *enc)
+{
+        unsigned char b = (CBOR_MAP << 5) | 31;
+        return cbor_put(enc, &b, 1);
+}
+
+/** Function to terminate an indefinite length array or map
+* @param - Address of encoder
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_break(iotf_cbor_encoder *enc)
+{
+        unsigned char b = 0xFF;
+        return cbor_put(enc, &b, 1);
+}
+
+/** Function to get the number of bytes encoded so far
+* @param - Address of encoder
+* @return - Encoded length on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW if any write did not fit into the buffer
+**/
+int iotf_cbor_length(iotf_cbor_encoder *enc)
+{
+        if (enc->error)
+                return enc->error;
+        return (int)enc->len;
+}
+
+/** Function to start a Watson IoT event record {"d": {...}}
+* @param - Address of encoder
+*        - Output buffer
+*        - Size of output buffer
+* @return - void
+**/
+void iotf_cbor_record_begin(iotf_cbor_encoder *enc, unsigned char *buf, size_t size)
+{
+        iotf_cbor_encoder_init(enc, buf, size);
+        iotf_cbor_map(enc, 1);
+        iotf_cbor_text(enc, "d", 1);
+        iotf_cbor_map_indefinite(enc);
+}
+
+/** Function to add an integer field to the record
+* @param - Address of encoder
+*        - Field name
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_record_int(iotf_cbor_encoder *enc, const char *key, int64_t value)
+{
+        iotf_cbor_cstr(enc, key);
+        return iotf_cbor_int(enc, value);
+}
+
+/** Function to add a floating point field to the record
+* @param - Address of encoder
+*        - Field name
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_record_float(iotf_cbor_encoder *enc, const char *key, double value)
+{
+        iotf_cbor_cstr(enc, key);
+        return iotf_cbor_float(enc, value);
+}
+
+/** Function to add a boolean field to the record
+* @param - Address of encoder
+*        - Field name
+*        - Value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_record_bool(iotf_cbor_encoder *enc, const char *key, int value)
+{
+        iotf_cbor_cstr(enc, key);
+        return iotf_cbor_bool(enc, value);
+}
+
+/** Function to add a text field to the record
+* @param - Address of encoder
+*        - Field name
+*        - NUL terminated value
+* @return - 0 on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_record_text(iotf_cbor_encoder *enc, const char *key, const char *value)
+{
+        iotf_cbor_cstr(enc, key);
+        return iotf_cbor_cstr(enc, value);
+}
+
+/** Function to finish the record
+* @param - Address of encoder
+* @return - Length of the encoded record on SUCCESS
+*         - CBOR_BUFFER_OVERFLOW on FAILURE
+**/
+int iotf_cbor_record_end(iotf_cbor_encoder *enc)
+{
+        iotf_cbor_break(enc);
+        return iotf_cbor_length(enc);
+}
+
+/** Function to initialize the decoder with a received payload
+* @param - Address of decoder
+*        - Payload
+*        - Payload length in bytes
+* @return - void
+**/
+void iotf_cbor_decoder_init(iotf_cbor_decoder *dec, const void *buf, size_t len)
+{
+        dec->ptr = (const unsigned char *)buf;
+        dec->end = dec->ptr + len;
+        dec->error = 0;
+}
+
+/** Function to convert a half precision bit pattern to double
+* @param - Half precision bit pattern
+* @return - Value
+**/
+static double cbor_half_to_double(uint16_t half)
+{
+        int exp = (half >> 10) & 0x1F;
+        int mant = half & 0x3FF;
+        double value;
+
+        if (exp == 0)
+                value = ldexp(mant, -24);
+        else if (exp != 31)
+                value = ldexp(mant + 1024, exp - 25);
+        else
+                value = (mant == 0) ? INFINITY : NAN;
+
+        return (half & 0x8000U) ? -value : value;
+}
+
+/** Function to decode the next data item header. For strings the data pointer and length
+* are returned and the string is consumed; for arrays and maps only the header is consumed
+* and the contained items are returned by subsequent calls.
+* @param - Address of decoder
+*        - Address of item to fill
+* @return - 0 on SUCCESS
+*         - CBOR_END when the payload is exhausted
+*         - CBOR_RANGE for a negative integer below INT64_MIN
+*         - CBOR_MALFORMED on FAILURE
+**/
+int iotf_cbor_next(iotf_cbor_decoder *dec, iotf_cbor_item *item)
+{
+        int major, info, i, size;
+        uint64_t value = 0;
+
+        if (dec->error)
+                return dec->error;
+        if (dec->ptr >= dec->end)
+                return CBOR_END;
+
+        memset(item, 0, sizeof(*item));
+        major = *dec->ptr >> 5;
+        info = *dec->ptr & 0x1F;
+        dec->ptr++;
+
+        if (info < 24)
+                value = (uint64_t)info;
+        else if (info <= 27) {
+                size = 1 << (info - 24);
+                if (dec->end - dec->ptr < size)
+                        goto malformed;
+                for (i = 0; i < size; i++)
+                        value = (value << 8) | *dec->ptr++;
+        }
+        else if (info == 31) {
+                if (major == CBOR_UINT || major == CBOR_NEGINT || major == CBOR_TAG)
+                        goto malformed;
+                item->indefinite = 1;
+        }
+        else
+                goto malformed;
+
+        item->type = major;
+        item->value = value;
+
+        switch (major) {
+        case CBOR_UINT:
+                item->intValue = (int64_t)value;
+                break;
+        case CBOR_NEGINT:
+                //-1 - value is below INT64_MIN once value exceeds INT64_MAX
+                if (value > (uint64_t)INT64_MAX) {
+                        dec->error = CBOR_RANGE;
+                        return dec->error;
+                }
+                item->intValue = -1 - (int64_t)value;
+                break;
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+                if (!item->indefinite) {
+                        if ((uint64_t)(dec->end - dec->ptr) < value)
+                                goto malformed;
+                        item->data = dec->ptr;
+                        dec->ptr += value;
+                }
+                break;
+        case CBOR_SIMPLE:
+                switch (info) {
+                case 20: item->type = CBOR_FALSE; break;
+                case 21: item->type = CBOR_TRUE; break;
+                case 22: item->type = CBOR_NULL; break;
+                case 23: item->type = CBOR_UNDEFINED; break;
+                case 25:
+                        item->type = CBOR_FLOAT;
+                        item->floatValue = cbor_half_to_double((uint16_t)value);
+                        break;
+                case 26: {
+                        uint32_t bits32 = (uint32_t)value;
+                        float f;
+                        memcpy(&f, &bits32, sizeof(f));
+                        item->type = CBOR_FLOAT;
+                        item->floatValue = f;
+                        break;
+                }
+                case 27:
+                        item->type = CBOR_FLOAT;
+                        memcpy(&item->floatValue, &value, sizeof(item->floatValue));
+                        break;
+                case 31:
+                        item->type = CBOR_BREAK;
+                        item->indefinite = 0;
+                        break;
+                default:
+                        break;
+                }
+                break;
+        default:
+                break;
+        }
+        return 0;
+
+ malformed:
+        dec->error = CBOR_MALFORMED;
+        return dec->error;
+}
+
+/** Function to skip the contents of an item already returned by iotf_cbor_next,
+* i.e. all chunks of an indefinite string or all items of an array or map.
+* @param - Address of decoder
+*        - Address of item returned by iotf_cbor_next
+*        - Current nesting depth
+* @return - 0 on SUCCESS
+*         - CBOR_MALFORMED on FAILURE
+**/
+static int cbor_skip_depth(iotf_cbor_decoder *dec, iotf_cbor_item *item, int depth)
+{
+        iotf_cbor_item child;
+        uint64_t count;
+        int rc;
+
+        if (depth > CBOR_MAX_DEPTH) {
+                dec->error = CBOR_MALFORMED;
+                return dec->error;
+        }
+
+        switch (item->type) {
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+        case CBOR_ARRAY:
+        case CBOR_MAP:
+        case CBOR_TAG:
+                break;
+        default:
+                return 0;
+        }
+
+        if (item->type == CBOR_TAG) {
+                if ((rc = iotf_cbor_next(dec, &child)) != 0)
+                        goto error;
+                return cbor_skip_depth(dec, &child, depth + 1);
+        }
+
+        if (item->indefinite) {
+                for (;;) {
+                        if ((rc = iotf_cbor_next(dec, &child)) != 0)
+                                goto error;
+                        if (child.type == CBOR_BREAK)
+                                return 0;
+                        if ((rc = cbor_skip_depth(dec, &child, depth + 1)) != 0)
+                                return rc;
+                }
+        }
+
+        if (item->type == CBOR_BYTES || item->type == CBOR_TEXT)
+                return 0;
+
+        count = (item->type == CBOR_MAP) ? item->value * 2 : item->value;
+        while (count--) {
+                if ((rc = iotf_cbor_next(dec, &child)) != 0)
+                        goto error;
+                if (child.type == CBOR_BREAK) {
+                        dec->error = CBOR_MALFORMED;
+                        return dec->error;
+                }
+                if ((rc = cbor_skip_depth(dec, &child, depth + 1)) != 0)
+                        return rc;
+        }
+        return 0;
+
+ error:
+        //Running out of data inside a container is malformed input
+        dec->error = CBOR_MALFORMED;
+        return dec->error;
+}
+
+/** Function to skip the contents of an item already returned by iotf_cbor_next
+* @param - Address of decoder
+*        - Address of item returned by iotf_cbor_next
+* @return - 0 on SUCCESS
+*         - CBOR_MALFORMED on FAILURE
+**/
+int iotf_cbor_skip(iotf_cbor_decoder *dec, iotf_cbor_item *item)
+{
+        return cbor_skip_depth(dec, item, 0);
+}
+
+/** Function to look up a text key in a map whose header was just returned by iotf_cbor_next.
+* On success the decoder is positioned right after the header of the value, so nested
+* arrays and maps can be walked further. The map is consumed by the lookup.
+* @param - Address of decoder
+*        - Address of map item returned by iotf_cbor_next
+*        - Key to look for
+*        - Address of item to store the value
+* @return - 0 on SUCCESS
+*         - CBOR_END if the key is not present
+*         - CBOR_MALFORMED on FAILURE
+**/
+int iotf_cbor_map_find(iotf_cbor_decoder *dec, iotf_cbor_item *map, const char *key, iotf_cbor_item *item)
+{
+        iotf_cbor_item name;
+        size_t keyLen = strlen(key);
+        uint64_t pairs = map->value;
+        int rc;
+
+        if (map->type != CBOR_MAP)
+                return CBOR_MALFORMED;
+
+        while (map->indefinite || pairs--) {
+                if ((rc = iotf_cbor_next(dec, &name)) != 0)
+                        return (rc == CBOR_END) ? CBOR_MALFORMED : rc;
+                if (name.type == CBOR_BREAK && map->indefinite)
+                        break;
+                //An indefinite or container key is skipped before its value is read
+                if ((rc = iotf_cbor_skip(dec, &name)) != 0)
+                        return rc;
+                if ((rc = iotf_cbor_next(dec, item)) != 0)
+                        return (rc == CBOR_END) ? CBOR_MALFORMED : rc;
+                if (name.type == CBOR_TEXT && !name.indefinite && name.value == keyLen &&
+                    memcmp(name.data, key, keyLen) == 0)
+                        return 0;
+                if ((rc = iotf_cbor_skip(dec, item)) != 0)
+                        return rc;
+        }
+        return CBOR_END;
+}
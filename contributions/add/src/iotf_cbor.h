@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the CBOR (RFC 7049) encoder/decoder declarations
+ *******************************************************************************/
+
+#ifndef IOTF_CBOR_H_
+#define IOTF_CBOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Event format string to be passed as eventFormat when publishing CBOR payloads
+#define IOTF_CBOR_FORMAT "cbor"
+
+enum cborErrors { CBOR_BUFFER_OVERFLOW = -1, CBOR_MALFORMED = -2, CBOR_END = -3, CBOR_RANGE = -4 };
+
+//CBOR major types
+enum cborTypes {
+        CBOR_UINT = 0,
+        CBOR_NEGINT = 1,
+        CBOR_BYTES = 2,
+        CBOR_TEXT = 3,
+        CBOR_ARRAY = 4,
+        CBOR_MAP = 5,
+        CBOR_TAG = 6,
+        CBOR_SIMPLE = 7,
+        //Decoded forms of major type 7
+        CBOR_FALSE,
+        CBOR_TRUE,
+        CBOR_NULL,
+        CBOR_UNDEFINED,
+        CBOR_FLOAT,
+        CBOR_BREAK
+};
+
+//Encoder state. All writes go straight into the caller supplied buffer.
+typedef struct
+{
+        unsigned char *buf;
+        size_t size;
+        size_t len;
+        int error;
+} iotf_cbor_encoder;
+
+//Decoder state working on a received payload (payload need not be NUL terminated)
+typedef struct
+{
+        const unsigned char *ptr;
+        const unsigned char *end;
+        int error;
+} iotf_cbor_decoder;
+
+//Single decoded data item
+typedef struct
+{
+        int type;
+        int indefinite;     //1 for indefinite length strings, arrays and maps
+        uint64_t value;     //Unsigned value, tag number, string length or container item count
+        int64_t intValue;   //Signed value for CBOR_UINT up to INT64_MAX and CBOR_NEGINT
+        double floatValue;  //Value for CBOR_FLOAT
+        const unsigned char *data; //Start of string data for CBOR_BYTES and CBOR_TEXT
+} iotf_cbor_item;
+
+//Encoder functions
+void iotf_cbor_encoder_init(iotf_cbor_encoder *enc, unsigned char *buf, size_t size);
+int iotf_cbor_uint(iotf_cbor_encoder *enc, uint64_t value);
+int iotf_cbor_int(iotf_cbor_encoder *enc, int64_t value);
+int iotf_cbor_float(iotf_cbor_encoder *enc, double value);
+int iotf_cbor_bool(iotf_cbor_encoder *enc, int value);
+int iotf_cbor_null(iotf_cbor_encoder *enc);
+int iotf_cbor_text(iotf_cbor_encoder *enc, const char *str, size_t len);
+int iotf_cbor_cstr(iotf_cbor_encoder *enc, const char *str);
+int iotf_cbor_bytes(iotf_cbor_encoder *enc, const void *data, size_t len);
+int iotf_cbor_array(iotf_cbor_encoder *enc, size_t count);
+int iotf_cbor_map(iotf_cbor_encoder *enc, size_t pairs);
+int iotf_cbor_array_indefinite(iotf_cbor_encoder *enc);
+int iotf_cbor_map_indefinite(iotf_cbor_encoder *enc);
+int iotf_cbor_break(iotf_cbor_encoder *enc);
+int iotf_cbor_length(iotf_cbor_encoder *enc);
+
+/**
+* Typed record builder. Produces the Watson IoT event layout {"d": {key: value, ...}}
+* without any text formatting:
+*
+*   iotf_cbor_record_begin(&enc, buf, sizeof(buf));
+*   iotf_cbor_record_int(&enc, "temp", 34);
+*   iotf_cbor_record_float(&enc, "humidity", 41.5);
+*   len = iotf_cbor_record_end(&enc);
+*   publishEventData(&client, "status", IOTF_CBOR_FORMAT, buf, len, QOS0);
+**/
+void iotf_cbor_record_begin(iotf_cbor_encoder *enc, unsigned char *buf, size_t size);
+int iotf_cbor_record_int(iotf_cbor_encoder *enc, const char *key, int64_t value);
+int iotf_cbor_record_float(iotf_cbor_encoder *enc, const char *key, double value);
+int iotf_cbor_record_bool(iotf_cbor_encoder *enc, const char *key, int value);
+int iotf_cbor_record_text(iotf_cbor_encoder *enc, const char *key, const char *value);
+int iotf_cbor_record_end(iotf_cbor_encoder *enc);
+
+//Decoder functions
+void iotf_cbor_decoder_init(iotf_cbor_decoder *dec, const void *buf, size_t len);
+int iotf_cbor_next(iotf_cbor_decoder *dec, iotf_cbor_item *item);
+int iotf_cbor_skip(iotf_cbor_decoder *dec, iotf_cbor_item *item);
+int iotf_cbor_map_find(iotf_cbor_decoder *dec, iotf_cbor_item *map, const char *key, iotf_cbor_item *item);
+
+#endif
@@ -0,0 +1,329 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the client configuration storage definitions
+ *******************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "iotf_config.h"
+#include "iotf_alloc.h"
+
+#define CONFIG_FIELDS   15
+
+//Slot of a key in configKeys, perfect for the keys below. Keys are at least 2 long.
+#define CONFIG_KEY_HASH(key, len) (((len) + (uint8_t)(key)[0] + 9U * (uint8_t)(key)[1]) & 31U)
+
+enum { CONFIG_STRING = 1, CONFIG_ORG, CONFIG_DOMAIN, CONFIG_CERT, CONFIG_USECERTS, CONFIG_PORT };
+
+typedef struct
+{
+        const char *name;
+        uint8_t len;
+        uint8_t kind;
+        uint16_t field;         //offset of the field in Config
+} config_key;
+
+#define KEY(slot, key, kind, field) [slot] = { key, sizeof(key) - 1, kind, offsetof(Config, field) }
+
+static const config_key configKeys[32] = {
+        KEY(20, "org",                   CONFIG_ORG,      org),
+        KEY(17, "domain",                CONFIG_DOMAIN,   domain),
+        KEY(25, "type",                  CONFIG_STRING,   type),
+        KEY(15, "id",                    CONFIG_STRING,   id),
+        KEY( 8, "auth-token",            CONFIG_STRING,   authtoken),
+        KEY( 9, "auth-method",           CONFIG_STRING,   authmethod),
+        KEY(14, "serverCertPath",        CONFIG_CERT,     serverCertPath),
+        KEY( 7, "rootCACertPath",        CONFIG_STRING,   rootCACertPath),
+        KEY(29, "clientCertPath",        CONFIG_STRING,   clientCertPath),
+        KEY(28, "clientKeyPath",         CONFIG_STRING,   clientKeyPath),
+        KEY(21, "useClientCertificates", CONFIG_USECERTS, useClientCertificates),
+        KEY(19, "host",                  CONFIG_STRING,   host),
+        KEY(27, "port",                  CONFIG_PORT,     port),
+        KEY( 6, "pskIdentity",           CONFIG_STRING,   pskIdentity),
+        KEY(30, "psk",                   CONFIG_STRING,   psk),
+        KEY(22, "hostIPs",               CONFIG_STRING,   hostIPs),
+};
+
+//String fields of a configuration that are set, sorted by address
+static int config_fields(Config *cfg, char **fields[CONFIG_FIELDS])
+{
+        char **all[CONFIG_FIELDS] = {
+                &cfg->org, &cfg->domain, &cfg->type, &cfg->id, &cfg->authmethod, &cfg->authtoken,
+                &cfg->serverCertPath, &cfg->rootCACertPath, &cfg->clientCertPath, &cfg->clientKeyPath,
+                &cfg->host, &cfg->hostname, &cfg->pskIdentity, &cfg->psk,
+                &cfg->hostIPs
+        };
+        int i, j, n = 0;
+
+        for (i = 0; i < CONFIG_FIELDS; i++) {
+                if (*all[i] == NULL)
+                        continue;
+                for (j = n; j > 0 && *fields[j - 1] > *all[i]; j--)
+                        fields[j] = fields[j - 1];
+                fields[j] = all[i];
+                n++;
+        }
+        return n;
+}
+
+//Moves the live strings to the start of the arena, dropping the space of replaced values
+static void config_compact(Config *cfg)
+{
+        char **fields[CONFIG_FIELDS];
+        int i, n = config_fields(cfg, fields);
+        size_t used = 0;
+
+        for (i = 0; i < n; i++) {
+                size_t len = strlen(*fields[i]) + 1;
+
+                memmove(cfg->arena + used, *fields[i], len);
+                *fields[i] = cfg->arena + used;
+                used += len;
+        }
+        cfg->arenaUsed = used;
+}
+
+//Replaces the arena with one that has room for need more bytes
+static int config_grow(Config *cfg, size_t need)
+{
+#ifdef IOTF_CONFIG_STATIC
+        (void)cfg;
+        (void)need;
+        return -1;
+#else
+        char **fields[CONFIG_FIELDS];
+        size_t size = (cfg->arenaSize > 0) ? cfg->arenaSize * 2 : IOTF_CONFIG_ARENA_SIZE;
+        char *arena;
+        int i, n;
+
+        while (size < cfg->arenaUsed + need)
+                size *= 2;
+        if ((arena = iotf_malloc(size)) == NULL)
+                return -1;
+        if (cfg->arena != NULL) {
+                memcpy(arena, cfg->arena, cfg->arenaUsed);
+                n = config_fields(cfg, fields);
+                for (i = 0; i < n; i++)
+                        *fields[i] = arena + (*fields[i] - cfg->arena);
+                iotf_free(cfg->arena);
+        }
+        cfg->arena = arena;
+        cfg->arenaSize = size;
+        return 0;
+#endif
+}
+
+void config_init(Config *cfg)
+{
+        cfg->org = cfg->domain = cfg->type = cfg->id = NULL;
+        cfg->authmethod = cfg->authtoken = NULL;
+        cfg->serverCertPath = cfg->rootCACertPath = cfg->clientCertPath = cfg->clientKeyPath = NULL;
+        cfg->host = cfg->hostname = NULL;
+        cfg->pskIdentity = cfg->psk = NULL;
+        cfg->hostIPs = NULL;
+        cfg->port = 0;
+        cfg->useClientCertificates = 0;
+#ifdef IOTF_CONFIG_STATIC
+        cfg->arenaSize = sizeof(cfg->arena);
+#else
+        cfg->arena = NULL;
+        cfg->arenaSize = 0;
+#endif
+        cfg->arenaUsed = 0;
+}
+
+char *config_reserve(Config *cfg, char **field, size_t len)
+{
+        char *p;
+
+        *field = NULL;
+        if (cfg->arenaSize - cfg->arenaUsed <= len) {
+                config_compact(cfg);
+                if (cfg->arenaSize - cfg->arenaUsed <= len && config_grow(cfg, len + 1) != 0)
+                        return NULL;
+        }
+        p = cfg->arena + cfg->arenaUsed;
+        cfg->arenaUsed += len + 1;
+        p[len] = '\0';
+        *field = p;
+        return p;
+}
+
+int config_set(Config *cfg, char **field, const char *value, size_t len)
+{
+        char *p = config_reserve(cfg, field, len);
+
+        if (p == NULL)
+                return -1;
+        memcpy(p, value, len);
+        return 0;
+}
+
+int config_set_str(Config *cfg, char **field, const char *value)
+{
+        return config_set(cfg, field, value, strlen(value));
+}
+
+int config_set_path(Config *cfg, char **field, const char *file)
+{
+        const char *home = getenv("IOT_EMBDC_HOME");
+        size_t homeLen, fileLen = strlen(file);
+        char *p;
+
+        if (home == NULL || strlen(home) <= 1)
+                home = ".";
+        homeLen = strlen(home);
+        if ((p = config_reserve(cfg, field, homeLen + fileLen)) == NULL)
+                return -1;
+        memcpy(p, home, homeLen);
+        memcpy(p + homeLen, file, fileLen);
+        return 0;
+}
+
+static int config_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * Stores one value. Values of one character are ignored and domain and serverCertPath
+ * fall back to their defaults, as get_config has always done.
+ * Returns 0, 1 if the value is invalid or -1 if it does not fit.
+ */
+static int config_apply(Config *cfg, const char *key, size_t klen, const char *value, size_t vlen)
+{
+        const config_key *ck;
+        char *field;
+        uint32_t port = 0;
+        size_t i;
+
+        if (klen < 2 || klen > 255)
+                return 0;
+        ck = &configKeys[CONFIG_KEY_HASH(key, klen)];
+        if (ck->name == NULL || ck->len != klen || memcmp(ck->name, key, klen) != 0)
+                return 0;
+        field = (char *)cfg + ck->field;
+
+        switch (ck->kind) {
+        case CONFIG_STRING:
+                if (vlen > 1)
+                        return config_set(cfg, (char **)field, value, vlen);
+                break;
+        case CONFIG_ORG:
+                if (vlen > 1 && config_set(cfg, (char **)field, value, vlen) != 0)
+                        return -1;
+                break;
+        case CONFIG_DOMAIN:
+                if (vlen <= 1)
+                        return config_set_str(cfg, (char **)field, "internetofthings.ibmcloud.com");
+                return config_set(cfg, (char **)field, value, vlen);
+        case CONFIG_CERT:
+                if (vlen <= 1)
+                        return config_set_path(cfg, (char **)field, "/IoTFoundation.pem");
+                return config_set(cfg, (char **)field, value, vlen);
+        case CONFIG_USECERTS:
+                if (vlen != 1 || value[0] < '0' || value[0] > '9')
+                        return 1;
+                *(int *)field = value[0] - '0';
+                break;
+        case CONFIG_PORT:
+                for (i = 0; i < vlen; i++) {
+                        if (value[i] < '0' || value[i] > '9' || (port = port * 10U + (uint32_t)(value[i] - '0')) > 65535U)
+                                return 1;
+                }
+                if (port > 0)
+                        *(int *)field = (int)port;
+                break;
+        }
+        return 0;
+}
+
+//Parses the line from s to e, without the newline. Returns as config_apply.
+static int config_line(Config *cfg, const char *s, const char *e)
+{
+        const char *key, *keyEnd, *value;
+
+        while (s < e && config_space(*s))
+                s++;
+        while (e > s && config_space(e[-1]))
+                e--;
+        if (s == e || *s == '#')
+                return 0;
+
+        key = s;
+        if ((s = memchr(s, '=', (size_t)(e - s))) == NULL)
+                return 1;
+        for (keyEnd = s; keyEnd > key && config_space(keyEnd[-1]); keyEnd--)
+                ;
+        if (keyEnd == key)
+                return 1;
+
+        for (value = s + 1; value < e && config_space(*value); value++)
+                ;
+        if (value < e && (*value == '"' || *value == '\'')) {
+                const char *quote = memchr(value + 1, *value, (size_t)(e - value - 1));
+
+                if (quote == NULL || quote + 1 != e)
+                        return 1;
+                value++;
+                e = quote;
+        }
+        return config_apply(cfg, key, (size_t)(keyEnd - key), value, (size_t)(e - value));
+}
+
+int config_parse(Config *cfg, const char *text, size_t len, size_t *consumed, int *line)
+{
+        const char *p = text, *end = text + len;
+        int rc = 0;
+
+        while (p < end) {
+                const char *eol = memchr(p, '\n', (size_t)(end - p));
+
+                if (eol == NULL) {
+                        if (consumed != NULL)
+                                break;
+                        eol = end;
+                }
+                (*line)++;
+                if ((rc = config_line(cfg, p, eol)) != 0) {
+                        if (rc > 0)
+                                rc = *line;
+                        break;
+                }
+                p = (eol < end) ? eol + 1 : end;
+        }
+        if (consumed != NULL)
+                *consumed = (size_t)(p - text);
+        return rc;
+}
+
+int config_finish(Config *cfg)
+{
+        if (cfg->port == 0)
+                cfg->port = (cfg->org != NULL && strcmp(cfg->org, "quickstart") != 0) ? 8883 : 1883;
+        if (cfg->domain == NULL)
+                return config_set_str(cfg, &cfg->domain, "internetofthings.ibmcloud.com");
+        return 0;
+}
+
+void config_release(Config *cfg)
+{
+#ifndef IOTF_CONFIG_STATIC
+        iotf_free(cfg->arena);
+#endif
+        config_init(cfg);
+}
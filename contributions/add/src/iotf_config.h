@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the client configuration storage declarations
+ *******************************************************************************/
+
+#ifndef IOTF_CONFIG_H_
+#define IOTF_CONFIG_H_
+
+#include <stddef.h>
+
+/*
+ * All strings of a configuration live in one arena. By default the arena is a single
+ * heap block of IOTF_CONFIG_ARENA_SIZE bytes that grows if a configuration needs more.
+ * With IOTF_CONFIG_STATIC defined the arena is part of the structure, the configuration
+ * never touches the heap and a configuration that does not fit is rejected.
+ */
+#ifndef IOTF_CONFIG_ARENA_SIZE
+#define IOTF_CONFIG_ARENA_SIZE  512
+#endif
+
+//configuration file structure
+struct iotf_config
+{
+       char* org;
+       char* domain;
+       char* type;
+       char* id;
+       char* authmethod;
+       char* authtoken;
+       char* serverCertPath;
+       char* rootCACertPath;
+       char* clientCertPath;
+       char* clientKeyPath;
+       int port;
+       int useClientCertificates;
+       char* host;
+       char* hostname;                  //<org>.messaging.<domain>, set on the first connect
+       char* pskIdentity;
+       char* psk;                       //pre-shared key in hex, TLS without certificates if set
+       char* hostIPs;                   //IPv4 addresses of the broker separated by commas, DNS is not used if set
+#ifdef IOTF_CONFIG_STATIC
+       char arena[IOTF_CONFIG_ARENA_SIZE];
+#else
+       char *arena;
+#endif
+       size_t arenaSize;
+       size_t arenaUsed;
+};
+
+typedef struct iotf_config Config;
+
+/**
+* Function to clear a configuration, port 0 (not given) and no strings. Releases nothing.
+* A configuration must not be copied, its strings point into its own arena.
+* @param - Configuration
+* @return - void
+**/
+void config_init(Config *cfg);
+
+/**
+* Function to make room for a string of a configuration. The previous value of the
+* field is dropped. Space of dropped values is reclaimed when the arena runs full.
+* @param - Configuration
+*        - Field of the configuration, e.g. &cfg->org
+*        - Length of the string without the terminator
+* @return - Buffer of len + 1 bytes now referenced by the field, NULL if it does not fit
+**/
+char *config_reserve(Config *cfg, char **field, size_t len);
+
+/**
+* Function to store a string in a configuration
+* @param - Configuration
+*        - Field of the configuration
+*        - Value and its length, the value need not be terminated and must not point
+*          into the arena
+* @return - 0 or -1 if it does not fit
+**/
+int config_set(Config *cfg, char **field, const char *value, size_t len);
+
+//Same as config_set with a terminated value
+int config_set_str(Config *cfg, char **field, const char *value);
+
+/**
+* Function to store IOT_EMBDC_HOME followed by a file name, or "." followed by the file
+* name if IOT_EMBDC_HOME is not defined, as buildPath does
+* @param - Configuration
+*        - Field of the configuration
+*        - File name starting with '/'
+* @return - 0 or -1 if it does not fit
+**/
+int config_set_path(Config *cfg, char **field, const char *file);
+
+/**
+* Function to parse configuration text in the device.cfg format, one key=value per line.
+* Keys and values are trimmed, a value may be quoted with " or ' to keep white space,
+* lines starting with # are comments and unknown keys are ignored. Lines without a key
+* and '=', with an unterminated quote or an invalid port or useClientCertificates value
+* are malformed. Only the values are copied, into the arena.
+* @param - Configuration set up with config_init
+*        - Text and its length
+*        - NULL if the text is complete. Otherwise the text is a chunk of a longer one,
+*          parsing stops before the last incomplete line and the number of bytes
+*          parsed is stored here.
+*        - Line counter, incremented for every line parsed
+* @return - 0, -1 if a value does not fit, or the number of the first malformed line
+**/
+int config_parse(Config *cfg, const char *text, size_t len, size_t *consumed, int *line);
+
+/**
+* Function to fill in what a configuration did not give once all of it is known: port
+* 8883, or 1883 for quickstart, and the internetofthings.ibmcloud.com domain. The port
+* does not depend on where the org and port keys appear in a file.
+* @param - Configuration
+* @return - 0 or -1 if the domain does not fit
+**/
+int config_finish(Config *cfg);
+
+/**
+* Function to release the arena and clear the configuration
+* @param - Configuration
+* @return - void
+**/
+void config_release(Config *cfg);
+
+#endif
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the gateway connection pool definitions
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iotf_gateway_pool.h"
+
+//Commands for the gateway and for every child device routed through it
+static const char gwpoolCommandTopic[] = "iot-2/type/+/id/+/cmd/+/fmt/+";
+
+//Queued event, topic and payload follow in the same allocation
+typedef struct
+{
+        uint32_t hash;
+        enum QoS qos;
+        size_t len;
+        char *topic;
+        void *payload;
+} gwpool_msg;
+
+static uint32_t gwpool_fnv(uint32_t hash, const char *s)
+{
+        while (*s != '\0') {
+                hash ^= (uint8_t)*s++;
+                hash *= 16777619U;
+        }
+        return hash;
+}
+
+static uint32_t gwpool_device_hash(const char *deviceType, const char *deviceId)
+{
+        return gwpool_fnv(gwpool_fnv(gwpool_fnv(2166136261U, deviceType), "/"), deviceId);
+}
+
+//Ring position of a virtual node, murmur3 finalizer over connection and node number
+static uint32_t gwpool_point_hash(uint32_t conn, uint32_t vnode)
+{
+        uint32_t h = conn * 0x9E3779B9U ^ (vnode + 1U) * 0x85EBCA6BU;
+
+        h ^= h >> 16;
+        h *= 0x85EBCA6BU;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35U;
+        h ^= h >> 16;
+        return h;
+}
+
+static int gwpool_point_cmp(const void *a, const void *b)
+{
+        uint32_t x = ((const gwpool_point *)a)->hash, y = ((const gwpool_point *)b)->hash;
+        return (x > y) - (x < y);
+}
+
+//Rebuilds the ring from the connections that are up
+static void gwpool_rebuild(gwpool *pool)
+{
+        int i, v, n = 0;
+
+        osMutexAcquire(pool->ringLock, osWaitForever);
+        for (i = 0; i < pool->count; i++) {
+                if (!pool->conn[i].up)
+                        continue;
+                for (v = 0; v < GWPOOL_VNODES; v++) {
+                        pool->ring[n].hash = gwpool_point_hash((uint32_t)i, (uint32_t)v);
+                        pool->ring[n].conn = (uint8_t)i;
+                        n++;
+                }
+        }
+        qsort(pool->ring, (size_t)n, sizeof(gwpool_point), gwpool_point_cmp);
+        pool->ringLength = n;
+        osMutexRelease(pool->ringLock);
+}
+
+//First point at or after hash, wrapping around. Caller holds ringLock.
+static int gwpool_lookup(gwpool *pool, uint32_t hash)
+{
+        int lo = 0, hi = pool->ringLength;
+
+        if (hi == 0)
+                return -1;
+        while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (pool->ring[mid].hash < hash)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        return pool->ring[(lo == pool->ringLength) ? 0 : lo].conn;
+}
+
+//Queues a message on the connection that owns its hash, 0 on success
+static int gwpool_route(gwpool *pool, gwpool_msg *msg)
+{
+        int rc = -1;
+        int owner;
+
+        osMutexAcquire(pool->ringLock, osWaitForever);
+        owner = gwpool_lookup(pool, msg->hash);
+        if (owner >= 0 && osMessageQueuePut(pool->conn[owner].queue, &msg, 0U, 0U) == osOK)
+                rc = 0;
+        osMutexRelease(pool->ringLock);
+        return rc;
+}
+
+//Takes a connection off the ring and hands its queued events to the new owners
+static void gwpool_conn_down(gwpool_conn *conn)
+{
+        gwpool *pool = conn->pool;
+        gwpool_msg *msg;
+
+        conn->up = 0;
+        gwpool_rebuild(pool);
+        while (osMessageQueueGet(conn->queue, &msg, NULL, 0U) == osOK) {
+                if (gwpool_route(pool, msg) == 0) {
+                        metrics_add(&pool->rerouted, 1);
+                }
+                else {
+                        metrics_add(&pool->dropped, 1);
+                        iotf_free(msg);
+                }
+        }
+}
+
+static void gwpool_worker(void *argument)
+{
+        gwpool_conn *conn = (gwpool_conn *)argument;
+        iotfclient *client = &conn->client;
+        gwpool_msg *msg;
+
+        while (!conn->pool->stop) {
+                if (pollReconnect(client) != SUCCESS) {
+                        if (conn->up)
+                                gwpool_conn_down(conn);
+                        osDelay(GWPOOL_YIELD_MS);
+                        continue;
+                }
+                if (!conn->up) {
+                        //The session is clean after every connect, subscribe again
+                        if (MQTTSubscribe(&client->c, gwpoolCommandTopic, QOS1, gatewayMessageArrived) != SUCCESS) {
+                                client->c.isconnected = 0;
+                                continue;
+                        }
+                        conn->up = 1;
+                        gwpool_rebuild(conn->pool);
+                }
+
+                //Queued QoS0 events leave together, up to IOTF_NETWORK_CORK_SIZE bytes per record
+                corkEvents(client);
+                while (osMessageQueueGet(conn->queue, &msg, NULL, 0U) == osOK) {
+                        if (publishDataLen(&client->c, msg->topic, msg->payload, msg->len, msg->qos) == SUCCESS) {
+                                metrics_add(&conn->published, 1);
+                                iotf_free(msg);
+                                continue;
+                        }
+                        //Lost the connection, give this and the queued events to the other connections
+                        metrics_add(&conn->failed, 1);
+                        client->c.isconnected = 0;
+                        gwpool_conn_down(conn);
+                        if (gwpool_route(conn->pool, msg) != 0) {
+                                metrics_add(&conn->pool->dropped, 1);
+                                iotf_free(msg);
+                        }
+                        break;
+                }
+                if (uncorkEvents(client) != SUCCESS && conn->up)
+                        gwpool_conn_down(conn);
+                if (client->c.isconnected)
+                        yield(client, GWPOOL_YIELD_MS);
+        }
+}
+
+int gwpool_init(gwpool *pool)
+{
+        memset(pool, 0, sizeof(*pool));
+        pool->ringLock = osMutexNew(NULL);
+        return (pool->ringLock != NULL) ? SUCCESS : -1;
+}
+
+int gwpool_add(gwpool *pool, char *configFilePath)
+{
+        gwpool_conn *conn;
+        int rc;
+
+        if (pool->count >= GWPOOL_MAX_CONNECTIONS || configFilePath == NULL)
+                return MISSING_INPUT_PARAM;
+        conn = &pool->conn[pool->count];
+        if ((rc = initialize_configfile(&conn->client, configFilePath, 1)) != SUCCESS)
+                return rc;
+        conn->pool = pool;
+        conn->index = pool->count;
+        return pool->count++;
+}
+
+iotfclient *gwpool_client(gwpool *pool, int index)
+{
+        if (index < 0 || index >= pool->count)
+                return NULL;
+        return &pool->conn[index].client;
+}
+
+int gwpool_start(gwpool *pool)
+{
+        osThreadAttr_t attr;
+        int i;
+
+        //LOG_HDR and LOG_STR write global buffers, the workers would race on them
+        if (logger != NULL)
+                return -2;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.name = "iotf_gwpool";
+        attr.attr_bits = osThreadJoinable;
+        attr.stack_size = GWPOOL_STACK_SIZE;
+
+        for (i = 0; i < pool->count; i++) {
+                gwpool_conn *conn = &pool->conn[i];
+
+                conn->queue = osMessageQueueNew(GWPOOL_QUEUE_LENGTH, sizeof(gwpool_msg *), NULL);
+                if (conn->queue == NULL)
+                        return -1;
+                conn->worker = osThreadNew(gwpool_worker, conn, &attr);
+                if (conn->worker == NULL)
+                        return -1;
+        }
+        return SUCCESS;
+}
+
+int gwpool_publish(gwpool *pool, char *deviceType, char *deviceId, char *eventType, char *eventFormat,
+                   void *data, size_t len, enum QoS qos)
+{
+        size_t topicLen;
+        gwpool_msg *msg;
+
+        if (deviceType == NULL || deviceId == NULL || eventType == NULL || eventFormat == NULL)
+                return MISSING_INPUT_PARAM;
+
+        topicLen = strlen(deviceType) + strlen(deviceId) + strlen(eventType) + strlen(eventFormat) + 25;
+        if ((msg = iotf_malloc(sizeof(gwpool_msg) + topicLen + len)) == NULL)
+                return -1;
+        msg->hash = gwpool_device_hash(deviceType, deviceId);
+        msg->qos = qos;
+        msg->len = len;
+        msg->topic = (char *)(msg + 1);
+        msg->payload = msg->topic + topicLen;
+        sprintf(msg->topic, "iot-2/type/%s/id/%s/evt/%s/fmt/%s", deviceType, deviceId, eventType, eventFormat);
+        memcpy(msg->payload, data, len);
+
+        if (gwpool_route(pool, msg) != 0) {
+                iotf_free(msg);
+                return -1;
+        }
+        return SUCCESS;
+}
+
+int gwpool_owner(gwpool *pool, const char *deviceType, const char *deviceId)
+{
+        int owner;
+
+        osMutexAcquire(pool->ringLock, osWaitForever);
+        owner = gwpool_lookup(pool, gwpool_device_hash(deviceType, deviceId));
+        osMutexRelease(pool->ringLock);
+        return owner;
+}
+
+void gwpool_stop(gwpool *pool)
+{
+        gwpool_msg *msg;
+        int i;
+
+        pool->stop = 1;
+        for (i = 0; i < pool->count; i++) {
+                gwpool_conn *conn = &pool->conn[i];
+
+                if (conn->worker != NULL)
+                        osThreadJoin(conn->worker);
+                conn->worker = NULL;
+                conn->up = 0;
+        }
+        gwpool_rebuild(pool);
+        for (i = 0; i < pool->count; i++) {
+                gwpool_conn *conn = &pool->conn[i];
+
+                if (conn->queue != NULL) {
+                        while (osMessageQueueGet(conn->queue, &msg, NULL, 0U) == osOK)
+                                iotf_free(msg);
+                        osMessageQueueDelete(conn->queue);
+                        conn->queue = NULL;
+                }
+                disconnect(&conn->client);
+        }
+        osMutexDelete(pool->ringLock);
+        pool->ringLock = NULL;
+}
@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the gateway connection pool declarations
+ *******************************************************************************/
+
+#ifndef IOTF_GATEWAY_POOL_H_
+#define IOTF_GATEWAY_POOL_H_
+
+#include "gatewayclient.h"
+#include "cmsis_os2.h"
+
+//Maximum number of gateway connections in a pool
+#ifndef GWPOOL_MAX_CONNECTIONS
+#define GWPOOL_MAX_CONNECTIONS  8
+#endif
+
+//Points per connection on the hash ring, more points give a more even share of child devices
+#define GWPOOL_VNODES           64
+
+//Events that can wait for the worker of one connection
+#ifndef GWPOOL_QUEUE_LENGTH
+#define GWPOOL_QUEUE_LENGTH     64
+#endif
+
+//Stack of a connection worker, it runs the TLS handshake
+#ifndef GWPOOL_STACK_SIZE
+#define GWPOOL_STACK_SIZE       8192
+#endif
+
+//How long a worker waits for commands when it has nothing to send
+#define GWPOOL_YIELD_MS         10
+
+typedef struct gwpool gwpool;
+
+//One gateway connection and the worker that owns it
+typedef struct
+{
+        iotfclient client;
+        gwpool *pool;
+        osThreadId_t worker;
+        osMessageQueueId_t queue;       //gwpool_msg pointers waiting to be published
+        int index;
+        volatile int up;                //connected, subscribed and on the ring
+        uint32_t published;
+        uint32_t failed;
+} gwpool_conn;
+
+typedef struct
+{
+        uint32_t hash;
+        uint8_t conn;
+} gwpool_point;
+
+struct gwpool
+{
+        gwpool_conn conn[GWPOOL_MAX_CONNECTIONS];
+        int count;
+        gwpool_point ring[GWPOOL_MAX_CONNECTIONS * GWPOOL_VNODES];
+        int ringLength;
+        osMutexId_t ringLock;
+        volatile int stop;
+        uint32_t rerouted;              //events moved to another connection when theirs went down
+        uint32_t dropped;               //events lost because no connection could take them
+};
+
+/**
+* Gateway connection pool. Child devices are spread over up to GWPOOL_MAX_CONNECTIONS
+* gateway connections by consistent hashing of "<type>/<id>". Every connection has its own
+* gateway identity (config file), MQTT session and worker thread, which publishes the
+* events queued for it and receives the commands of its child devices. When a connection
+* is lost it leaves the ring, its devices move to the neighbouring connections, and they
+* move back once it has reconnected. Reconnects use pollReconnect, so they are jittered.
+*
+*   gwpool_init(&pool);
+*   gwpool_add(&pool, "gateway1.cfg");
+*   gwpool_add(&pool, "gateway2.cfg");
+*   setGatewayCommandHandler(NULL, myCallback);
+*   disableLogging();
+*   gwpool_start(&pool);
+*   gwpool_publish(&pool, "elevator", "elevator-1", "status", "json", data, len, QOS0);
+*
+* The command callback is called from the workers, concurrently if several connections
+* receive commands at once. The log buffers are shared, so gwpool_start refuses to run
+* while logging is enabled.
+**/
+int gwpool_init(gwpool *pool);
+
+/**
+* Function to add a gateway connection, before gwpool_start
+* @param - Pool
+*        - Config file of the gateway identity used by this connection
+* @return - Index of the connection or a negative error code
+**/
+int gwpool_add(gwpool *pool, char *configFilePath);
+
+/**
+* Function to get the client of a connection, e.g. for setServerAddress, setReconnectPolicy
+* or getMetrics. Settings must be changed before gwpool_start.
+* @param - Pool
+*        - Index returned by gwpool_add
+* @return - Client or NULL if the index is out of range
+**/
+iotfclient *gwpool_client(gwpool *pool, int index);
+
+/**
+* Function to start the connection workers. They connect in the background.
+* Call disableLogging first, initialize_configfile in gwpool_add enables it.
+* @param - Pool
+* @return - SUCCESS, -1 if a worker could not be created or -2 if logging is enabled
+**/
+int gwpool_start(gwpool *pool);
+
+/**
+* Function to queue an event of a child device on the connection that owns the device.
+* Payload and topic are copied, the call does not wait for the network.
+* @param - Pool
+*        - Type and id of the child device
+*        - Event type and format
+*        - Payload and its length
+*        - QoS
+* @return - SUCCESS, or -1 if no connection is up or the owner's queue is full
+**/
+int gwpool_publish(gwpool *pool, char *deviceType, char *deviceId, char *eventType, char *eventFormat,
+                   void *data, size_t len, enum QoS qos);
+
+/**
+* Function to find the connection that currently owns a child device
+* @param - Pool
+*        - Type and id of the child device
+* @return - Index of the connection or -1 if no connection is up
+**/
+int gwpool_owner(gwpool *pool, const char *deviceType, const char *deviceId);
+
+/**
+* Function to stop the workers, drop queued events and disconnect all connections
+* @param - Pool
+* @return - void
+**/
+void gwpool_stop(gwpool *pool);
+
+#endif
@@ -0,0 +1,270 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the per-client metrics definitions
+ *******************************************************************************/
+
+#include <string.h>
+#include "cmsis_os2.h"
+#include "iotf_metrics.h"
+#include "iotf_telemetry.h"
+
+//Upper bounds of the histogram buckets in ms, the last bucket takes everything above
+static const uint32_t metricsBucketMs[METRICS_BUCKETS - 1] = {
+        1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000
+};
+
+//Client whose receive loop is running in a thread, target of metrics_command in that thread.
+//A slot is owned by the thread stored in it, only the owner writes its metrics pointer.
+static struct
+{
+        osThreadId_t thread;
+        iotf_metrics *metrics;
+} dispatchSlot[METRICS_DISPATCH_THREADS];
+
+//Shared by the threads that found no free slot, changed under the kernel lock. Holds the
+//client entered last, so with several such threads a command may count for another one.
+static struct
+{
+        uint32_t users;
+        uint32_t commands;
+        iotf_metrics *metrics;
+} dispatchOverflow;
+
+void metrics_add(uint32_t *counter, uint32_t value)
+{
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+//Cores without 64-bit exclusives (e.g. Cortex-M) fall back to a short kernel lock
+void metrics_add64(uint64_t *counter, uint64_t value)
+{
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#else
+        int32_t lock = osKernelLock();
+        *counter += value;
+        osKernelRestoreLock(lock);
+#endif
+}
+
+static uint64_t metrics_exchange64(uint64_t *counter, int reset)
+{
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+        return reset ? __atomic_exchange_n(counter, 0, __ATOMIC_RELAXED) : __atomic_load_n(counter, __ATOMIC_RELAXED);
+#else
+        int32_t lock = osKernelLock();
+        uint64_t value = *counter;
+        if (reset)
+                *counter = 0;
+        osKernelRestoreLock(lock);
+        return value;
+#endif
+}
+
+static uint32_t metrics_exchange(uint32_t *counter, int reset)
+{
+        return reset ? __atomic_exchange_n(counter, 0, __ATOMIC_RELAXED) : __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void metrics_observe(iotf_histogram *h, uint32_t ms)
+{
+        int i = 0;
+        uint32_t max = __atomic_load_n(&h->maxMs, __ATOMIC_RELAXED);
+
+        while (i < METRICS_BUCKETS - 1 && ms > metricsBucketMs[i])
+                i++;
+        __atomic_fetch_add(&h->buckets[i], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+        metrics_add64(&h->sumMs, ms);
+        while (ms > max && !__atomic_compare_exchange_n(&h->maxMs, &max, ms, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                ;
+}
+
+uint32_t metrics_time(void)
+{
+        uint32_t freq = osKernelGetTickFreq();
+        uint32_t tick = osKernelGetTickCount();
+
+        if (freq == 1000U || freq == 0U)
+                return tick;
+        return (uint32_t)((uint64_t)tick * 1000U / freq);
+}
+
+static void metrics_copy_histogram(iotf_histogram *h, iotf_histogram *out, int reset)
+{
+        int i;
+
+        out->count = metrics_exchange(&h->count, reset);
+        out->maxMs = metrics_exchange(&h->maxMs, reset);
+        out->sumMs = metrics_exchange64(&h->sumMs, reset);
+        for (i = 0; i < METRICS_BUCKETS; i++)
+                out->buckets[i] = metrics_exchange(&h->buckets[i], reset);
+}
+
+void metrics_snapshot(iotf_metrics *m, iotf_metrics *out, int reset)
+{
+        int i;
+
+        for (i = 0; i < 3; i++)
+                out->published[i] = metrics_exchange(&m->published[i], reset);
+        out->acked = metrics_exchange(&m->acked, reset);
+        out->publishFailures = metrics_exchange(&m->publishFailures, reset);
+        out->connects = metrics_exchange(&m->connects, reset);
+        out->connectFailures = metrics_exchange(&m->connectFailures, reset);
+        out->reconnects = metrics_exchange(&m->reconnects, reset);
+        out->commands = metrics_exchange(&m->commands, reset);
+        out->bytesOut = metrics_exchange64(&m->bytesOut, reset);
+        out->bytesIn = metrics_exchange64(&m->bytesIn, reset);
+        out->recordsOut = metrics_exchange(&m->recordsOut, reset);
+        out->wireBytesOut = metrics_exchange64(&m->wireBytesOut, reset);
+        out->readsIn = metrics_exchange(&m->readsIn, reset);
+        metrics_copy_histogram(&m->publishAck, &out->publishAck, reset);
+        metrics_copy_histogram(&m->handshake, &out->handshake, reset);
+        metrics_copy_histogram(&m->yield, &out->yield, reset);
+}
+
+static void metrics_add_histogram(tb_builder *tb, const char *key, const iotf_histogram *h)
+{
+        int i;
+
+        tb_begin_obj(tb, key);
+        tb_add_u32(tb, "count", h->count);
+        tb_add_u32(tb, "max", h->maxMs);
+        tb_add_i64(tb, "sum", (int64_t)h->sumMs);
+        tb_begin_array(tb, "buckets");
+        for (i = 0; i < METRICS_BUCKETS; i++)
+                tb_add_u32(tb, NULL, h->buckets[i]);
+        tb_end_array(tb);
+        tb_end_obj(tb);
+}
+
+int metrics_serialize(const iotf_metrics *m, char *buf, size_t size)
+{
+        tb_builder tb;
+        int i;
+
+        tb_begin(&tb, buf, size);
+        tb_begin_obj(&tb, "d");
+        tb_begin_array(&tb, "published");
+        for (i = 0; i < 3; i++)
+                tb_add_u32(&tb, NULL, m->published[i]);
+        tb_end_array(&tb);
+        tb_add_u32(&tb, "acked", m->acked);
+        tb_add_u32(&tb, "publishFailures", m->publishFailures);
+        tb_add_u32(&tb, "connects", m->connects);
+        tb_add_u32(&tb, "connectFailures", m->connectFailures);
+        tb_add_u32(&tb, "reconnects", m->reconnects);
+        tb_add_u32(&tb, "commands", m->commands);
+        tb_add_i64(&tb, "bytesOut", (int64_t)m->bytesOut);
+        tb_add_i64(&tb, "bytesIn", (int64_t)m->bytesIn);
+        tb_add_u32(&tb, "recordsOut", m->recordsOut);
+        tb_add_i64(&tb, "wireBytesOut", (int64_t)m->wireBytesOut);
+        tb_add_u32(&tb, "readsIn", m->readsIn);
+        tb_begin_array(&tb, "bucketsMs");
+        for (i = 0; i < METRICS_BUCKETS - 1; i++)
+                tb_add_u32(&tb, NULL, metricsBucketMs[i]);
+        tb_end_array(&tb);
+        metrics_add_histogram(&tb, "publishAck", &m->publishAck);
+        metrics_add_histogram(&tb, "handshake", &m->handshake);
+        metrics_add_histogram(&tb, "yield", &m->yield);
+        tb_end_obj(&tb);
+        return tb_end(&tb);
+}
+
+//Slot of the calling thread, a free one is claimed if claim is set
+static int metrics_slot(osThreadId_t self, int claim)
+{
+        int i;
+
+        for (i = 0; i < METRICS_DISPATCH_THREADS; i++) {
+                if (__atomic_load_n(&dispatchSlot[i].thread, __ATOMIC_ACQUIRE) == self)
+                        return i;
+        }
+        for (i = 0; claim && i < METRICS_DISPATCH_THREADS; i++) {
+                osThreadId_t none = NULL;
+                if (__atomic_compare_exchange_n(&dispatchSlot[i].thread, &none, self, 0,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+                        return i;
+        }
+        return -1;
+}
+
+iotf_metrics *metrics_enter(iotf_metrics *m)
+{
+        osThreadId_t self = osThreadGetId();
+        iotf_metrics *previous;
+        int i;
+
+        if (self == NULL)
+                return NULL;
+        if ((i = metrics_slot(self, 1)) < 0) {
+                int32_t lock = osKernelLock();
+                dispatchOverflow.users++;
+                previous = dispatchOverflow.metrics;
+                dispatchOverflow.metrics = m;
+                osKernelRestoreLock(lock);
+                return previous;
+        }
+        previous = dispatchSlot[i].metrics;
+        dispatchSlot[i].metrics = m;
+        return previous;
+}
+
+void metrics_leave(iotf_metrics *previous)
+{
+        osThreadId_t self = osThreadGetId();
+        int i;
+
+        if (self == NULL)
+                return;
+        if ((i = metrics_slot(self, 0)) < 0) {
+                int32_t lock = osKernelLock();
+                if (dispatchOverflow.users > 0 && --dispatchOverflow.users == 0)
+                        dispatchOverflow.metrics = NULL;
+                else if (previous != NULL)
+                        dispatchOverflow.metrics = previous;
+                osKernelRestoreLock(lock);
+                return;
+        }
+        dispatchSlot[i].metrics = previous;
+        //The outermost leave gives the slot back
+        if (previous == NULL)
+                __atomic_store_n(&dispatchSlot[i].thread, NULL, __ATOMIC_RELEASE);
+}
+
+void metrics_command(void)
+{
+        osThreadId_t self = osThreadGetId();
+        iotf_metrics *m = NULL;
+        int i;
+
+        if (self == NULL)
+                return;
+        if ((i = metrics_slot(self, 0)) >= 0)
+                m = dispatchSlot[i].metrics;
+        else {
+                int32_t lock = osKernelLock();
+                if ((m = dispatchOverflow.metrics) != NULL)
+                        dispatchOverflow.commands++;
+                osKernelRestoreLock(lock);
+        }
+        if (m != NULL)
+                metrics_add(&m->commands, 1);
+}
+
+uint32_t metrics_dispatch_overflow(void)
+{
+        return __atomic_load_n(&dispatchOverflow.commands, __ATOMIC_RELAXED);
+}
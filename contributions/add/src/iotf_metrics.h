@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the per-client metrics declarations
+ *******************************************************************************/
+
+#ifndef IOTF_METRICS_H_
+#define IOTF_METRICS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Number of latency buckets, upper bounds are given by metricsBucketMs in iotf_metrics.c
+#define METRICS_BUCKETS 12
+
+//Buffer size that holds metrics_serialize output for any counter values
+#define METRICS_JSON_SIZE 1088
+
+//Threads that can run a receive loop at the same time, e.g. gateway pool workers and the application
+#ifndef METRICS_DISPATCH_THREADS
+#define METRICS_DISPATCH_THREADS 10
+#endif
+
+//Fixed-bucket latency histogram in milliseconds
+typedef struct
+{
+        uint32_t count;
+        uint32_t maxMs;
+        uint64_t sumMs;
+        uint32_t buckets[METRICS_BUCKETS];
+} iotf_histogram;
+
+//Counters and histograms of one client. Updated with atomics, read with metrics_snapshot.
+typedef struct
+{
+        uint32_t published[3];          //publish attempts by QoS
+        uint32_t acked;                 //QoS1/2 publishes completed by the broker
+        uint32_t publishFailures;
+        uint32_t connects;
+        uint32_t connectFailures;
+        uint32_t reconnects;            //connection attempts made by retry_connection and pollReconnect
+        uint32_t commands;              //commands dispatched to the command callback
+        uint64_t bytesOut;
+        uint64_t bytesIn;
+        uint32_t recordsOut;            //socket sends, or TLS records on a TLS connection
+        uint64_t wireBytesOut;          //bytesOut with the TLS record overhead
+        uint32_t readsIn;               //socket receives, or mbedtls_ssl_read calls on a TLS connection
+        iotf_histogram publishAck;      //MQTTPublish until PUBACK/PUBCOMP
+        iotf_histogram handshake;       //TCP/TLS connect and MQTT CONNECT
+        iotf_histogram yield;           //MQTTYield duration
+} iotf_metrics;
+
+void metrics_add(uint32_t *counter, uint32_t value);
+void metrics_add64(uint64_t *counter, uint64_t value);
+void metrics_observe(iotf_histogram *h, uint32_t ms);
+
+//Millisecond timestamp for the histograms, based on the RTOS kernel tick
+uint32_t metrics_time(void);
+
+/**
+* Function to copy the metrics, optionally resetting them. Every field is read (and reset)
+* atomically on its own, so a snapshot taken while counting is consistent per field.
+* @param - Metrics to read
+*        - Address to store the copy
+*        - Non-zero to reset the metrics
+* @return - void
+**/
+void metrics_snapshot(iotf_metrics *m, iotf_metrics *out, int reset);
+
+/**
+* Function to serialize metrics as {"d":{...}} for publishing as an event
+* @param - Metrics, normally a snapshot
+*        - Output buffer and its size
+* @return - Length of the JSON text or -1 if the buffer is too small
+**/
+int metrics_serialize(const iotf_metrics *m, char *buf, size_t size);
+
+/*
+ * Commands reach the callback without a client reference. The client that is currently
+ * running the MQTT receive loop (yield or a QoS1/2 publish) is made the dispatch target
+ * of the calling thread, so pool workers running their clients concurrently each count
+ * their own commands. Threads beyond METRICS_DISPATCH_THREADS share one more target, the
+ * client that entered it last: their commands are all counted, but with several of them
+ * at once a command may be counted for another of these clients.
+ */
+iotf_metrics *metrics_enter(iotf_metrics *m);
+void metrics_leave(iotf_metrics *previous);
+void metrics_command(void);
+
+//Commands counted through the shared target so far, 0 while METRICS_DISPATCH_THREADS suffices
+uint32_t metrics_dispatch_overflow(void);
+
+#endif
@@ -0,0 +1,378 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the typed JSON telemetry builder definitions
+ *******************************************************************************/
+
+#include <string.h>
+#include "iotf_telemetry.h"
+
+//Largest number of decimals supported by tb_add_fixed and tb_add_double
+#define TB_MAX_DECIMALS 9
+
+static const double tbScale[TB_MAX_DECIMALS + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+static const char tbHex[] = "0123456789abcdef";
+
+/** Function to append raw characters to the builder buffer.
+* One byte is always kept free for the terminating NUL.
+* @param - Address of builder
+*        - Characters to append
+*        - Number of characters
+* @return - void
+**/
+static void tb_put(tb_builder *tb, const char *data, size_t len)
+{
+        if (tb->error)
+                return;
+        if (len >= tb->size - tb->len) {
+                tb->error = -1;
+                return;
+        }
+        memcpy(&tb->buf[tb->len], data, len);
+        tb->len += len;
+}
+
+/** Function to append a single character
+* @param - Address of builder
+*        - Character
+* @return - void
+**/
+static void tb_putc(tb_builder *tb, char c)
+{
+        if (tb->error)
+                return;
+        if (tb->size - tb->len < 2) {
+                tb->error = -1;
+                return;
+        }
+        tb->buf[tb->len++] = c;
+}
+
+/** Function to append a JSON string literal, escaping quotes, backslashes and control characters
+* @param - Address of builder
+*        - NUL terminated string
+* @return - void
+**/
+static void tb_put_escaped(tb_builder *tb, const char *str)
+{
+        const char *run = str;
+        char esc[6];
+
+        tb_putc(tb, '"');
+        for (; *str; str++) {
+                unsigned char c = (unsigned char)*str;
+                if (c >= 0x20 && c != '"' && c != '\\')
+                        continue;
+                tb_put(tb, run, (size_t)(str - run));
+                run = str + 1;
+                esc[0] = '\\';
+                switch (c) {
+                case '"':  esc[1] = '"';  break;
+                case '\\': esc[1] = '\\'; break;
+                case '\n': esc[1] = 'n';  break;
+                case '\r': esc[1] = 'r';  break;
+                case '\t': esc[1] = 't';  break;
+                case '\b': esc[1] = 'b';  break;
+                case '\f': esc[1] = 'f';  break;
+                default:
+                        esc[1] = 'u';
+                        esc[2] = '0';
+                        esc[3] = '0';
+                        esc[4] = tbHex[c >> 4];
+                        esc[5] = tbHex[c & 0xF];
+                        tb_put(tb, esc, 6);
+                        continue;
+                }
+                tb_put(tb, esc, 2);
+        }
+        tb_put(tb, run, (size_t)(str - run));
+        tb_putc(tb, '"');
+}
+
+/** Function to write the separator and key of a new member of the current object.
+* Array elements get the separator only.
+* @param - Address of builder
+*        - Member name
+* @return - void
+**/
+static void tb_key(tb_builder *tb, const char *key)
+{
+        if (tb->first[tb->depth])
+                tb->first[tb->depth] = 0;
+        else
+                tb_putc(tb, ',');
+        if (tb->isArray[tb->depth])
+                return;
+        tb_put_escaped(tb, key);
+        tb_putc(tb, ':');
+}
+
+/** Function to open a nested object or array
+* @param - Address of builder
+*        - Member name
+*        - 1 for array, 0 for object
+* @return - void
+**/
+static void tb_open(tb_builder *tb, const char *key, int isArray)
+{
+        tb_key(tb, key);
+        if (tb->depth + 1 >= TB_MAX_DEPTH) {
+                tb->error = -1;
+                return;
+        }
+        tb->depth++;
+        tb->first[tb->depth] = 1;
+        tb->isArray[tb->depth] = (unsigned char)isArray;
+        tb_putc(tb, isArray ? '[' : '{');
+}
+
+/** Function to close the innermost nested object or array
+* @param - Address of builder
+*        - 1 for array, 0 for object
+* @return - void
+**/
+static void tb_close(tb_builder *tb, int isArray)
+{
+        if (tb->depth == 0 || tb->isArray[tb->depth] != isArray) {
+                tb->error = -1;
+                return;
+        }
+        tb->depth--;
+        tb_putc(tb, isArray ? ']' : '}');
+}
+
+/** Function to format a scaled integer as decimal number, e.g. 3415 with 2 decimals as 34.15
+* @param - Address of builder
+*        - Scaled value
+*        - Number of decimals
+* @return - void
+**/
+static void tb_put_scaled(tb_builder *tb, int64_t value, int decimals)
+{
+        char tmp[24];
+        char *p = &tmp[sizeof(tmp)];
+        uint64_t v = (value < 0) ? (uint64_t)(-(value + 1)) + 1U : (uint64_t)value;
+        int digits = 0;
+
+        do {
+                *--p = (char)('0' + (v % 10U));
+                v /= 10U;
+                if (++digits == decimals)
+                        *--p = '.';
+        } while (v != 0 || digits <= decimals);
+
+        if (value < 0)
+                *--p = '-';
+        tb_put(tb, p, (size_t)(&tmp[sizeof(tmp)] - p));
+}
+
+/** Function to start building a JSON object into the given buffer
+* @param - Address of builder
+*        - Output buffer
+*        - Size of output buffer including room for the terminating NUL
+* @return - void
+**/
+void tb_begin(tb_builder *tb, char *buf, size_t size)
+{
+        tb->buf = buf;
+        tb->size = size;
+        tb->len = 0;
+        tb->error = (buf == NULL || size == 0) ? -1 : 0;
+        tb->depth = 0;
+        tb->first[0] = 1;
+        tb->isArray[0] = 0;
+        tb_putc(tb, '{');
+}
+
+/** Function to start a nested object member
+* @param - Address of builder
+*        - Member name
+* @return - void
+**/
+void tb_begin_obj(tb_builder *tb, const char *key)
+{
+        tb_open(tb, key, 0);
+}
+
+/** Function to close the innermost nested object
+* @param - Address of builder
+* @return - void
+**/
+void tb_end_obj(tb_builder *tb)
+{
+        tb_close(tb, 0);
+}
+
+/** Function to start a nested array member
+* @param - Address of builder
+*        - Member name
+* @return - void
+**/
+void tb_begin_array(tb_builder *tb, const char *key)
+{
+        tb_open(tb, key, 1);
+}
+
+/** Function to close the innermost nested array
+* @param - Address of builder
+* @return - void
+**/
+void tb_end_array(tb_builder *tb)
+{
+        tb_close(tb, 1);
+}
+
+/** Function to add a signed 32 bit integer member
+* @param - Address of builder
+*        - Member name
+*        - Value
+* @return - void
+**/
+void tb_add_i32(tb_builder *tb, const char *key, int32_t value)
+{
+        tb_key(tb, key);
+        tb_put_scaled(tb, value, 0);
+}
+
+/** Function to add an unsigned 32 bit integer member
+* @param - Address of builder
+*        - Member name
+*        - Value
+* @return - void
+**/
+void tb_add_u32(tb_builder *tb, const char *key, uint32_t value)
+{
+        tb_key(tb, key);
+        tb_put_scaled(tb, (int64_t)value, 0);
+}
+
+/** Function to add a signed 64 bit integer member
+* @param - Address of builder
+*        - Member name
+*        - Value
+* @return - void
+**/
+void tb_add_i64(tb_builder *tb, const char *key, int64_t value)
+{
+        tb_key(tb, key);
+        tb_put_scaled(tb, value, 0);
+}
+
+/** Function to add a fixed point member, value is the number scaled by 10^decimals
+* @param - Address of builder
+*        - Member name
+*        - Scaled value, e.g. 3415 for 34.15
+*        - Number of decimals (0..9)
+* @return - void
+**/
+void tb_add_fixed(tb_builder *tb, const char *key, int32_t value, int decimals)
+{
+        tb_key(tb, key);
+        if (decimals < 0 || decimals > TB_MAX_DECIMALS) {
+                tb->error = -1;
+                return;
+        }
+        tb_put_scaled(tb, value, decimals);
+}
+
+/** Function to add a floating point member rounded to the given number of decimals.
+* The value is converted to a scaled integer once, no floating point formatting is used.
+* NaN and infinity are not representable in JSON and are written as null.
+* @param - Address of builder
+*        - Member name
+*        - Value
+*        - Number of decimals (0..9)
+* @return - void
+**/
+void tb_add_double(tb_builder *tb, const char *key, double value, int decimals)
+{
+        double scaled;
+
+        tb_key(tb, key);
+        if (decimals < 0 || decimals > TB_MAX_DECIMALS) {
+                tb->error = -1;
+                return;
+        }
+        scaled = value * tbScale[decimals];
+        if (scaled != scaled || scaled > 9.2e18 || scaled < -9.2e18) {
+                tb_put(tb, "null", 4);
+                return;
+        }
+        scaled += (scaled < 0) ? -0.5 : 0.5;
+        tb_put_scaled(tb, (int64_t)scaled, decimals);
+}
+
+/** Function to add a boolean member
+* @param - Address of builder
+*        - Member name
+*        - 0 for false, any other value for true
+* @return - void
+**/
+void tb_add_bool(tb_builder *tb, const char *key, int value)
+{
+        tb_key(tb, key);
+        if (value)
+                tb_put(tb, "true", 4);
+        else
+                tb_put(tb, "false", 5);
+}
+
+/** Function to add a string member, the value is escaped as required by JSON
+* @param - Address of builder
+*        - Member name
+*        - NUL terminated value, NULL is written as null
+* @return - void
+**/
+void tb_add_str(tb_builder *tb, const char *key, const char *value)
+{
+        tb_key(tb, key);
+        if (value == NULL)
+                tb_put(tb, "null", 4);
+        else
+                tb_put_escaped(tb, value);
+}
+
+/** Function to add a member whose value is already valid JSON text (copied verbatim)
+* @param - Address of builder
+*        - Member name
+*        - JSON text, NULL or empty is written as {}
+* @return - void
+**/
+void tb_add_raw(tb_builder *tb, const char *key, const char *json)
+{
+        tb_key(tb, key);
+        if (json == NULL || *json == '\0')
+                tb_put(tb, "{}", 2);
+        else
+                tb_put(tb, json, strlen(json));
+}
+
+/** Function to close all open objects and arrays and terminate the JSON text with NUL
+* @param - Address of builder
+* @return - Length of the JSON text (without NUL) on SUCCESS
+*         - -1 if the buffer was too small or the builder was misused
+**/
+int tb_end(tb_builder *tb)
+{
+        while (tb->depth > 0 && !tb->error)
+                tb_close(tb, tb->isArray[tb->depth]);
+        tb_putc(tb, '}');
+        if (tb->error)
+                return -1;
+        tb->buf[tb->len] = '\0';
+        return (int)tb->len;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Contains the typed JSON telemetry builder declarations
+ *******************************************************************************/
+
+#ifndef IOTF_TELEMETRY_H_
+#define IOTF_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Maximum nesting of JSON objects and arrays including the outer object
+#define TB_MAX_DEPTH 8
+
+//Builder state. JSON text is written in a single pass into the caller supplied buffer.
+typedef struct
+{
+        char *buf;
+        size_t size;
+        size_t len;
+        int error;
+        int depth;
+        unsigned char first[TB_MAX_DEPTH];
+        unsigned char isArray[TB_MAX_DEPTH];
+} tb_builder;
+
+/**
+* Typed JSON builder used instead of sprintf templates. Numbers are formatted with
+* integer arithmetic only, strings are escaped on the fly:
+*
+*   tb_begin(&tb, buf, sizeof(buf));
+*   tb_begin_obj(&tb, "d");
+*   tb_add_i32(&tb, "temp", 34);
+*   tb_add_fixed(&tb, "humidity", 4150, 2);      //41.50
+*   tb_end_obj(&tb);
+*   len = tb_end(&tb);
+*   publishEventData(&client, "status", "json", buf, len, QOS0);
+*
+* Inside arrays started with tb_begin_array the key is ignored and may be NULL.
+* Errors are sticky, only the result of tb_end needs to be checked.
+**/
+void tb_begin(tb_builder *tb, char *buf, size_t size);
+void tb_begin_obj(tb_builder *tb, const char *key);
+void tb_end_obj(tb_builder *tb);
+void tb_begin_array(tb_builder *tb, const char *key);
+void tb_end_array(tb_builder *tb);
+void tb_add_i32(tb_builder *tb, const char *key, int32_t value);
+void tb_add_u32(tb_builder *tb, const char *key, uint32_t value);
+void tb_add_i64(tb_builder *tb, const char *key, int64_t value);
+void tb_add_fixed(tb_builder *tb, const char *key, int32_t value, int decimals);
+void tb_add_double(tb_builder *tb, const char *key, double value, int decimals);
+void tb_add_bool(tb_builder *tb, const char *key, int value);
+void tb_add_str(tb_builder *tb, const char *key, const char *value);
+void tb_add_raw(tb_builder *tb, const char *key, const char *json);
+int tb_end(tb_builder *tb);
+
+#endif
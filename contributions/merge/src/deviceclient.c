@@ -102,7 +102,7 @@
  	if(cbDevice != 0) {
  		MQTTMessage* message = md->message;
 
- 		char *topic = malloc(md->topicName->lenstring.len+1);
+ 		char *topic = iotf_malloc(md->topicName->lenstring.len+1);
 
  		sprintf(topic,"%.*s",md->topicName->lenstring.len,md->topicName->lenstring.data);
 
@@ -119,9 +119,10 @@
                 LOG_STR("Calling registered callabck to process the arrived message");
                 LOG(logHdr,logStr);
 
+ 		metrics_command();
  		(*cbDevice)(commandName, format, payload);
 
- 		free(topic);
+ 		iotf_free(topic);
 
  	}
         else{
@@ -20,8 +20,10 @@
  ****************************************/
 
 
+#include <math.h>
 #include "devicemanagementclient.h"
 #include "cJSON.h"
+#include "iotf_telemetry.h"
 
 //Character strings to hold log header and log message to be dumped.
 extern char logHdr[LOG_BUF];
@@ -47,6 +49,98 @@ const char* dmFirmwareUpdate = "iotdm-1/mgmt/initiate/firmware/update";
 static char currentRequestID[40];
 volatile int interrupt = 0;
 
+//Mean earth radius in meters used for location deltas
+#define EARTH_RADIUS 6371000.0
+
+//Location reporter state, see setLocationPolicy. reportLocation runs on the application
+//thread and flushLocation in yield_dm, both change it under the kernel lock
+struct LocationReporter{
+	bool enabled;
+	bool pending;
+	unsigned int seq;        //counts queued locations, a publish only clears the one it sent
+	bool hasSent;
+	bool holding;
+	double minDistance;
+	double minAccuracyChange;
+	unsigned int minInterval;
+	unsigned int maxInterval;
+	struct DeviceLocation location;
+	char measuredDateTime[30];
+	char updatedDateTime[30];
+	char reqId[40];
+	Timer holdTimer;
+	Timer refreshTimer;
+	struct LocationStats stats;
+};
+static struct LocationReporter locReporter;
+
+//Entry types of the diagnostics ring
+#define DIAG_LOG       0
+#define DIAG_ERRORCODE 1
+
+//Size of a single diagnostics upload payload, also the minimum burst budget
+#define DIAG_PAYLOAD_SIZE 512
+
+struct DiagEntry{
+	unsigned char type;
+	int value;               //severity for logs, errorCode for error codes
+	unsigned int count;
+	unsigned int seq;        //tells a flushed entry from one that replaced it meanwhile
+	time_t queuedAt;
+	char reqId[40];
+	char message[DIAG_TEXT_SIZE];
+	char data[DIAG_TEXT_SIZE];
+};
+
+//Diagnostics ring state, see setDiagnosticsPolicy. addLog and addErrorCode run on the
+//application thread and flushDiagnostics in yield_dm, both change it under the kernel lock
+struct Diagnostics{
+	bool enabled;
+	unsigned int seq;
+	unsigned int inFlight;   //seq of the entry flushDiagnostics is publishing, 0 for none
+	int minSeverity;
+	unsigned int rate;
+	unsigned int burst;
+	unsigned int tokens;
+	uint32_t lastTick;
+	unsigned int head;
+	unsigned int used;
+	struct DiagEntry ring[DIAG_RING_SIZE];
+	struct DiagStats stats;
+};
+static struct Diagnostics diag;
+static void queueDiagnostic(int type, int value, char* message, char* data, char* reqId);
+static void removeDiagnostics(int type);
+
+//Serializers writing the current value of an observable field as member "value"
+static void serializeFirmware(tb_builder* tb);
+static void serializeLocation(tb_builder* tb);
+static void serializeDeviceInfo(tb_builder* tb);
+static void serializeMetadata(tb_builder* tb);
+
+//DeviceData fields the platform can observe
+struct ObservableField{
+	const char* name;
+	void (*serialize)(tb_builder* tb);
+	bool observed;
+	bool dirty;
+};
+static struct ObservableField observables[] = {
+	{ "mgmt.firmware", serializeFirmware,   false, false },
+	{ "location",      serializeLocation,   false, false },
+	{ "deviceInfo",    serializeDeviceInfo, false, false },
+	{ "metadata",      serializeMetadata,   false, false }
+};
+#define OBSERVABLE_COUNT (sizeof(observables) / sizeof(observables[0]))
+
+//Notification debounce state
+static unsigned int observeInterval;
+static bool notifyPending;
+static Timer notifyTimer;
+
+//Size of a notify message or observe response
+#define NOTIFY_PAYLOAD_SIZE 700
+
 // Handle signal interrupt
 /*void sigHandler(int signo) {
 	printf("SigINT received.\n");
@@ -68,6 +162,7 @@ int initialize_configfile_dm(char *configFilePath)
         LOG(logHdr,"entry::");
 
 	int rc = -1;
+	iotf_alloc_hook_json();
 	rc = initialize_configfile(&dmClient.deviceClient, configFilePath,0);
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -101,6 +196,7 @@ int initialize_dm(char *orgId, char* domainName, char *deviceType, char *deviceI
         LOG(logHdr,"entry::");
 
 	int rc = -1;
+	iotf_alloc_hook_json();
 	rc = initialize(&dmClient.deviceClient, orgId, domainName, deviceType, deviceId,
 			authmethod, authToken,serverCertPath,useCerts, rootCACertPath,
 			clientCertPath,clientKeyPath,0);
@@ -139,6 +235,55 @@ int connectiotf_dm()
 	return rc;
 }
 
+/*
+* Function used to point the device management client at a broker other than
+* <org>.messaging.<domain>, see setServerAddress
+*
+* @return int return code
+*/
+int setServerAddress_dm(char* host, int port)
+{
+	return setServerAddress(&dmClient.deviceClient, host, port);
+}
+
+/*
+* Function used to read the device management client's metrics, see getMetrics
+*
+* @return int return code
+*/
+int getMetrics_dm(iotf_metrics *out, int reset)
+{
+	return getMetrics(&dmClient.deviceClient, out, reset);
+}
+
+/*
+* Function used to publish the device management client's metrics, see publishMetrics
+*
+* @return int return code from the publish
+*/
+int publishMetrics_dm(char *eventType, int reset)
+{
+	return publishMetrics(&dmClient.deviceClient, eventType, reset);
+}
+
+/*
+* Function used to drive reconnection of the device management client, see pollReconnect
+*
+* @return int return code
+*/
+int pollReconnect_dm(void)
+{
+	return pollReconnect(&dmClient.deviceClient);
+}
+
+/*
+* Function used to report that the network interface came (back) up, see notifyNetworkUp
+*/
+void notifyNetworkUp_dm(void)
+{
+	notifyNetworkUp(&dmClient.deviceClient);
+}
+
 /*
 * Function used to Publish events from the device to the IBM Watson IoT service
 *
@@ -383,6 +528,12 @@ int yield_dm(int time_ms)
 	int rc = 0;
 	rc = yield(&dmClient.deviceClient, time_ms);
 
+	if(locReporter.enabled)
+		flushLocation();
+	if(diag.enabled)
+		flushDiagnostics();
+	flushNotifications();
+
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG_STR("rc = %d",rc);
 	LOG(logHdr,logStr);
@@ -457,11 +608,32 @@ void publishManageEvent(long lifetime, int supportFirmwareActions,int supportDev
 	char uuid_str[40];
 	generateUUID(uuid_str);
 	strcpy(currentRequestID,uuid_str);
-	char* strPayload = "{\"d\": {\"metadata\":%s ,\"lifetime\":%ld ,\"supports\": {\"deviceActions\":%d,\"firmwareActions\":%d},\"deviceInfo\": {\"serialNumber\":\"%s\",\"manufacturer\":\"%s\",\"model\":\"%s\",\"deviceClass\":\"%s\",\"description\":\"%s\",\"fwVersion\":\"%s\",\"hwVersion\":\"%s\",\"descriptiveLocation\":\"%s\"}},\"reqId\": \"%s\"}" ;//cJSON_Print(jsonPayload);
 	char payload[1500];
-	sprintf(payload,strPayload,dmClient.DeviceData.metadata.metadata,lifetime, supportDeviceActions, supportFirmwareActions, dmClient.DeviceData.deviceInfo.serialNumber,dmClient.DeviceData.deviceInfo.manufacturer, dmClient.DeviceData.deviceInfo.model,dmClient.DeviceData.deviceInfo.deviceClass,dmClient.DeviceData.deviceInfo.description,dmClient.DeviceData.deviceInfo.fwVersion,dmClient.DeviceData.deviceInfo.hwVersion,dmClient.DeviceData.deviceInfo.descriptiveLocation,uuid_str);
+	tb_builder tb;
+	tb_begin(&tb, payload, sizeof(payload));
+	tb_begin_obj(&tb, "d");
+	tb_add_raw(&tb, "metadata", dmClient.DeviceData.metadata.metadata);
+	tb_add_i32(&tb, "lifetime", (int32_t)lifetime);
+	tb_begin_obj(&tb, "supports");
+	tb_add_i32(&tb, "deviceActions", supportDeviceActions);
+	tb_add_i32(&tb, "firmwareActions", supportFirmwareActions);
+	tb_end_obj(&tb);
+	tb_begin_obj(&tb, "deviceInfo");
+	tb_add_str(&tb, "serialNumber", dmClient.DeviceData.deviceInfo.serialNumber);
+	tb_add_str(&tb, "manufacturer", dmClient.DeviceData.deviceInfo.manufacturer);
+	tb_add_str(&tb, "model", dmClient.DeviceData.deviceInfo.model);
+	tb_add_str(&tb, "deviceClass", dmClient.DeviceData.deviceInfo.deviceClass);
+	tb_add_str(&tb, "description", dmClient.DeviceData.deviceInfo.description);
+	tb_add_str(&tb, "fwVersion", dmClient.DeviceData.deviceInfo.fwVersion);
+	tb_add_str(&tb, "hwVersion", dmClient.DeviceData.deviceInfo.hwVersion);
+	tb_add_str(&tb, "descriptiveLocation", dmClient.DeviceData.deviceInfo.descriptiveLocation);
+	tb_end_obj(&tb);
+	tb_end_obj(&tb);
+	tb_add_str(&tb, "reqId", uuid_str);
+	int len = tb_end(&tb);
 	int rc = -1;
-	rc = publish(MANAGE, payload);
+	if(len > 0)
+		rc = publishLen(MANAGE, payload, len);
 	if(rc == SUCCESS){
 		strcpy(reqId, uuid_str);
 
@@ -512,6 +684,19 @@ void publishUnManageEvent(char* reqId)
 	LOG(logHdr,"exit::");
 }
 
+//Stores the location the platform was sent and schedules a notify if "location" is observed
+static void setDeviceLocation(double latitude, double longitude, double elevation, double accuracy)
+{
+	struct DeviceLocation* location = &dmClient.DeviceData.deviceLocation;
+
+	location->latitude = latitude;
+	location->longitude = longitude;
+	location->elevation = elevation;
+	location->accuracy = accuracy;
+	location->measuredDateTime = time(NULL);
+	markFieldChanged("location");
+}
+
 /*
  * Update the location of the device. This method converts the
  * date in the required format. The caller needs to pass the date in string in ISO8601 format.
@@ -539,16 +724,28 @@ void updateLocation(double latitude, double longitude, double elevation, char* m
 
 	int rc = -1;
 
+	if(locReporter.enabled){
+		rc = reportLocation(latitude, longitude, elevation, measuredDateTime, NULL, accuracy, reqId);
+
+		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+		LOG_STR("reportLocation rc = %d",rc);
+		LOG(logHdr,logStr);
+		LOG(logHdr,"exit::");
+		return;
+	}
+
 	char uuid_str[40];
 	generateUUID(uuid_str);
 	strcpy(currentRequestID,uuid_str);
 
 	char data[500];
-	sprintf(data,"{\"d\":{\"longitude\":%f,\"latitude\":%f,\"elevation\":%f,\"measuredDateTime\":\"%s\",\"accuracy\":%f},\"reqId\":\"%s\"}",
-	                latitude, longitude, elevation, measuredDateTime, accuracy, uuid_str);
+	int len = buildLocationPayload(data, sizeof(data), latitude, longitude, elevation,
+	                measuredDateTime, NULL, accuracy, uuid_str);
 
-	rc = publish(UPDATE_LOCATION, data);
+	if(len > 0)
+		rc = publishLen(UPDATE_LOCATION, data, len);
 	if(rc == SUCCESS){
+		setDeviceLocation(latitude, longitude, elevation, accuracy);
 		strcpy(reqId, uuid_str);
 
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -590,17 +787,30 @@ void updateLocationEx(double latitude, double longitude, double elevation, char*
         LOG(logHdr,"entry::");
 
 	int rc = -1;
+
+	if(locReporter.enabled){
+		rc = reportLocation(latitude, longitude, elevation, updatedDateTime, updatedDateTime, accuracy, reqId);
+
+		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+		LOG_STR("reportLocation rc = %d",rc);
+		LOG(logHdr,logStr);
+		LOG(logHdr,"exit::");
+		return;
+	}
+
 	char uuid_str[40];
 	generateUUID(uuid_str);
 	strcpy(currentRequestID,uuid_str);
 
 	char data[500];
-	sprintf(data,"{\"d\":{\"longitude\":%f,\"latitude\":%f,\"elevation\":%f,\"measuredDateTime\":\"%s\",\"updatedDateTime\":\"%s\",\"accuracy\":%f},\"reqId\":\"%s\"}",
-	        latitude, longitude, elevation, updatedDateTime, updatedDateTime, accuracy, currentRequestID);
+	int len = buildLocationPayload(data, sizeof(data), latitude, longitude, elevation,
+	        updatedDateTime, updatedDateTime, accuracy, currentRequestID);
 
-	rc = publish(UPDATE_LOCATION, data);
+	if(len > 0)
+		rc = publishLen(UPDATE_LOCATION, data, len);
 
 	if(rc == SUCCESS){
+		setDeviceLocation(latitude, longitude, elevation, accuracy);
 		strcpy(reqId, uuid_str);
 
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -614,6 +824,214 @@ void updateLocationEx(double latitude, double longitude, double elevation, char*
 	LOG(logHdr,"exit::");
 }
 
+/**
+ * Enables the location reporter with the given thresholds
+ */
+void setLocationPolicy(double minDistance, double minAccuracyChange, unsigned int minInterval, unsigned int maxInterval)
+{
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	int32_t lock = osKernelLock();
+	locReporter.minDistance = minDistance;
+	locReporter.minAccuracyChange = minAccuracyChange;
+	locReporter.minInterval = minInterval;
+	locReporter.maxInterval = maxInterval;
+	if(!locReporter.enabled){
+		InitTimer(&locReporter.holdTimer);
+		InitTimer(&locReporter.refreshTimer);
+		locReporter.pending = false;
+		locReporter.holding = false;
+		locReporter.enabled = true;
+	}
+	osKernelRestoreLock(lock);
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("minDistance = %d minInterval = %u maxInterval = %u",(int)minDistance,minInterval,maxInterval);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+}
+
+/**
+ * Disables the location reporter
+ */
+void clearLocationPolicy(void)
+{
+	int32_t lock = osKernelLock();
+	locReporter.enabled = false;
+	locReporter.pending = false;
+	locReporter.holding = false;
+	osKernelRestoreLock(lock);
+}
+
+//Distance in meters between two locations (equirectangular approximation, sufficient for thresholds)
+static double locationDistance(struct DeviceLocation* a, double latitude, double longitude, double elevation)
+{
+	double rad = 3.14159265358979323846 / 180.0;
+	double x = (longitude - a->longitude) * rad * cos((latitude + a->latitude) * 0.5 * rad);
+	double y = (latitude - a->latitude) * rad;
+	double h = sqrt(x * x + y * y) * EARTH_RADIUS;
+	double z = elevation - a->elevation;
+	return sqrt(h * h + z * z);
+}
+
+/**
+ * Reports a location through the location reporter without blocking
+ */
+int reportLocation(double latitude, double longitude, double elevation, char* measuredDateTime,
+		char* updatedDateTime, double accuracy, char* reqId)
+{
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	struct DeviceLocation* last = &dmClient.DeviceData.deviceLocation;
+	bool significant = true;
+	char uuid_str[40];
+	int32_t lock;
+
+	generateUUID(uuid_str);
+	lock = osKernelLock();
+	locReporter.stats.reported++;
+
+	if(locReporter.hasSent){
+		significant = locationDistance(last, latitude, longitude, elevation) >= locReporter.minDistance;
+		if(!significant && locReporter.minAccuracyChange > 0)
+			significant = fabs(accuracy - last->accuracy) >= locReporter.minAccuracyChange;
+		if(!significant && locReporter.maxInterval > 0)
+			significant = expired(&locReporter.refreshTimer);
+	}
+
+	//A pending update is always replaced by the latest position
+	if(!significant && !locReporter.pending){
+		locReporter.stats.suppressed++;
+		osKernelRestoreLock(lock);
+
+		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+		LOG(logHdr,"Location update suppressed");
+		LOG(logHdr,"exit::");
+		return LOCATION_SUPPRESSED;
+	}
+
+	if(locReporter.pending)
+		locReporter.stats.coalesced++;
+	else
+		strcpy(locReporter.reqId, uuid_str);
+	locReporter.seq++;
+
+	locReporter.location.latitude = latitude;
+	locReporter.location.longitude = longitude;
+	locReporter.location.elevation = elevation;
+	locReporter.location.accuracy = accuracy;
+	locReporter.location.measuredDateTime = time(NULL);
+	strncpy(locReporter.measuredDateTime, measuredDateTime ? measuredDateTime : "", sizeof(locReporter.measuredDateTime) - 1);
+	locReporter.measuredDateTime[sizeof(locReporter.measuredDateTime) - 1] = '\0';
+	locReporter.updatedDateTime[0] = '\0';
+	if(updatedDateTime != NULL){
+		strncpy(locReporter.updatedDateTime, updatedDateTime, sizeof(locReporter.updatedDateTime) - 1);
+		locReporter.updatedDateTime[sizeof(locReporter.updatedDateTime) - 1] = '\0';
+	}
+	locReporter.pending = true;
+
+	if(reqId != NULL)
+		strcpy(reqId, locReporter.reqId);
+	osKernelRestoreLock(lock);
+
+	//Sent by the next yield_dm, so the caller never waits for a PUBACK
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG(logHdr,"Location update queued");
+	LOG(logHdr,"exit::");
+
+	return LOCATION_QUEUED;
+}
+
+/**
+ * Sends the pending location once the minimum interval has elapsed
+ */
+int flushLocation(void)
+{
+	struct DeviceLocation location;
+	char measuredDateTime[30];
+	char updatedDateTime[30];
+	char reqId[40];
+	char data[500];
+	unsigned int seq;
+	int32_t lock;
+	int len, rc;
+
+	//A device that stopped moving sends its last location again once maxInterval has passed
+	if(locReporter.hasSent && !locReporter.pending && locReporter.maxInterval > 0 &&
+	   expired(&locReporter.refreshTimer)){
+		generateUUID(reqId);
+		lock = osKernelLock();
+		if(!locReporter.pending){
+			strcpy(locReporter.reqId, reqId);
+			locReporter.seq++;
+			locReporter.pending = true;
+		}
+		osKernelRestoreLock(lock);
+	}
+
+	lock = osKernelLock();
+	if(!locReporter.pending || (locReporter.holding && !expired(&locReporter.holdTimer))){
+		rc = locReporter.pending ? LOCATION_QUEUED : 0;
+		osKernelRestoreLock(lock);
+		return rc;
+	}
+	location = locReporter.location;
+	strcpy(measuredDateTime, locReporter.measuredDateTime);
+	strcpy(updatedDateTime, locReporter.updatedDateTime);
+	strcpy(reqId, locReporter.reqId);
+	seq = locReporter.seq;
+	osKernelRestoreLock(lock);
+
+	if(!isConnected(&dmClient.deviceClient))
+		return LOCATION_QUEUED;
+
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	len = buildLocationPayload(data, sizeof(data), location.latitude, location.longitude,
+	        location.elevation, measuredDateTime, updatedDateTime[0] ? updatedDateTime : NULL,
+	        location.accuracy, reqId);
+
+	//Single publish, the platform response is not waited for
+	rc = (len > 0) ? publishDataLen(&dmClient.deviceClient.c, UPDATE_LOCATION, data, len, QOS1) : -1;
+	if(rc == SUCCESS){
+		lock = osKernelLock();
+		dmClient.DeviceData.deviceLocation = location;
+		//A location reported while the publish was in flight stays pending
+		if(locReporter.seq == seq)
+			locReporter.pending = false;
+		locReporter.hasSent = true;
+		locReporter.stats.sent++;
+		locReporter.holding = locReporter.minInterval > 0;
+		if(locReporter.holding)
+			countdown_ms(&locReporter.holdTimer, locReporter.minInterval);
+		if(locReporter.maxInterval > 0)
+			countdown_ms(&locReporter.refreshTimer, locReporter.maxInterval);
+		osKernelRestoreLock(lock);
+		markFieldChanged("location");
+		rc = LOCATION_SENT;
+	}
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("rc = %d",rc);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+
+	return rc;
+}
+
+/**
+ * Returns the location reporter statistics
+ */
+void getLocationStats(struct LocationStats* stats)
+{
+	int32_t lock = osKernelLock();
+	*stats = locReporter.stats;
+	osKernelRestoreLock(lock);
+}
+
 /**
  * Adds the current errorcode to IBM Watson IoT Platform.
  *
@@ -630,14 +1048,27 @@ void addErrorCode(int errNum, char* reqId)
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
+	if(diag.enabled){
+		queueDiagnostic(DIAG_ERRORCODE, errNum, NULL, NULL, reqId);
+		LOG(logHdr,"exit::");
+		return;
+	}
+
 	char uuid_str[40];
 	generateUUID(uuid_str);
 	strcpy(currentRequestID,uuid_str);
 	int rc = -1;
 	char data[125];
-	sprintf(data,"{\"d\":{\"errorCode\":%d},\"reqId\":\"%s\"}", errNum, uuid_str);
-
-	rc = publish(CREATE_DIAG_ERRCODES, data);
+	tb_builder tb;
+	tb_begin(&tb, data, sizeof(data));
+	tb_begin_obj(&tb, "d");
+	tb_add_i32(&tb, "errorCode", errNum);
+	tb_end_obj(&tb);
+	tb_add_str(&tb, "reqId", uuid_str);
+	int len = tb_end(&tb);
+
+	if(len > 0)
+		rc = publishLen(CREATE_DIAG_ERRCODES, data, len);
 	if(rc == SUCCESS){
 		strcpy(reqId, uuid_str);
 
@@ -665,6 +1096,10 @@ void clearErrorCodes(char* reqId)
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
+	//Queued error codes are dropped, those already uploaded are cleared below
+	if(diag.enabled)
+		removeDiagnostics(DIAG_ERRORCODE);
+
 	char uuid_str[40];
 	int rc = -1;
 	generateUUID(uuid_str);
@@ -709,6 +1144,12 @@ void addLog(char* message, char* data ,int severity, char* reqId)
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
+	if(diag.enabled){
+		queueDiagnostic(DIAG_LOG, severity, message, data, reqId);
+		LOG(logHdr,"exit::");
+		return;
+	}
+
 	char uuid_str[40];
 	int rc = -1;
 	generateUUID(uuid_str);
@@ -721,14 +1162,24 @@ void addLog(char* message, char* data ,int severity, char* reqId)
 	time_t t = 0;
 	char updatedDateTime[50];//"2016-03-01T07:07:56.323Z"
 	strftime(updatedDateTime, sizeof(updatedDateTime), "%Y-%m-%dT%TZ", localtime(&t));
-	char payload[125];
-	sprintf(payload,"{\"d\":{\"message\":\"%s\",\"timestamp\":\"%s\",\"data\":\"%s\",\"severity\":%d},\"reqId\":\"%s\"}",message,updatedDateTime,data,severity, uuid_str);
+	char payload[512];
+	tb_builder tb;
+	tb_begin(&tb, payload, sizeof(payload));
+	tb_begin_obj(&tb, "d");
+	tb_add_str(&tb, "message", message);
+	tb_add_str(&tb, "timestamp", updatedDateTime);
+	tb_add_str(&tb, "data", data);
+	tb_add_i32(&tb, "severity", severity);
+	tb_end_obj(&tb);
+	tb_add_str(&tb, "reqId", uuid_str);
+	int len = tb_end(&tb);
 
         LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-        LOG_STR("payload = %s",payload);
+        LOG_STR("payload = %.*s",LOG_BUF - 32,payload);
         LOG(logHdr,logStr);
 
-	rc = publish(ADD_DIAG_LOG, payload );
+	if(len > 0)
+		rc = publishLen(ADD_DIAG_LOG, payload, len);
 	if(rc == SUCCESS){
 		strcpy(reqId, uuid_str);
 
@@ -755,6 +1206,10 @@ void clearLogs(char* reqId){
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
+	//Queued logs are dropped, those already uploaded are cleared below
+	if(diag.enabled)
+		removeDiagnostics(DIAG_LOG);
+
 	char uuid_str[40];
 	int rc = -1;
 	generateUUID(uuid_str);
@@ -778,6 +1233,248 @@ void clearLogs(char* reqId){
 	LOG(logHdr,"exit::");
 }
 
+//Copies a possibly NULL string into a fixed size diagnostics field
+static void diagCopy(char* dst, char* src)
+{
+	if(src == NULL)
+		src = "";
+	strncpy(dst, src, DIAG_TEXT_SIZE - 1);
+	dst[DIAG_TEXT_SIZE - 1] = '\0';
+}
+
+//Stores a log or error code in the diagnostics ring and returns the reqId it is uploaded with
+static void queueDiagnostic(int type, int value, char* message, char* data, char* reqId)
+{
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	unsigned int i, used;
+	struct DiagEntry* entry;
+	char uuid_str[40];
+	time_t now = time(NULL);
+	int32_t lock;
+
+	if(type == DIAG_LOG && value < diag.minSeverity){
+		lock = osKernelLock();
+		diag.stats.filtered++;
+		osKernelRestoreLock(lock);
+		LOG(logHdr,"exit::");
+		return;
+	}
+
+	generateUUID(uuid_str);
+	lock = osKernelLock();
+	if(type == DIAG_ERRORCODE){
+		for(i = 0; i < diag.used; i++){
+			entry = &diag.ring[(diag.head + DIAG_RING_SIZE - diag.used + i) % DIAG_RING_SIZE];
+			if(entry->type == DIAG_ERRORCODE && entry->value == value){
+				entry->count++;
+				diag.stats.deduplicated++;
+				strcpy(reqId, entry->reqId);
+				osKernelRestoreLock(lock);
+				LOG(logHdr,"exit::");
+				return;
+			}
+		}
+	}
+
+	//When full the slot at head holds the oldest entry, unless it is being published
+	if(diag.used == DIAG_RING_SIZE){
+		if(diag.ring[diag.head].seq != diag.inFlight)
+			diag.stats.dropped++;
+	}
+	else
+		diag.used++;
+
+	entry = &diag.ring[diag.head];
+	diag.head = (diag.head + 1) % DIAG_RING_SIZE;
+	entry->type = (unsigned char)type;
+	entry->value = value;
+	entry->count = 1;
+	entry->seq = ++diag.seq;
+	entry->queuedAt = now;
+	strcpy(entry->reqId, uuid_str);
+	diagCopy(entry->message, message);
+	diagCopy(entry->data, data);
+	diag.stats.queued++;
+	used = diag.used;
+	osKernelRestoreLock(lock);
+	strcpy(reqId, uuid_str);
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("type = %d value = %d used = %u",type,value,used);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+}
+
+//Removes all entries of the given type from the diagnostics ring, keeping the order of the others
+static void removeDiagnostics(int type)
+{
+	unsigned int i, kept = 0, first;
+	int32_t lock = osKernelLock();
+
+	first = (diag.head + DIAG_RING_SIZE - diag.used) % DIAG_RING_SIZE;
+	for(i = 0; i < diag.used; i++){
+		struct DiagEntry* entry = &diag.ring[(first + i) % DIAG_RING_SIZE];
+		if(entry->type != type){
+			if(kept != i)
+				diag.ring[(first + kept) % DIAG_RING_SIZE] = *entry;
+			kept++;
+		}
+	}
+	diag.used = kept;
+	diag.head = (first + kept) % DIAG_RING_SIZE;
+	osKernelRestoreLock(lock);
+}
+
+/**
+ * Enables the diagnostics ring
+ */
+void setDiagnosticsPolicy(int minSeverity, unsigned int bytesPerSecond, unsigned int burstBytes)
+{
+	int32_t lock = osKernelLock();
+	diag.minSeverity = minSeverity;
+	diag.rate = bytesPerSecond;
+	diag.burst = (burstBytes < DIAG_PAYLOAD_SIZE) ? DIAG_PAYLOAD_SIZE : burstBytes;
+	diag.tokens = diag.burst;
+	diag.lastTick = osKernelGetTickCount();
+	diag.enabled = true;
+	osKernelRestoreLock(lock);
+}
+
+/**
+ * Disables the diagnostics ring
+ */
+void clearDiagnosticsPolicy(void)
+{
+	int32_t lock = osKernelLock();
+	diag.enabled = false;
+	diag.head = 0;
+	diag.used = 0;
+	osKernelRestoreLock(lock);
+}
+
+//Adds the budget accumulated since the last refill
+static void refillDiagnosticsBudget(void)
+{
+	uint32_t now = osKernelGetTickCount();
+	uint64_t add = ((uint64_t)diag.rate * (now - diag.lastTick)) / osKernelGetTickFreq();
+
+	if(add > 0){
+		add += diag.tokens;
+		diag.tokens = (add > diag.burst) ? diag.burst : (unsigned int)add;
+		diag.lastTick = now;
+	}
+}
+
+//Removes the oldest entry of the diagnostics ring if it is still the one with seq
+static void popDiagnostic(unsigned int seq)
+{
+	if(diag.used > 0 && diag.ring[(diag.head + DIAG_RING_SIZE - diag.used) % DIAG_RING_SIZE].seq == seq)
+		diag.used--;
+}
+
+/**
+ * Uploads entries from the diagnostics ring within the bandwidth budget
+ */
+int flushDiagnostics(void)
+{
+	struct DiagEntry entry;
+	char payload[DIAG_PAYLOAD_SIZE];
+	char timestamp[50];
+	int sent = 0;
+	int len, rc;
+	int32_t lock;
+	tb_builder tb;
+
+	if(diag.used == 0 || !isConnected(&dmClient.deviceClient))
+		return 0;
+
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	while(sent < DIAG_DRAIN_MAX){
+		lock = osKernelLock();
+		if(diag.used == 0){
+			osKernelRestoreLock(lock);
+			break;
+		}
+		if(diag.rate > 0)
+			refillDiagnosticsBudget();
+		entry = diag.ring[(diag.head + DIAG_RING_SIZE - diag.used) % DIAG_RING_SIZE];
+		diag.inFlight = entry.seq;
+		osKernelRestoreLock(lock);
+
+		tb_begin(&tb, payload, sizeof(payload));
+		tb_begin_obj(&tb, "d");
+		if(entry.type == DIAG_ERRORCODE){
+			tb_add_i32(&tb, "errorCode", entry.value);
+		}
+		else{
+			strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%TZ", gmtime(&entry.queuedAt));
+			tb_add_str(&tb, "message", entry.message);
+			tb_add_str(&tb, "timestamp", timestamp);
+			tb_add_str(&tb, "data", entry.data);
+			tb_add_i32(&tb, "severity", entry.value);
+		}
+		tb_end_obj(&tb);
+		tb_add_str(&tb, "reqId", entry.reqId);
+		len = tb_end(&tb);
+
+		if(len < 0){
+			//Only possible for text made of control characters that expand when escaped
+			lock = osKernelLock();
+			popDiagnostic(entry.seq);
+			diag.stats.dropped++;
+			diag.inFlight = 0;
+			osKernelRestoreLock(lock);
+			continue;
+		}
+		if(diag.rate > 0 && (unsigned int)len > diag.tokens){
+			diag.inFlight = 0;
+			break;
+		}
+
+		//The platform response is matched against the reqId of the last request
+		strcpy(currentRequestID, entry.reqId);
+		rc = publishDataLen(&dmClient.deviceClient.c,
+		        entry.type == DIAG_ERRORCODE ? CREATE_DIAG_ERRCODES : ADD_DIAG_LOG, payload, len, QOS1);
+		if(rc != SUCCESS){
+			diag.inFlight = 0;
+			sent = rc;
+			break;
+		}
+		lock = osKernelLock();
+		if(diag.rate > 0)
+			diag.tokens = ((unsigned int)len < diag.tokens) ? diag.tokens - len : 0;
+		popDiagnostic(entry.seq);
+		diag.stats.sent++;
+		diag.inFlight = 0;
+		osKernelRestoreLock(lock);
+		sent++;
+	}
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("sent = %d pending = %u",sent,diag.used);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+
+	return sent;
+}
+
+/**
+ * Returns the diagnostics ring statistics
+ */
+int getDiagnosticsStats(struct DiagStats* stats)
+{
+	int32_t lock = osKernelLock();
+	int used = (int)diag.used;
+
+	*stats = diag.stats;
+	osKernelRestoreLock(lock);
+	return used;
+}
+
 /**
  * Notifies the IBM Watson IoT Platform response for action
  *
@@ -821,18 +1518,10 @@ int changeFirmwareState(int state)
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
-	char firmwareMsg[300];
 	int rc = -1;
-	if (dmClient.bObserve) {
-		dmClient.DeviceData.mgmt.firmware.state = state;
-		sprintf(firmwareMsg,
-				"{\"d\":{\"fields\":[{\"field\" : \"mgmt.firmware\",\"value\":{\"state\":%d}}]}}",
-				state);
-		rc = publishActionResponse(NOTIFY, firmwareMsg);
-
-		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-		LOG_STR("publishActionResponse = %d",rc);
-		LOG(logHdr,logStr);
+	dmClient.DeviceData.mgmt.firmware.state = state;
+	if (markFieldChanged("mgmt.firmware") == 1) {
+		rc = SUCCESS;
 	} else{
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 		LOG_STR("mgmt.firmware is not in observe state");
@@ -861,18 +1550,10 @@ int changeFirmwareUpdateState(int state)
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
-	char firmwareMsg[300];
 	int rc = -1;
-	if (dmClient.bObserve) {
-		dmClient.DeviceData.mgmt.firmware.updateStatus = state;
-		sprintf(firmwareMsg,
-				"{\"d\":{\"fields\":[{\"field\" : \"mgmt.firmware\",\"value\":{\"state\":%d,\"updateStatus\":%d}}]}}",
-				dmClient.DeviceData.mgmt.firmware.state,state);
-		rc = publishActionResponse(NOTIFY, firmwareMsg);
-
-		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-		LOG_STR("publishActionResponse = %d",rc);
-		LOG(logHdr,logStr);
+	dmClient.DeviceData.mgmt.firmware.updateStatus = state;
+	if (markFieldChanged("mgmt.firmware") == 1) {
+		rc = SUCCESS;
 	} else{
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 		LOG_STR("mgmt.firmware is not in observe state");
@@ -887,8 +1568,171 @@ int changeFirmwareUpdateState(int state)
 	return rc;
 }
 
+//Looks up an observable field by name
+static struct ObservableField* findObservable(const char* field)
+{
+	unsigned int i;
+	for(i = 0; i < OBSERVABLE_COUNT; i++){
+		if(!strcmp(observables[i].name, field))
+			return &observables[i];
+	}
+	return NULL;
+}
+
+static void serializeFirmware(tb_builder* tb)
+{
+	tb_begin_obj(tb, "value");
+	tb_add_i32(tb, "state", dmClient.DeviceData.mgmt.firmware.state);
+	tb_add_i32(tb, "updateStatus", dmClient.DeviceData.mgmt.firmware.updateStatus);
+	tb_end_obj(tb);
+}
+
+static void serializeLocation(tb_builder* tb)
+{
+	struct DeviceLocation* location = &dmClient.DeviceData.deviceLocation;
+	char measuredDateTime[30];
+
+	strftime(measuredDateTime, sizeof(measuredDateTime), "%Y-%m-%dT%TZ", gmtime(&location->measuredDateTime));
+	tb_begin_obj(tb, "value");
+	tb_add_double(tb, "latitude", location->latitude, 6);
+	tb_add_double(tb, "longitude", location->longitude, 6);
+	tb_add_double(tb, "elevation", location->elevation, 3);
+	tb_add_double(tb, "accuracy", location->accuracy, 3);
+	tb_add_str(tb, "measuredDateTime", measuredDateTime);
+	tb_end_obj(tb);
+}
+
+static void serializeDeviceInfo(tb_builder* tb)
+{
+	struct DeviceInfo* info = &dmClient.DeviceData.deviceInfo;
+
+	tb_begin_obj(tb, "value");
+	tb_add_str(tb, "serialNumber", info->serialNumber);
+	tb_add_str(tb, "manufacturer", info->manufacturer);
+	tb_add_str(tb, "model", info->model);
+	tb_add_str(tb, "deviceClass", info->deviceClass);
+	tb_add_str(tb, "description", info->description);
+	tb_add_str(tb, "fwVersion", info->fwVersion);
+	tb_add_str(tb, "hwVersion", info->hwVersion);
+	tb_add_str(tb, "descriptiveLocation", info->descriptiveLocation);
+	tb_end_obj(tb);
+}
+
+static void serializeMetadata(tb_builder* tb)
+{
+	tb_add_raw(tb, "value", dmClient.DeviceData.metadata.metadata);
+}
+
+/**
+ * Marks a DeviceData field as changed
+ */
+int markFieldChanged(const char* field)
+{
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	struct ObservableField* observable = findObservable(field);
+	int rc = -1;
+
+	if(observable != NULL){
+		rc = observable->observed ? 1 : 0;
+		if(observable->observed){
+			observable->dirty = true;
+			//The interval starts with the first change, later changes are coalesced
+			if(!notifyPending){
+				notifyPending = true;
+				InitTimer(&notifyTimer);
+				countdown_ms(&notifyTimer, observeInterval);
+			}
+		}
+	}
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("field = %s rc = %d",field,rc);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+
+	return rc;
+}
+
+/**
+ * Sets the debounce interval for notifications of observed fields
+ */
+void setObserveInterval(unsigned int interval)
+{
+	observeInterval = interval;
+}
+
+/**
+ * Sends one notify message with all changed observed fields
+ */
+int flushNotifications(void)
+{
+	char payload[NOTIFY_PAYLOAD_SIZE];
+	tb_builder tb;
+	unsigned int i;
+	int count = 0;
+	int len, rc;
+
+	if(!notifyPending)
+		return 0;
+	if(observeInterval > 0 && !expired(&notifyTimer))
+		return 0;
+	if(!isConnected(&dmClient.deviceClient))
+		return 0;
+
+	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+        LOG(logHdr,"entry::");
+
+	tb_begin(&tb, payload, sizeof(payload));
+	tb_begin_obj(&tb, "d");
+	tb_begin_array(&tb, "fields");
+	for(i = 0; i < OBSERVABLE_COUNT; i++){
+		if(!observables[i].dirty || !observables[i].observed)
+			continue;
+		tb_begin_obj(&tb, NULL);
+		tb_add_str(&tb, "field", observables[i].name);
+		observables[i].serialize(&tb);
+		tb_end_obj(&tb);
+		count++;
+	}
+	len = tb_end(&tb);
+
+	rc = SUCCESS;
+	if(count > 0 && len <= 0){
+		//Retrying would build the same payload on every yield_dm, the changes are dropped
+		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+		LOG_STR("%d changed fields do not fit in %d bytes, notify dropped",count,NOTIFY_PAYLOAD_SIZE);
+		LOG(logHdr,logStr);
+		rc = -1;
+	}
+	else if(count > 0)
+		rc = publishDataLen(&dmClient.deviceClient.c, NOTIFY, payload, len, QOS1);
+
+	if(rc == SUCCESS || len <= 0){
+		for(i = 0; i < OBSERVABLE_COUNT; i++)
+			observables[i].dirty = false;
+		notifyPending = false;
+	}
+	if(rc != SUCCESS)
+		count = rc;
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("rc = %d",count);
+	LOG(logHdr,logStr);
+	LOG(logHdr,"exit::");
+
+	return count;
+}
+
 // Utility function to publish the message to Watson IoT
 int publish(char* publishTopic, char* data)
+{
+	return publishLen(publishTopic, data, strlen(data));
+}
+
+// Utility function to publish a message of known length to Watson IoT
+int publishLen(char* publishTopic, char* data, size_t len)
 {
 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
@@ -898,10 +1742,10 @@ int publish(char* publishTopic, char* data)
 	pub.qos = QOS1;
 	pub.retained = '0';
 	pub.payload = data;
-	pub.payloadlen = strlen(data);
+	pub.payloadlen = len;
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-	LOG_STR("Topic - %s Payload - %s",publishTopic,data);
+	LOG_STR("Topic - %s Payload - %.*s",publishTopic,(int)len,data);
 	LOG(logHdr,logStr);
 
 	//signal(SIGINT, sigHandler);
@@ -966,6 +1810,26 @@ int publishActionResponse(char* publishTopic, char* data)
 	return rc;
 }
 
+//Utility to build the location update payload, updatedDateTime is optional.
+//The former sprintf payloads had latitude and longitude swapped, see updateLocation.
+int buildLocationPayload(char* buf, size_t size, double latitude, double longitude, double elevation,
+                         char* measuredDateTime, char* updatedDateTime, double accuracy, char* reqId)
+{
+	tb_builder tb;
+	tb_begin(&tb, buf, size);
+	tb_begin_obj(&tb, "d");
+	tb_add_double(&tb, "longitude", longitude, 6);
+	tb_add_double(&tb, "latitude", latitude, 6);
+	tb_add_double(&tb, "elevation", elevation, 3);
+	tb_add_str(&tb, "measuredDateTime", measuredDateTime);
+	if(updatedDateTime != NULL)
+		tb_add_str(&tb, "updatedDateTime", updatedDateTime);
+	tb_add_double(&tb, "accuracy", accuracy, 3);
+	tb_end_obj(&tb);
+	tb_add_str(&tb, "reqId", reqId);
+	return tb_end(&tb);
+}
+
 //Utility for LocationUpdate Handler
 void updateLocationHandler(double latitude, double longitude, double elevation, char* measuredDateTime,char* updatedDateTime, double accuracy)
 {
@@ -974,10 +1838,11 @@ void updateLocationHandler(double latitude, double longitude, double elevation,
 
         int rc = -1;
         char data[500];
-        sprintf(data,"{\"d\":{\"longitude\":%f,\"latitude\":%f,\"elevation\":%f,\"measuredDateTime\":\"%s\",\"updatedDateTime\":\"%s\",\"accuracy\":%f},\"reqId\":\"%s\"}",
-	        latitude, longitude, elevation, updatedDateTime, updatedDateTime, accuracy, currentRequestID);
+        int len = buildLocationPayload(data, sizeof(data), latitude, longitude, elevation,
+	        updatedDateTime, updatedDateTime, accuracy, currentRequestID);
 
-        rc = publish(UPDATE_LOCATION, data);
+        if(len > 0)
+                rc = publishLen(UPDATE_LOCATION, data, len);
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG_STR("rc = %d",rc);
@@ -1055,7 +1920,7 @@ void onMessage(MessageData* md)
 	if (md) {
 		//MQTTMessage* message = md->message;
 
-		char *topic = malloc(md->topicName->lenstring.len + 1);
+		char *topic = iotf_malloc(md->topicName->lenstring.len + 1);
 
 		sprintf(topic, "%.*s", md->topicName->lenstring.len,
 				md->topicName->lenstring.data);
@@ -1128,7 +1993,7 @@ void onMessage(MessageData* md)
 			messageFirmwareUpdate(md);
 		}
 
-		free(topic);
+		iotf_free(topic);
 	}
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -1237,13 +2102,12 @@ void messageObserve(MessageData* md)
         LOG(logHdr,"entry::");
 
 	int i = 0;
+	int len;
 	MQTTMessage* message = md->message;
 	void *payload = message->payload;
-	char* respMsg;
-	cJSON *resPayload, *resd, *resFields;
-	resPayload = cJSON_CreateObject();
-	cJSON_AddItemToObject(resPayload, "rc",
-			cJSON_CreateNumber(RESPONSE_SUCCESS));
+	char respMsg[NOTIFY_PAYLOAD_SIZE];
+	bool added[OBSERVABLE_COUNT] = { false };
+	tb_builder tb;
 	cJSON * jsonPayload = cJSON_Parse(payload);
 	cJSON* jreqId = cJSON_GetObjectItem(jsonPayload, "reqId");
 	strcpy(currentRequestID, jreqId->valuestring);
@@ -1251,52 +2115,64 @@ void messageObserve(MessageData* md)
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG_STR("Observe reqId: %s", currentRequestID);
 
-	cJSON_AddItemToObject(resPayload, "reqId",
-			cJSON_CreateString(currentRequestID));
-
-	cJSON_AddItemToObject(resPayload, "d", resd = cJSON_CreateObject());
-
-	cJSON_AddItemToObject(resd, "fields", resFields =
-			cJSON_CreateArray());
+	tb_begin(&tb, respMsg, sizeof(respMsg));
+	tb_add_i32(&tb, "rc", RESPONSE_SUCCESS);
+	tb_add_str(&tb, "reqId", currentRequestID);
+	tb_begin_obj(&tb, "d");
+	tb_begin_array(&tb, "fields");
 
 	cJSON *d = cJSON_GetObjectItem(jsonPayload, "d");
 
 	cJSON *fields = cJSON_GetObjectItem(d, "fields");
 
-	//cJSON *fields = cJSON_GetObjectItem(jsonPayload,"fields");
 	for (i = 0; i < cJSON_GetArraySize(fields); i++) {
 		cJSON * field = cJSON_GetArrayItem(fields, i);
 
 		cJSON* fieldName = cJSON_GetObjectItem(field, "field");
 
-		cJSON * value = cJSON_GetArrayItem(fields, i);
-
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 		LOG_STR("Observe called for fieldName:%s", fieldName->valuestring);
 
-		if (!strcmp(fieldName->valuestring, "mgmt.firmware")) {
-			dmClient.bObserve = true;
-			cJSON* resValue;
-			cJSON* resField = cJSON_CreateObject();
-			cJSON_AddItemToObject(resField, "field", cJSON_CreateString("mgmt.firmware"));
-			cJSON_AddItemToObject(resField, "value", resValue = cJSON_CreateObject());
-			cJSON_AddItemToObject(resValue, "state",cJSON_CreateNumber(dmClient.DeviceData.mgmt.firmware.state));
-			cJSON_AddItemToObject(resValue, "updateStatus",cJSON_CreateNumber(dmClient.DeviceData.mgmt.firmware.updateStatus));
-			cJSON_AddItemToArray(resFields,resField);
-
+		struct ObservableField* observable = findObservable(fieldName->valuestring);
+		if (observable != NULL) {
+			added[observable - observables] = !observable->observed;
+			observable->observed = true;
+			if (!strcmp(observable->name, "mgmt.firmware"))
+				dmClient.bObserve = true;
+			//The response carries the current value
+			tb_begin_obj(&tb, NULL);
+			tb_add_str(&tb, "field", observable->name);
+			observable->serialize(&tb);
+			tb_end_obj(&tb);
 		}
 	}
-	respMsg = cJSON_Print(resPayload);
-	cJSON_Delete(resPayload);
+	len = tb_end(&tb);
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-	LOG_STR("Response Message:%s", respMsg);
+	LOG_STR("Response Message:%.*s", LOG_BUF - 32, respMsg);
+
+	if (len <= 0) {
+		//The current values do not fit a response, the request fails as a whole
+		for (i = 0; i < (int)OBSERVABLE_COUNT; i++)
+			if (added[i])
+				observables[i].observed = false;
+		dmClient.bObserve = findObservable("mgmt.firmware")->observed;
+
+		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+		LOG_STR("Observe response does not fit in %d bytes",NOTIFY_PAYLOAD_SIZE);
+		LOG(logHdr,logStr);
+
+		tb_begin(&tb, respMsg, sizeof(respMsg));
+		tb_add_i32(&tb, "rc", BAD_REQUEST);
+		tb_add_str(&tb, "reqId", currentRequestID);
+		len = tb_end(&tb);
+	}
 
 	//Publish the response to the IoTF
-	publishActionResponse(RESPONSE, respMsg);
+	if (len > 0)
+		publishActionResponse(RESPONSE, respMsg);
 
 	cJSON_Delete(jsonPayload);
-	free(respMsg);
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG(logHdr,"exit::");
@@ -1312,6 +2188,7 @@ void messageCancel(MessageData* md)
 	char respMsg[100];
 	MQTTMessage* message = md->message;
 	void *payload = message->payload;
+	tb_builder tb;
 	cJSON * jsonPayload = cJSON_Parse(payload);
 	cJSON* jreqId = cJSON_GetObjectItem(jsonPayload, "reqId");
 	strcpy(currentRequestID, jreqId->valuestring);
@@ -1321,28 +2198,35 @@ void messageCancel(MessageData* md)
 
 	cJSON *d = cJSON_GetObjectItem(jsonPayload, "d");
 	cJSON *fields = cJSON_GetObjectItem(d, "fields");
-	//cJSON *fields = cJSON_GetObjectItem(jsonPayload,"fields");
 	for (i = 0; i < cJSON_GetArraySize(fields); i++) {
 		cJSON * field = cJSON_GetArrayItem(fields, i);
 		cJSON* fieldName = cJSON_GetObjectItem(field, "field");
 
-		cJSON * value = cJSON_GetArrayItem(fields, i);
-
 		LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 		LOG_STR("Cancel called for fieldName:%s", fieldName->valuestring);
 
-		if (!strcmp(fieldName->valuestring, "mgmt.firmware")) {
-			dmClient.bObserve = false;
-			sprintf(respMsg,"{\"rc\":%d,\"reqId\":%s}",RESPONSE_SUCCESS,currentRequestID);
-
-			LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
-			LOG_STR("Response Message:%s", respMsg);
-
-			//Publish the response to the IoTF
-			publishActionResponse(RESPONSE, respMsg);
+		struct ObservableField* observable = findObservable(fieldName->valuestring);
+		if (observable != NULL) {
+			observable->observed = false;
+			observable->dirty = false;
+			if (!strcmp(observable->name, "mgmt.firmware"))
+				dmClient.bObserve = false;
 		}
 	}
 
+	tb_begin(&tb, respMsg, sizeof(respMsg));
+	tb_add_i32(&tb, "rc", RESPONSE_SUCCESS);
+	tb_add_str(&tb, "reqId", currentRequestID);
+	tb_end(&tb);
+
+	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+	LOG_STR("Response Message:%.*s", LOG_BUF - 32, respMsg);
+
+	//Publish the response to the IoTF
+	publishActionResponse(RESPONSE, respMsg);
+
+	cJSON_Delete(jsonPayload);
+
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG(logHdr,"exit::");
 }
@@ -1527,7 +2411,7 @@ void messageResponse(MessageData* md)
 		MQTTMessage* message = md->message;
 		void *payload = message->payload;
 		int sz = message->payloadlen;
-		char *pl = (char*) malloc(sizeof(char)*sz+1);
+		char *pl = (char*) iotf_malloc(sizeof(char)*sz+1);
 		strcpy(pl,message->payload);
 		char *reqID;
 		char *status;
@@ -1562,7 +2446,7 @@ void messageResponse(MessageData* md)
 			LOG_STR("%s != %s, Calling the callback",currentRequestID,reqID);
 			LOG(logHdr,logStr);
 		}
-		free(pl);
+		iotf_free(pl);
 	}
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -1580,13 +2464,13 @@ void messageForAction(MessageData* md, bool isReboot)
 
 		MQTTMessage* message = md->message;
 
-		char *topic = malloc(md->topicName->lenstring.len + 1);
+		char *topic = iotf_malloc(md->topicName->lenstring.len + 1);
 
 		sprintf(topic, "%.*s", md->topicName->lenstring.len,
 				md->topicName->lenstring.data);
 
 		void *payload = message->payload;
-		char *pl = (char*) malloc(sizeof(char)*message->payloadlen+1);
+		char *pl = (char*) iotf_malloc(sizeof(char)*message->payloadlen+1);
 		strcpy(pl,message->payload);
 
 		strtok(topic, "/");
@@ -1623,8 +2507,8 @@ void messageForAction(MessageData* md, bool isReboot)
 			(*cbFactoryReset)(reqID, action, payload);
 		}
 
-		free(topic);
-		free(pl);
+		iotf_free(topic);
+		iotf_free(pl);
 	}
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
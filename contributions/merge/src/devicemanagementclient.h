@@ -186,6 +186,47 @@ int initialize_dm(char *orgId, char *domianName, char *deviceType, char *deviceI
 */
 
 int connectiotf_dm(void);
+
+/**
+* Function used to point the device management client at a broker other than
+* <org>.messaging.<domain>, e.g. a local test broker
+* @param host - Host name or address to connect to, NULL restores the messaging hostname
+* @param port - Port to connect to, 0 keeps the configured port
+*
+* @return int return code
+*/
+int setServerAddress_dm(char* host, int port);
+
+/**
+* Function used to read the device management client's metrics, see getMetrics
+* @param out - Address to store the snapshot
+* @param reset - Non-zero to reset the metrics after reading them
+*
+* @return int return code
+*/
+int getMetrics_dm(iotf_metrics *out, int reset);
+
+/**
+* Function used to publish the device management client's metrics as a JSON event, see publishMetrics
+* @param eventType - Type of event to be published e.g metrics
+* @param reset - Non-zero to reset the metrics once they are taken for publishing
+*
+* @return int return code from the publish
+*/
+int publishMetrics_dm(char *eventType, int reset);
+
+/**
+* Function used to drive reconnection of the device management client without blocking, see pollReconnect
+*
+* @return int SUCCESS when connected, RECONNECT_PENDING while waiting for the next attempt
+*/
+int pollReconnect_dm(void);
+
+/**
+* Function used to report that the network interface came (back) up, see notifyNetworkUp
+*/
+void notifyNetworkUp_dm(void);
+
 /**
 * Function used to Publish events from the device to the IBM Watson IoT service
 *
@@ -286,6 +327,10 @@ void publishUnManageEvent(char* reqId);
 
 /**
  * Update the location.
+ * Pack versions up to 1.0.4 sent the latitude in the "longitude" field and the
+ * longitude in the "latitude" field. Each field now carries the value it is named for.
+ * A location the platform accepted is stored in DeviceData and, if "location" is
+ * observed, notified from the next yield_dm.
  *
  * @param latitude	Latitude in decimal degrees using WGS84
  *
@@ -325,6 +370,87 @@ void updateLocation(double latitude, double longitude, double elevation, char* m
  *        (200 means success, otherwise unsuccessful)
  */
 void updateLocationEx(double latitude, double longitude, double elevation, char* measuredDateTime,char* updatedDateTime, double accuracy, char* reqId);
+
+//Return codes of reportLocation and flushLocation
+#define LOCATION_SUPPRESSED 0
+#define LOCATION_QUEUED     1
+#define LOCATION_SENT       2
+
+//Statistics of the location reporter
+struct LocationStats{
+	unsigned int reported;
+	unsigned int sent;
+	unsigned int coalesced;
+	unsigned int suppressed;
+};
+
+/**
+ * Enables the location reporter. Once enabled, updateLocation and updateLocationEx
+ * return immediately and location updates are sent from yield_dm. An update is only
+ * sent when it differs from the last sent location (dmClient.DeviceData.deviceLocation)
+ * by at least one threshold. Updates arriving within minInterval of the last publish
+ * are coalesced so only the latest position is sent.
+ *
+ * @param minDistance Minimum movement in meters, 0 sends every position
+ *
+ * @param minAccuracyChange Minimum change of accuracy in meters, 0 disables this check
+ *
+ * @param minInterval Minimum time in milliseconds between two location publishes
+ *
+ * @param maxInterval Time in milliseconds after which an unchanged location is sent again by
+ * yield_dm, also when no location is reported any more, 0 disables
+ */
+void setLocationPolicy(double minDistance, double minAccuracyChange, unsigned int minInterval, unsigned int maxInterval);
+
+/**
+ * Disables the location reporter, updateLocation publishes every call again.
+ * A pending coalesced location is discarded.
+ */
+void clearLocationPolicy(void);
+
+/**
+ * Reports a location through the location reporter without blocking. The location is
+ * only recorded here. The next yield_dm (or flushLocation) sends it once the minimum
+ * interval has passed, and a newer report replaces it until then.
+ *
+ * @param latitude	Latitude in decimal degrees using WGS84
+ *
+ * @param longitude Longitude in decimal degrees using WGS84
+ *
+ * @param elevation	Elevation in meters using WGS84
+ *
+ * @param measuredDateTime	Date of location measurement in ISO8601 format
+ *
+ * @param updatedDateTime	Date of the update in ISO8601 format, may be NULL
+ *
+ * @param accuracy	Accuracy of the position in meters
+ *
+ * @param reqId Function returns the reqId the location is (or will be) sent with, may be NULL
+ *
+ * Once sent, the location is stored in DeviceData and an observed "location" field is
+ * notified like any other changed field, see markFieldChanged.
+ *
+ * @return LOCATION_SUPPRESSED or LOCATION_QUEUED
+ */
+int reportLocation(double latitude, double longitude, double elevation, char* measuredDateTime,
+		char* updatedDateTime, double accuracy, char* reqId);
+
+/**
+ * Sends the pending coalesced location if the minimum interval has elapsed, or the last
+ * sent location again once maxInterval has passed without one.
+ * Called from yield_dm, applications only need it when not calling yield_dm.
+ * reportLocation may be called from another thread meanwhile.
+ *
+ * @return LOCATION_SENT, LOCATION_QUEUED if still held back, 0 if nothing pending or a negative publish error
+ */
+int flushLocation(void);
+
+/**
+ * Returns the location reporter statistics
+ *
+ * @param stats Structure to be filled
+ */
+void getLocationStats(struct LocationStats* stats);
 /**
  * Adds the current errorcode to IBM Watson IoT Platform.
  *
@@ -373,6 +499,72 @@ void addLog(char* message, char* data ,int severity, char* reqId);
  */
 void clearLogs(char* reqId);
 
+//Size of the diagnostics ring and of the stored message/data strings
+#ifndef DIAG_RING_SIZE
+#define DIAG_RING_SIZE 8
+#endif
+#ifndef DIAG_TEXT_SIZE
+#define DIAG_TEXT_SIZE 64
+#endif
+
+//Diagnostics entries uploaded per yield_dm call. The platform takes one log or error code
+//per request, and each is a QoS1 publish that waits for its PUBACK.
+#ifndef DIAG_DRAIN_MAX
+#define DIAG_DRAIN_MAX 1
+#endif
+
+//Statistics of the diagnostics ring
+struct DiagStats{
+	unsigned int queued;
+	unsigned int sent;
+	unsigned int filtered;
+	unsigned int deduplicated;
+	unsigned int dropped;
+};
+
+/**
+ * Enables the diagnostics ring. Once enabled, addLog and addErrorCode return
+ * immediately after storing the entry in a local ring buffer, which is drained
+ * from yield_dm, DIAG_DRAIN_MAX entries per call. Each entry is uploaded on its own, with
+ * the reqId addLog or addErrorCode returned and, for logs, the time it was queued.
+ * clearLogs and clearErrorCodes also drop the entries of their type still in the ring.
+ * Repeated error codes still waiting in the ring are stored once with a count, and
+ * addErrorCode returns the reqId of the stored one.
+ * If the ring is full, the oldest entry is dropped.
+ *
+ * @param minSeverity Logs with lower severity are discarded (0 informational, 1 warning, 2 error)
+ *
+ * @param bytesPerSecond Upload budget in payload bytes per second, 0 for unlimited
+ *
+ * @param burstBytes Maximum budget that can be accumulated while idle
+ */
+void setDiagnosticsPolicy(int minSeverity, unsigned int bytesPerSecond, unsigned int burstBytes);
+
+/**
+ * Disables the diagnostics ring and discards entries not yet uploaded
+ */
+void clearDiagnosticsPolicy(void);
+
+/**
+ * Uploads the oldest entries of the diagnostics ring, at most DIAG_DRAIN_MAX, if the
+ * bandwidth budget allows it. Each entry is published with QoS1 and the call waits for
+ * its PUBACK, so with the default a yield_dm takes at most one extra round-trip. Called
+ * from yield_dm, applications only need it when not calling yield_dm. addLog and
+ * addErrorCode may be called from another thread meanwhile.
+ *
+ * @return number of entries sent or a negative publish error
+ */
+int flushDiagnostics(void);
+
+/**
+ * Returns the diagnostics ring statistics
+ *
+ * @param stats Structure to be filled
+ *
+ * @return number of entries currently waiting in the ring
+ */
+int getDiagnosticsStats(struct DiagStats* stats);
+
 /**
  * Register Callback function to managed request response
  *
@@ -416,6 +608,9 @@ void setFirmwareUpdateHandler(actionCallback cb);
  * Update the firmware state while downloading firmware and
  * Notifies the IBM Watson IoT Platform with the updated state
  *
+ * The notify message is not sent from this call. It is sent by the next yield_dm
+ * (or flushNotifications) once the observe interval has elapsed, see setObserveInterval.
+ *
  * @param state Download state update received from the device
  *
  * @return int return code
@@ -426,6 +621,9 @@ int changeFirmwareState(int state);
  * Update the firmware state while updating firmware and
  * Notifies the IBM Watson IoT Platform with the updated state
  *
+ * The notify message is not sent from this call. It is sent by the next yield_dm
+ * (or flushNotifications) once the observe interval has elapsed, see setObserveInterval.
+ *
  * @param state update state update received from the device
  *
  * @return int return code
@@ -433,6 +631,36 @@ int changeFirmwareState(int state);
  */
 int changeFirmwareUpdateState(int state);
 
+/**
+ * Marks a DeviceData field as changed after the application modified it.
+ * If the platform observes the field, one iotdevice-1/notify message carrying all
+ * fields changed within the observe interval is sent from yield_dm.
+ * Supported fields: "mgmt.firmware", "location", "deviceInfo", "metadata".
+ *
+ * @param field Name of the field as used by the platform
+ *
+ * @return 1 if the field is observed and a notification is scheduled,
+ *         0 if the field is not observed, -1 for unknown fields
+ */
+int markFieldChanged(const char* field);
+
+/**
+ * Sets the debounce interval for notifications of observed fields. Changes within
+ * the interval following the first change are coalesced into a single notify message.
+ *
+ * @param interval Interval in milliseconds, 0 sends on the next yield_dm
+ */
+void setObserveInterval(unsigned int interval);
+
+/**
+ * Sends the pending notification of changed observed fields once the interval elapsed.
+ * Called from yield_dm, applications only need it when not calling yield_dm.
+ * Changes whose values do not fit in one notify message are logged and dropped.
+ *
+ * @return number of fields notified, -1 if the changes were dropped, or a negative publish error
+ */
+int flushNotifications(void);
+
 int changeState(int rc);
 
 //util functions
@@ -444,8 +672,11 @@ void messageCancel(MessageData* md);
 void messageForAction(MessageData* md, bool isReboot);
 void generateUUID(char* uuid_str);
 int publish(char* publishTopic, char* data);
+int publishLen(char* publishTopic, char* data, size_t len);
 int publishActionResponse(char* publishTopic, char* data);
 void getMessageFromReturnCode(int rc, char* msg);
+int buildLocationPayload(char* buf, size_t size, double latitude, double longitude, double elevation,
+                         char* measuredDateTime, char* updatedDateTime, double accuracy, char* reqId);
 void messageFirmwareDownload(MessageData* md);
 void messageFirmwareUpdate(MessageData* md);
 
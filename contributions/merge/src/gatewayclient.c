@@ -132,7 +132,7 @@ int subscribeToGatewayCommands(iotfclient  *client)
 
 	char* subscribeTopic = NULL;
 
-	subscribeTopic = (char*) malloc(strlen(client->cfg.id) + strlen(client->cfg.type) + 28);
+	subscribeTopic = (char*) iotf_malloc(strlen(client->cfg.id) + strlen(client->cfg.type) + 28);
 
 	sprintf(subscribeTopic, "iot-2/type/%s/id/%s/cmd/+/fmt/+", client->cfg.type, client->cfg.id);
 
@@ -166,7 +166,7 @@ int subscribeToDeviceCommands(iotfclient  *client, char* deviceType, char* devic
 
 	char* subscribeTopic = NULL;
 
-	subscribeTopic = (char*)malloc(strlen(deviceType) + strlen(deviceId) + strlen(command) + strlen(format) + 26);
+	subscribeTopic = (char*)iotf_malloc(strlen(deviceType) + strlen(deviceId) + strlen(command) + strlen(format) + 26);
 
 	sprintf(subscribeTopic, "iot-2/type/%s/id/%s/cmd/%s/fmt/%s", deviceType, deviceId, command, format);
 
@@ -205,7 +205,7 @@ int disconnectGateway(iotfclient  *client)
 
 	//free memory for subscriptions
 	for(count = 0; count < subscribeCount ; count++)
-		free(subscribeTopics[count]);
+		iotf_free(subscribeTopics[count]);
 
 	LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	LOG_STR("RC from iotf disconnect function - %d",rc);
@@ -224,7 +224,7 @@ void gatewayMessageArrived(MessageData* md)
        if(cbGateway != 0) {
 	       MQTTMessage* message = md->message;
 
-	       char *topic = malloc(md->topicName->lenstring.len+1);
+	       char *topic = iotf_malloc(md->topicName->lenstring.len+1);
 
 	       sprintf(topic,"%.*s",md->topicName->lenstring.len,md->topicName->lenstring.data);
 
@@ -232,24 +232,31 @@ void gatewayMessageArrived(MessageData* md)
 
 	       size_t payloadlen = message->payloadlen;
 
-	       strtok(topic, "/");
-	       strtok(NULL, "/");
-
-	       char *type = strtok(NULL, "/");
-	       strtok(NULL, "/");
-	       char *id = strtok(NULL, "/");
-	       strtok(NULL, "/");
-	       char *commandName = strtok(NULL, "/");
-	       strtok(NULL, "/");
-	       char *format = strtok(NULL, "/");
-
-	       free(topic);
+	       //iot-2/type/<type>/id/<id>/cmd/<command>/fmt/<format>, split in place.
+	       //strtok is not used as gateway pool workers may get here concurrently.
+	       char *segment[10] = {NULL};
+	       char *p = topic;
+	       int count = 0;
+	       while(count < 10) {
+		       segment[count++] = p;
+		       if((p = strchr(p, '/')) == NULL)
+			       break;
+		       *p++ = '\0';
+	       }
+
+	       char *type = segment[2];
+	       char *id = segment[4];
+	       char *commandName = segment[6];
+	       char *format = segment[8];
 
 	       LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
 	       LOG_STR("Calling registered callabck to process the arrived message");
 	       LOG(logHdr,logStr);
 
+	       metrics_command();
 	       (*cbGateway)(type,id,commandName, format, payload,payloadlen);
+
+	       iotf_free(topic);
        }
        else{
 	       LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -34,12 +34,31 @@ void NewNetwork(Network* n)
        n->my_socket = 0;
        n->mqttread = network_read;
        n->mqttwrite = network_write;
+       n->mqttwritev = network_writev;
        n->disconnect = network_disconnect;
+       n->metrics = NULL;
+       n->resolver = NULL;
+       n->deadline = NULL;
+       n->progress = NULL;
+       n->corked = 0;
+       n->held = 0;
+       n->tail = NULL;
+       n->tailLen = 0;
+       n->tailOwner = NULL;
+       n->rxOff = n->rxLen = 0;
+       n->rcvTimeout = -1;
        n->TLSConnectData.pServerCertLocation = NULL;
        n->TLSConnectData.pRootCACertLocation = NULL;
        n->TLSConnectData.pDeviceCertLocation = NULL;
        n->TLSConnectData.pDevicePrivateKeyLocation = NULL;
        n->TLSConnectData.pDestinationURL = NULL;
+       n->TLSConnectData.restrictSuites = 0;
+       n->TLSConnectData.pServerCertPin = NULL;
+       n->TLSConnectData.pPskIdentity = NULL;
+       n->TLSConnectData.pPsk = NULL;
+       n->TLSConnectData.pResolver = NULL;
+       n->TLSConnectData.pDeadline = NULL;
+       n->TLSConnectData.progress = NULL;
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"exit::");
@@ -59,15 +78,17 @@ static uint32_t TickFreq;
  	return (left >= 0x80000000U);
  }
 
- /** Function to update timer with given timeout value in milliseconds
+ /** Function to update timer with given timeout value in milliseconds. Timeouts longer
+ * than 2^31 ticks, which expired could not tell from a past end time, are cut to that.
  * @param - Address of Timer and timeout in milliseconds
  * @return - void
  **/
  void countdown_ms(Timer* timer, unsigned int timeout)
  {
  	uint32_t tick;
+ 	uint64_t ticks = ((uint64_t)timeout * TickFreq) / 1000U;
  	tick = osKernelGetTickCount();
- 	timer->end_time = tick + ((timeout * TickFreq) / 1000U);
+ 	timer->end_time = tick + ((ticks < 0x80000000U) ? (uint32_t)ticks : 0x7FFFFFFFU);
  }
 
  /** Function to update timer with given timeout value in seconds
@@ -103,46 +124,314 @@ static uint32_t TickFreq;
  	timer->end_time =  0U;
  }
 
- /** Function to establish connection to given host address and port without SSL/TLS
+ /** Function to forget the addresses of a resolver, the next connect resolves the name
+ * @param - Address of net_resolver structure
+ * @return - void
+ **/
+ void net_resolver_init(net_resolver *r)
+ {
+ 	r->name[0] = '\0';
+ 	r->count = 0;
+ 	r->fixed = 0;
+ 	r->good = -1;
+ 	r->resolvedAt = 0;
+ }
+
+ /** Function to parse a dotted IPv4 address
+ * @param - String starting with the address
+ *        - Address to fill
+ * @return - Number of characters parsed, 0 if the string does not start with an address
+ **/
+ static int net_parse_ipv4(const char *str, net_addr *a)
+ {
+ 	int i, len = 0;
+
+ 	for (i = 0; i < 4; i++)
+ 	{
+ 		int value = 0, digits = 0;
+
+ 		if (i > 0 && str[len++] != '.')
+ 			return 0;
+ 		while (digits < 3 && str[len] >= '0' && str[len] <= '9')
+ 		{
+ 			value = 10 * value + (str[len++] - '0');
+ 			digits++;
+ 		}
+ 		if (digits == 0 || value > 255)
+ 			return 0;
+ 		a->ip[i] = (uint8_t)value;
+ 	}
+ 	a->len = 4;
+ 	return len;
+ }
+
+ /** Function to give a resolver addresses that are used instead of resolving the name
+ * @param - Address of net_resolver structure
+ *        - IPv4 addresses separated by commas, at most IOTF_NETWORK_ADDRS
+ * @return - 0 on SUCCESS
+ *         - -1 if the list is empty, too long or has something else than IPv4 addresses
+ **/
+ int net_resolver_fixed(net_resolver *r, const char *list)
+ {
+ 	int len;
+
+ 	net_resolver_init(r);
+ 	while (r->count < IOTF_NETWORK_ADDRS && (len = net_parse_ipv4(list, &r->addr[r->count])) > 0)
+ 	{
+ 		r->count++;
+ 		list += len;
+ 		if (*list != ',')
+ 			break;
+ 		list++;
+ 	}
+ 	if (r->count == 0 || *list != '\0')
+ 	{
+ 		net_resolver_init(r);
+ 		return -1;
+ 	}
+ 	r->fixed = 1;
+ 	return 0;
+ }
+
+ /** Function to make sure a resolver has addresses for a host name. An IPv4 address is
+ * taken as it is. Resolved addresses are used for IOTF_NETWORK_DNS_TTL seconds, and for
+ * as long as the name does not resolve again afterwards.
+ * @param - Address of net_resolver structure
+ *        - Host name or IPv4 address
+ * @return - 0 on SUCCESS
+ *         - IoT Socket error on FAILURE
+ **/
+ static int net_resolve(net_resolver *r, const char *name)
+ {
+ 	net_addr found[2];
+ 	int count = 0, i, same;
+ 	int32_t rc = IOT_SOCKET_EHOSTNOTFOUND;
+ 	uint32_t now = osKernelGetTickCount();
+
+ 	if (r->fixed)
+ 		return 0;
+ 	same = (r->count > 0 && strncmp(r->name, name, NET_NAME_SIZE) == 0);
+ 	if (same && now - r->resolvedAt < IOTF_NETWORK_DNS_TTL * osKernelGetTickFreq())
+ 		return 0;
+
+ 	i = net_parse_ipv4(name, &found[0]);
+ 	if (i > 0 && name[i] == '\0')
+ 		count = 1;
+ 	else
+ 	{
+#if IOTF_NETWORK_IPV6
+ 		found[count].len = sizeof(found[count].ip);
+ 		if (iotSocketGetHostByName(name, IOT_SOCKET_AF_INET6, found[count].ip, &found[count].len) == 0)
+ 			count++;
+#endif
+ 		found[count].len = sizeof(found[count].ip);
+ 		if ((rc = iotSocketGetHostByName(name, IOT_SOCKET_AF_INET, found[count].ip, &found[count].len)) == 0)
+ 			count++;
+ 	}
+
+ 	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+ 	if (count == 0)
+ 	{
+ 		LOG_STR("%s does not resolve, rc = %d%s",name,rc,same ? ", using its last addresses" : "");
+ 		LOG(logHdr,logStr);
+ 		return same ? 0 : rc;
+ 	}
+ 	LOG_STR("%s resolved to %d addresses",name,count);
+ 	LOG(logHdr,logStr);
+
+ 	//The address that connected last stays the first one tried if it is still there
+ 	net_addr good = (same && r->good >= 0) ? r->addr[r->good] : found[0];
+ 	r->good = -1;
+ 	for (i = 0; i < count; i++)
+ 	{
+ 		r->addr[i] = found[i];
+ 		if (same && found[i].len == good.len && memcmp(found[i].ip, good.ip, good.len) == 0)
+ 			r->good = i;
+ 	}
+ 	r->count = count;
+ 	r->resolvedAt = now;
+ 	//A longer name is never the same and is resolved every time
+ 	if (strlen(name) < NET_NAME_SIZE)
+ 		strcpy(r->name, name);
+ 	else
+ 		r->name[0] = '\0';
+ 	return 0;
+ }
+
+ /** Function to connect a TCP socket to a host. The address that connected last is tried
+ * first. While a connect is pending, the next address is tried alongside it every
+ * IOTF_NETWORK_CONNECT_STAGGER milliseconds, and the first connection to complete is kept.
+ * The sockets connect without blocking, so a broker that does not answer costs no more
+ * than the time left in the deadline. Pending sockets are polled at growing intervals,
+ * each wait bounded by the stagger and the deadline.
+ * @param - Address of net_resolver structure, kept by the caller across connections
+ *        - Host name or IPv4 address
+ *        - Port number
+ *        - Address of Timer the connect has to complete by, NULL for
+ *          IOTF_NETWORK_CONNECT_TIMEOUT milliseconds
+ *        - Function called at each stage of the connect, NULL for none
+ * @return - Blocking socket on SUCCESS
+ *         - Negative IoT Socket error on FAILURE, IOT_SOCKET_ETIMEDOUT when the deadline passed
+ **/
+ int net_connect(net_resolver *r, const char *name, int port, Timer *deadline, net_progress progress)
+ {
+ 	int32_t sock[IOTF_NETWORK_ADDRS];
+ 	int order[IOTF_NETWORK_ADDRS];
+ 	int i, started = 0, pending = 0, won = -1;
+ 	uint32_t nonBlocking = 1, wait = 0U;
+ 	int32_t rc;
+ 	int left;
+ 	Timer limit, next;
+
+ 	InitTimer(&next);
+ 	if (deadline == NULL)
+ 	{
+ 		InitTimer(&limit);
+ 		countdown_ms(&limit, IOTF_NETWORK_CONNECT_TIMEOUT);
+ 		deadline = &limit;
+ 	}
+ 	if ((rc = net_resolve(r, name)) != 0)
+ 	{
+ 		if (progress != NULL)
+ 			progress(NET_STAGE_FAILED, NULL, rc);
+ 		return rc;
+ 	}
+ 	if (progress != NULL)
+ 		progress(NET_STAGE_RESOLVED, NULL, r->count);
+ 	if (r->good >= 0)
+ 		order[started++] = r->good;
+ 	for (i = 0; i < r->count; i++)
+ 		if (i != r->good)
+ 			order[started++] = i;
+ 	started = 0;
+
+ 	rc = IOT_SOCKET_ETIMEDOUT;
+ 	while (won < 0)
+ 	{
+ 		if (expired(deadline))
+ 		{
+ 			rc = IOT_SOCKET_ETIMEDOUT;
+ 			break;
+ 		}
+ 		if (started < r->count && (pending == 0 || expired(&next)))
+ 		{
+ 			net_addr *a = &r->addr[order[started]];
+ 			int32_t s = iotSocketCreate((a->len == 16) ? IOT_SOCKET_AF_INET6 : IOT_SOCKET_AF_INET,
+ 			                            IOT_SOCKET_SOCK_STREAM, IOT_SOCKET_IPPROTO_TCP);
+
+ 			sock[started++] = s;
+ 			countdown_ms(&next, IOTF_NETWORK_CONNECT_STAGGER);
+ 			wait = 0U;
+ 			if (progress != NULL)
+ 				progress(NET_STAGE_CONNECTING, a, 0);
+ 			if (s < 0)
+ 			{
+ 				rc = s;
+ 				if (progress != NULL)
+ 					progress(NET_STAGE_FAILED, a, rc);
+ 				continue;
+ 			}
+ 			iotSocketSetOpt(s, IOT_SOCKET_IO_FIONBIO, &nonBlocking, sizeof(nonBlocking));
+ 			rc = iotSocketConnect(s, a->ip, a->len, (uint16_t)port);
+ 			if (rc == 0 || rc == IOT_SOCKET_EISCONN)
+ 				won = started - 1;
+ 			else if (rc == IOT_SOCKET_EINPROGRESS || rc == IOT_SOCKET_EALREADY || rc == IOT_SOCKET_EAGAIN)
+ 				pending++;
+ 			else
+ 			{
+ 				iotSocketClose(s);
+ 				sock[started - 1] = -1;
+ 				if (progress != NULL)
+ 					progress(NET_STAGE_FAILED, a, rc);
+ 			}
+ 			continue;
+ 		}
+ 		//A pending connect is asked again until it reports connected or an error
+ 		for (i = 0; i < started && won < 0; i++)
+ 		{
+ 			int32_t st;
+
+ 			if (sock[i] < 0)
+ 				continue;
+ 			st = iotSocketConnect(sock[i], r->addr[order[i]].ip, r->addr[order[i]].len, (uint16_t)port);
+ 			if (st == 0 || st == IOT_SOCKET_EISCONN)
+ 				won = i;
+ 			else if (st != IOT_SOCKET_EINPROGRESS && st != IOT_SOCKET_EALREADY && st != IOT_SOCKET_EAGAIN)
+ 			{
+ 				rc = st;
+ 				iotSocketClose(sock[i]);
+ 				sock[i] = -1;
+ 				pending--;
+ 				if (progress != NULL)
+ 					progress(NET_STAGE_FAILED, &r->addr[order[i]], rc);
+ 			}
+ 		}
+ 		if (won >= 0 || (pending == 0 && started == r->count))
+ 			break;
+ 		//The IoT Socket API cannot wait on a socket, so the wait between two polls doubles
+ 		//from one tick, up to a stagger, and never runs past the next address due or the deadline
+ 		wait = (wait == 0U) ? 1U : wait * 2U;
+ 		left = (started < r->count) ? left_ms(&next) : IOTF_NETWORK_CONNECT_STAGGER;
+ 		if (left_ms(deadline) < left)
+ 			left = left_ms(deadline);
+ 		if (wait > ((uint32_t)left * TickFreq) / 1000U)
+ 			wait = ((uint32_t)left * TickFreq) / 1000U;
+ 		osDelay((wait > 0U) ? wait : 1U);
+ 	}
+
+ 	for (i = 0; i < started; i++)
+ 		if (i != won && sock[i] >= 0)
+ 			iotSocketClose(sock[i]);
+ 	if (won < 0)
+ 	{
+ 		rc = (rc < 0) ? rc : IOT_SOCKET_ERROR;
+ 		LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+ 		LOG_STR("connect to %s:%d failed on %d addresses, rc = %d",name,port,r->count,rc);
+ 		LOG(logHdr,logStr);
+ 		//Resolved again by the next connect, the addresses may have moved
+ 		if (!r->fixed)
+ 			r->resolvedAt = osKernelGetTickCount() - IOTF_NETWORK_DNS_TTL * osKernelGetTickFreq();
+ 		if (progress != NULL)
+ 			progress(NET_STAGE_FAILED, NULL, rc);
+ 		return rc;
+ 	}
+ 	nonBlocking = 0;
+ 	iotSocketSetOpt(sock[won], IOT_SOCKET_IO_FIONBIO, &nonBlocking, sizeof(nonBlocking));
+ 	r->good = order[won];
+ 	if (progress != NULL)
+ 		progress(NET_STAGE_CONNECTED, &r->addr[r->good], 0);
+ 	return sock[won];
+ }
+
+ /** Function to establish connection to given host address and port without SSL/TLS.
+ * The connect ends by n->deadline and reports its stages to n->progress, see net_connect.
  * @param - Address of Network Structure
  *        - Host Address to connect
  *        - Port number to connect
  * @return - 0 for SUCCESS
- *         - -1 for FAILURE
+ *         - negative IoT Socket error for FAILURE, IOT_SOCKET_ETIMEDOUT when the deadline passed
  **/
  int ConnectNetwork(Network* n, char* addr, int port)
  {
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
- 	unsigned char ip[4];
- 	unsigned int  ip_len = sizeof(ip);
+ 	net_resolver once;
  	int rc;
 
- 	rc = iotSocketGetHostByName(addr, IOT_SOCKET_AF_INET, &ip[0], &ip_len);
- 	if (rc == 0)
- 	{
-                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-                LOG_STR("%s","ADDR FAMILY: AF_INET");
-                LOG(logHdr,logStr);
- 	}
-
- 	if (rc == 0)
+ 	if (n->resolver == NULL)
+ 		net_resolver_init(&once);
+ 	rc = net_connect((n->resolver != NULL) ? n->resolver : &once, addr, port, n->deadline, n->progress);
+ 	if (rc >= 0)
  	{
- 		n->my_socket = iotSocketCreate(IOT_SOCKET_AF_INET, IOT_SOCKET_SOCK_STREAM, 0);
+ 		n->my_socket = rc;
+ 		n->rxOff = n->rxLen = 0;
+ 		n->rcvTimeout = -1;
+ 		rc = 0;
 
                 LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
                 LOG_STR("Socket FD: %d",n->my_socket);
                 LOG(logHdr,logStr);
-
- 		if (n->my_socket >= 0)
- 		{
- 			rc = iotSocketConnect(n->my_socket, &ip[0], ip_len, (unsigned short)port);
-
-                        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-                        LOG_STR("RC from connect - %d :",rc);
-                        LOG(logHdr,logStr);
- 		}
  	}
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
@@ -153,56 +442,117 @@ static uint32_t TickFreq;
  	return rc;
  }
 
- /** Function to read data from the socket opened into provided buffer
+ /** Function to receive what the socket has, at most len bytes, with a single recv.
+ * The receive timeout is set only when it changes.
  * @param - Address of Network Structure
  *        - Buffer to store the data read from socket
- *        - Expected number of bytes to read from socket
- *        - Timeout in milliseconds
- * @return - Number of Bytes read on SUCCESS
+ *        - Maximum number of bytes to read from socket
+ *        - Timeout in milliseconds for the first byte
+ * @return - Number of Bytes read, 0 if none arrived in time
  *         - -1 on FAILURE
  **/
- int network_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ static int network_recv(Network* n, unsigned char* buffer, int len, int timeout_ms)
  {
-        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-        LOG(logHdr,"entry::");
-
- 	int bytes = 0;
  	int rc;
 
  	if (timeout_ms == 0)
  	{
  		timeout_ms = 10;
  	}
+ 	if (timeout_ms != n->rcvTimeout)
+ 	{
+ 		iotSocketSetOpt(n->my_socket, IOT_SOCKET_SO_RCVTIMEO, &timeout_ms, sizeof(int));
+ 		n->rcvTimeout = timeout_ms;
+ 	}
 
- 	iotSocketSetOpt(n->my_socket, IOT_SOCKET_SO_RCVTIMEO, &timeout_ms, sizeof(int));
+ 	rc = iotSocketRecv(n->my_socket, buffer, (uint32_t)len);
+ 	if (rc < 0)
+ 	{
+ 		if (rc == IOT_SOCKET_EAGAIN)
+ 			return 0;
+                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+                LOG_STR("network_read failed while calling recv with return code - %d\n",rc);
+                LOG(logHdr,logStr);
+ 		return -1;
+ 	}
+ 	if (n->metrics != NULL)
+ 		metrics_add(&n->metrics->readsIn, 1);
+ 	return rc;
+ }
+
+ typedef int (*recv_fn)(Network*, unsigned char*, int, int);
+
+ /** Function to read exactly len bytes unless the timeout runs out. MQTTClient-C reads a
+ * packet as the type byte, the remaining length one byte at a time and the rest. Each
+ * receive takes what has arrived, up to IOTF_NETWORK_READ_AHEAD bytes, so the small reads
+ * of a packet are served from memory. Reads of a full read-ahead buffer or more go
+ * straight to the caller's buffer.
+ * @param - Address of Network Structure
+ *        - Buffer to store the data read
+ *        - Expected number of bytes to read
+ *        - Timeout in milliseconds for each receive
+ *        - Function receiving on the transport of the network
+ * @return - Number of Bytes read on SUCCESS, fewer if the timeout ran out
+ *         - -1 on FAILURE
+ **/
+ static int read_ahead(Network* n, unsigned char* buffer, int len, int timeout_ms, recv_fn transport)
+ {
+ 	int bytes = 0;
+ 	int rc;
 
  	while (bytes < len)
  	{
- 		rc = iotSocketRecv(n->my_socket, &buffer[bytes], (uint32_t)(len - bytes));
- 		if (rc < 0)
+#if IOTF_NETWORK_READ_AHEAD > 0
+ 		if (n->rxOff < n->rxLen)
  		{
- 			if (rc != IOT_SOCKET_EAGAIN)
+ 			rc = n->rxLen - n->rxOff;
+ 			if (rc > len - bytes)
+ 				rc = len - bytes;
+ 			memcpy(&buffer[bytes], &n->rx[n->rxOff], (size_t)rc);
+ 			n->rxOff += rc;
+ 			bytes += rc;
+ 			continue;
+ 		}
+ 		if (len - bytes < IOTF_NETWORK_READ_AHEAD)
+ 		{
+ 			if ((rc = transport(n, n->rx, IOTF_NETWORK_READ_AHEAD, timeout_ms)) <= 0)
  			{
-                                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-                                LOG_STR("network_read failed while calling recv with return code - %d\n",rc);
-                                LOG(logHdr,logStr);
- 				bytes = -1;
+ 				bytes = (rc < 0) ? -1 : bytes;
+ 				break;
  			}
+ 			n->rxOff = 0;
+ 			n->rxLen = rc;
+ 			continue;
+ 		}
+#endif
+ 		if ((rc = transport(n, &buffer[bytes], len - bytes, timeout_ms)) <= 0)
+ 		{
+ 			bytes = (rc < 0) ? -1 : bytes;
  			break;
  		}
- 		else
- 			bytes += rc;
+ 		bytes += rc;
  	}
 
-        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-        LOG_STR("bytes - %d ",bytes);
-        LOG(logHdr,logStr);
-        LOG(logHdr,"exit::");
+        if (bytes > 0 && n->metrics != NULL)
+                metrics_add64(&n->metrics->bytesIn, (uint64_t)bytes);
 
  	return bytes;
  }
 
- /** Function to write data to the socket opened present in provided buffer
+ /** Function to read data from the socket opened into provided buffer
+ * @param - Address of Network Structure
+ *        - Buffer to store the data read from socket
+ *        - Expected number of bytes to read from socket
+ *        - Timeout in milliseconds
+ * @return - Number of Bytes read on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ {
+        return read_ahead(n, buffer, len, timeout_ms, network_recv);
+ }
+
+ /** Function to send data to the socket opened present in provided buffer
  * @param - Address of Network Structure
  *        - Buffer storing the data to write to socket
  *        - Number of bytes of data to write to socket
@@ -210,7 +560,7 @@ static uint32_t TickFreq;
  * @return - Number of Bytes written on SUCCESS
  *         - -1 on FAILURE
  **/
- int network_write(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ static int network_send(Network* n, unsigned char* buffer, int len, int timeout_ms)
  {
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
@@ -235,9 +585,19 @@ static uint32_t TickFreq;
  			break;
  		}
  		else
+ 		{
  			bytes += rc;
+ 			if (n->metrics != NULL)
+ 				metrics_add(&n->metrics->recordsOut, 1);
+ 		}
  	}
 
+        if (bytes > 0 && n->metrics != NULL)
+        {
+                metrics_add64(&n->metrics->bytesOut, (uint64_t)bytes);
+                metrics_add64(&n->metrics->wireBytesOut, (uint64_t)bytes);
+        }
+
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG_STR("bytes - %d ",bytes);
         LOG(logHdr,logStr);
@@ -246,6 +606,267 @@ static uint32_t TickFreq;
  	return bytes;
  }
 
+ typedef int (*send_fn)(Network*, unsigned char*, int, int);
+
+ static int packet_header_end(const unsigned char* buffer, int len);
+ static int tail_write(Network* n, unsigned char* buffer, int len, int end, int timeout_ms);
+
+ /** Function to write through the cork of a network. While the network is corked, a write
+ * that fits is held. Otherwise the held bytes leave first, together with this write if it
+ * fits, so the write that ends a corked section still makes one send or TLS record.
+ * @param - Address of Network Structure
+ *        - Buffer storing the data to write
+ *        - Number of bytes of data to write
+ *        - Timeout in milliseconds
+ *        - Function sending on the transport of the network
+ * @return - Number of Bytes written on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ static int corked_write(Network* n, unsigned char* buffer, int len, int timeout_ms, send_fn transport)
+ {
+        int end;
+
+        //PUBLISH packet type in the fixed header, written in one piece
+        if (n->tail != NULL && len > 1 && (buffer[0] >> 4) == 3 && n->tailOwner == osThreadGetId() &&
+            (end = packet_header_end(buffer, len)) > 0)
+                return tail_write(n, buffer, len, end, timeout_ms);
+#if IOTF_NETWORK_CORK_SIZE > 0
+        int held = n->held;
+
+        if (held > 0 && held + len > IOTF_NETWORK_CORK_SIZE)
+        {
+                n->held = 0;
+                if (transport(n, n->cork, held, timeout_ms) != held)
+                        return -1;
+                held = 0;
+        }
+        if ((n->corked > 0 || held > 0) && held + len <= IOTF_NETWORK_CORK_SIZE)
+        {
+                memcpy(&n->cork[held], buffer, (size_t)len);
+                n->held = held + len;
+                if (n->corked > 0)
+                        return len;
+                n->held = 0;
+                return (transport(n, n->cork, held + len, timeout_ms) == held + len) ? len : -1;
+        }
+#endif
+        return transport(n, buffer, len, timeout_ms);
+ }
+
+ /** Function to write data to the socket opened present in provided buffer
+ * @param - Address of Network Structure
+ *        - Buffer storing the data to write to socket
+ *        - Number of bytes of data to write to socket
+ *        - Timeout in milliseconds
+ * @return - Number of Bytes written on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_write(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ {
+        return corked_write(n, buffer, len, timeout_ms, network_send);
+ }
+
+ /** Function to write several buffers in order through the network's mqttwrite, so the
+ * parts are sent from where they are without being gathered into one buffer first.
+ * Each part is one write, on the TLS path one record or more.
+ * @param - Address of Network Structure
+ *        - Parts to write
+ *        - Number of parts
+ *        - Timeout in milliseconds for all parts together
+ * @return - Number of Bytes written on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_writev(Network* n, const net_iovec* iov, int count, int timeout_ms)
+ {
+        Timer timer;
+        int bytes = 0;
+        int i, rc, left;
+
+        countdown_ms(&timer, (unsigned int)timeout_ms);
+        for (i = 0; i < count; i++)
+        {
+                if (iov[i].len == 0)
+                        continue;
+                //A socket timeout of 0 would block without limit
+                if ((left = left_ms(&timer)) == 0 ||
+                    (rc = n->mqttwrite(n, iov[i].data, iov[i].len, left)) != iov[i].len)
+                {
+                        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+                        LOG_STR("network_writev failed at part %d of %d",i,count);
+                        LOG(logHdr,logStr);
+                        return -1;
+                }
+                bytes += rc;
+        }
+        return bytes;
+ }
+
+ /** Function to find the end of the fixed header of a whole MQTT packet
+ * @param - Packet
+ *        - Length of the packet
+ * @return - Offset of the variable header
+ *         - 0 if the buffer does not hold exactly one packet
+ **/
+ static int packet_header_end(const unsigned char* buffer, int len)
+ {
+        int rem = 0, mult = 1, end = 1;
+
+        //Remaining length, at most 4 bytes
+        do {
+                if (end > 4 || end >= len)
+                        return 0;
+                rem += (buffer[end] & 127) * mult;
+                mult *= 128;
+        } while ((buffer[end++] & 128) != 0);
+        return (end + rem == len) ? end : 0;
+ }
+
+ /** Function to write a PUBLISH packet serialized with the head of its payload, followed by
+ * the payload rest attached with network_attach_tail. The remaining length in the fixed
+ * header is raised by the length of the rest, in place when its encoding keeps its size.
+ * @param - Address of Network Structure
+ *        - Packet as serialized by MQTTPublish
+ *        - Length of the packet
+ *        - Offset of its variable header
+ *        - Timeout in milliseconds for all parts together
+ * @return - len on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ static int tail_write(Network* n, unsigned char* buffer, int len, int end, int timeout_ms)
+ {
+        unsigned char head[5];
+        net_iovec iov[3], rest;
+        int rem = len - end, hlen = 1, count = 0;
+
+        //Taken once, the writes below do not see it again
+        rest.data = (unsigned char *)n->tail;
+        rest.len = n->tailLen;
+        n->tail = NULL;
+
+        rem += rest.len;
+        head[0] = buffer[0];
+        do {
+                head[hlen] = (unsigned char)(rem % 128);
+                rem /= 128;
+                if (rem > 0)
+                        head[hlen] |= 128;
+                hlen++;
+        } while (rem > 0 && hlen < 5);
+
+        if (hlen == end)
+        {
+                memcpy(buffer, head, (size_t)hlen);
+                iov[count].data = buffer;
+                iov[count++].len = len;
+        }
+        else
+        {
+                iov[count].data = head;
+                iov[count++].len = hlen;
+                iov[count].data = buffer + end;
+                iov[count++].len = len - end;
+        }
+        iov[count++] = rest;
+
+        if (n->mqttwritev(n, iov, count, timeout_ms) < 0)
+                return -1;
+        return len;
+ }
+
+ /** Function to attach memory that the next PUBLISH packet written by the calling thread
+ * carries after its serialized part, see tail_write. A packet larger than the client's send
+ * buffer is published by MQTTPublish with the head of the payload and the rest attached here,
+ * so the rest is sent from the caller's memory. Other threads wait until the tail is detached.
+ * @param - Address of Network Structure
+ *        - Payload rest
+ *        - Length of the payload rest
+ *        - Timeout in milliseconds to wait for another thread's tail
+ * @return - 0 on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_attach_tail(Network* n, const unsigned char* tail, int len, int timeout_ms)
+ {
+        osThreadId_t self = osThreadGetId();
+        Timer timer;
+
+        countdown_ms(&timer, (unsigned int)timeout_ms);
+        for (;;)
+        {
+                osThreadId_t none = NULL;
+                if (__atomic_compare_exchange_n(&n->tailOwner, &none, self, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                        break;
+                if (expired(&timer))
+                        return -1;
+                osDelay(1);
+        }
+        n->tail = tail;
+        n->tailLen = len;
+        return 0;
+ }
+
+ /** Function to drop the tail of network_attach_tail, whether the packet took it or not
+ * @param - Address of Network Structure
+ * @return - void
+ **/
+ void network_detach_tail(Network* n)
+ {
+        if (n->tailOwner != osThreadGetId())
+                return;
+        n->tail = NULL;
+        n->tailLen = 0;
+        __atomic_store_n(&n->tailOwner, NULL, __ATOMIC_RELEASE);
+ }
+
+ /** Function to hold the following writes of a network until network_uncork, so several
+ * small packets, e.g. a burst of QoS0 events, leave as one send or TLS record. Calls nest.
+ * A QoS1 or QoS2 publish and yield flush the held bytes, as they wait for the broker.
+ * @param - Address of Network Structure
+ * @return - void
+ **/
+ void network_cork(Network* n)
+ {
+        n->corked++;
+ }
+
+ /** Function to end a corked section, the outermost one flushes the held bytes
+ * @param - Address of Network Structure
+ *        - Timeout in milliseconds
+ * @return - 0 on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_uncork(Network* n, int timeout_ms)
+ {
+        if (n->corked > 0 && --n->corked > 0)
+                return 0;
+        return network_flush(n, timeout_ms);
+ }
+
+ /** Function to write the bytes held by network_cork now, corked or not
+ * @param - Address of Network Structure
+ *        - Timeout in milliseconds
+ * @return - 0 on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int network_flush(Network* n, int timeout_ms)
+ {
+#if IOTF_NETWORK_CORK_SIZE > 0
+        int corked = n->corked;
+        int rc;
+
+        if (n->held == 0)
+                return 0;
+        //A write of nothing while not corked sends what is held
+        n->corked = 0;
+        rc = n->mqttwrite(n, &n->cork[n->held], 0, timeout_ms);
+        n->corked = corked;
+        return (rc < 0) ? -1 : 0;
+#else
+        (void)n;
+        (void)timeout_ms;
+        return 0;
+#endif
+ }
+
  /** Function used to close the opened socket for communication. If the given mode is quick start,
  it just closes the socket opened otherwise it calls teardown_tls function to cleanup mbedtls structures.
  * @param - Address of Network Structure
@@ -254,6 +875,8 @@ static uint32_t TickFreq;
  **/
  void network_disconnect(Network* n, int qsMode)
  {
+        n->held = 0;
+        n->rxOff = n->rxLen = 0;
         if(qsMode)
  	  iotSocketClose(n->my_socket);
         else
@@ -275,13 +898,15 @@ static uint32_t TickFreq;
         mbedtls_net_init( &(tlsInitParams->server_fd) );
         mbedtls_ssl_init( &(tlsInitParams->ssl) );
         mbedtls_ssl_config_init( &(tlsInitParams->conf) );
-        mbedtls_x509_crt_init( &(tlsInitParams->cacert) );
         mbedtls_ctr_drbg_init( &(tlsInitParams->ctr_drbg) );
         mbedtls_entropy_init( &(tlsInitParams->entropy) );
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        mbedtls_x509_crt_init( &(tlsInitParams->cacert) );
 //      if(useClientCerts){
             mbedtls_x509_crt_init(&(tlsInitParams->clicert));
             mbedtls_pk_init(&(tlsInitParams->pkey));
 //      }
+#endif
         strcpy(tlsInitParams->clientName,"mbed_tls_client");
 
         if((rc = mbedtls_ctr_drbg_seed( &(tlsInitParams->ctr_drbg), mbedtls_entropy_func, &(tlsInitParams->entropy),
@@ -321,6 +946,155 @@ static uint32_t TickFreq;
     fflush(  (FILE *) ctx  );
  }
 
+ //Offered by a client with restrictSuites set
+ static const int restrictedSuites[] = { MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 0 };
+ static const uint16_t restrictedGroups[] = { MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1, MBEDTLS_SSL_IANA_TLS_GROUP_NONE };
+
+ #if defined(MBEDTLS_X509_CRT_PARSE_C)
+ /** Function to trust the server certificate by its SHA-256 instead of its chain. Called by
+ * mbedtls for each certificate of the chain, the server certificate (depth 0) last. Only the
+ * missing trust anchor is forgiven, other failures (e.g. a bad signature or the host name)
+ * still fail the handshake.
+ * @param - Pin, TLS_PIN_SIZE bytes
+ *        - Certificate
+ *        - Depth in the chain
+ *        - Verification flags of the certificate
+ * @return - 0
+ **/
+ static int tls_verify_pin(void *pin, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+ {
+        unsigned char hash[TLS_PIN_SIZE];
+
+        //No CA is configured, so the top of the chain is never trusted
+        if(depth > 0)
+                *flags &= ~MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        else if(mbedtls_sha256(crt->raw.p, crt->raw.len, hash, 0) == 0 && memcmp(hash, pin, TLS_PIN_SIZE) == 0)
+                *flags &= ~MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        else
+                *flags |= MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        return 0;
+ }
+ #endif
+
+ #if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+ //Offered by a client with a pre-shared key, those that are built in
+ static const int pskSuites[] = {
+        MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256, 0 };
+
+ /** Function to configure the pre-shared key and its identity
+ * @param - Address of ssl config
+ *        - Key in hex
+ *        - Identity
+ * @return - 0 on SUCCESS
+ *         - mbedtls error code on FAILURE
+ **/
+ static int tls_conf_psk(mbedtls_ssl_config *conf, const char *hex, const char *identity)
+ {
+        unsigned char psk[MBEDTLS_PSK_MAX_LEN];
+        size_t i, len = strlen(hex) / 2;
+        int rc = 0;
+
+        if(identity == NULL || len == 0 || len > sizeof(psk) || strlen(hex) % 2 != 0)
+                return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+        for(i = 0; i < 2 * len && rc == 0; i++){
+                char c = hex[i];
+                int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                        (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if(v < 0)
+                        rc = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+                else if(i % 2 == 0)
+                        psk[i / 2] = (unsigned char)(v << 4);
+                else
+                        psk[i / 2] |= (unsigned char)v;
+        }
+        if(rc == 0)
+                rc = mbedtls_ssl_conf_psk(conf, psk, len, (const unsigned char *)identity, strlen(identity));
+        mbedtls_platform_zeroize(psk, sizeof(psk));
+        if(rc == 0)
+                mbedtls_ssl_conf_ciphersuites(conf, pskSuites);
+        return rc;
+ }
+ #endif
+
+ /** Function to open the TCP connection of a TLS session
+ * @param - Address of tls_init_params structure
+ *        - Address of tls_connect_params structure
+ *        - Server Address
+ *        - Port Number
+ *        - Address of Timer the connection has to be open by
+ * @return - 0 on SUCCESS
+ *         - MBEDTLS_ERR_SSL_TIMEOUT when the deadline passed, another mbedtls error code on FAILURE
+ **/
+ static int tls_open_socket(tls_init_params *tlsInitData, tls_connect_params *tlsConnectData,
+                const char *server, int port, Timer *deadline)
+ {
+        net_resolver once;
+        net_resolver *resolver = tlsConnectData->pResolver;
+        int rc;
+
+        if(resolver == NULL){
+                net_resolver_init(&once);
+                resolver = &once;
+        }
+        if((rc = net_connect(resolver, server, port, deadline, tlsConnectData->progress)) < 0){
+            LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+            LOG_STR("net_connect failed with return code = %d",rc);
+            LOG(logHdr,logStr);
+            if(rc == IOT_SOCKET_ETIMEDOUT)
+                return MBEDTLS_ERR_SSL_TIMEOUT;
+            return (rc == IOT_SOCKET_EHOSTNOTFOUND) ? MBEDTLS_ERR_NET_UNKNOWN_HOST : MBEDTLS_ERR_NET_CONNECT_FAILED;
+        }
+        tlsInitData->server_fd.fd = rc;
+        if((rc = mbedtls_net_set_block(&(tlsInitData->server_fd)))!=0){
+            LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+            LOG_STR("mbedtls_net_set_block failed with return code = 0x%x",-rc);
+            LOG(logHdr,logStr);
+        }
+        return rc;
+ }
+
+ /** Function to run the TLS handshake until it completes or fails. A read of the handshake
+ * waits no longer than the time left in the deadline.
+ * @param - Address of tls_init_params structure
+ *        - Address of tls_connect_params structure
+ *        - Address of Timer the handshake has to complete by
+ * @return - 0 on SUCCESS
+ *         - MBEDTLS_ERR_SSL_TIMEOUT when the deadline passed, another mbedtls error code on FAILURE
+ **/
+ static int tls_handshake(tls_init_params *tlsInitData, tls_connect_params *tlsConnectData, Timer *deadline)
+ {
+        int rc;
+
+        if(tlsConnectData->progress != NULL)
+                tlsConnectData->progress(NET_STAGE_HANDSHAKE, NULL, 0);
+        //A read timeout of 0 would wait without limit
+        mbedtls_ssl_conf_read_timeout(&(tlsInitData->conf), left_ms(deadline) > 0 ? left_ms(deadline) : 1);
+        while((rc = mbedtls_ssl_handshake(&(tlsInitData->ssl))) != 0 )
+        {
+           if((rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) && expired(deadline))
+                rc = MBEDTLS_ERR_SSL_TIMEOUT;
+           mbedtls_ssl_conf_read_timeout(&(tlsInitData->conf), left_ms(deadline) > 0 ? left_ms(deadline) : 1);
+           if( rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE )
+           {
+                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+                LOG_STR("mbedtls_ssl_handshake failed with rc = 0x%x",-rc);
+                LOG(logHdr,logStr);
+                if(rc == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED){
+                  LOG_STR("ssl_handshake failed with MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED");
+                  LOG(logHdr,logStr);
+                }
+                LOG_STR("ssl state = %d",tlsInitData->ssl.state);
+                LOG(logHdr,logStr);
+                LOG_STR("ssl version = %s",mbedtls_ssl_get_version(&(tlsInitData->ssl)));
+                LOG(logHdr,logStr);
+                break;
+            }
+        }
+        return rc;
+ }
+
  /** Function to connect to given server using SSL/TLS secured connection. If useClientCerts Flag
  * is set, then it uses the specified Client Side Certificates for communication.
  * @param - Address of tls_init_larams structure
@@ -328,8 +1102,19 @@ static uint32_t TickFreq;
  *        - Server Address
  *        - Port Number
  *        - whether to use client side certificates or not
- * @return - 1 on SUCCESS
- *         - -1 on FAILURE
+ * With pServerCertPin set the CA certificates are not loaded and only a server certificate
+ * with that SHA-256 is accepted. With restrictSuites set the client offers a single cipher
+ * suite and curve, which needs a server with an ECDSA P-256 certificate.
+ * With pPsk set the client authenticates with that key and identity instead of certificates,
+ * offers only PSK and ECDHE-PSK cipher suites and loads no certificate. Without
+ * MBEDTLS_X509_CRT_PARSE_C this is the only mode.
+ * The TCP connect and the handshake end by pDeadline, or
+ * IOTF_NETWORK_CONNECT_TIMEOUT milliseconds after the call without one, and report their
+ * stages to progress. A deadline that passes fails the call with MBEDTLS_ERR_SSL_TIMEOUT.
+ * @return - 0 on SUCCESS
+ *         - Negative mbed TLS error on FAILURE, MBEDTLS_ERR_SSL_TIMEOUT when the deadline
+ *           passed, MBEDTLS_ERR_NET_UNKNOWN_HOST or MBEDTLS_ERR_NET_CONNECT_FAILED when
+ *           the TCP connect failed
  **/
  int tls_connect(tls_init_params *tlsInitData,tls_connect_params *tlsConnectData,
                 const char *server, const int port, int useClientCerts){
@@ -338,9 +1123,17 @@ static uint32_t TickFreq;
         LOG(logHdr,"entry::");
 
         int rc=-1;
-        char str_port[10];
-        sprintf(str_port,"%d",port);
-
+        int usePsk = (tlsConnectData->pPsk != NULL);
+        Timer limit;
+        Timer *deadline = tlsConnectData->pDeadline;
+
+        if(usePsk)
+                useClientCerts = 0;
+        if(deadline == NULL){
+                InitTimer(&limit);
+                countdown_ms(&limit, IOTF_NETWORK_CONNECT_TIMEOUT);
+                deadline = &limit;
+        }
         mbedtls_debug_set_threshold(MBEDTLS_DEBUG_LEVEL);
 
         if((rc = initialize_tls(tlsInitData,useClientCerts))!=0)
@@ -350,20 +1143,27 @@ static uint32_t TickFreq;
             LOG(logHdr,logStr);
             goto exit;
         }
-        if((rc = mbedtls_net_connect(&(tlsInitData->server_fd), server, str_port, MBEDTLS_NET_PROTO_TCP )) != 0){
+#if !defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+        if(usePsk)
+                rc = MBEDTLS_ERR_SSL_BAD_CONFIG;
+#endif
+#if !defined(MBEDTLS_X509_CRT_PARSE_C)
+        if(!usePsk)
+                rc = MBEDTLS_ERR_SSL_BAD_CONFIG;
+#endif
+        if(rc != 0)
+        {
             LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-            LOG_STR("mbedtls_net_connect failed with return code = 0x%x",-rc);
+            LOG_STR("mbed TLS is built without %s",usePsk ? "PSK cipher suites" : "certificates");
             LOG(logHdr,logStr);
             goto exit;
         }
-        if((rc = mbedtls_net_set_block(&(tlsInitData->server_fd)))!=0){
-            LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-            LOG_STR("mbedtls_net_set_block failed with return code = 0x%x",-rc);
-            LOG(logHdr,logStr);
+        if((rc = tls_open_socket(tlsInitData, tlsConnectData, server, port, deadline)) != 0)
             goto exit;
-        }
 
-        if((rc = mbedtls_x509_crt_parse_file(&(tlsInitData->cacert),tlsConnectData->pServerCertLocation))!=0)
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        if(!usePsk && tlsConnectData->pServerCertPin == NULL &&
+           (rc = mbedtls_x509_crt_parse_file(&(tlsInitData->cacert),tlsConnectData->pServerCertLocation))!=0)
         {
             LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
             LOG_STR("mbedtls_x509_crt_parse_file failed for Server CA certificate with return code = 0x%x",-rc);
@@ -372,7 +1172,8 @@ static uint32_t TickFreq;
         }
 
         if(useClientCerts){
-          if((rc = mbedtls_x509_crt_parse_file(&(tlsInitData->cacert),tlsConnectData->pRootCACertLocation))!=0)
+          if(tlsConnectData->pServerCertPin == NULL &&
+             (rc = mbedtls_x509_crt_parse_file(&(tlsInitData->cacert),tlsConnectData->pRootCACertLocation))!=0)
           {
             LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
             LOG_STR("mbedtls_x509_crt_parse_file failed for Root CA certificate with return code = 0x%x",-rc);
@@ -409,6 +1210,7 @@ static uint32_t TickFreq;
                 LOG(logHdr,logStr);
                 goto exit;
         }
+#endif
         if((rc = mbedtls_ssl_config_defaults(&(tlsInitData->conf),MBEDTLS_SSL_IS_CLIENT,
                       MBEDTLS_SSL_TRANSPORT_STREAM,MBEDTLS_SSL_PRESET_DEFAULT ))!=0)
         {
@@ -420,7 +1222,25 @@ static uint32_t TickFreq;
         mbedtls_ssl_conf_max_version(&(tlsInitData->conf),MBEDTLS_SSL_MAJOR_VERSION_3,MBEDTLS_SSL_MINOR_VERSION_3);
         mbedtls_ssl_conf_min_version(&(tlsInitData->conf),MBEDTLS_SSL_MAJOR_VERSION_3,MBEDTLS_SSL_MINOR_VERSION_3);
         mbedtls_ssl_conf_authmode(&(tlsInitData->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        //Left empty with a pin or a pre-shared key, so no certificate of the chain can be trusted but the pinned one
         mbedtls_ssl_conf_ca_chain(&(tlsInitData->conf), &(tlsInitData->cacert), NULL);
+        if(tlsConnectData->pServerCertPin != NULL)
+                mbedtls_ssl_conf_verify(&(tlsInitData->conf), tls_verify_pin, (void *)tlsConnectData->pServerCertPin);
+#endif
+        if(tlsConnectData->restrictSuites){
+                mbedtls_ssl_conf_ciphersuites(&(tlsInitData->conf), restrictedSuites);
+                mbedtls_ssl_conf_groups(&(tlsInitData->conf), restrictedGroups);
+        }
+#if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+        if(usePsk && (rc = tls_conf_psk(&(tlsInitData->conf), tlsConnectData->pPsk, tlsConnectData->pPskIdentity)) != 0)
+        {
+                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+                LOG_STR("tls_conf_psk failed with rc = 0x%x",-rc);
+                LOG(logHdr,logStr);
+                goto exit;
+        }
+#endif
         mbedtls_ssl_conf_rng(&(tlsInitData->conf), mbedtls_ctr_drbg_random, &(tlsInitData->ctr_drbg));
         mbedtls_ssl_conf_dbg( &(tlsInitData->conf), tls_debug, stdout );
         mbedtls_ssl_set_bio(&(tlsInitData->ssl), &(tlsInitData->server_fd), mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
@@ -431,24 +1251,7 @@ static uint32_t TickFreq;
                 LOG(logHdr,logStr);
                 goto exit;
         }
-        while((rc = mbedtls_ssl_handshake(&(tlsInitData->ssl))) != 0 )
-        {
-           if( rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE )
-           {
-                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-                LOG_STR("mbedtls_ssl_handshake failed with rc = 0x%x",-rc);
-                LOG(logHdr,logStr);
-                if(rc == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED){
-                  LOG_STR("ssl_handshake failed with MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED");
-                  LOG(logHdr,logStr);
-                }
-                LOG_STR("ssl state = %d",tlsInitData->ssl.state);
-                LOG(logHdr,logStr);
-                LOG_STR("ssl version = %s",mbedtls_ssl_get_version(&(tlsInitData->ssl)));
-                LOG(logHdr,logStr);
-                break;
-            }
-        }
+        rc = tls_handshake(tlsInitData, tlsConnectData, deadline);
   exit:
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG_STR("rc = %d ",rc);
@@ -458,59 +1261,54 @@ static uint32_t TickFreq;
         return rc;
  }
 
- /** Function to read data from the secured tls socket
+ /** Function to take what the current TLS record has, at most len bytes, with a single
+ * mbedtls_ssl_read
  * @param - Address of Network Structure
  *        - Buffer to store the read data from the secured socket
- *        - Number of bytes of data to read from secured socket
- *        - Timeout in milliseconds
- * @return - Number of Bytes read on SUCCESS
+ *        - Maximum number of bytes to read from secured socket
+ *        - Timeout in milliseconds for the next record
+ * @return - Number of Bytes read, 0 if none arrived in time or the peer closed
  *         - -1 on FAILURE
  **/
- int tls_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ static int tls_recv(Network* n, unsigned char* buffer, int len, int timeout_ms)
  {
-        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-        LOG(logHdr,"entry::");
-
         tls_init_params *tlsInitData = &(n->TLSInitData);
         int rc;
- 	int bytes = 0;
+
  	if (timeout_ms == 0)
  	{
  		timeout_ms = 10;
  	}
  	mbedtls_ssl_conf_read_timeout(&(tlsInitData->conf), timeout_ms);
- 	while (bytes < len)
+ 	rc = mbedtls_ssl_read(&(tlsInitData->ssl), buffer, len);
+ 	if (rc < 0)
  	{
- 		rc = mbedtls_ssl_read(&(tlsInitData->ssl), &buffer[bytes], len - bytes);
- 		if (rc < 0)
- 		{
- 			if ((rc != MBEDTLS_ERR_SSL_WANT_READ) && (rc != MBEDTLS_ERR_SSL_WANT_WRITE) && (rc != MBEDTLS_ERR_SSL_TIMEOUT))
- 			{
-                                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-                                LOG_STR("mbedtls_ssl_read failed with rc = %d",rc);
-                                LOG(logHdr,logStr);
- 				bytes = -1;
- 			}
- 			break;
- 		}
- 		else if (rc == 0)
- 		{
- 			bytes = 0;
- 			break;
- 		}
- 		else
- 			bytes += rc;
+ 		if ((rc == MBEDTLS_ERR_SSL_WANT_READ) || (rc == MBEDTLS_ERR_SSL_WANT_WRITE) || (rc == MBEDTLS_ERR_SSL_TIMEOUT))
+ 			return 0;
+                LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+                LOG_STR("mbedtls_ssl_read failed with rc = %d",rc);
+                LOG(logHdr,logStr);
+ 		return -1;
  	}
+ 	if (n->metrics != NULL)
+ 		metrics_add(&n->metrics->readsIn, 1);
+ 	return rc;
+ }
 
-        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-        LOG_STR("bytes - %d ",bytes);
-        LOG(logHdr,logStr);
-        LOG(logHdr,"exit::");
-
- 	return bytes;
+ /** Function to read data from the secured tls socket
+ * @param - Address of Network Structure
+ *        - Buffer to store the read data from the secured socket
+ *        - Number of bytes of data to read from secured socket
+ *        - Timeout in milliseconds
+ * @return - Number of Bytes read on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int tls_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ {
+        return read_ahead(n, buffer, len, timeout_ms, tls_recv);
  }
 
- /** Function to write data to the secured tls socket
+ /** Function to send data to the secured tls socket, one record per mbedtls_ssl_write
  * @param - Address of Network Structure
  *        - Buffer storing the data to write to the secured socket
  *        - Number of bytes of data to write to secured socket
@@ -518,7 +1316,7 @@ static uint32_t TickFreq;
  * @return - Number of Bytes written on SUCCESS
  *         - -1 on FAILURE
  **/
- int tls_write(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ static int tls_send(Network* n, unsigned char* buffer, int len, int timeout_ms)
  {
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
@@ -527,9 +1325,11 @@ static uint32_t TickFreq;
         tls_init_params *tlsInitData = &(n->TLSInitData);
  	int rc = -1;
  	int bytes;
+        int expansion = mbedtls_ssl_get_record_expansion(&(tlsInitData->ssl));
         countdown_ms(&timer, (unsigned int)timeout_ms);
         for (bytes = 0; bytes < len; bytes += rc)
         {
+                rc = -1;
                 while (!expired(&timer) &&
                        ((rc = mbedtls_ssl_write(&(tlsInitData->ssl), &buffer[bytes], len - bytes)) <= 0))
                 {
@@ -543,14 +1343,36 @@ static uint32_t TickFreq;
                 }
                 if (rc <= 0)
                         break;
+                if (n->metrics != NULL)
+                {
+                        metrics_add(&n->metrics->recordsOut, 1);
+                        metrics_add64(&n->metrics->wireBytesOut, (uint64_t)(rc + (expansion > 0 ? expansion : 0)));
+                }
         }
 
+        if (bytes > 0 && n->metrics != NULL)
+                metrics_add64(&n->metrics->bytesOut, (uint64_t)bytes);
+
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG_STR("rc = %d ",rc);
         LOG(logHdr,logStr);
         LOG(logHdr,"exit::");
 
- 	return rc;
+        //A write longer than a record takes several mbedtls_ssl_write calls
+ 	return (rc > 0) ? bytes : rc;
+ }
+
+ /** Function to write data to the secured tls socket
+ * @param - Address of Network Structure
+ *        - Buffer storing the data to write to the secured socket
+ *        - Number of bytes of data to write to secured socket
+ *        - Timeout in milliseconds
+ * @return - Number of Bytes written on SUCCESS
+ *         - -1 on FAILURE
+ **/
+ int tls_write(Network* n, unsigned char* buffer, int len, int timeout_ms)
+ {
+        return corked_write(n, buffer, len, timeout_ms, tls_send);
  }
 
  /** Function to clear off the mbedtls structures.
@@ -567,9 +1389,11 @@ void teardown_tls(tls_init_params *tlsInitParams,tls_connect_params* tlsConnectD
         mbedtls_ssl_config_free( &(tlsInitParams->conf) );
         mbedtls_ctr_drbg_free( &(tlsInitParams->ctr_drbg) );
         mbedtls_entropy_free( &(tlsInitParams->entropy) );
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
         mbedtls_x509_crt_free( &(tlsInitParams->cacert) );
         mbedtls_x509_crt_free( &(tlsInitParams->clicert) );
         mbedtls_pk_free(&(tlsInitParams->pkey) );
+#endif
 
         freeTLSConnectData(tlsConnectData);
 
@@ -577,7 +1401,8 @@ void teardown_tls(tls_init_params *tlsInitParams,tls_connect_params* tlsConnectD
         LOG(logHdr,"exit::");
  }
 
- /** Function to clear off the memory allocated for certificates location.
+ /** Function to drop the certificate locations. They are borrowed from the client
+ * configuration and are not freed here.
  * @param - Address of tls_connect Structure
  * @return - void
  **/
@@ -585,11 +1410,14 @@ void freeTLSConnectData(tls_connect_params* tlsConnectData){
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"entry::");
 
-        freePtr(tlsConnectData->pServerCertLocation);
-        freePtr(tlsConnectData->pRootCACertLocation);
-        freePtr(tlsConnectData->pDeviceCertLocation);
-        freePtr(tlsConnectData->pDevicePrivateKeyLocation);
-        freePtr(tlsConnectData->pDestinationURL);
+        tlsConnectData->pServerCertLocation = NULL;
+        tlsConnectData->pRootCACertLocation = NULL;
+        tlsConnectData->pDeviceCertLocation = NULL;
+        tlsConnectData->pDevicePrivateKeyLocation = NULL;
+        tlsConnectData->pDestinationURL = NULL;
+        tlsConnectData->pServerCertPin = NULL;
+        tlsConnectData->pPskIdentity = NULL;
+        tlsConnectData->pPsk = NULL;
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
         LOG(logHdr,"exit::");
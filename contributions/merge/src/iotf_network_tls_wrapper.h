@@ -32,8 +32,96 @@
 #include "mbedtls/net_sockets.h"
 #include "mbedtls/pk.h"
 #include "mbedtls/x509.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/platform_util.h"
 
 #include "iotf_utils.h"
+#include "iotf_metrics.h"
+
+/*
+ * While a network is corked, writes are held in a buffer of this size and leave as one
+ * socket send or TLS record when it is uncorked or full. 0 disables corking.
+ */
+#ifndef IOTF_NETWORK_CORK_SIZE
+#define IOTF_NETWORK_CORK_SIZE  512
+#endif
+
+/*
+ * Bytes a read takes ahead of what MQTTClient-C asked for, so the type byte and the
+ * remaining length of a packet do not cost a receive each. 0 reads only what is asked.
+ */
+#ifndef IOTF_NETWORK_READ_AHEAD
+#define IOTF_NETWORK_READ_AHEAD 256
+#endif
+
+/*
+ * Seconds a resolved broker address is used before its name is resolved again. A name
+ * that does not resolve keeps the addresses it had.
+ */
+#ifndef IOTF_NETWORK_DNS_TTL
+#define IOTF_NETWORK_DNS_TTL    300
+#endif
+
+//1 resolves IPv6 addresses of the broker too, which are tried before the IPv4 address
+#ifndef IOTF_NETWORK_IPV6
+#define IOTF_NETWORK_IPV6       0
+#endif
+
+//Addresses a resolver keeps for the broker. A resolved name gives at most 2 (one IPv6,
+//one IPv4), more only matter for hostIPs lists (net_resolver_fixed)
+#ifndef IOTF_NETWORK_ADDRS
+#define IOTF_NETWORK_ADDRS      4
+#endif
+
+/*
+ * Milliseconds a connect to one address has before the next address is tried alongside
+ * it. The first connection to complete is kept.
+ */
+#ifndef IOTF_NETWORK_CONNECT_STAGGER
+#define IOTF_NETWORK_CONNECT_STAGGER    250
+#endif
+
+//Milliseconds a connect, with all of its addresses, may take when no deadline is given
+#ifndef IOTF_NETWORK_CONNECT_TIMEOUT
+#define IOTF_NETWORK_CONNECT_TIMEOUT    30000
+#endif
+
+typedef struct Timer Timer;
+
+struct Timer {
+	uint32_t end_time;
+};
+
+//Host names longer than this are resolved on every connect
+#define NET_NAME_SIZE   64
+
+//IPv4 or IPv6 address
+typedef struct
+{
+	uint8_t ip[16];
+	uint32_t len;                   //4 or 16
+} net_addr;
+
+//Broker addresses kept across connections, so a reconnect does not wait for DNS
+typedef struct
+{
+	char name[NET_NAME_SIZE];       //host name the addresses were resolved for
+	net_addr addr[IOTF_NETWORK_ADDRS];
+	int count;
+	int fixed;                      //addresses come from the configuration, no DNS
+	int good;                       //address connected last, tried first, -1 for none
+	uint32_t resolvedAt;            //kernel tick of the last resolution
+} net_resolver;
+
+//Stages of a connection reported to a net_progress handler
+enum net_stage { NET_STAGE_RESOLVED, NET_STAGE_CONNECTING, NET_STAGE_CONNECTED, NET_STAGE_FAILED, NET_STAGE_HANDSHAKE };
+
+/*
+ * Called with the stage, the address concerned or NULL, and a value: the number of
+ * addresses for NET_STAGE_RESOLVED, the IoT Socket error for NET_STAGE_FAILED, else 0.
+ * NET_STAGE_FAILED with a NULL address ends a connect that found no address to use.
+ */
+typedef void (*net_progress)(int stage, const net_addr *addr, int rc);
 
 //TLS initialization parameters
 typedef struct
@@ -43,12 +131,17 @@ typedef struct
 	mbedtls_ctr_drbg_context ctr_drbg;
 	mbedtls_ssl_context ssl;
 	mbedtls_ssl_config conf;
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
 	mbedtls_x509_crt cacert;
 	mbedtls_x509_crt clicert;
 	mbedtls_pk_context pkey;
+#endif
         char clientName[20];
 } tls_init_params;
 
+//Size of a server certificate pin, the SHA-256 of the certificate in DER
+#define TLS_PIN_SIZE 32
+
 //Structure for storing certificates location
 typedef struct
 {
@@ -57,13 +150,21 @@ typedef struct
 	char *pDeviceCertLocation;
 	char *pDevicePrivateKeyLocation;
 	char *pDestinationURL;
+	int restrictSuites;                     //offer ECDHE-ECDSA-AES128-GCM-SHA256 on secp256r1 only
+	const unsigned char *pServerCertPin;    //TLS_PIN_SIZE bytes, trusted instead of the CA chain
+	const char *pPskIdentity;
+	const char *pPsk;                       //key in hex, replaces all certificates
+	net_resolver *pResolver;                //kept across connections, NULL resolves every time
+	Timer *pDeadline;                       //end of the TCP connect and handshake, NULL for the default
+	net_progress progress;                  //NULL for none
 } tls_connect_params;
 
-typedef struct Timer Timer;
-
-struct Timer {
-	uint32_t end_time;
-};
+//One part of a scattered write
+typedef struct
+{
+	unsigned char *data;
+	int len;
+} net_iovec;
 
 //Structure definition to store network related information
 typedef struct Network Network;
@@ -74,7 +175,26 @@ struct Network
 	tls_init_params TLSInitData;
 	int (*mqttread) (Network*, unsigned char*, int, int);
 	int (*mqttwrite) (Network*, unsigned char*, int, int);
+	int (*mqttwritev) (Network*, const net_iovec*, int, int);
 	void (*disconnect) (Network*, int);
+	iotf_metrics *metrics;          //byte counters of the owning client, NULL if not counted
+	net_resolver *resolver;         //addresses of ConnectNetwork, NULL resolves every time
+	Timer *deadline;                //end of the connect of ConnectNetwork, NULL for the default
+	net_progress progress;          //connect progress of ConnectNetwork, NULL for none
+	int corked;                     //nesting depth of network_cork
+	int held;                       //bytes held in cork
+	const unsigned char *tail;      //payload rest appended to the next PUBLISH of tailOwner, NULL for none
+	int tailLen;                    //length of tail
+	osThreadId_t tailOwner;         //thread that attached the tail, NULL if none did
+#if IOTF_NETWORK_CORK_SIZE > 0
+	unsigned char cork[IOTF_NETWORK_CORK_SIZE];
+#endif
+	int rcvTimeout;                 //receive timeout set on my_socket, -1 if not set
+	int rxOff;                      //read-ahead bytes taken
+	int rxLen;                      //read-ahead bytes received
+#if IOTF_NETWORK_READ_AHEAD > 0
+	unsigned char rx[IOTF_NETWORK_READ_AHEAD];
+#endif
 };
 
 //Functions declaration related to network activity
@@ -82,7 +202,16 @@ void NewNetwork(Network*);
 int ConnectNetwork(Network* n, char* addr, int port);
 int network_read(Network* n, unsigned char* buffer, int len, int timeout_ms);
 int network_write(Network* n, unsigned char* buffer, int len, int timeout_ms);
+int network_writev(Network* n, const net_iovec* iov, int count, int timeout_ms);
 void network_disconnect(Network* n, int qsMode);
+void net_resolver_init(net_resolver *r);
+int net_resolver_fixed(net_resolver *r, const char *list);
+int net_connect(net_resolver *r, const char *name, int port, Timer *deadline, net_progress progress);
+void network_cork(Network* n);
+int network_uncork(Network* n, int timeout_ms);
+int network_flush(Network* n, int timeout_ms);
+int network_attach_tail(Network* n, const unsigned char* tail, int len, int timeout_ms);
+void network_detach_tail(Network* n);
 
 //Functions declaration related to timing
 char expired(Timer*);
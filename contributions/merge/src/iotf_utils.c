@@ -45,14 +45,14 @@
                         //printf("Logging is Enabled\n");
                         if(embdcHome != NULL && strlen(embdcHome)>1){
                                 //printf("IOT_EMBDC_HOME is defined to %s\n",embdcHome);
-                                logFile = (char*)malloc(strlen(embdcHome)+strlen(iotfLog)+5);
+                                logFile = (char*)iotf_malloc(strlen(embdcHome)+strlen(iotfLog)+5);
                                 strcpy(logFile,embdcHome);
                                 strcat(logFile,"/");
                                 strcat(logFile,iotfLog);
                         }
                         else{
                                 //printf("IOT_EMBDC_HOME is not defined...\n");
-                                logFile = (char*)malloc(strlen(iotfLog)+5);
+                                logFile = (char*)iotf_malloc(strlen(iotfLog)+5);
                                 strcpy(logFile,"./");
                                 strcat(logFile,iotfLog);
                         }
@@ -67,7 +67,7 @@
                                 //printf("Logger not initialized...\n");
                                 enabled = 0;
                         }
-                        //freePtr(logFile);
+                        iotf_free(logFile);
                 }
                 //else
                         //printf("Logging is Not Enabled");
@@ -137,13 +137,13 @@
          if(isEMBDCHomeDefined()){
             char *embdC_home = getenv("IOT_EMBDC_HOME");
             pathLen = strlen(embdC_home) + strlen(filePath);
-            *ptr = (char*)malloc(sizeof(char)*(pathLen+3));
+            *ptr = (char*)iotf_malloc(sizeof(char)*(pathLen+3));
             strcpy(*ptr,embdC_home);
             strcat(*ptr,filePath);
          }
          else{
             pathLen = strlen(filePath);
-            *ptr = (char*)malloc(sizeof(char)*(pathLen+3));
+            *ptr = (char*)iotf_malloc(sizeof(char)*(pathLen+3));
             strcpy(*ptr,".");
             strcat(*ptr,filePath);
             pathLen++;
@@ -201,7 +201,7 @@
 
         buildPath(path,"/test/");
 
-        *path = (char*)realloc(*path,strlen(*path)+strlen(fileName)+1);
+        *path = (char*)iotf_realloc(*path,strlen(*path)+strlen(fileName)+1);
         strcat(*path,fileName);
 
         LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -264,7 +264,7 @@
 
          if(strlen(src) >= 1){
 
-                 *dest = (char*)malloc(sizeof(char)*(strlen(src)+1));
+                 *dest = (char*)iotf_malloc(sizeof(char)*(strlen(src)+1));
                  strcpy(*dest,src);
 
                  LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
@@ -290,7 +290,7 @@
          LOG(logHdr,"entry::");
 
          if(p != NULL)
-            free(p);
+            iotf_free(p);
          else {
                  LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
                  LOG_STR("NULL Pointer cannot be freed");
@@ -21,12 +21,14 @@
  #include<stdio.h>
  #include<string.h>
  #include<ctype.h>
+ #include "iotf_alloc.h"
 
  #define LOG(logHeader,msg)       if(logger != NULL) fprintf(logger,"%s:%s\n",logHeader,msg);
  #define LOG_BUF 512
 
- #define LOG_HDR(...) snprintf(logHdr, sizeof(logHdr), __VA_ARGS__)
- #define LOG_STR(...) snprintf(logStr, sizeof(logStr), __VA_ARGS__)
+ //The shared buffers are only written while logging is enabled
+ #define LOG_HDR(...) do { if (logger != NULL) snprintf(logHdr, sizeof(logHdr), __VA_ARGS__); } while (0)
+ #define LOG_STR(...) do { if (logger != NULL) snprintf(logStr, sizeof(logStr), __VA_ARGS__); } while (0)
 
  extern FILE *logger;
 
@@ -45,47 +45,57 @@ int initialize_configfile(iotfclient  *client, char *configFilePath, int isGatew
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"entry::");
 
-       Config configstr = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 1883,0};
-
+       //Filled in place, the strings point into the arena of client->cfg
+       Config *configstr = &client->cfg;
        int rc = 0;
 
-       rc = get_config(configFilePath, &configstr);
+       config_init(configstr);
+       rc = get_config(configFilePath, configstr);
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG_STR("org:%s , domain:%s , type: %s , id:%s , token: %s , useCerts: %d , serverCertPath: %s",
-		configstr.org,configstr.domain,configstr.type,configstr.id,configstr.authtoken,configstr.useClientCertificates,
-		configstr.serverCertPath);
+		configstr->org,configstr->domain,configstr->type,configstr->id,configstr->authtoken,configstr->useClientCertificates,
+		configstr->serverCertPath);
        LOG(logHdr,logStr);
 
        if(rc != SUCCESS) {
+	       freeConfig(configstr);
 	       goto exit;
        }
 
-       if(configstr.org == NULL || configstr.type == NULL || configstr.id == NULL ||
-	  configstr.authmethod == NULL || configstr.authtoken == NULL) {
-	       freeConfig(&configstr);
+       if(configstr->org == NULL || configstr->type == NULL || configstr->id == NULL ||
+	  configstr->authmethod == NULL || configstr->authtoken == NULL ||
+	  (configstr->psk != NULL && configstr->pskIdentity == NULL)) {
+	       freeConfig(configstr);
 	       rc = MISSING_INPUT_PARAM;
 	       goto exit;
        }
 
+       //Kept by the resolver, which then connects without DNS
+       if(configstr->hostIPs != NULL && net_resolver_fixed(&client->resolver, configstr->hostIPs) != 0) {
+	       freeConfig(configstr);
+	       rc = CONFIG_FILE_ERROR;
+	       goto exit;
+       }
+
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-       LOG_STR("useCertificates: %d",configstr.useClientCertificates);
+       LOG_STR("useCertificates: %d",configstr->useClientCertificates);
        LOG(logHdr,logStr);
 
-       if(configstr.useClientCertificates){
-	       if(configstr.rootCACertPath == NULL || configstr.clientCertPath == NULL ||
-		  configstr.clientKeyPath == NULL){
-		       freeConfig(&configstr);
+       if(configstr->useClientCertificates){
+	       if(configstr->rootCACertPath == NULL || configstr->clientCertPath == NULL ||
+		  configstr->clientKeyPath == NULL){
+		       freeConfig(configstr);
 		       rc = MISSING_INPUT_PARAM;
 		       goto exit;
 	       }
 	       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	       LOG_STR("CACertPath:%s , clientCertPath:%s , clientKeyPath: %s",
-			configstr.rootCACertPath,configstr.clientCertPath,configstr.clientKeyPath);
+			configstr->rootCACertPath,configstr->clientCertPath,configstr->clientKeyPath);
 	       LOG(logHdr,logStr);
        }
 
-       if((strcmp(configstr.org,"quickstart") == 0))
+       if((strcmp(configstr->org,"quickstart") == 0))
 	       client->isQuickstart = 1;
        else
 	       client->isQuickstart = 0;
@@ -97,20 +107,28 @@ int initialize_configfile(iotfclient  *client, char *configFilePath, int isGatew
        if(isGatewayClient){
 	       if(client->isQuickstart) {
 		       printf("Quickstart mode is not supported in Gateway Client\n");
-		       freeConfig(&configstr);
+		       freeConfig(configstr);
 		       return QUICKSTART_NOT_SUPPORTED;
 	       }
 	       client->isGateway = 1;
        }
        else
 	       client->isGateway = 0;
+       memset(&client->metrics, 0, sizeof(client->metrics));
+       backoff_init(&client->backoff, BACKOFF_BASE_MS, BACKOFF_CAP_MS, backoff_seed(configstr->id));
+       client->reconnectPending = 0;
+       client->networkOpen = 0;
+       client->fastHandshake = 0;
+       client->pinned = 0;
+       if(configstr->hostIPs == NULL)
+	       net_resolver_init(&client->resolver);
+       client->connectTimeout = IOTF_NETWORK_CONNECT_TIMEOUT;
+       client->connectProgress = NULL;
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	LOG_STR("isGateway Client: %d",client->isGateway);
 	LOG(logHdr,logStr);
 
-       client->cfg = configstr;
-
  exit:
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	LOG_STR("rc = %d",rc);
@@ -146,8 +164,9 @@ int initialize(iotfclient  *client, char *orgId, char* domainName, char *deviceT
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"entry::");
 
-       Config configstr = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 1883,0};
+       Config *configstr = &client->cfg;
        int rc = 0;
+       int overflow = 0;
 
        	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	LOG_STR("org:%s , domain:%s , type: %s , id:%s , token: %s , useCerts: %d , serverCertPath: %s",
@@ -166,83 +185,94 @@ int initialize(iotfclient  *client, char *orgId, char* domainName, char *deviceT
 	       }
        }
 
-       strCopy(&configstr.org, orgId);
+       config_init(configstr);
+       overflow |= config_set_str(configstr, &configstr->org, orgId);
        if(domainName != NULL)
-	       strCopy(&configstr.domain, domainName);
+	       overflow |= config_set_str(configstr, &configstr->domain, domainName);
        else
-	       strCopy(&configstr.domain,"internetofthings.ibmcloud.com");
-       strCopy(&configstr.type, deviceType);
-       strCopy(&configstr.id, deviceId);
+	       overflow |= config_set_str(configstr, &configstr->domain,"internetofthings.ibmcloud.com");
+       overflow |= config_set_str(configstr, &configstr->type, deviceType);
+       overflow |= config_set_str(configstr, &configstr->id, deviceId);
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	LOG_STR("cfgstr.domain:%s , cfgstr.type:%s , cfgstr.id: %s",configstr.domain,configstr.type,configstr.id);
+	LOG_STR("cfgstr.domain:%s , cfgstr.type:%s , cfgstr.id: %s",configstr->domain,configstr->type,configstr->id);
 	LOG(logHdr,logStr);
 
        if((strcmp(orgId,"quickstart") != 0)) {
 	       if(authmethod == NULL || authToken == NULL) {
-		       freeConfig(&configstr);
+		       freeConfig(configstr);
 		       rc = MISSING_INPUT_PARAM;
 		       goto exit;
 	       }
-	       strCopy(&configstr.authmethod, authmethod);
-	       strCopy(&configstr.authtoken, authToken);
+	       overflow |= config_set_str(configstr, &configstr->authmethod, authmethod);
+	       overflow |= config_set_str(configstr, &configstr->authtoken, authToken);
 
 	       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	       LOG_STR("cfgstr.authmethod:%s , cfgstr.token:%s ",configstr.authmethod,configstr.authtoken);
+	       LOG_STR("cfgstr.authmethod:%s , cfgstr.token:%s ",configstr->authmethod,configstr->authtoken);
 	       LOG(logHdr,logStr);
 
 	       if(serverCertPath == NULL)
-		       if(isEMBDCHomeDefined())
-			       getServerCertPath(&configstr.serverCertPath);
-		       else
-			       strCopy(&configstr.serverCertPath,"./IoTFoundation.pem");
+		       overflow |= config_set_path(configstr, &configstr->serverCertPath, "/IoTFoundation.pem");
 	       else
-		       strCopy(&configstr.serverCertPath,serverCertPath);
+		       overflow |= config_set_str(configstr, &configstr->serverCertPath, serverCertPath);
 
 	       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	       LOG_STR("cfgstr.serverCertPath:%s",configstr.serverCertPath);
+	       LOG_STR("cfgstr.serverCertPath:%s",configstr->serverCertPath);
 	       LOG(logHdr,logStr);
 
 	       if(useCerts){
-		       strCopy(&configstr.rootCACertPath,rootCACertPath);
-		       strCopy(&configstr.clientCertPath,clientCertPath);
-		       strCopy(&configstr.clientKeyPath,clientKeyPath);
-		       configstr.useClientCertificates = 1;
+		       overflow |= config_set_str(configstr, &configstr->rootCACertPath, rootCACertPath);
+		       overflow |= config_set_str(configstr, &configstr->clientCertPath, clientCertPath);
+		       overflow |= config_set_str(configstr, &configstr->clientKeyPath, clientKeyPath);
+		       configstr->useClientCertificates = 1;
 
 		       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 		       LOG_STR("cfgstr.CACertPath:%s , cfgstr.clientCertPath:%s , cfgstr.clientKeyPath: %s",
-				configstr.rootCACertPath,configstr.clientCertPath,configstr.clientKeyPath);
+				configstr->rootCACertPath,configstr->clientCertPath,configstr->clientKeyPath);
 		       LOG(logHdr,logStr);
-		       LOG_STR("cfgstr.useCertificates:%d",configstr.useClientCertificates);
+		       LOG_STR("cfgstr.useCertificates:%d",configstr->useClientCertificates);
 		       LOG(logHdr,logStr);
 	       }
 	       client->isQuickstart = 0;
-               configstr.port = 8883;
        }
        else
 	       client->isQuickstart = 1;
+       overflow |= config_finish(configstr);
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	LOG_STR("isQuickStart Mode: %d Port: %d",client->isQuickstart,configstr.port);
+	LOG_STR("isQuickStart Mode: %d Port: %d",client->isQuickstart,configstr->port);
 	LOG(logHdr,logStr);
 
+       if(overflow) {
+	       freeConfig(configstr);
+	       rc = CONFIG_TOO_LARGE;
+	       goto exit;
+       }
+
        if(isGatewayClient){
 	       if(client->isQuickstart) {
 		       printf("Quickstart mode is not supported in Gateway Client\n");
-		       freeConfig(&configstr);
+		       freeConfig(configstr);
 		       return QUICKSTART_NOT_SUPPORTED;
 	       }
 	       client->isGateway = 1;
        }
        else
 	       client->isGateway = 0;
+       memset(&client->metrics, 0, sizeof(client->metrics));
+       backoff_init(&client->backoff, BACKOFF_BASE_MS, BACKOFF_CAP_MS, backoff_seed(configstr->id));
+       client->reconnectPending = 0;
+       client->networkOpen = 0;
+       client->fastHandshake = 0;
+       client->pinned = 0;
+       net_resolver_init(&client->resolver);
+       client->connectTimeout = IOTF_NETWORK_CONNECT_TIMEOUT;
+       client->connectProgress = NULL;
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	LOG_STR("isGateway Client: %d",client->isGateway);
 	LOG(logHdr,logStr);
 
-       client->cfg = configstr;
-
 exit:
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	LOG_STR("rc = %d",rc);
@@ -253,106 +283,51 @@ exit:
 }
 
 // This is the function to read the config from the device.cfg file
+// The file is read in chunks and parsed in place, see config_parse for the format
 int get_config(char * filename, Config * configstr) {
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"entry::");
 
        int rc = 0;
        int linenum = 0;
+       size_t have = 0;
+       size_t used = 0;
+       size_t n;
+       char text[256];
        FILE* prop;
        prop = fopen(filename, "r");
        if (prop == NULL) {
 	      rc = CONFIG_FILE_ERROR;
 	      goto exit;
        }
-       char line[256];
-
-       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-       LOG_STR("Default domainName: %s",configstr->domain);
-       LOG(logHdr,logStr);
-
-       while (fgets(line, 256, prop) != NULL) {
-	      char* prop;
-	      char* value;
-	      linenum++;
-	      if (line[0] == '#')
-		      continue;
-
-	      prop = strtok(line, "=");
-	      prop = trim(prop);
-	      value = strtok(NULL, "=");
-	      value = trim(value);
 
+       do {
+	      n = fread(text + have, 1, sizeof(text) - have, prop);
+	      have += n;
+	      //At the end of the file the rest is the last line
+	      rc = config_parse(configstr, text, have, (n > 0) ? &used : NULL, &linenum);
+	      if (n == 0 || rc != 0)
+		      break;
+	      if (used == 0 && have == sizeof(text)) {
+		      //Longer than the buffer
+		      rc = linenum + 1;
+		      break;
+	      }
+	      memmove(text, text + used, have - used);
+	      have -= used;
+       } while (1);
+       fclose(prop);
+
+       if (rc > 0) {
 	      LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	      LOG_STR("Property: %s , Value: %s",prop,value);
+	      LOG_STR("Malformed line %d",rc);
 	      LOG(logHdr,logStr);
-
-	      if (strcmp(prop, "org") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&(configstr->org), value);
-
-		  if(strcmp(configstr->org,"quickstart") !=0)
-		     configstr->port = 8883;
-
-		  LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-		  LOG_STR("cfgstr.org: %s , cfgstr.port: %d",configstr->org,configstr->port);
-		  LOG(logHdr,logStr);
-	       }
-	      else if (strcmp(prop, "domain") == 0){
-		  if(strlen(value) <= 1)
-		     strCopy(&configstr->domain,"internetofthings.ibmcloud.com");
-		  else
-		     strCopy(&configstr->domain, value);
-
-		  LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-		  LOG_STR("cfgstr.domain: %s ",configstr->domain);
-		  LOG(logHdr,logStr);
-	       }
-	      else if (strcmp(prop, "type") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->type, value);
-	       }
-	      else if (strcmp(prop, "id") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->id, value);
-	       }
-	      else if (strcmp(prop, "auth-token") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->authtoken, value);
-	       }
-	      else if (strcmp(prop, "auth-method") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->authmethod, value);
-	       }
-	      else if (strcmp(prop, "serverCertPath") == 0){
-		  if(strlen(value) <= 1)
-		     getServerCertPath(&configstr->serverCertPath);
-		  else
-		     strCopy(&configstr->serverCertPath, value);
-
-		  LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-		  LOG_STR("cfgstr.serverCertPath: %s ",configstr->serverCertPath);
-		  LOG(logHdr,logStr);
-	       }
-	      else if (strcmp(prop, "rootCACertPath") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->rootCACertPath, value);
-	       }
-	      else if (strcmp(prop, "clientCertPath") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->clientCertPath, value);
-	       }
-	      else if (strcmp(prop, "clientKeyPath") == 0){
-		  if(strlen(value) > 1)
-		    strCopy(&configstr->clientKeyPath, value);
-	       }
-	      else if (strcmp(prop,"useClientCertificates") == 0){
-		  configstr->useClientCertificates = value[0] - '0';
-	       }
+	      rc = CONFIG_FILE_ERROR;
        }
-
-	if (configstr->domain == NULL)
-		strCopy(&configstr->domain,"internetofthings.ibmcloud.com");
+       else if (rc < 0)
+	      rc = CONFIG_TOO_LARGE;
+       else if (config_finish(configstr) != 0)
+	      rc = CONFIG_TOO_LARGE;
 
  exit:
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
@@ -379,6 +354,8 @@ int connectiotf(iotfclient  *client)
        int isGateway = client->isGateway;
        int qsMode = client->isQuickstart;
        int port = client->cfg.port;
+       int networkUp = 0;
+       Timer deadline;
 
        MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
 
@@ -386,10 +363,25 @@ int connectiotf(iotfclient  *client)
        LOG_STR("useCerts:%d , isGateway:%d , qsMode:%d",useCerts,isGateway,qsMode);
        LOG(logHdr,logStr);
 
-       char messagingUrl[120];
-       sprintf(messagingUrl, ".messaging.%s",client->cfg.domain);
-       char hostname[strlen(client->cfg.org) + strlen(messagingUrl) + 1];
-       sprintf(hostname, "%s%s", client->cfg.org, messagingUrl);
+       if(client->cfg.org == NULL) {
+	       //Released by disconnect, initialize again before connecting
+	       LOG(logHdr,"exit::");
+	       return MISSING_INPUT_PARAM;
+       }
+
+       //Built once and kept in the configuration for the reconnects
+       if(client->cfg.hostname == NULL) {
+	       char *p = config_reserve(&client->cfg, &client->cfg.hostname,
+					strlen(client->cfg.org) + strlen(client->cfg.domain) + 11);
+	       if(p == NULL) {
+		       LOG(logHdr,"exit::");
+		       return CONFIG_TOO_LARGE;
+	       }
+	       sprintf(p, "%s.messaging.%s", client->cfg.org, client->cfg.domain);
+       }
+       char *hostname = client->cfg.hostname;
+       //Address to connect to, the messaging hostname unless overridden
+       char *address = (client->cfg.host != NULL) ? client->cfg.host : hostname;
        char clientId[strlen(client->cfg.org) + strlen(client->cfg.type) + strlen(client->cfg.id) + 5];
 
        if(isGateway)
@@ -398,29 +390,59 @@ int connectiotf(iotfclient  *client)
 	  sprintf(clientId, "d:%s:%s:%s", client->cfg.org, client->cfg.type, client->cfg.id);
 
        	LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-	LOG_STR("messagingUrl:%s , hostname:%s , port:%d , clientId:%s",messagingUrl,hostname,port,clientId);
+	LOG_STR("hostname:%s , address:%s , port:%d , clientId:%s",hostname,address,port,clientId);
 	LOG(logHdr,logStr);
 
+       uint32_t connectStart = metrics_time();
        NewNetwork(&client->n);
+       client->n.metrics = &client->metrics;
+       client->n.resolver = &client->resolver;
+       //Bounds the TCP connect and the TLS handshake of this attempt
+       InitTimer(&deadline);
+       countdown_ms(&deadline, client->connectTimeout);
 
        if(!isGateway && qsMode){
-	   if((rc = ConnectNetwork(&(client->n),hostname,client->cfg.port)) != 0){
+	   client->n.deadline = &deadline;
+	   client->n.progress = client->connectProgress;
+	   if((rc = ConnectNetwork(&(client->n),address,client->cfg.port)) != 0){
+	       //IoT Socket errors overlap errorCodes
+	       if(rc == IOT_SOCKET_ETIMEDOUT)
+		   rc = CONNECT_TIMEOUT;
+	       else
+		   rc = (rc == IOT_SOCKET_EHOSTNOTFOUND) ? HOST_NOT_FOUND : CONNECT_FAILED;
 	       goto exit;
 	   }
+	   networkUp = 1;
 
 	   LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	   LOG_STR("RC from ConnectNetwork:%d",rc);
            LOG(logHdr,logStr);
        }
        else {
-	   tls_connect_params tls_params = {NULL,"","","",NULL};
-	   strCopy(&tls_params.pServerCertLocation,client->cfg.serverCertPath);
+	   //Borrowed from the configuration, which outlives the connection
+	   tls_connect_params tls_params;
+
+	   memset(&tls_params, 0, sizeof(tls_params));
+	   tls_params.pServerCertLocation = client->cfg.serverCertPath;
+	   tls_params.pRootCACertLocation = "";
+	   tls_params.pDeviceCertLocation = "";
+	   tls_params.pDevicePrivateKeyLocation = "";
+	   tls_params.pDestinationURL = hostname;
+	   tls_params.restrictSuites = client->fastHandshake;
+	   tls_params.pServerCertPin = client->pinned ? client->serverCertPin : NULL;
+	   tls_params.pResolver = &client->resolver;
+	   tls_params.pDeadline = &deadline;
+	   tls_params.progress = client->connectProgress;
+	   if(client->cfg.psk != NULL){
+	       tls_params.pPskIdentity = client->cfg.pskIdentity;
+	       tls_params.pPsk = client->cfg.psk;
+	       useCerts = 0;
+	   }
 	   if(useCerts){
-	       strCopy(&tls_params.pRootCACertLocation,client->cfg.rootCACertPath);
-	       strCopy(&tls_params.pDeviceCertLocation,client->cfg.clientCertPath);
-	       strCopy(&tls_params.pDevicePrivateKeyLocation,client->cfg.clientKeyPath);
+	       tls_params.pRootCACertLocation = client->cfg.rootCACertPath;
+	       tls_params.pDeviceCertLocation = client->cfg.clientCertPath;
+	       tls_params.pDevicePrivateKeyLocation = client->cfg.clientKeyPath;
 	   }
-	   strCopy(&tls_params.pDestinationURL,hostname);
 
 	   LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
 	   LOG_STR("tls_params: { %s , %s , %s , %s , %s }",tls_params.pServerCertLocation,
@@ -429,8 +451,15 @@ int connectiotf(iotfclient  *client)
 	    LOG(logHdr,logStr);
 
 	   client->n.TLSConnectData = tls_params;
-	   if((rc = tls_connect(&(client->n.TLSInitData),&(client->n.TLSConnectData),hostname,port,useCerts))!=0)
+	   //The certificate is still verified against the messaging hostname
+	   if((rc = tls_connect(&(client->n.TLSInitData),&(client->n.TLSConnectData),address,port,useCerts))!=0)
 	   {
+	       if(rc == MBEDTLS_ERR_SSL_TIMEOUT)
+		   rc = CONNECT_TIMEOUT;
+	       else if(rc == MBEDTLS_ERR_NET_UNKNOWN_HOST)
+		   rc = HOST_NOT_FOUND;
+	       else if(rc == MBEDTLS_ERR_NET_CONNECT_FAILED)
+		   rc = CONNECT_FAILED;
 	       goto exit;
 	   }
 
@@ -482,9 +511,24 @@ exit:
 	LOG_STR("rc = %d",rc);
 	LOG(logHdr,logStr);
 
-        if(rc != 0){
-                freeTLSConnectData(&(client->n.TLSConnectData));
-                freeConfig(&client->cfg);
+        //The deadline ends with this call
+        client->n.deadline = NULL;
+        client->n.TLSConnectData.pDeadline = NULL;
+        if(rc == 0){
+                client->connectedAt = metrics_time();
+                client->networkOpen = 1;
+                metrics_add(&client->metrics.connects, 1);
+                metrics_observe(&client->metrics.handshake, metrics_time() - connectStart);
+        }
+        else {
+                metrics_add(&client->metrics.connectFailures, 1);
+                //Release the connection but keep the configuration for the next attempt
+                if(!isGateway && qsMode) {
+                        if(networkUp)
+                                iotSocketClose(client->n.my_socket);
+                }
+                else
+                        teardown_tls(&(client->n.TLSInitData),&(client->n.TLSConnectData));
         }
 
         LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
@@ -503,6 +547,51 @@ exit:
 * @return int - Return code from MQTT Publish
 **/
 int publishData(MQTTClient *mqttClient, char *topic, char *payload, int qos){
+       return publishDataLen(mqttClient, topic, payload, strlen(payload), qos);
+}
+
+/**
+* Function used to publish a message whose packet does not fit the client's send buffer,
+* which MQTTPublish rejects. MQTTPublish serializes the topic and the head of the payload
+* into the buffer, and the network appends the rest of the payload from the caller's memory
+* to that packet (network_attach_tail). Packet id, client mutex and acknowledgement are
+* those of MQTTPublish.
+* @Param c - Address of MQTT Client
+* @Param topic - Topic to publish
+* @Param message - Message to publish, its id is set for QoS1 and QoS2
+*
+* @return int - SUCCESS or FAILURE
+**/
+static int publishScattered(MQTTClient *c, const char *topic, MQTTMessage *message){
+       MQTTMessage head = *message;
+       int rc;
+       //Fixed header of at most 5 bytes, topic and packet id leave the rest of the buffer to the payload
+       int headLen = (int)c->buf_size - 5 - (2 + (int)strlen(topic) + (message->qos > QOS0 ? 2 : 0));
+
+       if(headLen <= 0 || (size_t)headLen >= message->payloadlen)
+	       return FAILURE;
+       head.payloadlen = (size_t)headLen;
+       if(network_attach_tail(c->ipstack, (unsigned char *)message->payload + headLen,
+			      (int)message->payloadlen - headLen, c->command_timeout_ms) != 0)
+	       return FAILURE;
+       rc = MQTTPublish(c, topic, &head);
+       network_detach_tail(c->ipstack);
+       message->id = head.id;
+       return rc;
+}
+
+/**
+* Function used to publish a payload of known length to the topic with the given QoS.
+* The payload may contain binary data (e.g. CBOR) and need not be NUL terminated.
+* @Param client - Address of MQTT Client
+* @Param topic - Topic to publish
+* @Param payload - Message payload
+* @Param len - Payload length in bytes
+* @Param qos - quality of service either of 0,1,2
+*
+* @return int - Return code from MQTT Publish
+**/
+int publishDataLen(MQTTClient *mqttClient, char *topic, void *payload, size_t len, int qos){
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"entry::");
 
@@ -512,14 +601,42 @@ int publishData(MQTTClient *mqttClient, char *topic, char *payload, int qos){
        pub.qos = (enum QoS)qos;
        pub.retained = '0';
        pub.payload = payload;
-       pub.payloadlen = strlen(payload);
+       pub.payloadlen = len;
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
-       LOG_STR("MQTTMessage = { qos: %d  retained: %d  payload: %s  payloadLen: %d}",
-                        pub.qos,pub.retained,(char *)pub.payload,pub.payloadlen);
+       LOG_STR("MQTTMessage = { qos: %d  retained: %d  payloadLen: %d}",
+                        pub.qos,pub.retained,(int)pub.payloadlen);
        LOG(logHdr,logStr);
 
-       rc = MQTTPublish(mqttClient, topic , &pub);
+       iotf_metrics *metrics = mqttClient->ipstack->metrics;
+       iotf_metrics *previous = NULL;
+       uint32_t start = 0;
+       int corked = mqttClient->ipstack->corked;
+       if(metrics != NULL) {
+	       metrics_add(&metrics->published[pub.qos], 1);
+	       previous = metrics_enter(metrics);
+	       start = metrics_time();
+       }
+
+       //The broker only acknowledges what it received, so this publish takes held packets along
+       if(pub.qos != QOS0)
+	       mqttClient->ipstack->corked = 0;
+       //Packets that fit the send buffer are written in one piece, one TLS record
+       if(MQTTPacket_len(2 + (int)strlen(topic) + (pub.qos > QOS0 ? 2 : 0) + (int)len) <= (int)mqttClient->buf_size)
+	       rc = MQTTPublish(mqttClient, topic , &pub);
+       else
+	       rc = publishScattered(mqttClient, topic, &pub);
+       mqttClient->ipstack->corked = corked;
+
+       if(metrics != NULL) {
+	       metrics_leave(previous);
+	       if(rc != SUCCESS)
+		       metrics_add(&metrics->publishFailures, 1);
+	       else if(pub.qos != QOS0) {
+		       metrics_add(&metrics->acked, 1);
+		       metrics_observe(&metrics->publishAck, metrics_time() - start);
+	       }
+       }
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG_STR("rc = %d",rc);
@@ -529,6 +646,53 @@ int publishData(MQTTClient *mqttClient, char *topic, char *payload, int qos){
        return(rc);
 }
 
+/**
+* Function used to publish an event of the client's own identity with an explicit payload length.
+* Device clients publish to iot-2/evt/<event>/fmt/<format>, gateway clients to
+* iot-2/type/<type>/id/<id>/evt/<event>/fmt/<format>.
+* @param client - Reference to the Iotfclient
+* @param eventType - Type of event to be published e.g status, gps
+* @param eventFormat - Format of the event e.g json, cbor
+* @param data - Payload of the event
+* @param len - Payload length in bytes
+* @param qos - qos for the publish event. Supported values : QOS0, QOS1, QOS2
+*
+* @return int return code from the publish
+**/
+int publishEventData(iotfclient *client, char *eventType, char *eventFormat, void *data, size_t len, enum QoS qos)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = -1;
+
+       char publishTopic[strlen(eventType) + strlen(eventFormat) + strlen(client->cfg.id) + strlen(client->cfg.type)+25];
+
+       if(client->isGateway)
+              sprintf(publishTopic, "iot-2/type/%s/id/%s/evt/%s/fmt/%s", client->cfg.type, client->cfg.id, eventType, eventFormat);
+       else
+              sprintf(publishTopic, "iot-2/evt/%s/fmt/%s", eventType, eventFormat);
+
+       LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+       LOG_STR("Calling publishDataLen to publish to topic - %s",publishTopic);
+       LOG(logHdr,logStr);
+
+       rc = publishDataLen(&(client->c),publishTopic,data,len,qos);
+
+       if(rc != SUCCESS) {
+              printf("\nConnection lost, retry the connection \n");
+              retry_connection(client);
+              rc = publishDataLen(&(client->c),publishTopic,data,len,qos);
+       }
+
+       LOG_HDR("%s:%d:%s",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
 /**
 * Function used to Yield for commands.
 * @param time_ms - Time in milliseconds
@@ -540,7 +704,21 @@ int yield(iotfclient  *client, int time_ms)
        LOG(logHdr,"entry::");
 
        int rc = 0;
-       rc = MQTTYield(&client->c, time_ms);
+       int corked = client->n.corked;
+       iotf_metrics *previous = metrics_enter(&client->metrics);
+       uint32_t start = metrics_time();
+       //Held packets leave first, acknowledgements and pings sent meanwhile are not held
+       client->n.corked = 0;
+       if(network_flush(&client->n, client->c.command_timeout_ms) != 0)
+	       rc = FAILURE;
+       else
+	       rc = MQTTYield(&client->c, time_ms);
+       client->n.corked = corked;
+       metrics_observe(&client->metrics.yield, metrics_time() - start);
+       metrics_leave(previous);
+       //A read error or missed PINGRESP means the connection is gone, let pollReconnect see it
+       if(rc == FAILURE)
+	       client->c.isconnected = 0;
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG_STR("rc = %d",rc);
@@ -607,19 +785,329 @@ void setKeepAliveInterval(unsigned int keepAlive)
 
 }
 
-//Staggered retry
+/**
+* Function used to connect to a broker other than <org>.messaging.<domain>, e.g. a local
+* test broker. TLS server certificates are still verified against the messaging hostname.
+* The addresses of the hostIPs key and those resolved before are dropped.
+* @param client - Reference to the Iotfclient
+* @param host - Host name or address to connect to, NULL restores the messaging hostname
+* @param port - Port to connect to, 0 keeps the configured port
+*
+* @return int return code
+*/
+int setServerAddress(iotfclient *client, char *host, int port)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = SUCCESS;
+
+       if(client == NULL || port < 0 || port > 65535) {
+	       rc = MISSING_INPUT_PARAM;
+	       goto exit;
+       }
+
+       client->cfg.host = NULL;
+       if(host != NULL && config_set_str(&client->cfg, &client->cfg.host, host) != 0) {
+	       rc = CONFIG_TOO_LARGE;
+	       goto exit;
+       }
+       if(port > 0)
+	       client->cfg.port = port;
+       //hostIPs are addresses of the configured broker
+       client->cfg.hostIPs = NULL;
+       net_resolver_init(&client->resolver);
+
+exit:
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
+/**
+* Function used to authenticate the TLS connection with a pre-shared key instead of certificates
+* @param client - Reference to the Iotfclient
+* @param identity - PSK identity
+* @param pskHex - Key in hex, NULL returns to certificates
+*
+* @return int return code
+*/
+int setPreSharedKey(iotfclient *client, char *identity, char *pskHex)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = SUCCESS;
+
+       if(client == NULL || (pskHex != NULL && identity == NULL)) {
+	       rc = MISSING_INPUT_PARAM;
+	       goto exit;
+       }
+
+       client->cfg.psk = client->cfg.pskIdentity = NULL;
+       if(pskHex != NULL && (config_set_str(&client->cfg, &client->cfg.pskIdentity, identity) != 0 ||
+			     config_set_str(&client->cfg, &client->cfg.psk, pskHex) != 0)) {
+	       client->cfg.psk = client->cfg.pskIdentity = NULL;
+	       rc = CONFIG_TOO_LARGE;
+	       goto exit;
+       }
+
+exit:
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
+/**
+* Function used to make the TLS handshake of the client as short as possible: a single cipher
+* suite and curve and, with a pin, no certificate chain verification
+* @param client - Reference to the Iotfclient
+* @param enable - 1 for the short handshake, 0 restores the default
+* @param serverCertSha256 - SHA-256 of the server certificate, NULL verifies the chain
+*
+* @return int return code
+*/
+int setFastHandshake(iotfclient *client, int enable, const unsigned char *serverCertSha256)
+{
+       if(client == NULL)
+	       return MISSING_INPUT_PARAM;
+
+       client->fastHandshake = enable ? 1 : 0;
+       client->pinned = (enable && serverCertSha256 != NULL);
+       if(client->pinned)
+	       memcpy(client->serverCertPin, serverCertSha256, TLS_PIN_SIZE);
+       return SUCCESS;
+}
+
+/**
+* Function used to hold the following events of the client until uncorkEvents, so a burst
+* of QoS0 events leaves in one TLS record. Calls nest. A QoS1 or QoS2 event and yield
+* send the held events at once.
+* @param client - Reference to the Iotfclient
+*
+*/
+void corkEvents(iotfclient *client)
+{
+       network_cork(&client->n);
+}
+
+/**
+* Function used to end the section started by corkEvents. The outermost call sends the
+* held events.
+* @param client - Reference to the Iotfclient
+*
+* @return int SUCCESS or FAILURE if the held events could not be sent
+*/
+int uncorkEvents(iotfclient *client)
+{
+       if(network_uncork(&client->n, client->c.command_timeout_ms) != 0) {
+	       client->c.isconnected = 0;
+	       return FAILURE;
+       }
+       return SUCCESS;
+}
+
+/**
+* Function used to read the client's counters and latency histograms
+* @param client - Reference to the Iotfclient
+* @param out - Address to store the snapshot
+* @param reset - Non-zero to reset the metrics after reading them
+*
+* @return int return code
+*/
+int getMetrics(iotfclient *client, iotf_metrics *out, int reset)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = SUCCESS;
+
+       if(client == NULL || out == NULL)
+	       rc = MISSING_INPUT_PARAM;
+       else
+	       metrics_snapshot(&client->metrics, out, reset);
+
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
+/**
+* Function used to publish a snapshot of the client's metrics as a JSON event with QoS0.
+* The publish itself is counted in the next snapshot.
+* @param client - Reference to the Iotfclient
+* @param eventType - Type of event to be published e.g metrics
+* @param reset - Non-zero to reset the metrics once they are taken for publishing
+*
+* @return int return code from the publish
+*/
+int publishMetrics(iotfclient *client, char *eventType, int reset)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = -1;
+       int len;
+       iotf_metrics snapshot;
+       char payload[METRICS_JSON_SIZE];
+
+       if((rc = getMetrics(client, &snapshot, reset)) != SUCCESS || eventType == NULL) {
+	       rc = MISSING_INPUT_PARAM;
+	       goto exit;
+       }
+
+       if((len = metrics_serialize(&snapshot, payload, sizeof(payload))) < 0) {
+	       rc = -1;
+	       goto exit;
+       }
+
+       rc = publishEventData(client, eventType, "json", payload, (size_t)len, QOS0);
+
+exit:
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
+//Releases the socket or TLS session of a connection that was lost
+static void release_connection(iotfclient *client)
+{
+       if(client->networkOpen) {
+	       client->n.disconnect(&(client->n),client->isQuickstart);
+	       client->networkOpen = 0;
+       }
+       client->c.isconnected = 0;
+}
+
+//Arms reconnectTimer with the next backoff delay
+static void schedule_reconnect(iotfclient *client)
+{
+       uint32_t delay = backoff_next(&client->backoff);
+
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("next connection attempt in %u ms",(unsigned int)delay);
+       LOG(logHdr,logStr);
+
+       countdown_ms(&client->reconnectTimer, delay);
+       client->reconnectPending = 1;
+}
+
+/**
+* Function used to bound the connection attempts of the client
+* @param client - Reference to the Iotfclient
+* @param timeoutMs - Time an attempt may take in milliseconds, 0 for the default
+* @param progress - Function called at each stage of an attempt, NULL for none
+*
+*/
+void setConnectTimeout(iotfclient *client, unsigned int timeoutMs, net_progress progress)
+{
+       client->connectTimeout = (timeoutMs != 0) ? timeoutMs : IOTF_NETWORK_CONNECT_TIMEOUT;
+       client->connectProgress = progress;
+}
+
+/**
+* Function used to set the reconnect backoff
+* @param client - Reference to the Iotfclient
+* @param baseMs - Window of the first retry in milliseconds
+* @param maxMs - Upper limit of the window in milliseconds
+*
+*/
+void setReconnectPolicy(iotfclient *client, unsigned int baseMs, unsigned int maxMs)
+{
+       backoff_init(&client->backoff, baseMs, maxMs, client->backoff.seed);
+}
+
+/**
+* Function used to drive reconnection without blocking
+* @param client - Reference to the Iotfclient
+*
+* @return int SUCCESS when connected, RECONNECT_PENDING while waiting for the next attempt
+*/
+int pollReconnect(iotfclient *client)
+{
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG(logHdr,"entry::");
+
+       int rc = RECONNECT_PENDING;
+
+       if(client->c.isconnected) {
+	       client->reconnectPending = 0;
+	       rc = SUCCESS;
+       }
+       else if(!client->reconnectPending) {
+	       //A connection that was stable gets a quick first retry, a flapping one keeps backing off
+	       if(client->networkOpen && metrics_time() - client->connectedAt >= BACKOFF_STABLE_MS)
+		       backoff_reset(&client->backoff);
+	       release_connection(client);
+	       schedule_reconnect(client);
+       }
+       else if(expired(&client->reconnectTimer)) {
+	       metrics_add(&client->metrics.reconnects, 1);
+	       if((rc = connectiotf(client)) == SUCCESS) {
+		       client->reconnectPending = 0;
+	       }
+	       else {
+		       //CONNACK 2, 4 and 5 (client id or credentials refused) will not be fixed by retrying soon
+		       if(rc == 2 || rc == 4 || rc == 5)
+			       backoff_saturate(&client->backoff);
+		       schedule_reconnect(client);
+		       rc = RECONNECT_PENDING;
+	       }
+       }
+
+       LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
+       LOG_STR("rc = %d",rc);
+       LOG(logHdr,logStr);
+       LOG(logHdr,"exit::");
+
+       return rc;
+}
+
+/**
+* Function used to report that the network interface came (back) up
+* @param client - Reference to the Iotfclient
+*
+*/
+void notifyNetworkUp(iotfclient *client)
+{
+       backoff_reset(&client->backoff);
+       if(client->reconnectPending)
+	       schedule_reconnect(client);
+}
+
+/**
+* Function used to reconnect, blocking the caller until the connection is back
+* @param client - Reference to the Iotfclient
+*
+* @return int return code
+*/
 int retry_connection(iotfclient  *client)
 {
        int retry = 1;
        int rc = -1;
 
-       while((rc = connectiotf(client)) != SUCCESS)
+       if(client->networkOpen && metrics_time() - client->connectedAt >= BACKOFF_STABLE_MS)
+	       backoff_reset(&client->backoff);
+       release_connection(client);
+       do
        {
-	       printf("Retry Attempt #%d ", retry);
-	       int delay = reconnect_delay(retry++);
-	       printf(" next attempt in %d seconds\n", delay);
-	       osDelay(1000*delay);
-       }
+	       uint32_t delay = backoff_next(&client->backoff);
+	       printf("Retry Attempt #%d in %u ms\n", retry++, (unsigned int)delay);
+	       osDelay((uint32_t)(((uint64_t)delay * osKernelGetTickFreq() + 999U) / 1000U));
+	       metrics_add(&client->metrics.reconnects, 1);
+       } while((rc = connectiotf(client)) != SUCCESS);
        return rc;
 }
 
@@ -627,15 +1115,7 @@ void freeConfig(Config *cfg){
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"entry::");
 
-       freePtr(cfg->org);
-       freePtr(cfg->domain);
-       freePtr(cfg->type);
-       freePtr(cfg->id);
-       freePtr(cfg->authmethod);
-       freePtr(cfg->authtoken);
-       freePtr(cfg->rootCACertPath);
-       freePtr(cfg->clientCertPath);
-       freePtr(cfg->clientKeyPath);
+       config_release(cfg);
 
        LOG_HDR("%s:%d:%s:",__FILE__,__LINE__,__func__);
        LOG(logHdr,"exit::");
@@ -26,33 +26,20 @@
 #include "iotf_utils.h"
 #include "MQTTClient.h"
 #include "iotf_network_tls_wrapper.h"
+#include "iotf_backoff.h"
+#include "iotf_config.h"
 
+//MQTT send and read buffer size
+#ifndef BUFFER_SIZE
 #define BUFFER_SIZE 1024
+#endif
 
-enum errorCodes { CONFIG_FILE_ERROR = -3, MISSING_INPUT_PARAM = -4, QUICKSTART_NOT_SUPPORTED = -5 };
+enum errorCodes { CONFIG_FILE_ERROR = -3, MISSING_INPUT_PARAM = -4, QUICKSTART_NOT_SUPPORTED = -5, RECONNECT_PENDING = -6, CONFIG_TOO_LARGE = -7,
+                  CONNECT_TIMEOUT = -8, HOST_NOT_FOUND = -9, CONNECT_FAILED = -10 };
 
 extern unsigned short keepAliveInterval;
 extern char *sourceFile;
 
-//configuration file structure
-struct iotf_config
-{
-       char* org;
-       char* domain;
-       char* type;
-       char* id;
-       char* authmethod;
-       char* authtoken;
-       char* serverCertPath;
-       char* rootCACertPath;
-       char* clientCertPath;
-       char* clientKeyPath;
-       int port;
-       int useClientCertificates;
-};
-
-typedef struct iotf_config Config;
-
 //iotfclient
 typedef struct
 {
@@ -63,6 +50,18 @@ typedef struct
        unsigned char readbuf[BUFFER_SIZE];
        int isQuickstart;
        int isGateway;
+       iotf_metrics metrics;
+       iotf_backoff backoff;
+       Timer reconnectTimer;
+       int reconnectPending;           //reconnectTimer holds the time of the next attempt
+       int networkOpen;                //n holds a connection that has to be released
+       uint32_t connectedAt;
+       int fastHandshake;              //see setFastHandshake
+       int pinned;                     //serverCertPin replaces the CA chain
+       unsigned char serverCertPin[TLS_PIN_SIZE];
+       net_resolver resolver;          //broker addresses, so reconnects do not wait for DNS
+       unsigned int connectTimeout;    //milliseconds of the TCP connect and TLS handshake, see setConnectTimeout
+       net_progress connectProgress;   //see setConnectTimeout
 } iotfclient;
 
 /**
@@ -100,9 +99,14 @@ int initialize_configfile(iotfclient *client, char *configFilePath, int isGatewa
 
 /**
 * Function used to initialize the IBM Watson IoT client
+* The TCP connect and TLS handshake end after the time set with setConnectTimeout.
 * @param client - Reference to the Iotfclient
 *
 * @return int return code
+* error codes
+* CONNECT_TIMEOUT -8 - The broker did not accept the connection or finish the handshake in time
+* HOST_NOT_FOUND -9 - The broker address did not resolve
+* CONNECT_FAILED -10 - The broker refused the connection or the network failed
 */
 int connectiotf(iotfclient *client);
 
@@ -117,6 +121,33 @@ int connectiotf(iotfclient *client);
 **/
 int publishData(MQTTClient *mqttClient, char *topic, char *payload, int qos);
 
+/**
+* Function used to publish a payload of known length (binary safe) to the topic with the given QoS.
+* The payload may be larger than the client's send buffer, the part that does not fit is
+* written from the payload itself.
+* @Param client - Address of MQTT Client
+* @Param topic - Topic to publish
+* @Param payload - Message payload
+* @Param len - Payload length in bytes
+* @Param qos - quality of service either of 0,1,2
+*
+* @return int - Return code from MQTT Publish Call
+**/
+int publishDataLen(MQTTClient *mqttClient, char *topic, void *payload, size_t len, int qos);
+
+/**
+* Function used to publish an event with an explicit payload length, e.g. CBOR encoded data
+* @param client - Reference to the Iotfclient
+* @param eventType - Type of event to be published e.g status, gps
+* @param eventFormat - Format of the event e.g json, cbor (IOTF_CBOR_FORMAT)
+* @param data - Payload of the event
+* @param len - Payload length in bytes
+* @param qos - qos for the publish event. Supported values : QOS0, QOS1, QOS2
+*
+* @return int return code from the publish
+**/
+int publishEventData(iotfclient *client, char *eventType, char *eventFormat, void *data, size_t len, enum QoS qos);
+
 /**
 * Function used to check if the client is connected
 * @param client - Reference to the Iotfclient
@@ -148,8 +179,140 @@ int disconnect(iotfclient *client);
 */
 void setKeepAliveInterval(unsigned int keepAlive);
 
+/**
+* Function used to connect to a broker other than <org>.messaging.<domain>, e.g. a local
+* test broker. TLS server certificates are still verified against the messaging hostname.
+* The addresses of the hostIPs key and those resolved before are dropped.
+* The config file keys "host" and "port" have the same effect.
+* @param client - Reference to the Iotfclient
+* @param host - Host name or address to connect to, NULL restores the messaging hostname
+* @param port - Port to connect to, 0 keeps the configured port
+*
+* @return int return code
+*/
+int setServerAddress(iotfclient *client, char *host, int port);
+
+/**
+* Function used to authenticate the TLS connection with a pre-shared key, the same as the psk
+* and pskIdentity keys of the configuration file. The client loads no certificates and offers
+* only the PSK and ECDHE-PSK cipher suites built into mbed TLS, so the broker has to know the
+* key. Takes effect with the next connection, call it after initialize.
+* @param client - Reference to the Iotfclient
+* @param identity - PSK identity
+* @param pskHex - Key in hex, at most MBEDTLS_PSK_MAX_LEN bytes, NULL returns to certificates
+*
+* @return int return code
+*/
+int setPreSharedKey(iotfclient *client, char *identity, char *pskHex);
+
+/**
+* Function used to make the TLS handshake of the client as short as possible. The client offers
+* only ECDHE-ECDSA-AES128-GCM-SHA256 on secp256r1, so the server needs an ECDSA P-256 certificate.
+* With a pin, the server certificate is trusted if its SHA-256 matches, the CA certificates are
+* neither loaded nor used. The other checks of the chain (signatures, host name) still apply.
+* Takes effect with the next connection.
+* @param client - Reference to the Iotfclient
+* @param enable - 1 for the short handshake, 0 restores the default
+* @param serverCertSha256 - SHA-256 of the server certificate in DER (TLS_PIN_SIZE bytes), NULL
+*                           verifies the server certificate against serverCertPath
+*
+* @return int return code
+*/
+int setFastHandshake(iotfclient *client, int enable, const unsigned char *serverCertSha256);
+
+/**
+* Function used to hold the following events of the client until uncorkEvents, so a burst
+* of QoS0 events leaves in one TLS record (IOTF_NETWORK_CORK_SIZE bytes at most). Calls
+* nest. A QoS1 or QoS2 event and yield send the held events at once.
+* @param client - Reference to the Iotfclient
+*
+*/
+void corkEvents(iotfclient *client);
+
+/**
+* Function used to end the section started by corkEvents. The outermost call sends the
+* held events.
+* @param client - Reference to the Iotfclient
+*
+* @return int SUCCESS or FAILURE if the held events could not be sent
+*/
+int uncorkEvents(iotfclient *client);
+
+/**
+* Function used to read the client's counters and latency histograms
+* @param client - Reference to the Iotfclient
+* @param out - Address to store the snapshot
+* @param reset - Non-zero to reset the metrics after reading them
+*
+* @return int return code
+*/
+int getMetrics(iotfclient *client, iotf_metrics *out, int reset);
+
+/**
+* Function used to publish a snapshot of the client's metrics as a JSON event with QoS0
+* @param client - Reference to the Iotfclient
+* @param eventType - Type of event to be published e.g metrics
+* @param reset - Non-zero to reset the metrics once they are taken for publishing
+*
+* @return int return code from the publish
+*/
+int publishMetrics(iotfclient *client, char *eventType, int reset);
+
+/**
+* Function used to bound the connection attempts of connectiotf, retry_connection and
+* pollReconnect. The TCP connect and the TLS handshake of an attempt fail with
+* CONNECT_TIMEOUT after timeoutMs, so a half-open network does not hold the caller for the
+* network stack's own timeout. The default is IOTF_NETWORK_CONNECT_TIMEOUT.
+* @param client - Reference to the Iotfclient
+* @param timeoutMs - Time an attempt may take in milliseconds, 0 for the default
+* @param progress - Function called as an attempt resolves the broker, connects to each of
+*                   its addresses and starts the handshake, NULL for none. Its signature -
+*                   void (*net_progress)(int stage, const net_addr *addr, int rc)
+*
+*/
+void setConnectTimeout(iotfclient *client, unsigned int timeoutMs, net_progress progress);
+
+/**
+* Function used to set the reconnect backoff. Each retry waits a random time between
+* zero and min(maxMs, baseMs * 2^retries), so a fleet that loses the broker at the
+* same moment does not reconnect in lockstep.
+* @param client - Reference to the Iotfclient
+* @param baseMs - Window of the first retry in milliseconds
+* @param maxMs - Upper limit of the window in milliseconds
+*
+*/
+void setReconnectPolicy(iotfclient *client, unsigned int baseMs, unsigned int maxMs);
+
+/**
+* Function used to drive reconnection without blocking. Call it from the application loop,
+* e.g. before yield. When the connection is lost the next attempt is scheduled with the
+* backoff, and a call after the delay has passed makes one connection attempt, which takes
+* no longer than the time set with setConnectTimeout plus the MQTT CONNECT.
+* @param client - Reference to the Iotfclient
+*
+* @return int SUCCESS when connected, RECONNECT_PENDING while waiting for the next attempt
+*/
+int pollReconnect(iotfclient *client);
+
+/**
+* Function used to report that the network interface came (back) up, e.g. from the
+* link or DHCP callback. A pending reconnect is rescheduled within the base window.
+* @param client - Reference to the Iotfclient
+*
+*/
+void notifyNetworkUp(iotfclient *client);
+
+/**
+* Function used to reconnect, blocking the caller until the connection is back.
+* Waits between attempts follow the backoff, see setReconnectPolicy, and each attempt is
+* bounded by setConnectTimeout.
+* @param client - Reference to the Iotfclient
+*
+* @return int return code
+*/
 int retry_connection(iotfclient *client);
 
+//Reads a config file into a configuration set up with config_init
 int get_config(char * filename, Config * configstr);
 
 void freeConfig(Config *cfg);
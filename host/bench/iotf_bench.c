@@ -0,0 +1,1017 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Host benchmark suite. Runs against a local MQTT broker and reports
+ *                    connect times, publish throughput per QoS, command dispatch latency,
+ *                    device management round-trip and heap high-water marks as JSON.
+ *                 -  Server certificate pinning checked with the right and a wrong pin.
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <math.h>
+#include "deviceclient.h"
+#include "devicemanagementclient.h"
+#include "iotf_telemetry.h"
+#include "cmsis_os2.h"
+#include "iotf_broker.h"
+
+#define QS_DOMAIN       "internetofthings.ibmcloud.com"
+#define QS_HOSTNAME     "quickstart.messaging." QS_DOMAIN
+#define MAX_SIZES       4
+#define MAX_SIZE        12288   //the broker stand-in takes packets up to 16 KB
+
+//Benchmark options
+static struct {
+        const char *host;
+        int port;
+        int tlsPort;
+        const char *caFile;
+        const char *tlsName;
+        int connects;
+        int messages;
+        int sizes[MAX_SIZES];
+        int nsizes;
+        int commands;
+        int dmRequests;
+        const char *output;
+        int broker;
+        const char *certDir;
+        const char *pinFile;
+        iotf_broker_config brokerCfg;
+} opt = { "127.0.0.1", 1883, 0, NULL, QS_HOSTNAME, 10, 1000, { 64 }, 1, 200, 20, NULL, 0, NULL, NULL, { 0, -1, NULL, NULL, 0, 0, 0, 0, 0, 0, 0 } };
+
+/*
+ * Heap accounting. The bench is linked with --wrap for the allocator entry points,
+ * so every allocation made by the library, mbedTLS, cJSON and Paho is counted.
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t heapCurrent;
+static size_t heapPeak;
+
+static void heap_add(void *ptr)
+{
+        size_t cur, peak;
+        if (ptr == NULL)
+                return;
+        cur = __atomic_add_fetch(&heapCurrent, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+        peak = __atomic_load_n(&heapPeak, __ATOMIC_RELAXED);
+        while (cur > peak && !__atomic_compare_exchange_n(&heapPeak, &peak, cur, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                ;
+}
+
+static void heap_sub(void *ptr)
+{
+        if (ptr != NULL)
+                __atomic_sub_fetch(&heapCurrent, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size)
+{
+        void *ptr = __real_malloc(size);
+        heap_add(ptr);
+        return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+        void *ptr = __real_calloc(n, size);
+        heap_add(ptr);
+        return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+        void *res;
+        heap_sub(ptr);
+        res = __real_realloc(ptr, size);
+        //A failed realloc leaves the old block in place
+        heap_add(res != NULL ? res : (size ? ptr : NULL));
+        return res;
+}
+
+void __wrap_free(void *ptr)
+{
+        heap_sub(ptr);
+        __real_free(ptr);
+}
+
+//Starts a heap window, returns the baseline
+static size_t heap_mark(void)
+{
+        size_t cur = __atomic_load_n(&heapCurrent, __ATOMIC_RELAXED);
+        __atomic_store_n(&heapPeak, cur, __ATOMIC_RELAXED);
+        return cur;
+}
+
+static size_t heap_high_water(size_t base)
+{
+        size_t peak = __atomic_load_n(&heapPeak, __ATOMIC_RELAXED);
+        return peak > base ? peak - base : 0;
+}
+
+//Resident set high-water mark in kB from /proc
+static long rss_high_water(void)
+{
+        char line[128];
+        long kb = -1;
+        FILE *f = fopen("/proc/self/status", "r");
+        if (f == NULL)
+                return -1;
+        while (fgets(line, sizeof(line), f) != NULL)
+                if (sscanf(line, "VmHWM: %ld", &kb) == 1)
+                        break;
+        fclose(f);
+        return kb;
+}
+
+static double now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static uint64_t now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+//Latency samples
+typedef struct {
+        double *v;
+        int n;
+        int cap;
+} samples;
+
+static void samples_init(samples *s, int cap)
+{
+        s->v = malloc(sizeof(double) * (cap > 0 ? cap : 1));
+        s->n = 0;
+        s->cap = s->v != NULL ? cap : 0;
+}
+
+static void samples_add(samples *s, double v)
+{
+        if (s->n < s->cap)
+                s->v[s->n++] = v;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+        double x = *(const double *)a, y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+static double samples_pct(samples *s, double pct)
+{
+        int idx;
+        if (s->n == 0)
+                return 0;
+        qsort(s->v, s->n, sizeof(double), cmp_double);
+        idx = (int)(pct / 100.0 * (s->n - 1) + 0.5);
+        return s->v[idx];
+}
+
+//Adds {"n":..,"p50_ms":..,"p99_ms":..,"max_ms":..}
+static void tb_add_samples(tb_builder *tb, const char *key, samples *s)
+{
+        tb_begin_obj(tb, key);
+        tb_add_i32(tb, "n", s->n);
+        tb_add_double(tb, "p50_ms", samples_pct(s, 50), 3);
+        tb_add_double(tb, "p99_ms", samples_pct(s, 99), 3);
+        tb_add_double(tb, "max_ms", s->n ? s->v[s->n - 1] : 0, 3);
+        tb_end_obj(tb);
+}
+
+static void samples_free(samples *s)
+{
+        free(s->v);
+        s->v = NULL;
+        s->n = s->cap = 0;
+}
+
+/*
+ * Application side client. A plain Paho client that publishes commands to the bench
+ * device and answers device management requests, driven from its own thread so that
+ * blocking library calls on the device side (publishManageEvent) can complete.
+ */
+static struct {
+        Network n;
+        MQTTClient c;
+        unsigned char buf[BUFFER_SIZE];
+        unsigned char readbuf[BUFFER_SIZE];
+        volatile int run;
+        volatile int cmdToSend;
+        volatile int cmdInFlight;
+        volatile int cmdStorm;          //send cmdToSend commands without waiting for each
+        uint64_t cmdSentAt;
+        volatile int dmAnswered;
+        osThreadId_t thread;
+} app;
+
+static int mqtt_open(Network *n, MQTTClient *c, unsigned char *buf, unsigned char *readbuf, char *clientId)
+{
+        MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+
+        NewNetwork(n);
+        if (ConnectNetwork(n, (char *)opt.host, opt.port) != 0)
+                return -1;
+        MQTTClientInit(c, n, 1000, buf, BUFFER_SIZE, readbuf, BUFFER_SIZE);
+        data.MQTTVersion = 3;
+        data.clientID.cstring = clientId;
+        data.keepAliveInterval = 60;
+        data.cleansession = 1;
+        if (MQTTConnect(c, &data) != SUCCESS) {
+                iotSocketClose(n->my_socket);
+                return -1;
+        }
+        return 0;
+}
+
+static void mqtt_close(Network *n, MQTTClient *c)
+{
+        MQTTDisconnect(c);
+        iotSocketClose(n->my_socket);
+}
+
+//Answers iotdevice-1/mgmt/manage with rc 200 and the request id
+static void app_on_manage(MessageData *md)
+{
+        char reply[96];
+        char reqId[48];
+        const char *p = md->message->payload;
+        const char *end = p + md->message->payloadlen;
+        const char *key = "\"reqId\":\"";
+        size_t klen = strlen(key);
+        size_t i = 0;
+        MQTTMessage msg;
+
+        for (; p + klen <= end; p++)
+                if (memcmp(p, key, klen) == 0)
+                        break;
+        if (p + klen > end)
+                return;
+        for (p += klen; p < end && *p != '"' && i < sizeof(reqId) - 1; p++)
+                reqId[i++] = *p;
+        reqId[i] = '\0';
+
+        //messageResponse expects the request id before the return code
+        snprintf(reply, sizeof(reply), "{\"reqId\":\"%s\",\"rc\":200}", reqId);
+        memset(&msg, 0, sizeof(msg));
+        msg.qos = QOS0;
+        msg.payload = reply;
+        msg.payloadlen = strlen(reply);
+        MQTTPublish(&app.c, "iotdm-1/response", &msg);
+        app.dmAnswered++;
+}
+
+static void app_thread(void *arg)
+{
+        char payload[17];
+        MQTTMessage msg;
+        (void)arg;
+
+        while (app.run) {
+                while (app.cmdStorm && app.cmdToSend > 0) {
+                        snprintf(payload, sizeof(payload), "%016llx", (unsigned long long)now_us());
+                        memset(&msg, 0, sizeof(msg));
+                        msg.qos = QOS0;
+                        msg.payload = payload;
+                        msg.payloadlen = 16;
+                        if (MQTTPublish(&app.c, "iot-2/cmd/bench/fmt/hex", &msg) != SUCCESS)
+                                break;
+                        app.cmdToSend--;
+                }
+                if (app.cmdToSend > 0 && !app.cmdInFlight && !app.cmdStorm) {
+                        snprintf(payload, sizeof(payload), "%016llx", (unsigned long long)now_us());
+                        memset(&msg, 0, sizeof(msg));
+                        msg.qos = QOS0;
+                        msg.payload = payload;
+                        msg.payloadlen = 16;
+                        app.cmdInFlight = 1;
+                        app.cmdSentAt = now_us();
+                        if (MQTTPublish(&app.c, "iot-2/cmd/bench/fmt/hex", &msg) == SUCCESS)
+                                app.cmdToSend--;
+                        else
+                                app.cmdInFlight = 0;
+                }
+                //A lost command must not stall the sender
+                if (app.cmdInFlight && now_us() - app.cmdSentAt > 1000000U)
+                        app.cmdInFlight = 0;
+                MQTTYield(&app.c, 1);
+        }
+}
+
+static int app_start(void)
+{
+        memset(&app, 0, sizeof(app));
+        if (mqtt_open(&app.n, &app.c, app.buf, app.readbuf, "a:quickstart:iotfbench") != 0)
+                return -1;
+        if (MQTTSubscribe(&app.c, "iotdevice-1/mgmt/manage", QOS0, app_on_manage) != SUCCESS) {
+                mqtt_close(&app.n, &app.c);
+                return -1;
+        }
+        app.run = 1;
+        app.thread = osThreadNew(app_thread, NULL, NULL);
+        return app.thread != NULL ? 0 : -1;
+}
+
+static void app_stop(void)
+{
+        app.run = 0;
+        if (app.thread != NULL)
+                osThreadJoin(app.thread);
+        mqtt_close(&app.n, &app.c);
+}
+
+/*
+ * Scenario: time-to-connect. TCP connect, TLS handshake (over its own TCP connection)
+ * and MQTT CONNECT/CONNACK are timed separately. TCP connects are timed resolving the
+ * host each time and, as connectiotf reconnects, with the addresses a resolver kept.
+ * TLS connects are timed with a full handshake each.
+ */
+static void bench_connect(tb_builder *tb)
+{
+        samples tcp, cached, tls, mqtt;
+        net_resolver resolver;
+        MQTTPacket_connectData data;
+        Network n;
+        MQTTClient c;
+        unsigned char buf[BUFFER_SIZE], readbuf[BUFFER_SIZE];
+        double t0;
+        int i, failed = 0;
+        size_t base = heap_mark();
+
+        samples_init(&tcp, opt.connects);
+        samples_init(&cached, opt.connects);
+        samples_init(&tls, opt.connects);
+        samples_init(&mqtt, opt.connects);
+
+        for (i = 0; i < opt.connects; i++) {
+                NewNetwork(&n);
+                t0 = now_ms();
+                if (ConnectNetwork(&n, (char *)opt.host, opt.port) != 0) {
+                        failed++;
+                        continue;
+                }
+                samples_add(&tcp, now_ms() - t0);
+
+                MQTTClientInit(&c, &n, 1000, buf, sizeof(buf), readbuf, sizeof(readbuf));
+                data = (MQTTPacket_connectData)MQTTPacket_connectData_initializer;
+                data.MQTTVersion = 3;
+                data.clientID.cstring = "d:quickstart:bench:iotfconnect";
+                t0 = now_ms();
+                if (MQTTConnect(&c, &data) == SUCCESS) {
+                        samples_add(&mqtt, now_ms() - t0);
+                        MQTTDisconnect(&c);
+                } else
+                        failed++;
+                iotSocketClose(n.my_socket);
+        }
+
+        //The first connect resolves the host for the following ones
+        net_resolver_init(&resolver);
+        for (i = 0; i <= opt.connects; i++) {
+                NewNetwork(&n);
+                n.resolver = &resolver;
+                t0 = now_ms();
+                if (ConnectNetwork(&n, (char *)opt.host, opt.port) != 0) {
+                        failed++;
+                        continue;
+                }
+                if (i > 0)
+                        samples_add(&cached, now_ms() - t0);
+                iotSocketClose(n.my_socket);
+        }
+
+        for (i = 0; opt.tlsPort && i < opt.connects; i++) {
+                tls_connect_params params = { (char *)opt.caFile, "", "", "", (char *)opt.tlsName };
+                NewNetwork(&n);
+                t0 = now_ms();
+                if (tls_connect(&n.TLSInitData, &params, opt.host, opt.tlsPort, 0) == 0)
+                        samples_add(&tls, now_ms() - t0);
+                else
+                        failed++;
+                teardown_tls(&n.TLSInitData, &n.TLSConnectData);
+        }
+
+        tb_begin_obj(tb, "connect");
+        tb_add_i32(tb, "failed", failed);
+        tb_add_samples(tb, "tcp", &tcp);
+        tb_add_samples(tb, "tcp_cached", &cached);
+        if (opt.tlsPort)
+                tb_add_samples(tb, "tcp_tls", &tls);
+        tb_add_samples(tb, "mqtt", &mqtt);
+        tb_add_u32(tb, "heap_high_water", (uint32_t)heap_high_water(base));
+        tb_end_obj(tb);
+
+        fprintf(stderr, "connect: tcp p50 %.3f ms (cached %.3f ms), mqtt p50 %.3f ms, tls p50 %.3f ms, %d failed\n",
+                samples_pct(&tcp, 50), samples_pct(&cached, 50), samples_pct(&mqtt, 50), samples_pct(&tls, 50),
+                failed);
+        samples_free(&tcp);
+        samples_free(&cached);
+        samples_free(&tls);
+        samples_free(&mqtt);
+}
+
+/*
+ * Scenario: server certificate pinning. Handshakes with restrictSuites and the SHA-256
+ * of the server certificate as pin are timed against the default handshake, then a pin
+ * with one bit flipped must be refused. Returns -1 if the right pin failed or the wrong
+ * pin was accepted.
+ */
+static int bench_pin(tb_builder *tb)
+{
+        samples plain, pinned;
+        mbedtls_x509_crt crt;
+        unsigned char pin[TLS_PIN_SIZE], wrong[TLS_PIN_SIZE];
+        Network n;
+        double t0;
+        int i, rc, failed = 0, wrongAccepted = 0;
+
+        mbedtls_x509_crt_init(&crt);
+        rc = mbedtls_x509_crt_parse_file(&crt, opt.pinFile);
+        if (rc == 0)
+                rc = mbedtls_sha256(crt.raw.p, crt.raw.len, pin, 0);
+        mbedtls_x509_crt_free(&crt);
+        if (rc != 0) {
+                fprintf(stderr, "pin: cannot read %s\n", opt.pinFile);
+                return -1;
+        }
+        memcpy(wrong, pin, sizeof(wrong));
+        wrong[0] ^= 0x01;
+
+        samples_init(&plain, opt.connects);
+        samples_init(&pinned, opt.connects);
+        for (i = 0; i < opt.connects; i++) {
+                tls_connect_params params;
+
+                memset(&params, 0, sizeof(params));
+                params.pServerCertLocation = (char *)opt.caFile;
+                params.pRootCACertLocation = "";
+                params.pDeviceCertLocation = "";
+                params.pDevicePrivateKeyLocation = "";
+                params.pDestinationURL = (char *)opt.tlsName;
+                NewNetwork(&n);
+                t0 = now_ms();
+                if (tls_connect(&n.TLSInitData, &params, opt.host, opt.tlsPort, 0) == 0)
+                        samples_add(&plain, now_ms() - t0);
+                else
+                        failed++;
+                teardown_tls(&n.TLSInitData, &n.TLSConnectData);
+
+                params.restrictSuites = 1;
+                params.pServerCertPin = pin;
+                NewNetwork(&n);
+                t0 = now_ms();
+                if (tls_connect(&n.TLSInitData, &params, opt.host, opt.tlsPort, 0) == 0)
+                        samples_add(&pinned, now_ms() - t0);
+                else
+                        failed++;
+                teardown_tls(&n.TLSInitData, &n.TLSConnectData);
+
+                params.pServerCertPin = wrong;
+                NewNetwork(&n);
+                if (tls_connect(&n.TLSInitData, &params, opt.host, opt.tlsPort, 0) == 0)
+                        wrongAccepted++;
+                teardown_tls(&n.TLSInitData, &n.TLSConnectData);
+        }
+
+        tb_begin_obj(tb, "pin");
+        tb_add_i32(tb, "failed", failed);
+        tb_add_i32(tb, "wrong_pin_accepted", wrongAccepted);
+        tb_add_samples(tb, "tcp_tls", &plain);
+        tb_add_samples(tb, "tcp_tls_pinned", &pinned);
+        tb_end_obj(tb);
+
+        fprintf(stderr, "pin: tls p50 %.3f ms, pinned p50 %.3f ms, %d failed, wrong pin accepted %d of %d\n",
+                samples_pct(&plain, 50), samples_pct(&pinned, 50), failed, wrongAccepted, opt.connects);
+        samples_free(&plain);
+        samples_free(&pinned);
+        return (failed == 0 && wrongAccepted == 0) ? 0 : -1;
+}
+
+/*
+ * Scenario: publish throughput per payload size and QoS through publishEventData. QoS1
+ * and QoS2 wait for the acknowledgement flow, so they measure broker round-trips.
+ * Packets larger than the client's send buffer take the scattered write path.
+ */
+static void bench_publish_size(tb_builder *tb, iotfclient *client, int size)
+{
+        size_t payloadSize = (size_t)size + 64;
+        char *payload = malloc(payloadSize);
+        char *filler = malloc(size + 1);
+        tb_builder pb;
+        int qos, i, len, failed;
+        double t0, elapsed;
+        size_t base;
+
+        if (filler == NULL || payload == NULL) {
+                free(payload);
+                free(filler);
+                return;
+        }
+        memset(filler, 'x', size);
+        filler[size] = '\0';
+
+        for (qos = QOS0; qos <= QOS2; qos++) {
+                failed = 0;
+                base = heap_mark();
+                t0 = now_ms();
+                for (i = 0; i < opt.messages; i++) {
+                        tb_begin(&pb, payload, payloadSize);
+                        tb_begin_obj(&pb, "d");
+                        tb_add_i32(&pb, "seq", i);
+                        tb_add_str(&pb, "fill", filler);
+                        tb_end_obj(&pb);
+                        len = tb_end(&pb);
+                        if (len < 0 || publishEventData(client, "bench", "json", payload, len, qos) != SUCCESS)
+                                failed++;
+                }
+                elapsed = now_ms() - t0;
+
+                tb_begin_obj(tb, NULL);
+                tb_add_i32(tb, "qos", qos);
+                tb_add_i32(tb, "messages", opt.messages);
+                tb_add_i32(tb, "payload_bytes", size);
+                tb_add_i32(tb, "failed", failed);
+                tb_add_double(tb, "elapsed_ms", elapsed, 3);
+                tb_add_double(tb, "msg_per_s", elapsed > 0 ? opt.messages * 1000.0 / elapsed : 0, 1);
+                tb_add_u32(tb, "heap_high_water", (uint32_t)heap_high_water(base));
+                tb_end_obj(tb);
+
+                fprintf(stderr, "publish %d bytes qos%d: %d messages %d failed %.0f msg/s\n",
+                        size, qos, opt.messages, failed, elapsed > 0 ? opt.messages * 1000.0 / elapsed : 0);
+        }
+        free(payload);
+        free(filler);
+}
+
+static void bench_publish(tb_builder *tb, iotfclient *client)
+{
+        int i;
+
+        tb_begin_array(tb, "publish");
+        for (i = 0; i < opt.nsizes; i++)
+                bench_publish_size(tb, client, opt.sizes[i]);
+        tb_end_array(tb);
+}
+
+/*
+ * Scenario: records and bytes on the wire per QoS0 event, sent one by one and in corked
+ * bursts of CORK_BURST events. Each burst leaves in as few TLS records as the cork holds.
+ */
+#define CORK_BURST      10
+
+static void bench_cork(tb_builder *tb, iotfclient *client)
+{
+        char payload[] = "{\"d\":{\"temp\":21.5,\"hum\":48}}";
+        int len = (int)sizeof(payload) - 1;
+        iotf_metrics before, after;
+        int burst, i, j, failed;
+        double t0, elapsed, records, wire;
+        size_t base;
+
+        tb_begin_array(tb, "cork");
+        for (burst = 1; burst <= CORK_BURST; burst += CORK_BURST - 1) {
+                failed = 0;
+                base = heap_mark();
+                getMetrics(client, &before, 0);
+                t0 = now_ms();
+                for (i = 0; i < opt.messages; i += burst) {
+                        if (burst > 1)
+                                corkEvents(client);
+                        for (j = 0; j < burst; j++) {
+                                if (publishEventData(client, "bench", "json", payload, len, QOS0) != SUCCESS)
+                                        failed++;
+                        }
+                        if (burst > 1 && uncorkEvents(client) != SUCCESS)
+                                failed += burst;
+                }
+                elapsed = now_ms() - t0;
+                getMetrics(client, &after, 0);
+                records = (double)(after.recordsOut - before.recordsOut) / opt.messages;
+                wire = (double)(after.wireBytesOut - before.wireBytesOut) / opt.messages;
+
+                tb_begin_obj(tb, NULL);
+                tb_add_i32(tb, "burst", burst);
+                tb_add_i32(tb, "messages", opt.messages);
+                tb_add_i32(tb, "payload_bytes", len);
+                tb_add_i32(tb, "failed", failed);
+                tb_add_double(tb, "records_per_msg", records, 3);
+                tb_add_double(tb, "wire_bytes_per_msg", wire, 1);
+                tb_add_double(tb, "msg_per_s", elapsed > 0 ? opt.messages * 1000.0 / elapsed : 0, 1);
+                tb_add_u32(tb, "heap_high_water", (uint32_t)heap_high_water(base));
+                tb_end_obj(tb);
+
+                fprintf(stderr, "cork burst %d: %.3f records %.1f bytes on the wire per message\n",
+                        burst, records, wire);
+        }
+        tb_end_array(tb);
+}
+
+//Parses a comma separated list of payload sizes
+static int parse_sizes(const char *arg)
+{
+        char *end;
+
+        for (opt.nsizes = 0; opt.nsizes < MAX_SIZES; arg = end + 1) {
+                long v = strtol(arg, &end, 10);
+
+                if (end == arg || v < 0 || v > MAX_SIZE)
+                        return -1;
+                opt.sizes[opt.nsizes++] = (int)v;
+                if (*end == '\0')
+                        return 0;
+                if (*end != ',')
+                        return -1;
+        }
+        return -1;
+}
+
+//Command dispatch latency, from application publish to the device callback
+static samples cmdLatency;
+
+static void on_command(char *commandName, char *format, void *payload)
+{
+        char stamp[17];
+        (void)commandName;
+        (void)format;
+
+        memcpy(stamp, payload, 16);
+        stamp[16] = '\0';
+        samples_add(&cmdLatency, (now_us() - strtoull(stamp, NULL, 16)) / 1000.0);
+        app.cmdInFlight = 0;
+}
+
+static void bench_commands(tb_builder *tb, iotfclient *client)
+{
+        double deadline;
+        int lost;
+        size_t base = heap_mark();
+
+        samples_init(&cmdLatency, opt.commands);
+        setCommandHandler(client, on_command);
+        subscribeCommands(client);
+
+        app.cmdToSend = opt.commands;
+        deadline = now_ms() + 5000.0 + opt.commands * 1000.0;
+        while ((app.cmdToSend > 0 || app.cmdInFlight) && now_ms() < deadline)
+                yield(client, 1);
+        lost = opt.commands - cmdLatency.n;
+        app.cmdToSend = 0;
+
+        tb_begin_obj(tb, "commands");
+        tb_add_i32(tb, "lost", lost);
+        tb_add_samples(tb, "dispatch", &cmdLatency);
+        tb_add_u32(tb, "heap_high_water", (uint32_t)heap_high_water(base));
+        tb_end_obj(tb);
+
+        fprintf(stderr, "commands: p50 %.3f ms p99 %.3f ms, %d lost\n",
+                samples_pct(&cmdLatency, 50), samples_pct(&cmdLatency, 99), lost);
+        samples_free(&cmdLatency);
+}
+
+/*
+ * Scenario: command storm. The application sends all commands back to back and the device
+ * takes them from its socket as fast as it can, which shows the receive calls per command.
+ */
+static void bench_command_storm(tb_builder *tb, iotfclient *client)
+{
+        iotf_metrics before, after;
+        double t0, elapsed, deadline;
+        int received;
+
+        samples_init(&cmdLatency, opt.commands);
+        getMetrics(client, &before, 0);
+        app.cmdToSend = opt.commands;
+        app.cmdStorm = 1;
+        t0 = now_ms();
+        deadline = t0 + 5000.0 + opt.commands * 10.0;
+        while (cmdLatency.n < opt.commands && now_ms() < deadline)
+                yield(client, 10);
+        elapsed = now_ms() - t0;
+        received = cmdLatency.n;
+        app.cmdStorm = 0;
+        app.cmdToSend = 0;
+        getMetrics(client, &after, 0);
+
+        tb_begin_obj(tb, "command_storm");
+        tb_add_i32(tb, "commands", opt.commands);
+        tb_add_i32(tb, "lost", opt.commands - received);
+        tb_add_double(tb, "commands_per_s", elapsed > 0 ? received * 1000.0 / elapsed : 0, 1);
+        tb_add_double(tb, "reads_per_command",
+                      received > 0 ? (double)(after.readsIn - before.readsIn) / received : 0, 2);
+        tb_add_samples(tb, "dispatch", &cmdLatency);
+        tb_end_obj(tb);
+
+        fprintf(stderr, "command storm: %d of %d in %.0f ms, %.2f reads per command\n", received,
+                opt.commands, elapsed, received > 0 ? (double)(after.readsIn - before.readsIn) / received : 0);
+        samples_free(&cmdLatency);
+}
+
+/*
+ * Synthetic GPS trace of 600 fixes, one per second, generated here rather than recorded:
+ * 200 s parked, 200 s driving at 12 m/s and 200 s walking at 1.4 m/s, with up to 4 m of
+ * pseudo-random receiver noise on every fix. The bench
+ * replays it 100 times faster, one fix per 10 ms, with the policy scaled the same way.
+ */
+#define TRACE_FIXES     600
+#define TRACE_SPEEDUP   100
+
+static void trace_fix(int i, double *latitude, double *longitude, double *accuracy)
+{
+        static const double metersPerDegree = 6371000.0 * 3.14159265358979323846 / 180.0;
+        static uint32_t noise = 12345;
+        double north, east;
+
+        if (i == 0)
+                noise = 12345;
+        if (i < 200)
+                north = 0;
+        else if (i < 400)
+                north = (i - 200) * 12.0;
+        else
+                north = 200 * 12.0 + (i - 400) * 1.4;
+        noise = noise * 1103515245U + 12345U;
+        east = (double)((noise >> 16) % 801) / 100.0 - 4.0;
+        noise = noise * 1103515245U + 12345U;
+        north += (double)((noise >> 16) % 801) / 100.0 - 4.0;
+        *latitude = 48.1371 + north / metersPerDegree;
+        *longitude = 11.5754 + east / (metersPerDegree * cos(48.1371 * 3.14159265358979323846 / 180.0));
+        *accuracy = 5.0;
+}
+
+//Location updates the reporter sends for the GPS trace, against one update per fix
+static void bench_location(tb_builder *tb)
+{
+        struct LocationStats st;
+        double latitude, longitude, accuracy;
+        int i;
+
+        //25 m, an update at most every 5 s and at least every 300 s, in trace time
+        setLocationPolicy(25.0, 0, 5000 / TRACE_SPEEDUP, 300000 / TRACE_SPEEDUP);
+        for (i = 0; i < TRACE_FIXES; i++) {
+                trace_fix(i, &latitude, &longitude, &accuracy);
+                reportLocation(latitude, longitude, 500.0, "2026-10-19T12:00:00Z", NULL, accuracy, NULL);
+                yield_dm(1000 / TRACE_SPEEDUP);
+        }
+        //The last coalesced fix
+        for (i = 0; i < 10 && flushLocation() == LOCATION_QUEUED; i++)
+                yield_dm(1000 / TRACE_SPEEDUP);
+        getLocationStats(&st);
+        clearLocationPolicy();
+
+        tb_begin_obj(tb, "location");
+        tb_add_u32(tb, "fixes", st.reported);
+        tb_add_u32(tb, "sent", st.sent);
+        tb_add_u32(tb, "suppressed", st.suppressed);
+        tb_add_u32(tb, "coalesced", st.coalesced);
+        tb_add_fixed(tb, "reduction", st.sent ? (int32_t)(st.reported * 100U / st.sent) : 0, 2);
+        tb_end_obj(tb);
+
+        fprintf(stderr, "location: %u updates for %u fixes, %u suppressed, %u coalesced\n",
+                st.sent, st.reported, st.suppressed, st.coalesced);
+}
+
+//Device management round-trip, manage request to response callback
+static volatile int dmDone;
+
+static void on_managed(char *status, char *reqId, void *payload)
+{
+        (void)status;
+        (void)reqId;
+        (void)payload;
+        dmDone = 1;
+}
+
+static void bench_dm(tb_builder *tb)
+{
+        samples rtt;
+        char reqId[40];
+        double t0;
+        int i, failed = 0;
+        size_t base = heap_mark();
+
+        samples_init(&rtt, opt.dmRequests);
+        if (initialize_dm("quickstart", QS_DOMAIN, "bench", "iotfbenchdm", "token", NULL, NULL, 0,
+                          NULL, NULL, NULL) != SUCCESS || setServerAddress_dm((char *)opt.host, opt.port) != SUCCESS ||
+            connectiotf_dm() != SUCCESS) {
+                fprintf(stderr, "dm: connect failed\n");
+                samples_free(&rtt);
+                return;
+        }
+        disableLogging();
+        setManagedHandler_dm(on_managed);
+        subscribeCommands_dm();
+
+        for (i = 0; i < opt.dmRequests; i++) {
+                dmDone = 0;
+                t0 = now_ms();
+                publishManageEvent(0, 1, 1, reqId);
+                if (dmDone)
+                        samples_add(&rtt, now_ms() - t0);
+                else
+                        failed++;
+        }
+        bench_location(tb);
+        disconnect_dm();
+
+        tb_begin_obj(tb, "dm");
+        tb_add_i32(tb, "failed", failed);
+        tb_add_samples(tb, "manage", &rtt);
+        tb_add_u32(tb, "heap_high_water", (uint32_t)heap_high_water(base));
+        tb_end_obj(tb);
+
+        fprintf(stderr, "dm: manage p50 %.3f ms p99 %.3f ms, %d failed\n",
+                samples_pct(&rtt, 50), samples_pct(&rtt, 99), failed);
+        samples_free(&rtt);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -h host     broker address (127.0.0.1)\n"
+                "  -p port     broker MQTT port (1883)\n"
+                "  -T port     broker MQTT over TLS port, 0 skips TLS (0)\n"
+                "  -C file     CA certificate for the TLS broker\n"
+                "  -N name     TLS server name (" QS_HOSTNAME ")\n"
+                "  -P file     server certificate to pin, checks pinning with it and a wrong pin\n"
+                "  -r count    connect repetitions (10)\n"
+                "  -n count    messages per QoS (1000)\n"
+                "  -s bytes    payload filler sizes, up to 4 separated by commas (64)\n"
+                "  -c count    commands (200)\n"
+                "  -d count    device management requests (20)\n"
+                "  -o file     JSON output, stdout if omitted\n"
+                "In-process broker stand-in, replaces -h/-p/-T:\n"
+                "  -B          start the broker stand-in\n"
+                "  -K dir      enable its TLS listener with ca.pem, server.pem and server.key\n"
+                "              from gen_test_certs.sh, and pin server.pem\n"
+                "  -D ms       delay added to every packet the broker sends\n"
+                "  -W bytes    broker send rate cap per connection in bytes per second\n"
+                "  -L permille share of QoS0 deliveries the broker drops\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[16384];
+        tb_builder tb;
+        iotfclient client;
+        FILE *out = stdout;
+        iotf_broker *broker = NULL;
+        iotf_broker_stats bst;
+        iotf_metrics metrics;
+        char metricsJson[METRICS_JSON_SIZE];
+        char caPath[256], certPath[256], keyPath[256];
+        int c, i, len, pinFailed = 0;
+
+        while ((c = getopt(argc, argv, "h:p:T:C:N:P:r:n:s:c:d:o:BK:D:W:L:")) != -1) {
+                switch (c) {
+                case 'h': opt.host = optarg; break;
+                case 'p': opt.port = atoi(optarg); break;
+                case 'T': opt.tlsPort = atoi(optarg); break;
+                case 'C': opt.caFile = optarg; break;
+                case 'N': opt.tlsName = optarg; break;
+                case 'P': opt.pinFile = optarg; break;
+                case 'r': opt.connects = atoi(optarg); break;
+                case 'n': opt.messages = atoi(optarg); break;
+                case 's':
+                        if (parse_sizes(optarg) != 0) {
+                                usage(argv[0]);
+                                return 2;
+                        }
+                        break;
+                case 'c': opt.commands = atoi(optarg); break;
+                case 'd': opt.dmRequests = atoi(optarg); break;
+                case 'o': opt.output = optarg; break;
+                case 'B': opt.broker = 1; break;
+                case 'K': opt.certDir = optarg; break;
+                case 'D': opt.brokerCfg.delayMs = atoi(optarg); break;
+                case 'W': opt.brokerCfg.bytesPerSecond = atoi(optarg); break;
+                case 'L': opt.brokerCfg.lossPermille = atoi(optarg); break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.broker) {
+                if (opt.certDir != NULL) {
+                        snprintf(caPath, sizeof(caPath), "%s/ca.pem", opt.certDir);
+                        snprintf(certPath, sizeof(certPath), "%s/server.pem", opt.certDir);
+                        snprintf(keyPath, sizeof(keyPath), "%s/server.key", opt.certDir);
+                        opt.brokerCfg.tlsPort = 0;
+                        opt.brokerCfg.certFile = certPath;
+                        opt.brokerCfg.keyFile = keyPath;
+                        opt.caFile = caPath;
+                        opt.pinFile = certPath;
+                }
+                if ((broker = iotf_broker_start(&opt.brokerCfg)) == NULL) {
+                        fprintf(stderr, "cannot start broker stand-in\n");
+                        return 1;
+                }
+                opt.host = "127.0.0.1";
+                opt.port = iotf_broker_port(broker, 0);
+                opt.tlsPort = opt.certDir != NULL ? iotf_broker_port(broker, 1) : 0;
+        }
+        if (opt.tlsPort && opt.caFile == NULL) {
+                usage(argv[0]);
+                return 2;
+        }
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_str(&tb, "host", opt.host);
+        tb_add_i32(&tb, "port", opt.port);
+        tb_add_i32(&tb, "tls_port", opt.tlsPort);
+        tb_begin_array(&tb, "payload_bytes");
+        for (i = 0; i < opt.nsizes; i++)
+                tb_add_i32(&tb, NULL, opt.sizes[i]);
+        tb_end_array(&tb);
+        tb_add_bool(&tb, "broker_stand_in", opt.broker);
+        if (opt.broker) {
+                tb_add_u32(&tb, "delay_ms", opt.brokerCfg.delayMs);
+                tb_add_u32(&tb, "bytes_per_second", opt.brokerCfg.bytesPerSecond);
+                tb_add_u32(&tb, "loss_permille", opt.brokerCfg.lossPermille);
+        }
+        tb_end_obj(&tb);
+
+        if (initialize(&client, "quickstart", QS_DOMAIN, "bench", "iotfbench",
+                       "token", NULL, NULL, 0, NULL, NULL, NULL, 0) != SUCCESS) {
+                fprintf(stderr, "initialize failed\n");
+                return 1;
+        }
+        disableLogging();
+        setServerAddress(&client, (char *)opt.host, opt.port);
+
+        bench_connect(&tb);
+        if (opt.tlsPort && opt.pinFile != NULL)
+                pinFailed = bench_pin(&tb);
+
+        if (connectiotf(&client) != SUCCESS) {
+                fprintf(stderr, "connect failed\n");
+                return 1;
+        }
+        bench_publish(&tb, &client);
+        bench_cork(&tb, &client);
+
+        if (app_start() == 0) {
+                bench_commands(&tb, &client);
+                bench_command_storm(&tb, &client);
+                bench_dm(&tb);
+                app_stop();
+        } else
+                fprintf(stderr, "application client failed, skipping commands and dm\n");
+        getMetrics(&client, &metrics, 0);
+        if (metrics_serialize(&metrics, metricsJson, sizeof(metricsJson)) > 0)
+                tb_add_raw(&tb, "client_metrics", metricsJson);
+        disconnect(&client);
+
+        if (broker != NULL) {
+                iotf_broker_get_stats(broker, &bst);
+                tb_begin_obj(&tb, "broker");
+                tb_add_u32(&tb, "connections", bst.connections);
+                tb_add_u32(&tb, "publishes_in", bst.publishesIn);
+                tb_add_u32(&tb, "publishes_out", bst.publishesOut);
+                tb_add_u32(&tb, "dropped", bst.dropped);
+                tb_add_i64(&tb, "bytes_in", (int64_t)bst.bytesIn);
+                tb_add_i64(&tb, "bytes_out", (int64_t)bst.bytesOut);
+                tb_end_obj(&tb);
+                iotf_broker_stop(broker);
+        }
+        tb_add_i32(&tb, "rss_high_water_kb", (int32_t)rss_high_water());
+        len = tb_end(&tb);
+        if (len < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return pinFailed ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Event payload size and encode time, CBOR against JSON
+ *******************************************************************************/
+
+/*
+ * Encodes the same events many times as sprintf JSON, the way the samples build their
+ * payloads, as JSON from the telemetry builder and as a CBOR record, and reports the
+ * payload size and the time per event. A CBOR event is also looked up with
+ * iotf_cbor_map_find, behind a key given as an indefinite-length string.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "iotf_cbor.h"
+#include "iotf_telemetry.h"
+
+static struct
+{
+        int iterations;
+        const char *output;
+} opt = { 200000, NULL };
+
+//Status event of a sensor
+typedef struct
+{
+        double temp;
+        double humidity;
+        int pressure;
+        int battery;
+        int door;
+        const char *name;
+} status_event;
+
+//Vibration event with a burst of raw samples
+#define SAMPLES 16
+
+typedef struct
+{
+        int seq;
+        int samples[SAMPLES];
+} vibration_event;
+
+static const status_event status = { 23.5, 41.25, 1013, 87, 1, "sensor-000042" };
+static vibration_event vibration;
+
+static int status_sprintf(char *buf, size_t size, const status_event *e)
+{
+        return snprintf(buf, size,
+                        "{\"d\":{\"temp\":%.2f,\"humidity\":%.2f,\"pressure\":%d,\"battery\":%d,"
+                        "\"door\":%s,\"name\":\"%s\"}}",
+                        e->temp, e->humidity, e->pressure, e->battery, e->door ? "true" : "false", e->name);
+}
+
+static int status_tb(char *buf, size_t size, const status_event *e)
+{
+        tb_builder tb;
+
+        tb_begin(&tb, buf, size);
+        tb_begin_obj(&tb, "d");
+        tb_add_double(&tb, "temp", e->temp, 2);
+        tb_add_double(&tb, "humidity", e->humidity, 2);
+        tb_add_i32(&tb, "pressure", e->pressure);
+        tb_add_i32(&tb, "battery", e->battery);
+        tb_add_bool(&tb, "door", e->door);
+        tb_add_str(&tb, "name", e->name);
+        tb_end_obj(&tb);
+        return tb_end(&tb);
+}
+
+static int status_cbor(char *buf, size_t size, const status_event *e)
+{
+        iotf_cbor_encoder enc;
+
+        iotf_cbor_record_begin(&enc, (unsigned char *)buf, size);
+        iotf_cbor_record_float(&enc, "temp", e->temp);
+        iotf_cbor_record_float(&enc, "humidity", e->humidity);
+        iotf_cbor_record_int(&enc, "pressure", e->pressure);
+        iotf_cbor_record_int(&enc, "battery", e->battery);
+        iotf_cbor_record_bool(&enc, "door", e->door);
+        iotf_cbor_record_text(&enc, "name", e->name);
+        return iotf_cbor_record_end(&enc);
+}
+
+static int vibration_sprintf(char *buf, size_t size, const vibration_event *e)
+{
+        int i, len = snprintf(buf, size, "{\"d\":{\"seq\":%d,\"samples\":[", e->seq);
+
+        for (i = 0; i < SAMPLES && len > 0 && (size_t)len < size; i++)
+                len += snprintf(buf + len, size - len, i ? ",%d" : "%d", e->samples[i]);
+        if (len > 0 && (size_t)len < size)
+                len += snprintf(buf + len, size - len, "]}}");
+        return ((size_t)len < size) ? len : -1;
+}
+
+static int vibration_tb(char *buf, size_t size, const vibration_event *e)
+{
+        tb_builder tb;
+        int i;
+
+        tb_begin(&tb, buf, size);
+        tb_begin_obj(&tb, "d");
+        tb_add_i32(&tb, "seq", e->seq);
+        tb_begin_array(&tb, "samples");
+        for (i = 0; i < SAMPLES; i++)
+                tb_add_i32(&tb, NULL, e->samples[i]);
+        tb_end_array(&tb);
+        tb_end_obj(&tb);
+        return tb_end(&tb);
+}
+
+static int vibration_cbor(char *buf, size_t size, const vibration_event *e)
+{
+        iotf_cbor_encoder enc;
+        int i;
+
+        iotf_cbor_record_begin(&enc, (unsigned char *)buf, size);
+        iotf_cbor_record_int(&enc, "seq", e->seq);
+        iotf_cbor_cstr(&enc, "samples");
+        iotf_cbor_array(&enc, SAMPLES);
+        for (i = 0; i < SAMPLES; i++)
+                iotf_cbor_int(&enc, e->samples[i]);
+        return iotf_cbor_record_end(&enc);
+}
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+//Runs one encoder opt.iterations times, returns the payload size or -1
+static int run(tb_builder *tb, const char *name, int (*encode)(char *, size_t, const void *), const void *event)
+{
+        static volatile int sink;
+        char buf[256];
+        double start, ns;
+        int i, len = 0;
+
+        start = now_s();
+        for (i = 0; i < opt.iterations; i++) {
+                len = encode(buf, sizeof(buf), event);
+                sink += buf[len > 0 ? len - 1 : 0];
+        }
+        ns = (now_s() - start) * 1e9 / opt.iterations;
+        if (len <= 0) {
+                fprintf(stderr, "%s: encode failed (%d)\n", name, len);
+                return -1;
+        }
+
+        tb_begin_obj(tb, name);
+        tb_add_i32(tb, "bytes", len);
+        tb_add_i32(tb, "ns_per_event", (int32_t)ns);
+        tb_end_obj(tb);
+        fprintf(stderr, "%-18s %4d bytes %8.0f ns per event\n", name, len, ns);
+        return len;
+}
+
+//Looks up "name" in a map whose first key is an indefinite-length string, returns ns per lookup
+static double run_lookup(tb_builder *tb)
+{
+        static const unsigned char chunked[] = { 0x7f, 0x62, 's', 'e', 0x61, 'q', 0xff, 0x07 };
+        unsigned char buf[256];
+        iotf_cbor_encoder enc;
+        iotf_cbor_decoder dec;
+        iotf_cbor_item map, item;
+        double start, ns;
+        int i, len, rc = 0;
+
+        //{"seq"(chunked): 7, "temp": ..., "name": ...}
+        iotf_cbor_encoder_init(&enc, buf, sizeof(buf));
+        iotf_cbor_map(&enc, 3);
+        memcpy(buf + enc.len, chunked, sizeof(chunked));
+        enc.len += sizeof(chunked);
+        iotf_cbor_cstr(&enc, "temp");
+        iotf_cbor_float(&enc, status.temp);
+        iotf_cbor_cstr(&enc, "name");
+        iotf_cbor_cstr(&enc, status.name);
+        len = iotf_cbor_length(&enc);
+
+        start = now_s();
+        for (i = 0; i < opt.iterations && rc == 0; i++) {
+                iotf_cbor_decoder_init(&dec, buf, (size_t)len);
+                if ((rc = iotf_cbor_next(&dec, &map)) == 0)
+                        rc = iotf_cbor_map_find(&dec, &map, "name", &item);
+        }
+        ns = (now_s() - start) * 1e9 / opt.iterations;
+        if (rc != 0 || item.type != CBOR_TEXT || item.value != strlen(status.name) ||
+            memcmp(item.data, status.name, item.value) != 0) {
+                fprintf(stderr, "cbor_map_find: lookup failed (%d)\n", rc);
+                return -1.0;
+        }
+
+        tb_begin_obj(tb, "cbor_map_find");
+        tb_add_i32(tb, "ns_per_lookup", (int32_t)ns);
+        tb_end_obj(tb);
+        fprintf(stderr, "%-18s      %8.0f ns per lookup\n", "cbor_map_find", ns);
+        return ns;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -n count    events encoded by each encoder (200000)\n"
+                "  -o file     JSON output, stdout if omitted\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[2048];
+        tb_builder tb;
+        FILE *out = stdout;
+        int c, i, len, json1, cbor1, json2, cbor2;
+
+        while ((c = getopt(argc, argv, "n:o:")) != -1) {
+                switch (c) {
+                case 'n': opt.iterations = atoi(optarg); break;
+                case 'o': opt.output = optarg; break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.iterations <= 0) {
+                usage(argv[0]);
+                return 2;
+        }
+        //Accelerometer counts around a 1 g offset, as a 12-bit sensor reports them
+        vibration.seq = 4711;
+        for (i = 0; i < SAMPLES; i++)
+                vibration.samples[i] = 1024 + ((i * 37) % 61) - 30;
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_i32(&tb, "iterations", opt.iterations);
+        tb_end_obj(&tb);
+        tb_begin_obj(&tb, "status");
+        json1 = run(&tb, "sprintf_json", (int (*)(char *, size_t, const void *))status_sprintf, &status);
+        run(&tb, "tb_json", (int (*)(char *, size_t, const void *))status_tb, &status);
+        cbor1 = run(&tb, "cbor", (int (*)(char *, size_t, const void *))status_cbor, &status);
+        tb_end_obj(&tb);
+        tb_begin_obj(&tb, "vibration");
+        json2 = run(&tb, "sprintf_json", (int (*)(char *, size_t, const void *))vibration_sprintf, &vibration);
+        run(&tb, "tb_json", (int (*)(char *, size_t, const void *))vibration_tb, &vibration);
+        cbor2 = run(&tb, "cbor", (int (*)(char *, size_t, const void *))vibration_cbor, &vibration);
+        tb_end_obj(&tb);
+        if (json1 < 0 || cbor1 < 0 || json2 < 0 || cbor2 < 0 || run_lookup(&tb) < 0)
+                return 1;
+        if ((len = tb_end(&tb)) < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Config parsing time, line-by-line parser against config_parse
+ *******************************************************************************/
+
+/*
+ * Loads the same device.cfg many times with three parsers: a copy of the former
+ * get_config loop (fgets, strtok, trim, strcmp chain, one strCopy per value), the
+ * current get_config, and config_parse on text already in memory, which is what a
+ * simulator creating thousands of clients from one template uses. Before timing, the
+ * port of a few small configurations is checked, with the port key before and after org.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "iotfclient.h"
+#include "iotf_telemetry.h"
+
+extern char logHdr[LOG_BUF];
+extern char logStr[LOG_BUF];
+
+static const char configText[] =
+        "# Device configuration\n"
+        "org=abc123\n"
+        "domain=internetofthings.ibmcloud.com\n"
+        "type=sensor\n"
+        "id=sensor-000042\n"
+        "auth-method=token\n"
+        "auth-token=Tq8!hV2@kL5#nP9$rW\n"
+        "serverCertPath=/opt/iotf/certs/IoTFoundation.pem\n"
+        "useClientCertificates=1\n"
+        "rootCACertPath=/opt/iotf/certs/rootCA_certificate.pem\n"
+        "clientCertPath=/opt/iotf/certs/SampleDevice.pem\n"
+        "clientKeyPath=/opt/iotf/certs/SampleDevice.key\n";
+
+static struct
+{
+        int iterations;
+        const char *output;
+} opt = { 20000, NULL };
+
+typedef struct
+{
+        char *org, *domain, *type, *id, *authmethod, *authtoken;
+        char *serverCertPath, *rootCACertPath, *clientCertPath, *clientKeyPath, *host;
+        int port;
+        int useClientCertificates;
+} legacy_config;
+
+//The former get_config without its file open, as it was before the single-pass parser
+static int legacy_parse(FILE *f, legacy_config *cfg)
+{
+        char line[256];
+
+        while (fgets(line, 256, f) != NULL) {
+                char *prop, *value;
+
+                if (line[0] == '#')
+                        continue;
+                prop = trim(strtok(line, "="));
+                value = trim(strtok(NULL, "="));
+                LOG_HDR("%s:%d:%s:", __FILE__, __LINE__, __func__);
+                LOG_STR("Property: %s , Value: %s", prop, value);
+                LOG(logHdr, logStr);
+
+                if (strcmp(prop, "org") == 0) {
+                        if (strlen(value) > 1)
+                                strCopy(&cfg->org, value);
+                        if (strcmp(cfg->org, "quickstart") != 0)
+                                cfg->port = 8883;
+                }
+                else if (strcmp(prop, "domain") == 0)
+                        strCopy(&cfg->domain, value);
+                else if (strcmp(prop, "type") == 0)
+                        strCopy(&cfg->type, value);
+                else if (strcmp(prop, "id") == 0)
+                        strCopy(&cfg->id, value);
+                else if (strcmp(prop, "auth-token") == 0)
+                        strCopy(&cfg->authtoken, value);
+                else if (strcmp(prop, "auth-method") == 0)
+                        strCopy(&cfg->authmethod, value);
+                else if (strcmp(prop, "serverCertPath") == 0)
+                        strCopy(&cfg->serverCertPath, value);
+                else if (strcmp(prop, "rootCACertPath") == 0)
+                        strCopy(&cfg->rootCACertPath, value);
+                else if (strcmp(prop, "clientCertPath") == 0)
+                        strCopy(&cfg->clientCertPath, value);
+                else if (strcmp(prop, "clientKeyPath") == 0)
+                        strCopy(&cfg->clientKeyPath, value);
+                else if (strcmp(prop, "useClientCertificates") == 0)
+                        cfg->useClientCertificates = value[0] - '0';
+                else if (strcmp(prop, "host") == 0)
+                        strCopy(&cfg->host, value);
+                else if (strcmp(prop, "port") == 0 && atoi(value) > 0)
+                        cfg->port = atoi(value);
+        }
+        return 0;
+}
+
+static void legacy_free(legacy_config *cfg)
+{
+        char **fields[] = { &cfg->org, &cfg->domain, &cfg->type, &cfg->id, &cfg->authmethod, &cfg->authtoken,
+                            &cfg->serverCertPath, &cfg->rootCACertPath, &cfg->clientCertPath,
+                            &cfg->clientKeyPath, &cfg->host };
+        size_t i;
+
+        for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+                freePtr(*fields[i]);
+                *fields[i] = NULL;
+        }
+}
+
+//Ports a configuration must end up with, whatever the order of its org and port keys
+static const struct
+{
+        const char *text;
+        int port;
+} portCases[] = {
+        { "org=abc123\n", 8883 },
+        { "org=quickstart\n", 1883 },
+        { "org=abc123\nport=1884\n", 1884 },
+        { "port=1884\norg=abc123\n", 1884 },
+        { "port=1884\norg=quickstart\n", 1884 },
+};
+
+//Loads each port case through config_parse and through get_config, returns the number of wrong ports
+static int check_ports(const char *path)
+{
+        Config cfg;
+        FILE *f;
+        size_t i;
+        int rc, line, failed = 0;
+
+        for (i = 0; i < sizeof(portCases) / sizeof(portCases[0]); i++) {
+                line = 0;
+                config_init(&cfg);
+                rc = config_parse(&cfg, portCases[i].text, strlen(portCases[i].text), NULL, &line);
+                if (rc == 0)
+                        rc = config_finish(&cfg);
+                if (rc != 0 || cfg.port != portCases[i].port) {
+                        fprintf(stderr, "config_parse: port %d instead of %d (rc %d) for \"%s\"\n",
+                                cfg.port, portCases[i].port, rc, portCases[i].text);
+                        failed++;
+                }
+                config_release(&cfg);
+
+                if ((f = fopen(path, "w")) == NULL)
+                        return 1;
+                fputs(portCases[i].text, f);
+                fclose(f);
+                config_init(&cfg);
+                rc = get_config((char *)path, &cfg);
+                if (rc != 0 || cfg.port != portCases[i].port) {
+                        fprintf(stderr, "get_config: port %d instead of %d (rc %d) for \"%s\"\n",
+                                cfg.port, portCases[i].port, rc, portCases[i].text);
+                        failed++;
+                }
+                config_release(&cfg);
+        }
+        return failed;
+}
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+//Runs one parser opt.iterations times, returns ns per configuration
+static double run(tb_builder *tb, const char *name, const char *path, int mode)
+{
+        iotf_alloc_stats before, after;
+        legacy_config legacy;
+        Config cfg;
+        double start, ns;
+        int i, rc = 0;
+
+        iotf_alloc_get_stats(&before, 0);
+        start = now_s();
+        for (i = 0; i < opt.iterations && rc == 0; i++) {
+                if (mode == 0) {
+                        FILE *f = fopen(path, "r");
+
+                        if (f == NULL)
+                                return -1.0;
+                        memset(&legacy, 0, sizeof(legacy));
+                        rc = legacy_parse(f, &legacy);
+                        fclose(f);
+                        legacy_free(&legacy);
+                }
+                else if (mode == 1) {
+                        config_init(&cfg);
+                        rc = get_config((char *)path, &cfg);
+                        config_release(&cfg);
+                }
+                else {
+                        int line = 0;
+
+                        config_init(&cfg);
+                        rc = config_parse(&cfg, configText, sizeof(configText) - 1, NULL, &line);
+                        if (rc == 0)
+                                rc = config_finish(&cfg);
+                        config_release(&cfg);
+                }
+        }
+        ns = (now_s() - start) * 1e9 / opt.iterations;
+        iotf_alloc_get_stats(&after, 0);
+        if (rc != 0) {
+                fprintf(stderr, "%s: parse failed (%d)\n", name, rc);
+                return -1.0;
+        }
+
+        tb_begin_obj(tb, name);
+        tb_add_i32(tb, "ns_per_config", (int32_t)ns);
+        tb_add_fixed(tb, "allocations_per_config",
+                     (int32_t)((after.allocations - before.allocations) * 100ULL / (uint64_t)opt.iterations), 2);
+        tb_end_obj(tb);
+        fprintf(stderr, "%-12s %8.0f ns per config, %u allocations per config\n", name, ns,
+                (after.allocations - before.allocations) / (uint32_t)opt.iterations);
+        return ns;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -n count    configurations parsed by each parser (20000)\n"
+                "  -o file     JSON output, stdout if omitted\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[2048];
+        char path[64];
+        tb_builder tb;
+        FILE *out = stdout, *f;
+        double legacy, file, memory;
+        int c, len;
+
+        while ((c = getopt(argc, argv, "n:o:")) != -1) {
+                switch (c) {
+                case 'n': opt.iterations = atoi(optarg); break;
+                case 'o': opt.output = optarg; break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.iterations <= 0) {
+                usage(argv[0]);
+                return 2;
+        }
+
+        snprintf(path, sizeof(path), "/tmp/iotf_config_bench_%d.cfg", (int)getpid());
+        disableLogging();
+        if (check_ports(path) != 0) {
+                unlink(path);
+                return 1;
+        }
+        if ((f = fopen(path, "w")) == NULL) {
+                perror(path);
+                return 1;
+        }
+        fputs(configText, f);
+        fclose(f);
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_i32(&tb, "iterations", opt.iterations);
+        tb_add_i32(&tb, "file_bytes", (int32_t)(sizeof(configText) - 1));
+        tb_end_obj(&tb);
+        legacy = run(&tb, "line_by_line", path, 0);
+        file = run(&tb, "get_config", path, 1);
+        memory = run(&tb, "config_parse", path, 2);
+        unlink(path);
+        if (legacy < 0 || file < 0 || memory < 0)
+                return 1;
+        tb_add_fixed(&tb, "file_speedup", (int32_t)(legacy * 100.0 / file), 2);
+        if ((len = tb_end(&tb)) < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}
@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Fleet reconnect simulation, legacy ladder against jittered backoff
+ *******************************************************************************/
+
+/*
+ * Every device loses the broker at t=0. Until the outage ends each attempt is refused,
+ * afterwards the broker completes at most `capacity` handshakes per second and refuses
+ * the rest. The simulation runs on virtual time and calls the library's own
+ * reconnect_delay and backoff_next, so it measures the policies as shipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "iotf_utils.h"
+#include "iotf_backoff.h"
+#include "iotf_telemetry.h"
+
+typedef struct
+{
+        uint64_t t;
+        uint32_t dev;
+} event;
+
+typedef struct
+{
+        iotf_backoff backoff;
+        int retry;
+        uint32_t attempts;
+} device;
+
+static struct
+{
+        uint32_t devices;
+        uint32_t capacity;
+        uint32_t outageMs;
+        uint32_t horizonMs;
+        uint32_t baseMs;
+        uint32_t capMs;
+        uint32_t seed;
+        const char *output;
+} opt = { 10000, 1000, 30000, 3600000, BACKOFF_BASE_MS, BACKOFF_CAP_MS, 1, NULL };
+
+static event *heap;
+static uint32_t heapLen;
+
+static void heap_push(uint64_t t, uint32_t dev)
+{
+        uint32_t i = heapLen++;
+
+        while (i > 0 && heap[(i - 1) / 2].t > t) {
+                heap[i] = heap[(i - 1) / 2];
+                i = (i - 1) / 2;
+        }
+        heap[i].t = t;
+        heap[i].dev = dev;
+}
+
+static event heap_pop(void)
+{
+        event top = heap[0];
+        event last = heap[--heapLen];
+        uint32_t i = 0, c;
+
+        while ((c = 2 * i + 1) < heapLen) {
+                if (c + 1 < heapLen && heap[c + 1].t < heap[c].t)
+                        c++;
+                if (heap[c].t >= last.t)
+                        break;
+                heap[i] = heap[c];
+                i = c;
+        }
+        heap[i] = last;
+        return top;
+}
+
+//Delay before the next attempt of a device, legacy ladder or jittered backoff
+static uint64_t next_delay(device *d, int jitter)
+{
+        if (jitter)
+                return backoff_next(&d->backoff);
+        return (uint64_t)reconnect_delay(d->retry++) * 1000U;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+        return (x > y) - (x < y);
+}
+
+static void simulate(tb_builder *tb, const char *name, int jitter)
+{
+        uint32_t seconds = opt.horizonMs / 1000U + 1U;
+        uint32_t *accepted = calloc(seconds, sizeof(uint32_t));
+        uint32_t *attempts = calloc(seconds, sizeof(uint32_t));
+        uint64_t *connectedAt = malloc(opt.devices * sizeof(uint64_t));
+        device *dev = calloc(opt.devices, sizeof(device));
+        uint64_t total = 0;
+        uint32_t connected = 0, peak = 0, peakSecond = 0, maxAttempts = 0, i;
+
+        heap = malloc(opt.devices * sizeof(event));
+        heapLen = 0;
+        if (accepted == NULL || attempts == NULL || connectedAt == NULL || dev == NULL || heap == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+        }
+
+        //Legacy retry_connection tries at once, the jittered one waits before the first attempt too
+        for (i = 0; i < opt.devices; i++) {
+                dev[i].retry = 1;
+                backoff_init(&dev[i].backoff, opt.baseMs, opt.capMs, opt.seed * 2654435761U + i * 40503U + 1U);
+                heap_push(jitter ? next_delay(&dev[i], 1) : 0U, i);
+        }
+
+        while (heapLen > 0) {
+                event e = heap_pop();
+                uint32_t second = (uint32_t)(e.t / 1000U);
+                device *d = &dev[e.dev];
+
+                if (e.t > opt.horizonMs)
+                        break;
+                d->attempts++;
+                total++;
+                attempts[second]++;
+                if (e.t >= opt.outageMs && accepted[second] < opt.capacity) {
+                        accepted[second]++;
+                        connectedAt[connected++] = e.t;
+                        if (d->attempts > maxAttempts)
+                                maxAttempts = d->attempts;
+                        continue;
+                }
+                heap_push(e.t + next_delay(d, jitter), e.dev);
+        }
+
+        //The storm that matters is the one the broker sees once it is back
+        for (i = opt.outageMs / 1000U; i < seconds; i++) {
+                if (attempts[i] > peak) {
+                        peak = attempts[i];
+                        peakSecond = i;
+                }
+        }
+        qsort(connectedAt, connected, sizeof(uint64_t), cmp_u64);
+
+        tb_begin_obj(tb, name);
+        tb_add_i64(tb, "attempts", (int64_t)total);
+        tb_add_u32(tb, "peak_attempts_per_s_after_outage", peak);
+        tb_add_u32(tb, "peak_second", peakSecond);
+        tb_add_fixed(tb, "wasted_per_device", (int32_t)((total - connected) * 100U / opt.devices), 2);
+        tb_add_u32(tb, "max_attempts_per_device", maxAttempts);
+        tb_add_u32(tb, "connected", connected);
+        if (connected > 0) {
+                tb_add_i64(tb, "p50_connected_ms", (int64_t)connectedAt[(connected - 1) / 2]);
+                tb_add_i64(tb, "p99_connected_ms", (int64_t)connectedAt[(uint64_t)(connected - 1) * 99U / 100U]);
+                tb_add_i64(tb, "all_connected_ms", (int64_t)connectedAt[connected - 1]);
+        }
+        //Attempts per second for the two minutes after the outage, shows whether they come in waves
+        tb_begin_array(tb, "attempts_per_s");
+        for (i = opt.outageMs / 1000U; i < seconds && i < opt.outageMs / 1000U + 120U; i++)
+                tb_add_u32(tb, NULL, attempts[i]);
+        tb_end_array(tb);
+        tb_end_obj(tb);
+
+        free(accepted);
+        free(attempts);
+        free(connectedAt);
+        free(dev);
+        free(heap);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -n count    devices (10000)\n"
+                "  -c rate     handshakes the broker completes per second (1000)\n"
+                "  -t ms       outage length (30000)\n"
+                "  -H ms       simulated time (3600000)\n"
+                "  -b ms       backoff base window (%u)\n"
+                "  -m ms       backoff cap (%u)\n"
+                "  -s seed     fleet seed (1)\n"
+                "  -o file     write the JSON result to file instead of stdout\n",
+                prog, BACKOFF_BASE_MS, BACKOFF_CAP_MS);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[8192];
+        tb_builder tb;
+        FILE *out = stdout;
+        int c, len;
+
+        while ((c = getopt(argc, argv, "n:c:t:H:b:m:s:o:")) != -1) {
+                switch (c) {
+                case 'n': opt.devices = strtoul(optarg, NULL, 0); break;
+                case 'c': opt.capacity = strtoul(optarg, NULL, 0); break;
+                case 't': opt.outageMs = strtoul(optarg, NULL, 0); break;
+                case 'H': opt.horizonMs = strtoul(optarg, NULL, 0); break;
+                case 'b': opt.baseMs = strtoul(optarg, NULL, 0); break;
+                case 'm': opt.capMs = strtoul(optarg, NULL, 0); break;
+                case 's': opt.seed = strtoul(optarg, NULL, 0); break;
+                case 'o': opt.output = optarg; break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.devices == 0 || opt.outageMs > opt.horizonMs) {
+                usage(argv[0]);
+                return 2;
+        }
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_u32(&tb, "devices", opt.devices);
+        tb_add_u32(&tb, "capacity_per_s", opt.capacity);
+        tb_add_u32(&tb, "outage_ms", opt.outageMs);
+        tb_add_u32(&tb, "base_ms", opt.baseMs);
+        tb_add_u32(&tb, "cap_ms", opt.capMs);
+        tb_end_obj(&tb);
+        simulate(&tb, "ladder", 0);
+        simulate(&tb, "jitter", 1);
+        if ((len = tb_end(&tb)) < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}
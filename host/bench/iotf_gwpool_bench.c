@@ -0,0 +1,234 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Gateway pool throughput against the number of connections
+ *******************************************************************************/
+
+/*
+ * Publishes child device events through a gateway pool of 1, 2, 4, ... connections
+ * over TLS to the in-process broker stand-in and reports the aggregate rate. The
+ * broker delay makes every QoS1 publish wait one round-trip, which is what a single
+ * gateway connection is limited by in the field.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "iotf_gateway_pool.h"
+#include "iotf_telemetry.h"
+#include "iotf_broker.h"
+
+static struct
+{
+        const char *certDir;
+        int delayMs;
+        int events;
+        int devices;
+        int qos;
+        int size;
+        int maxConnections;
+        const char *output;
+} opt = { NULL, 2, 5000, 1000, 1, 64, GWPOOL_MAX_CONNECTIONS, NULL };
+
+static gwpool pool;
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int write_config(const char *path, int index, const char *caFile, int port)
+{
+        FILE *f = fopen(path, "w");
+
+        if (f == NULL)
+                return -1;
+        fprintf(f, "org=bench\ndomain=internetofthings.ibmcloud.com\ntype=benchgw\nid=gw%d\n"
+                   "auth-method=token\nauth-token=benchtoken\nserverCertPath=%s\n"
+                   "host=127.0.0.1\nport=%d\n", index, caFile, port);
+        fclose(f);
+        return 0;
+}
+
+//Runs one round with the given number of connections, returns events per second or -1
+static double run(tb_builder *tb, int connections, const char *caFile, int port)
+{
+        char path[64], deviceId[16], payload[1024];
+        uint32_t share[GWPOOL_MAX_CONNECTIONS] = {0};
+        uint32_t done;
+        double start, elapsed;
+        int i, up, sent = 0;
+
+        memset(payload, 'x', sizeof(payload));
+        gwpool_init(&pool);
+        for (i = 0; i < connections; i++) {
+                snprintf(path, sizeof(path), "/tmp/iotf_gwpool_%d_%d.cfg", (int)getpid(), i);
+                if (write_config(path, i, caFile, port) != 0 || gwpool_add(&pool, path) < 0) {
+                        fprintf(stderr, "cannot add connection %d\n", i);
+                        return -1;
+                }
+                unlink(path);
+                setReconnectPolicy(gwpool_client(&pool, i), 50, 1000);
+        }
+        disableLogging();
+        if (gwpool_start(&pool) != SUCCESS) {
+                fprintf(stderr, "cannot start the workers\n");
+                gwpool_stop(&pool);
+                return -1;
+        }
+
+        for (start = now_s(), up = 0; up < connections && now_s() - start < 10.0; osDelay(10))
+                for (i = 0, up = 0; i < connections; i++)
+                        up += pool.conn[i].up;
+        if (up < connections) {
+                fprintf(stderr, "only %d of %d connections came up\n", up, connections);
+                gwpool_stop(&pool);
+                return -1;
+        }
+        for (i = 0; i < opt.devices; i++) {
+                snprintf(deviceId, sizeof(deviceId), "dev%d", i);
+                share[gwpool_owner(&pool, "benchdev", deviceId)]++;
+        }
+
+        start = now_s();
+        while (sent < opt.events) {
+                snprintf(deviceId, sizeof(deviceId), "dev%d", sent % opt.devices);
+                if (gwpool_publish(&pool, "benchdev", deviceId, "status", "json", payload,
+                                   (size_t)opt.size, (enum QoS)opt.qos) == SUCCESS)
+                        sent++;
+                else
+                        osThreadYield();
+        }
+        for (;;) {
+                for (i = 0, done = pool.dropped; i < connections; i++)
+                        done += __atomic_load_n(&pool.conn[i].published, __ATOMIC_RELAXED);
+                if (done >= (uint32_t)opt.events)
+                        break;
+                osDelay(1);
+        }
+        elapsed = now_s() - start;
+
+        tb_begin_obj(tb, NULL);
+        tb_add_i32(tb, "connections", connections);
+        tb_add_i32(tb, "events_per_s", (int32_t)(opt.events / elapsed));
+        tb_add_u32(tb, "dropped", pool.dropped);
+        tb_begin_array(tb, "devices_per_connection");
+        for (i = 0; i < connections; i++)
+                tb_add_u32(tb, NULL, share[i]);
+        tb_end_array(tb);
+        tb_begin_array(tb, "events_per_connection");
+        for (i = 0; i < connections; i++)
+                tb_add_u32(tb, NULL, pool.conn[i].published);
+        tb_end_array(tb);
+        tb_end_obj(tb);
+
+        gwpool_stop(&pool);
+        return opt.events / elapsed;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s -K certdir [options]\n"
+                "  -K dir      ca.pem, server.pem and server.key from gen_test_certs.sh\n"
+                "  -D ms       broker delay, half of the simulated round-trip (2)\n"
+                "  -n count    events per round (5000)\n"
+                "  -d count    child devices (1000)\n"
+                "  -q qos      QoS of the events (1)\n"
+                "  -s bytes    payload size (64)\n"
+                "  -C count    largest pool, rounds double from 1 (%d)\n"
+                "  -o file     JSON output, stdout if omitted\n", prog, GWPOOL_MAX_CONNECTIONS);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[8192];
+        char caPath[256], certPath[256], keyPath[256];
+        iotf_broker_config cfg = { 0, 0, NULL, NULL, 0, 0, 0, 0, 0, 0, 0 };
+        iotf_broker *broker;
+        tb_builder tb;
+        FILE *out = stdout;
+        double base = 0.0, rate;
+        int c, n, len;
+
+        while ((c = getopt(argc, argv, "K:D:n:d:q:s:C:o:")) != -1) {
+                switch (c) {
+                case 'K': opt.certDir = optarg; break;
+                case 'D': opt.delayMs = atoi(optarg); break;
+                case 'n': opt.events = atoi(optarg); break;
+                case 'd': opt.devices = atoi(optarg); break;
+                case 'q': opt.qos = atoi(optarg); break;
+                case 's': opt.size = atoi(optarg); break;
+                case 'C': opt.maxConnections = atoi(optarg); break;
+                case 'o': opt.output = optarg; break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.certDir == NULL || opt.events <= 0 || opt.devices <= 0 || opt.qos < 0 || opt.qos > 2 ||
+            opt.size < 0 || opt.size > BUFFER_SIZE / 2 || opt.maxConnections < 1 ||
+            opt.maxConnections > GWPOOL_MAX_CONNECTIONS) {
+                usage(argv[0]);
+                return 2;
+        }
+
+        snprintf(caPath, sizeof(caPath), "%s/ca.pem", opt.certDir);
+        snprintf(certPath, sizeof(certPath), "%s/server.pem", opt.certDir);
+        snprintf(keyPath, sizeof(keyPath), "%s/server.key", opt.certDir);
+        cfg.certFile = certPath;
+        cfg.keyFile = keyPath;
+        cfg.delayMs = (unsigned int)opt.delayMs;
+        if ((broker = iotf_broker_start(&cfg)) == NULL) {
+                fprintf(stderr, "cannot start broker stand-in\n");
+                return 1;
+        }
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_i32(&tb, "delay_ms", opt.delayMs);
+        tb_add_i32(&tb, "events", opt.events);
+        tb_add_i32(&tb, "devices", opt.devices);
+        tb_add_i32(&tb, "qos", opt.qos);
+        tb_add_i32(&tb, "payload_bytes", opt.size);
+        tb_add_i32(&tb, "cpus", (int32_t)sysconf(_SC_NPROCESSORS_ONLN));
+        tb_end_obj(&tb);
+        tb_begin_array(&tb, "rounds");
+        for (n = 1; n <= opt.maxConnections; n *= 2) {
+                if ((rate = run(&tb, n, caPath, iotf_broker_port(broker, 1))) < 0)
+                        break;
+                if (n == 1)
+                        base = rate;
+                fprintf(stderr, "%d connection(s): %.0f events/s, %.2fx\n", n, rate, rate / base);
+        }
+        tb_end_array(&tb);
+        iotf_broker_stop(broker);
+        if ((len = tb_end(&tb)) < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}
@@ -0,0 +1,634 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Handshake time and heap of one mbedTLS configuration profile
+ *******************************************************************************/
+
+/*
+ * Built once per IOTF_MBEDTLS_PROFILE against mbedTLS compiled with the pack's
+ * mbedTLS_config.h. Runs full TLS 1.2 handshakes between a client configured as
+ * tls_connect does and a server in the same thread, connected by memory pipes, and
+ * times the client's handshake steps and counts its heap and the bytes exchanged.
+ * It does so with the default client and with the one setFastHandshake asks for,
+ * a single cipher suite and a pinned server certificate. The round trips each
+ * handshake waits for give its connect time at a given RTT. Then measures the
+ * primitives an accelerator would replace: AES-GCM, SHA-256, ECDSA and ECDH.
+ * With PSK cipher suites built in it also measures a client with a pre-shared key, and
+ * built with IOTF_MBEDTLS_PSK_ONLY that client is the only one.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/random.h>
+#include "mbedtls/build_info.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/ecdh.h"
+#include "iotf_telemetry.h"
+
+#if defined(IOTF_MBEDTLS_PSK_ONLY)
+#define PROFILE_NAME    "psk_only"
+#elif defined(IOTF_MBEDTLS_ECDSA_ONLY)
+#define PROFILE_NAME    "ecdsa_only"
+#elif IOTF_MBEDTLS_PROFILE == IOTF_MBEDTLS_PROFILE_MIN_RAM
+#define PROFILE_NAME    "min_ram"
+#elif IOTF_MBEDTLS_PROFILE == IOTF_MBEDTLS_PROFILE_BALANCED
+#define PROFILE_NAME    "balanced"
+#else
+#define PROFILE_NAME    "max_speed"
+#endif
+
+#define PIPE_SIZE       16384
+#define SERVER_NAME     "bench.messaging.internetofthings.ibmcloud.com"
+
+static struct
+{
+        const char *certDir;
+        int handshakes;
+        int ops;
+        int rttMs;
+        const char *output;
+} opt = { NULL, 50, 200, 100, NULL };
+
+/*
+ * Heap accounting. The bench is linked with --wrap for calloc and free, which is all
+ * mbedTLS allocates with. Only the client side is counted.
+ */
+void *__real_calloc(size_t n, size_t size);
+void __real_free(void *ptr);
+
+static int counting;
+static size_t heapCurrent;
+static size_t heapPeak;
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+        void *ptr = __real_calloc(n, size);
+
+        if (ptr != NULL && counting) {
+                heapCurrent += malloc_usable_size(ptr);
+                if (heapCurrent > heapPeak)
+                        heapPeak = heapCurrent;
+        }
+        return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+        if (ptr != NULL && counting)
+                heapCurrent -= malloc_usable_size(ptr);
+        __real_free(ptr);
+}
+
+//Entropy source of MBEDTLS_ENTROPY_HARDWARE_ALT
+int mbedtls_hardware_poll(void *data, unsigned char *output, size_t len, size_t *olen)
+{
+        ssize_t n = getrandom(output, len, 0);
+
+        (void)data;
+        if (n < 0)
+                return -1;
+        *olen = (size_t)n;
+        return 0;
+}
+
+typedef struct
+{
+        unsigned char buf[PIPE_SIZE];
+        size_t len;
+        size_t total;           //bytes sent through the pipe
+} pipe_buf;
+
+//One side of the connection, the BIO context of its mbedtls_ssl_context
+typedef struct
+{
+        pipe_buf *tx;
+        pipe_buf *rx;
+} pipe_end;
+
+static int pipe_send(void *ctx, const unsigned char *buf, size_t len)
+{
+        pipe_buf *p = ((pipe_end *)ctx)->tx;
+
+        if (len > PIPE_SIZE - p->len)
+                len = PIPE_SIZE - p->len;
+        if (len == 0)
+                return MBEDTLS_ERR_SSL_WANT_WRITE;
+        memcpy(p->buf + p->len, buf, len);
+        p->len += len;
+        p->total += len;
+        return (int)len;
+}
+
+static int pipe_recv(void *ctx, unsigned char *buf, size_t len)
+{
+        pipe_buf *p = ((pipe_end *)ctx)->rx;
+
+        if (p->len == 0)
+                return MBEDTLS_ERR_SSL_WANT_READ;
+        if (len > p->len)
+                len = p->len;
+        memcpy(buf, p->buf, len);
+        memmove(p->buf, p->buf + len, p->len - len);
+        p->len -= len;
+        return (int)len;
+}
+
+typedef struct
+{
+        double *v;
+        int n;
+} samples;
+
+static int cmp_double(const void *a, const void *b)
+{
+        double x = *(const double *)a, y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+static double samples_pct(samples *s, double pct)
+{
+        if (s->n == 0)
+                return 0;
+        qsort(s->v, s->n, sizeof(double), cmp_double);
+        return s->v[(int)(pct / 100.0 * (s->n - 1) + 0.5)];
+}
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static mbedtls_entropy_context entropy;
+static mbedtls_ctr_drbg_context drbg;
+static mbedtls_ssl_config srvConf;
+static pipe_buf toServer, toClient;
+static pipe_end cliEnd = { &toServer, &toClient };
+static pipe_end srvEnd = { &toClient, &toServer };
+
+enum { CLIENT_CA, CLIENT_FAST, CLIENT_PSK };
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+static mbedtls_x509_crt cacert, noCa, srvcert;
+static mbedtls_pk_context srvkey;
+static mbedtls_ssl_config cliConf, fastConf;
+static unsigned char pin[32];
+
+//As tls_connect with restrictSuites and pServerCertPin set
+static const int fastSuites[] = { MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 0 };
+static const uint16_t fastGroups[] = { MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1, MBEDTLS_SSL_IANA_TLS_GROUP_NONE };
+
+static int verify_pin(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+        unsigned char hash[32];
+
+        if (depth > 0)
+                *flags = 0;
+        else if (mbedtls_sha256(crt->raw.p, crt->raw.len, hash, 0) == 0 && memcmp(hash, ctx, sizeof(hash)) == 0)
+                *flags = 0;
+        else
+                *flags |= MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        return 0;
+}
+#endif
+
+#if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+static mbedtls_ssl_config pskConf;
+static const unsigned char psk[] = "iotf_tls_bench pre-shared key 01";
+static const char pskIdentity[] = "bench";
+
+//As tls_connect with pPsk set
+static const int pskSuites[] = {
+        MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256, 0 };
+#endif
+
+//As tls_connect configures the device side
+static int setup_client(mbedtls_ssl_config *conf, int mode)
+{
+        int rc;
+
+        if ((rc = mbedtls_ssl_config_defaults(conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+                return rc;
+        mbedtls_ssl_conf_max_version(conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        mbedtls_ssl_conf_min_version(conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_rng(conf, mbedtls_ctr_drbg_random, &drbg);
+        switch (mode) {
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        case CLIENT_CA:
+                mbedtls_ssl_conf_ca_chain(conf, &cacert, NULL);
+                break;
+        case CLIENT_FAST:
+                mbedtls_ssl_conf_ca_chain(conf, &noCa, NULL);
+                mbedtls_ssl_conf_verify(conf, verify_pin, pin);
+                mbedtls_ssl_conf_ciphersuites(conf, fastSuites);
+                mbedtls_ssl_conf_groups(conf, fastGroups);
+                break;
+#endif
+#if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+        case CLIENT_PSK:
+                if ((rc = mbedtls_ssl_conf_psk(conf, psk, sizeof(psk) - 1, (const unsigned char *)pskIdentity,
+                                               sizeof(pskIdentity) - 1)) != 0)
+                        return rc;
+                mbedtls_ssl_conf_ciphersuites(conf, pskSuites);
+                break;
+#endif
+        default:
+                return -1;
+        }
+        return 0;
+}
+
+static int setup_configs(void)
+{
+        int rc;
+
+        mbedtls_ssl_config_init(&srvConf);
+        if ((rc = mbedtls_ssl_config_defaults(&srvConf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+                return rc;
+        mbedtls_ssl_conf_rng(&srvConf, mbedtls_ctr_drbg_random, &drbg);
+
+#if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+        mbedtls_ssl_config_init(&pskConf);
+        if ((rc = setup_client(&pskConf, CLIENT_PSK)) != 0 ||
+            (rc = mbedtls_ssl_conf_psk(&srvConf, psk, sizeof(psk) - 1, (const unsigned char *)pskIdentity,
+                                       sizeof(pskIdentity) - 1)) != 0)
+                return rc;
+#endif
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        char path[256];
+
+        mbedtls_x509_crt_init(&cacert);
+        mbedtls_x509_crt_init(&noCa);
+        mbedtls_x509_crt_init(&srvcert);
+        mbedtls_pk_init(&srvkey);
+        mbedtls_ssl_config_init(&cliConf);
+        mbedtls_ssl_config_init(&fastConf);
+
+        snprintf(path, sizeof(path), "%s/ca.pem", opt.certDir);
+        if ((rc = mbedtls_x509_crt_parse_file(&cacert, path)) != 0)
+                return rc;
+        snprintf(path, sizeof(path), "%s/server.pem", opt.certDir);
+        if ((rc = mbedtls_x509_crt_parse_file(&srvcert, path)) != 0)
+                return rc;
+        snprintf(path, sizeof(path), "%s/server.key", opt.certDir);
+        if ((rc = mbedtls_pk_parse_keyfile(&srvkey, path, NULL, mbedtls_ctr_drbg_random, &drbg)) != 0)
+                return rc;
+        if ((rc = mbedtls_sha256(srvcert.raw.p, srvcert.raw.len, pin, 0)) != 0 ||
+            (rc = setup_client(&cliConf, CLIENT_CA)) != 0 || (rc = setup_client(&fastConf, CLIENT_FAST)) != 0)
+                return rc;
+        rc = mbedtls_ssl_conf_own_cert(&srvConf, &srvcert, &srvkey);
+#endif
+        return rc;
+}
+
+typedef struct
+{
+        double clientMs;
+        double serverMs;
+        size_t setupHeap;       //client heap after mbedtls_ssl_setup
+        size_t peakHeap;
+        size_t connectedHeap;
+        size_t helloBytes;      //the client's first flight
+        size_t clientBytes;
+        size_t serverBytes;
+        int roundTrips;         //flights the client sent and then waited for an answer to
+        char suite[64];
+} hs_result;
+
+//Runs one handshake of a client with the given configuration, returns 0 or the mbedTLS error of either side
+static int handshake(const mbedtls_ssl_config *conf, hs_result *r)
+{
+        mbedtls_ssl_context cli, srv;
+        int cliDone = 0, srvDone = 0, rc = 0, steps = 0;
+        size_t waitedAt = 0;
+        double start, cliTime = 0.0, srvTime = 0.0;
+
+        toServer.len = toClient.len = 0;
+        toServer.total = toClient.total = 0;
+        heapCurrent = heapPeak = 0;
+        counting = 1;
+        mbedtls_ssl_init(&cli);
+        rc = mbedtls_ssl_setup(&cli, conf);
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        if (rc == 0)
+                rc = mbedtls_ssl_set_hostname(&cli, SERVER_NAME);
+#endif
+        mbedtls_ssl_set_bio(&cli, &cliEnd, pipe_send, pipe_recv, NULL);
+        r->setupHeap = heapCurrent;
+        counting = 0;
+
+        mbedtls_ssl_init(&srv);
+        if (rc == 0)
+                rc = mbedtls_ssl_setup(&srv, &srvConf);
+        mbedtls_ssl_set_bio(&srv, &srvEnd, pipe_send, pipe_recv, NULL);
+
+        while (rc == 0 && (!cliDone || !srvDone) && steps++ < 1000) {
+                if (!cliDone) {
+                        start = now_s();
+                        counting = 1;
+                        rc = mbedtls_ssl_handshake(&cli);
+                        counting = 0;
+                        cliTime += now_s() - start;
+                        if (steps == 1)
+                                r->helloBytes = toServer.total;
+                        if (rc == 0)
+                                cliDone = 1;
+                        else if (rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE)
+                                break;
+                        else if (toServer.total > waitedAt) {
+                                r->roundTrips++;
+                                waitedAt = toServer.total;
+                        }
+                }
+                if (!srvDone) {
+                        start = now_s();
+                        rc = mbedtls_ssl_handshake(&srv);
+                        srvTime += now_s() - start;
+                        if (rc == 0)
+                                srvDone = 1;
+                        else if (rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE)
+                                break;
+                }
+                rc = 0;
+        }
+        if (rc == 0 && (!cliDone || !srvDone))
+                rc = -1;
+
+        r->peakHeap = heapPeak;
+        r->connectedHeap = heapCurrent;
+        r->clientMs = cliTime * 1e3;
+        r->serverMs = srvTime * 1e3;
+        r->clientBytes = toServer.total;
+        r->serverBytes = toClient.total;
+        if (rc == 0)
+                snprintf(r->suite, sizeof(r->suite), "%s", mbedtls_ssl_get_ciphersuite(&cli));
+        counting = 1;
+        mbedtls_ssl_free(&cli);
+        counting = 0;
+        mbedtls_ssl_free(&srv);
+        return rc;
+}
+
+static int bench_handshakes(tb_builder *tb, const char *key, const mbedtls_ssl_config *conf)
+{
+        samples cli, srv;
+        hs_result r, max;
+        int i, rc = 0;
+        double atRtt;
+
+        cli.v = calloc((size_t)opt.handshakes, sizeof(double));
+        srv.v = calloc((size_t)opt.handshakes, sizeof(double));
+        cli.n = srv.n = 0;
+        if (cli.v == NULL || srv.v == NULL)
+                return -1;
+        memset(&max, 0, sizeof(max));
+        for (i = 0; i < opt.handshakes && rc == 0; i++) {
+                memset(&r, 0, sizeof(r));
+                if ((rc = handshake(conf, &r)) != 0)
+                        break;
+                cli.v[i] = r.clientMs;
+                srv.v[i] = r.serverMs;
+                cli.n = srv.n = i + 1;
+                if (r.setupHeap > max.setupHeap)
+                        max.setupHeap = r.setupHeap;
+                if (r.peakHeap > max.peakHeap)
+                        max.peakHeap = r.peakHeap;
+                if (r.connectedHeap > max.connectedHeap)
+                        max.connectedHeap = r.connectedHeap;
+        }
+        if (rc != 0)
+                fprintf(stderr, "%s failed: -0x%04x\n", key, (unsigned int)-rc);
+        else {
+                //TCP connect, then the handshake round trips
+                atRtt = samples_pct(&cli, 50) + samples_pct(&srv, 50) + (double)((1 + r.roundTrips) * opt.rttMs);
+                tb_begin_obj(tb, key);
+                tb_add_str(tb, "ciphersuite", r.suite);
+                tb_add_i32(tb, "n", cli.n);
+                tb_add_double(tb, "client_p50_ms", samples_pct(&cli, 50), 3);
+                tb_add_double(tb, "client_p99_ms", samples_pct(&cli, 99), 3);
+                tb_add_double(tb, "server_p50_ms", samples_pct(&srv, 50), 3);
+                tb_add_u32(tb, "client_hello_bytes", (uint32_t)r.helloBytes);
+                tb_add_u32(tb, "client_bytes", (uint32_t)r.clientBytes);
+                tb_add_u32(tb, "server_bytes", (uint32_t)r.serverBytes);
+                tb_add_i32(tb, "round_trips", r.roundTrips);
+                tb_add_double(tb, "connect_ms_at_rtt", atRtt, 1);
+                tb_add_u32(tb, "client_heap_setup", (uint32_t)max.setupHeap);
+                tb_add_u32(tb, "client_heap_high_water", (uint32_t)max.peakHeap);
+                tb_add_u32(tb, "client_heap_connected", (uint32_t)max.connectedHeap);
+                tb_end_obj(tb);
+                fprintf(stderr, "%-10s %-16s %.2f ms (p50, client), %d round trips, heap %u bytes peak, %u connected\n",
+                        PROFILE_NAME, key, samples_pct(&cli, 50), r.roundTrips, (unsigned int)max.peakHeap,
+                        (unsigned int)max.connectedHeap);
+        }
+        free(cli.v);
+        free(srv.v);
+        return rc;
+}
+
+//Throughput of the primitives an accelerator replaces
+static int bench_primitives(tb_builder *tb)
+{
+        static unsigned char data[1024], out[1024];
+        unsigned char key[16] = { 0 }, iv[12] = { 0 }, tag[16], hash[32];
+        mbedtls_gcm_context gcm;
+        mbedtls_ecp_group grp;
+        mbedtls_ecp_point q, peer;
+        mbedtls_mpi d, peerD, z;
+        double start, gcmMBs, shaMBs, ecdhPerS;
+        int i, rc;
+        const int blocks = 4096;
+
+        mbedtls_gcm_init(&gcm);
+        if ((rc = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128)) != 0)
+                return rc;
+        start = now_s();
+        for (i = 0; i < blocks && rc == 0; i++)
+                rc = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, sizeof(data), iv, sizeof(iv), NULL, 0,
+                                               data, out, sizeof(tag), tag);
+        gcmMBs = blocks * sizeof(data) / 1e6 / (now_s() - start);
+        mbedtls_gcm_free(&gcm);
+
+        start = now_s();
+        for (i = 0; i < blocks && rc == 0; i++)
+                rc = mbedtls_sha256(data, sizeof(data), hash, 0);
+        shaMBs = blocks * sizeof(data) / 1e6 / (now_s() - start);
+        if (rc != 0)
+                return rc;
+
+#if defined(MBEDTLS_ECDSA_C)
+        unsigned char sig[MBEDTLS_ECDSA_MAX_LEN];
+        mbedtls_ecdsa_context ecdsa;
+        size_t sigLen;
+        double signPerS, verifyPerS;
+
+        mbedtls_ecdsa_init(&ecdsa);
+        if ((rc = mbedtls_ecdsa_genkey(&ecdsa, MBEDTLS_ECP_DP_SECP256R1, mbedtls_ctr_drbg_random, &drbg)) != 0)
+                return rc;
+        start = now_s();
+        for (i = 0; i < opt.ops && rc == 0; i++)
+                rc = mbedtls_ecdsa_write_signature(&ecdsa, MBEDTLS_MD_SHA256, hash, sizeof(hash), sig, sizeof(sig),
+                                                   &sigLen, mbedtls_ctr_drbg_random, &drbg);
+        signPerS = opt.ops / (now_s() - start);
+        start = now_s();
+        for (i = 0; i < opt.ops && rc == 0; i++)
+                rc = mbedtls_ecdsa_read_signature(&ecdsa, hash, sizeof(hash), sig, sigLen);
+        verifyPerS = opt.ops / (now_s() - start);
+        mbedtls_ecdsa_free(&ecdsa);
+        if (rc != 0)
+                return rc;
+#endif
+
+        //One ECDHE exchange of the client: a key pair and the shared secret
+        mbedtls_ecp_group_init(&grp);
+        mbedtls_ecp_point_init(&q);
+        mbedtls_ecp_point_init(&peer);
+        mbedtls_mpi_init(&d);
+        mbedtls_mpi_init(&peerD);
+        mbedtls_mpi_init(&z);
+        if ((rc = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1)) == 0)
+                rc = mbedtls_ecdh_gen_public(&grp, &peerD, &peer, mbedtls_ctr_drbg_random, &drbg);
+        start = now_s();
+        for (i = 0; i < opt.ops && rc == 0; i++) {
+                if ((rc = mbedtls_ecdh_gen_public(&grp, &d, &q, mbedtls_ctr_drbg_random, &drbg)) == 0)
+                        rc = mbedtls_ecdh_compute_shared(&grp, &z, &peer, &d, mbedtls_ctr_drbg_random, &drbg);
+        }
+        ecdhPerS = opt.ops / (now_s() - start);
+        mbedtls_mpi_free(&z);
+        mbedtls_mpi_free(&peerD);
+        mbedtls_mpi_free(&d);
+        mbedtls_ecp_point_free(&peer);
+        mbedtls_ecp_point_free(&q);
+        mbedtls_ecp_group_free(&grp);
+        if (rc != 0)
+                return rc;
+
+        tb_begin_obj(tb, "primitives");
+        tb_add_double(tb, "aes128_gcm_mb_per_s", gcmMBs, 1);
+        tb_add_double(tb, "sha256_mb_per_s", shaMBs, 1);
+#if defined(MBEDTLS_ECDSA_C)
+        tb_add_double(tb, "ecdsa_p256_sign_per_s", signPerS, 0);
+        tb_add_double(tb, "ecdsa_p256_verify_per_s", verifyPerS, 0);
+#endif
+        tb_add_double(tb, "ecdh_p256_per_s", ecdhPerS, 0);
+        tb_end_obj(tb);
+        return 0;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s -K certdir [options]\n"
+                "  -K dir      ca.pem, server.pem and server.key from gen_test_certs.sh,\n"
+                "              not used by the psk_only build\n"
+                "  -n count    handshakes (50)\n"
+                "  -c count    ECDSA and ECDH operations (200)\n"
+                "  -R ms       round-trip time for connect_ms_at_rtt (100)\n"
+                "  -o file     JSON output, stdout if omitted\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[8192];
+        tb_builder tb;
+        FILE *out = stdout;
+        int c, rc, len;
+
+        while ((c = getopt(argc, argv, "K:n:c:R:o:")) != -1) {
+                switch (c) {
+                case 'K': opt.certDir = optarg; break;
+                case 'n': opt.handshakes = atoi(optarg); break;
+                case 'c': opt.ops = atoi(optarg); break;
+                case 'R': opt.rttMs = atoi(optarg); break;
+                case 'o': opt.output = optarg; break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.handshakes <= 0 || opt.ops <= 0 || opt.rttMs < 0) {
+                usage(argv[0]);
+                return 2;
+        }
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        if (opt.certDir == NULL) {
+                usage(argv[0]);
+                return 2;
+        }
+#endif
+
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+        if ((rc = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0)) != 0 ||
+            (rc = setup_configs()) != 0) {
+                fprintf(stderr, "setup failed: -0x%04x\n", (unsigned int)-rc);
+                return 1;
+        }
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_str(&tb, "profile", PROFILE_NAME);
+        tb_add_i32(&tb, "mpi_window_size", MBEDTLS_MPI_WINDOW_SIZE);
+        tb_add_i32(&tb, "ecp_window_size", MBEDTLS_ECP_WINDOW_SIZE);
+        tb_add_i32(&tb, "ecp_fixed_point_optim", MBEDTLS_ECP_FIXED_POINT_OPTIM);
+        tb_add_i32(&tb, "rtt_ms", opt.rttMs);
+#ifdef MBEDTLS_AES_ROM_TABLES
+        tb_add_bool(&tb, "aes_rom_tables", 1);
+#else
+        tb_add_bool(&tb, "aes_rom_tables", 0);
+#endif
+        tb_end_obj(&tb);
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        if (bench_handshakes(&tb, "handshake", &cliConf) != 0 ||
+            bench_handshakes(&tb, "handshake_fast", &fastConf) != 0)
+                return 1;
+#endif
+#if defined(MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED)
+        if (bench_handshakes(&tb, "handshake_psk", &pskConf) != 0)
+                return 1;
+#endif
+        if ((rc = bench_primitives(&tb)) != 0) {
+                fprintf(stderr, "primitives failed: -0x%04x\n", (unsigned int)-rc);
+                return 1;
+        }
+        if ((len = tb_end(&tb)) < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}
@@ -0,0 +1,27 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  MBEDTLS_CONFIG_FILE of the TLS profile benchmarks
+ *******************************************************************************/
+
+#ifndef IOTF_TLS_BENCH_CONFIG_H_
+#define IOTF_TLS_BENCH_CONFIG_H_
+
+//The pack configuration, IOTF_MBEDTLS_PROFILE is set by the build
+#include "mbedTLS_config.h"
+
+//The server side of the in-process handshake
+#define MBEDTLS_SSL_SRV_C
+
+#endif
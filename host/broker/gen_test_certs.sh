@@ -0,0 +1,26 @@
+#!/bin/bash
+# Generates a throwaway CA and a server certificate for the broker stand-in.
+# The server certificate is valid for the Watson IoT messaging hostnames, so the
+# client verifies it exactly as it would verify the platform, and for 127.0.0.1.
+#
+# usage: gen_test_certs.sh [output directory]
+
+set -e
+OUT=${1:-./certs}
+mkdir -p "$OUT"
+cd "$OUT"
+
+openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+openssl req -x509 -new -key ca.key -sha256 -days 365 -subj "/CN=iotf test CA" -out ca.pem
+
+openssl ecparam -name prime256v1 -genkey -noout -out server.key
+openssl req -new -key server.key -subj "/CN=*.messaging.internetofthings.ibmcloud.com" -out server.csr
+cat > server.ext <<EXT
+subjectAltName=DNS:*.messaging.internetofthings.ibmcloud.com,DNS:localhost,IP:127.0.0.1
+extendedKeyUsage=serverAuth
+EXT
+openssl x509 -req -in server.csr -CA ca.pem -CAkey ca.key -CAcreateserial -sha256 -days 365 \
+        -extfile server.ext -out server.pem
+rm -f server.csr server.ext ca.srl
+
+echo "CA: $OUT/ca.pem  server: $OUT/server.pem $OUT/server.key"
@@ -0,0 +1,863 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  MQTT 3.1.1 broker stand-in. Single threaded poll loop, no sessions,
+ *                    no retained messages and no wills. Everything the broker sends goes
+ *                    through a per-connection queue that applies the configured delay and
+ *                    bandwidth cap.
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+#include "iotf_broker.h"
+
+#define BROKER_MAX_CONN         32      //default of iotf_broker_config.maxConnections
+#define BROKER_MAX_SUBS         8
+#define BROKER_FILTER_LEN       128
+#define BROKER_TOPIC_LEN        256
+#define BROKER_INBUF            16384
+#define BROKER_ACCEPT_BURST     256     //connections accepted per poll
+
+//Packet waiting in a connection's send queue
+typedef struct pending
+{
+        struct pending *next;
+        uint64_t due;
+        size_t len;
+        unsigned char data[];
+} pending;
+
+typedef struct
+{
+        int fd;
+        int tls;
+        mbedtls_net_context net;
+        mbedtls_ssl_context ssl;
+        int connected;
+        char clientId[64];
+        struct {
+                char filter[BROKER_FILTER_LEN];
+                int qos;
+        } subs[BROKER_MAX_SUBS];
+        int nsubs;
+        unsigned char in[BROKER_INBUF];
+        size_t inLen;
+        pending *head;
+        pending *tail;
+        int64_t tokens;
+        uint64_t refill;
+        unsigned short nextId;
+} conn;
+
+struct iotf_broker
+{
+        iotf_broker_config cfg;
+        int listenFd;
+        int tlsFd;
+        int port;
+        int tlsPort;
+        int wake[2];
+        conn **conns;
+        int maxConn;
+        struct pollfd *pfd;             //poll set of the broker thread, 3 + maxConn entries
+        int *idx;
+        pthread_t thread;
+        pthread_mutex_t lock;
+        volatile int run;
+        iotf_broker_stats stats;
+        int tlsReady;
+        mbedtls_ssl_config conf;
+        mbedtls_x509_crt cert;
+        mbedtls_pk_context key;
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context drbg;
+        uint64_t nextDm;
+        unsigned int dmSeq;
+        unsigned int dmKind;
+        unsigned int seed;
+};
+
+static uint64_t now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+/** Function to create a listening socket on 127.0.0.1
+* @param - Port, 0 for any free port
+*        - Address to store the bound port
+* @return - Socket or -1 on failure
+**/
+static int listen_on(int port, int *bound)
+{
+        struct sockaddr_in sa;
+        socklen_t len = sizeof(sa);
+        int one = 1;
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (fd < 0)
+                return -1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+            getsockname(fd, (struct sockaddr *)&sa, &len) != 0) {
+                close(fd);
+                return -1;
+        }
+        *bound = ntohs(sa.sin_port);
+        return fd;
+}
+
+static int tls_setup(iotf_broker *b)
+{
+        mbedtls_ssl_config_init(&b->conf);
+        mbedtls_x509_crt_init(&b->cert);
+        mbedtls_pk_init(&b->key);
+        mbedtls_entropy_init(&b->entropy);
+        mbedtls_ctr_drbg_init(&b->drbg);
+        b->tlsReady = 1;
+
+        if (mbedtls_ctr_drbg_seed(&b->drbg, mbedtls_entropy_func, &b->entropy,
+                                  (const unsigned char *)"iotf_broker", 11) != 0)
+                return -1;
+        if (mbedtls_x509_crt_parse_file(&b->cert, b->cfg.certFile) != 0) {
+                fprintf(stderr, "broker: cannot load %s\n", b->cfg.certFile);
+                return -1;
+        }
+        if (mbedtls_pk_parse_keyfile(&b->key, b->cfg.keyFile, NULL, mbedtls_ctr_drbg_random, &b->drbg) != 0) {
+                fprintf(stderr, "broker: cannot load %s\n", b->cfg.keyFile);
+                return -1;
+        }
+        if (mbedtls_ssl_config_defaults(&b->conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+                return -1;
+        mbedtls_ssl_conf_rng(&b->conf, mbedtls_ctr_drbg_random, &b->drbg);
+        return mbedtls_ssl_conf_own_cert(&b->conf, &b->cert, &b->key);
+}
+
+static void tls_cleanup(iotf_broker *b)
+{
+        if (!b->tlsReady)
+                return;
+        mbedtls_ssl_config_free(&b->conf);
+        mbedtls_x509_crt_free(&b->cert);
+        mbedtls_pk_free(&b->key);
+        mbedtls_ctr_drbg_free(&b->drbg);
+        mbedtls_entropy_free(&b->entropy);
+}
+
+static void conn_close(iotf_broker *b, int idx)
+{
+        conn *c = b->conns[idx];
+        pending *p;
+
+        while ((p = c->head) != NULL) {
+                c->head = p->next;
+                free(p);
+        }
+        if (c->tls) {
+                mbedtls_ssl_close_notify(&c->ssl);
+                mbedtls_ssl_free(&c->ssl);
+        }
+        close(c->fd);
+        free(c);
+        b->conns[idx] = NULL;
+}
+
+/** Function to accept one pending connection
+* @return - 0 if none was pending, 1 otherwise
+**/
+static int conn_accept(iotf_broker *b, int lfd, int tls)
+{
+        int one = 1;
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        int i, rc;
+        conn *c;
+
+        if (fd < 0)
+                return 0;
+        for (i = 0; i < b->maxConn && b->conns[i] != NULL; i++)
+                ;
+        c = (i < b->maxConn) ? calloc(1, sizeof(conn)) : NULL;
+        if (c == NULL) {
+                close(fd);
+                return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c->fd = fd;
+        c->nextId = 1;
+        c->refill = now_us();
+        c->tokens = b->cfg.bytesPerSecond;
+
+        if (tls) {
+                //Handshake is done blocking with a timeout, other connections wait meanwhile
+                struct timeval tv = { 5, 0 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                c->tls = 1;
+                c->net.fd = fd;
+                mbedtls_ssl_init(&c->ssl);
+                if (mbedtls_ssl_setup(&c->ssl, &b->conf) != 0) {
+                        mbedtls_ssl_free(&c->ssl);
+                        close(fd);
+                        free(c);
+                        return 1;
+                }
+                mbedtls_ssl_set_bio(&c->ssl, &c->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+                while ((rc = mbedtls_ssl_handshake(&c->ssl)) != 0) {
+                        if (rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE) {
+                                mbedtls_ssl_free(&c->ssl);
+                                close(fd);
+                                free(c);
+                                return 1;
+                        }
+                }
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        b->conns[i] = c;
+        return 1;
+}
+
+/** Function to write a whole buffer to a non-blocking connection
+* @return - 0 on success, -1 if the connection failed
+**/
+static int conn_write(iotf_broker *b, conn *c, const unsigned char *buf, size_t len)
+{
+        struct pollfd pfd = { c->fd, POLLOUT, 0 };
+        size_t off = 0;
+        ssize_t rc;
+
+        while (off < len) {
+                if (c->tls) {
+                        rc = mbedtls_ssl_write(&c->ssl, buf + off, len - off);
+                        if (rc == MBEDTLS_ERR_SSL_WANT_WRITE || rc == MBEDTLS_ERR_SSL_WANT_READ) {
+                                poll(&pfd, 1, 100);
+                                continue;
+                        }
+                } else {
+                        rc = send(c->fd, buf + off, len - off, MSG_NOSIGNAL);
+                        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                                poll(&pfd, 1, 100);
+                                continue;
+                        }
+                }
+                if (rc <= 0)
+                        return -1;
+                off += rc;
+        }
+        b->stats.bytesOut += len;
+        return 0;
+}
+
+//Queues a packet for sending after the configured delay
+static void conn_queue(iotf_broker *b, conn *c, const unsigned char *buf, size_t len)
+{
+        pending *p = malloc(sizeof(pending) + len);
+
+        if (p == NULL)
+                return;
+        p->next = NULL;
+        p->due = now_us() + (uint64_t)b->cfg.delayMs * 1000U;
+        p->len = len;
+        memcpy(p->data, buf, len);
+        if (c->tail != NULL)
+                c->tail->next = p;
+        else
+                c->head = p;
+        c->tail = p;
+}
+
+//Sends queued packets that are due and fit into the bandwidth budget
+static int conn_flush(iotf_broker *b, conn *c, uint64_t now)
+{
+        pending *p;
+        uint64_t rate = b->cfg.bytesPerSecond;
+
+        if (rate) {
+                c->tokens += (int64_t)((now - c->refill) * rate / 1000000U);
+                if (c->tokens > (int64_t)rate)
+                        c->tokens = rate;
+                c->refill = now;
+        }
+        while ((p = c->head) != NULL && p->due <= now && (!rate || c->tokens > 0)) {
+                if (conn_write(b, c, p->data, p->len) != 0)
+                        return -1;
+                if (rate)
+                        c->tokens -= p->len;
+                c->head = p->next;
+                if (c->head == NULL)
+                        c->tail = NULL;
+                free(p);
+        }
+        return 0;
+}
+
+//Earliest time a queued packet can be sent, 0 if nothing is queued
+static uint64_t conn_next_due(iotf_broker *b, conn *c)
+{
+        uint64_t due;
+
+        if (c->head == NULL)
+                return 0;
+        due = c->head->due;
+        if (b->cfg.bytesPerSecond && c->tokens <= 0) {
+                uint64_t wait = (uint64_t)(1 - c->tokens) * 1000000U / b->cfg.bytesPerSecond;
+                if (c->refill + wait > due)
+                        due = c->refill + wait;
+        }
+        return due;
+}
+
+static void send_ack(iotf_broker *b, conn *c, unsigned char type, unsigned short id)
+{
+        unsigned char pkt[4] = { type, 2, (unsigned char)(id >> 8), (unsigned char)id };
+        conn_queue(b, c, pkt, sizeof(pkt));
+}
+
+//MQTT remaining length, returns bytes used
+static size_t encode_length(unsigned char *buf, size_t len)
+{
+        size_t n = 0;
+        do {
+                unsigned char d = len % 128;
+                len /= 128;
+                buf[n++] = d | (len > 0 ? 0x80 : 0);
+        } while (len > 0);
+        return n;
+}
+
+/** Function to decode the fixed header of the packet at the start of a buffer
+* @return - 1 if a whole packet is available, 0 if more data is needed, -1 if malformed
+**/
+static int decode_header(const unsigned char *buf, size_t len, size_t *hdr, size_t *rem)
+{
+        size_t value = 0, mult = 1, i;
+
+        for (i = 1; i < len && i <= 4; i++) {
+                value += (buf[i] & 0x7f) * mult;
+                mult *= 128;
+                if ((buf[i] & 0x80) == 0) {
+                        *hdr = i + 1;
+                        *rem = value;
+                        return (len >= *hdr + value) ? 1 : 0;
+                }
+        }
+        return (i > 4) ? -1 : 0;
+}
+
+//Reads a length-prefixed string, returns its length or -1
+static int read_string(const unsigned char **p, const unsigned char *end, const char **str)
+{
+        int len;
+
+        if (end - *p < 2)
+                return -1;
+        len = ((*p)[0] << 8) | (*p)[1];
+        if (end - *p < 2 + len)
+                return -1;
+        *str = (const char *)(*p + 2);
+        *p += 2 + len;
+        return len;
+}
+
+static int topic_match(const char *filter, const char *topic)
+{
+        while (*filter != '\0') {
+                if (*filter == '#')
+                        return 1;
+                if (*filter == '+') {
+                        while (*topic != '\0' && *topic != '/')
+                                topic++;
+                        filter++;
+                        continue;
+                }
+                if (*filter != *topic)
+                        return 0;
+                filter++;
+                topic++;
+        }
+        return *topic == '\0';
+}
+
+static void deliver(iotf_broker *b, conn *c, const char *topic, const void *payload, size_t len, int qos)
+{
+        size_t tlen = strlen(topic);
+        size_t rem = 2 + tlen + (qos ? 2 : 0) + len;
+        unsigned char *pkt = malloc(5 + rem);
+        size_t n;
+
+        if (pkt == NULL)
+                return;
+        pkt[0] = 0x30 | (qos << 1);
+        n = 1 + encode_length(pkt + 1, rem);
+        pkt[n++] = (unsigned char)(tlen >> 8);
+        pkt[n++] = (unsigned char)tlen;
+        memcpy(pkt + n, topic, tlen);
+        n += tlen;
+        if (qos) {
+                if (c->nextId == 0)
+                        c->nextId = 1;
+                pkt[n++] = (unsigned char)(c->nextId >> 8);
+                pkt[n++] = (unsigned char)c->nextId;
+                c->nextId++;
+        }
+        memcpy(pkt + n, payload, len);
+        conn_queue(b, c, pkt, n + len);
+        free(pkt);
+        b->stats.publishesOut++;
+}
+
+/** Function to forward a publish to every connection with a matching subscription
+* @return - Number of connections the message was queued for
+**/
+static int route(iotf_broker *b, const char *topic, const void *payload, size_t len, int qos)
+{
+        int i, s, sent = 0;
+
+        for (i = 0; i < b->maxConn; i++) {
+                conn *c = b->conns[i];
+                if (c == NULL || !c->connected)
+                        continue;
+                for (s = 0; s < c->nsubs; s++) {
+                        if (!topic_match(c->subs[s].filter, topic))
+                                continue;
+                        int q = qos < c->subs[s].qos ? qos : c->subs[s].qos;
+                        if (q == 0 && b->cfg.lossPermille && (unsigned int)(rand_r(&b->seed) % 1000) < b->cfg.lossPermille)
+                                b->stats.dropped++;
+                        else {
+                                deliver(b, c, topic, payload, len, q);
+                                sent++;
+                        }
+                        break;
+                }
+        }
+        return sent;
+}
+
+//Platform side handling of device management traffic
+static void platform(iotf_broker *b, const char *topic, const char *payload, size_t len)
+{
+        const char *key = "\"reqId\":\"";
+        size_t klen = strlen(key);
+        char reply[128];
+        const char *p, *end = payload + len;
+        int n = 0;
+
+        if (strcmp(topic, "iotdevice-1/response") == 0) {
+                b->stats.dmResponses++;
+                return;
+        }
+        if (!b->cfg.answerManage || strcmp(topic, "iotdevice-1/mgmt/manage") != 0)
+                return;
+        for (p = payload; p + klen <= end; p++)
+                if (memcmp(p, key, klen) == 0)
+                        break;
+        if (p + klen > end)
+                return;
+        p += klen;
+        while (p + n < end && p[n] != '"' && n < 64)
+                n++;
+        n = snprintf(reply, sizeof(reply), "{\"reqId\":\"%.*s\",\"rc\":200}", n, p);
+        route(b, "iotdm-1/response", reply, n, 0);
+}
+
+static int handle_packet(iotf_broker *b, conn *c, const unsigned char *pkt, size_t hdr, size_t rem)
+{
+        const unsigned char *p = pkt + hdr;
+        const unsigned char *end = p + rem;
+        unsigned char type = pkt[0] >> 4;
+        unsigned short id = 0;
+        const char *str;
+        int len;
+
+        if (!c->connected && type != 1)
+                return -1;
+
+        switch (type) {
+        case 1: { //CONNECT
+                unsigned char connack[4] = { 0x20, 2, 0, 0 };
+                if (read_string(&p, end, &str) < 0 || end - p < 4)
+                        return -1;
+                p += 4;
+                if ((len = read_string(&p, end, &str)) < 0)
+                        return -1;
+                snprintf(c->clientId, sizeof(c->clientId), "%.*s", len, str);
+                c->connected = 1;
+                b->stats.connections++;
+                conn_queue(b, c, connack, sizeof(connack));
+                return 0;
+        }
+        case 3: { //PUBLISH
+                char topic[BROKER_TOPIC_LEN];
+                int qos = (pkt[0] >> 1) & 3;
+                if ((len = read_string(&p, end, &str)) < 0 || len >= (int)sizeof(topic))
+                        return -1;
+                memcpy(topic, str, len);
+                topic[len] = '\0';
+                if (qos) {
+                        if (end - p < 2)
+                                return -1;
+                        id = (p[0] << 8) | p[1];
+                        p += 2;
+                }
+                b->stats.publishesIn++;
+                if (qos == 1)
+                        send_ack(b, c, 0x40, id);
+                else if (qos == 2)
+                        send_ack(b, c, 0x50, id);
+                platform(b, topic, (const char *)p, end - p);
+                route(b, topic, p, end - p, qos);
+                return 0;
+        }
+        case 5: //PUBREC for a QoS2 delivery
+                if (rem >= 2)
+                        send_ack(b, c, 0x62, (p[0] << 8) | p[1]);
+                return 0;
+        case 6: //PUBREL
+                if (rem >= 2)
+                        send_ack(b, c, 0x70, (p[0] << 8) | p[1]);
+                return 0;
+        case 4: //PUBACK
+        case 7: //PUBCOMP
+                return 0;
+        case 8: { //SUBSCRIBE
+                unsigned char suback[4 + 5 + BROKER_MAX_SUBS];
+                size_t n, count = 0;
+                unsigned char granted[BROKER_MAX_SUBS];
+                if (end - p < 2)
+                        return -1;
+                id = (p[0] << 8) | p[1];
+                p += 2;
+                while (p < end && count < BROKER_MAX_SUBS) {
+                        if ((len = read_string(&p, end, &str)) < 0 || p >= end)
+                                return -1;
+                        int qos = *p++ & 3;
+                        if (len < BROKER_FILTER_LEN && c->nsubs < BROKER_MAX_SUBS) {
+                                memcpy(c->subs[c->nsubs].filter, str, len);
+                                c->subs[c->nsubs].filter[len] = '\0';
+                                c->subs[c->nsubs].qos = qos;
+                                c->nsubs++;
+                                granted[count++] = (unsigned char)qos;
+                        } else
+                                granted[count++] = 0x80;
+                }
+                suback[0] = 0x90;
+                n = 1 + encode_length(suback + 1, 2 + count);
+                suback[n++] = (unsigned char)(id >> 8);
+                suback[n++] = (unsigned char)id;
+                memcpy(suback + n, granted, count);
+                conn_queue(b, c, suback, n + count);
+                return 0;
+        }
+        case 10: { //UNSUBSCRIBE
+                int s;
+                if (end - p < 2)
+                        return -1;
+                id = (p[0] << 8) | p[1];
+                p += 2;
+                while (p < end) {
+                        if ((len = read_string(&p, end, &str)) < 0)
+                                return -1;
+                        for (s = 0; s < c->nsubs; s++) {
+                                if ((int)strlen(c->subs[s].filter) == len && memcmp(c->subs[s].filter, str, len) == 0) {
+                                        c->subs[s] = c->subs[--c->nsubs];
+                                        break;
+                                }
+                        }
+                }
+                send_ack(b, c, 0xB0, id);
+                return 0;
+        }
+        case 12: { //PINGREQ
+                unsigned char pingresp[2] = { 0xD0, 0 };
+                conn_queue(b, c, pingresp, sizeof(pingresp));
+                return 0;
+        }
+        case 14: //DISCONNECT
+        default:
+                return -1;
+        }
+}
+
+/** Function to read from a connection and handle every complete packet
+* @return - 0 to keep the connection, -1 to close it
+**/
+static int conn_read(iotf_broker *b, conn *c)
+{
+        size_t hdr, rem;
+        ssize_t rc;
+        int state;
+
+        for (;;) {
+                if (c->inLen == sizeof(c->in))
+                        return -1;
+                if (c->tls) {
+                        rc = mbedtls_ssl_read(&c->ssl, c->in + c->inLen, sizeof(c->in) - c->inLen);
+                        if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE)
+                                break;
+                } else {
+                        rc = recv(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen, MSG_DONTWAIT);
+                        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                                break;
+                }
+                if (rc <= 0)
+                        return -1;
+                c->inLen += rc;
+                b->stats.bytesIn += rc;
+        }
+
+        while ((state = decode_header(c->in, c->inLen, &hdr, &rem)) == 1) {
+                if (handle_packet(b, c, c->in, hdr, rem) != 0)
+                        return -1;
+                memmove(c->in, c->in + hdr + rem, c->inLen - hdr - rem);
+                c->inLen -= hdr + rem;
+        }
+        return state < 0 ? -1 : 0;
+}
+
+//Scripted device management requests, one per period in round robin over dmMask
+static void inject_dm(iotf_broker *b, uint64_t now)
+{
+        char payload[160];
+        const char *topic = NULL;
+        int n, i;
+
+        if (!b->cfg.dmPerSecond || !(b->cfg.dmMask & 0x07) || now < b->nextDm)
+                return;
+        b->nextDm = now + 1000000U / b->cfg.dmPerSecond;
+
+        for (i = 0; i < 3 && topic == NULL; i++) {
+                unsigned int kind = 1U << (b->dmKind++ % 3);
+                if (!(b->cfg.dmMask & kind))
+                        continue;
+                b->dmSeq++;
+                if (kind == BROKER_DM_OBSERVE) {
+                        topic = "iotdm-1/observe";
+                        n = snprintf(payload, sizeof(payload),
+                                     "{\"reqId\":\"broker-%u\",\"d\":{\"fields\":[{\"field\":\"mgmt.firmware\"}]}}", b->dmSeq);
+                } else if (kind == BROKER_DM_REBOOT) {
+                        topic = "iotdm-1/mgmt/initiate/device/reboot";
+                        n = snprintf(payload, sizeof(payload), "{\"reqId\":\"broker-%u\"}", b->dmSeq);
+                } else {
+                        topic = "iotdm-1/mgmt/initiate/firmware/download";
+                        n = snprintf(payload, sizeof(payload), "{\"reqId\":\"broker-%u\"}", b->dmSeq);
+                }
+        }
+        if (topic != NULL && route(b, topic, payload, n, 0) > 0)
+                b->stats.dmInjected++;
+}
+
+static void *broker_thread(void *arg)
+{
+        iotf_broker *b = arg;
+        struct pollfd *pfd = b->pfd;
+        int *idx = b->idx;
+        int nfds, i, timeout;
+        uint64_t now, due, next;
+        char drain[64];
+
+        while (b->run) {
+                nfds = 0;
+                pfd[nfds].fd = b->wake[0];
+                pfd[nfds++].events = POLLIN;
+                pfd[nfds].fd = b->listenFd;
+                pfd[nfds++].events = POLLIN;
+                pfd[nfds].fd = b->tlsFd;
+                pfd[nfds++].events = POLLIN;
+
+                pthread_mutex_lock(&b->lock);
+                now = now_us();
+                next = now + 100000U;
+                if (b->cfg.dmPerSecond && b->nextDm < next)
+                        next = b->nextDm > now ? b->nextDm : now;
+                for (i = 0; i < b->maxConn; i++) {
+                        conn *c = b->conns[i];
+                        if (c == NULL)
+                                continue;
+                        pfd[nfds].fd = c->fd;
+                        pfd[nfds].events = POLLIN;
+                        //Records already decrypted by mbedTLS are not visible to poll
+                        if (c->tls && mbedtls_ssl_get_bytes_avail(&c->ssl) > 0)
+                                next = now;
+                        idx[nfds++] = i;
+                        due = conn_next_due(b, c);
+                        if (due && due < next)
+                                next = due;
+                }
+                pthread_mutex_unlock(&b->lock);
+
+                timeout = (int)((next - now + 999) / 1000);
+                poll(pfd, nfds, timeout);
+
+                pthread_mutex_lock(&b->lock);
+                if (pfd[0].revents & POLLIN)
+                        while (read(b->wake[0], drain, sizeof(drain)) > 0)
+                                ;
+                //Accept the whole backlog, each pass of this loop visits every connection
+                if (pfd[1].revents & POLLIN)
+                        for (i = 0; i < BROKER_ACCEPT_BURST && conn_accept(b, b->listenFd, 0); i++)
+                                ;
+                if (pfd[2].revents & POLLIN)
+                        for (i = 0; i < BROKER_ACCEPT_BURST && conn_accept(b, b->tlsFd, 1); i++)
+                                ;
+                for (i = 3; i < nfds; i++) {
+                        conn *c = b->conns[idx[i]];
+                        if (c == NULL)
+                                continue;
+                        if ((pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) ||
+                            (c->tls && mbedtls_ssl_get_bytes_avail(&c->ssl) > 0)) {
+                                if (conn_read(b, c) != 0)
+                                        conn_close(b, idx[i]);
+                        }
+                }
+                now = now_us();
+                inject_dm(b, now);
+                for (i = 0; i < b->maxConn; i++)
+                        if (b->conns[i] != NULL && conn_flush(b, b->conns[i], now) != 0)
+                                conn_close(b, i);
+                pthread_mutex_unlock(&b->lock);
+        }
+        return NULL;
+}
+
+iotf_broker *iotf_broker_start(const iotf_broker_config *cfg)
+{
+        iotf_broker *b = calloc(1, sizeof(iotf_broker));
+
+        if (b == NULL)
+                return NULL;
+        b->cfg = *cfg;
+        b->listenFd = b->tlsFd = b->wake[0] = b->wake[1] = -1;
+        b->tlsPort = -1;
+        b->seed = (unsigned int)now_us();
+        b->maxConn = cfg->maxConnections ? (int)cfg->maxConnections : BROKER_MAX_CONN;
+        pthread_mutex_init(&b->lock, NULL);
+
+        b->conns = calloc(b->maxConn, sizeof(conn *));
+        b->pfd = malloc((3 + b->maxConn) * sizeof(struct pollfd));
+        b->idx = malloc((3 + b->maxConn) * sizeof(int));
+        if (b->conns == NULL || b->pfd == NULL || b->idx == NULL)
+                goto fail;
+
+        if (pipe2(b->wake, O_NONBLOCK | O_CLOEXEC) != 0)
+                goto fail;
+        if ((b->listenFd = listen_on(cfg->port, &b->port)) < 0)
+                goto fail;
+        if (cfg->tlsPort >= 0 && cfg->certFile != NULL && cfg->keyFile != NULL) {
+                if (tls_setup(b) != 0 || (b->tlsFd = listen_on(cfg->tlsPort, &b->tlsPort)) < 0)
+                        goto fail;
+        }
+
+        b->nextDm = now_us() + 1000000U;
+        b->run = 1;
+        if (pthread_create(&b->thread, NULL, broker_thread, b) != 0)
+                goto fail;
+        return b;
+
+fail:
+        b->run = 0;
+        if (b->listenFd >= 0)
+                close(b->listenFd);
+        if (b->tlsFd >= 0)
+                close(b->tlsFd);
+        if (b->wake[0] >= 0) {
+                close(b->wake[0]);
+                close(b->wake[1]);
+        }
+        tls_cleanup(b);
+        pthread_mutex_destroy(&b->lock);
+        free(b->conns);
+        free(b->pfd);
+        free(b->idx);
+        free(b);
+        return NULL;
+}
+
+//Interrupts the poll of the broker thread
+static void wakeup(iotf_broker *b)
+{
+        ssize_t rc = write(b->wake[1], "", 1);
+        (void)rc;
+}
+
+int iotf_broker_port(iotf_broker *broker, int tls)
+{
+        return tls ? broker->tlsPort : broker->port;
+}
+
+int iotf_broker_inject(iotf_broker *broker, const char *topic, const void *payload, int len)
+{
+        int sent;
+
+        pthread_mutex_lock(&broker->lock);
+        sent = route(broker, topic, payload, len, 0);
+        pthread_mutex_unlock(&broker->lock);
+        wakeup(broker);
+        return sent;
+}
+
+void iotf_broker_get_stats(iotf_broker *broker, iotf_broker_stats *stats)
+{
+        pthread_mutex_lock(&broker->lock);
+        *stats = broker->stats;
+        pthread_mutex_unlock(&broker->lock);
+}
+
+void iotf_broker_stop(iotf_broker *broker)
+{
+        int i;
+
+        if (broker == NULL)
+                return;
+        broker->run = 0;
+        wakeup(broker);
+        pthread_join(broker->thread, NULL);
+        for (i = 0; i < broker->maxConn; i++)
+                if (broker->conns[i] != NULL)
+                        conn_close(broker, i);
+        close(broker->listenFd);
+        if (broker->tlsFd >= 0)
+                close(broker->tlsFd);
+        close(broker->wake[0]);
+        close(broker->wake[1]);
+        tls_cleanup(broker);
+        pthread_mutex_destroy(&broker->lock);
+        free(broker->conns);
+        free(broker->pfd);
+        free(broker->idx);
+        free(broker);
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  In-process MQTT 3.1.1 broker stand-in for load and latency tests
+ *******************************************************************************/
+
+#ifndef IOTF_BROKER_H_
+#define IOTF_BROKER_H_
+
+#include <stdint.h>
+
+//Scripted device management requests, see iotf_broker_config.dmMask
+#define BROKER_DM_OBSERVE       0x01
+#define BROKER_DM_REBOOT        0x02
+#define BROKER_DM_FIRMWARE      0x04
+
+//Broker settings. Zero means default or disabled for every field.
+typedef struct
+{
+        int port;                       //plain MQTT listener, 0 picks a free port
+        int tlsPort;                    //MQTT over TLS listener, -1 disables, 0 picks a free port
+        const char *certFile;           //server certificate (PEM), required for TLS
+        const char *keyFile;            //server private key (PEM), required for TLS
+        unsigned int delayMs;           //added to every packet the broker sends
+        unsigned int bytesPerSecond;    //send rate cap per connection
+        unsigned int lossPermille;      //share of forwarded QoS0 publishes that are dropped
+        unsigned int dmPerSecond;       //rate of scripted device management requests
+        unsigned int dmMask;            //BROKER_DM_* kinds to inject, round robin
+        int answerManage;               //reply rc 200 to iotdevice-1/mgmt/manage like the platform
+        unsigned int maxConnections;    //connections served at once, 0 for 32
+} iotf_broker_config;
+
+typedef struct
+{
+        uint32_t connections;
+        uint32_t publishesIn;
+        uint32_t publishesOut;
+        uint32_t dropped;
+        uint64_t bytesIn;
+        uint64_t bytesOut;
+        uint32_t dmInjected;
+        uint32_t dmResponses;
+} iotf_broker_stats;
+
+typedef struct iotf_broker iotf_broker;
+
+/**
+* Starts the broker on its own thread. Listeners are bound to 127.0.0.1.
+* Delay applies to everything the broker sends, so it adds to each round-trip.
+* Loss only drops QoS0 deliveries, the client library does not retransmit QoS1/2.
+* @param - Broker settings
+* @return - Broker handle or NULL on failure
+**/
+iotf_broker *iotf_broker_start(const iotf_broker_config *cfg);
+
+/**
+* Function to get the bound port of a listener
+* @param - Broker handle
+*        - 1 for the TLS listener, 0 for plain MQTT
+* @return - Port number or -1 if the listener is disabled
+**/
+int iotf_broker_port(iotf_broker *broker, int tls);
+
+/**
+* Function to publish a message to all matching subscribers, as if sent by the platform
+* @param - Broker handle
+*        - Topic
+*        - Payload and its length
+* @return - Number of subscribers the message was queued for
+**/
+int iotf_broker_inject(iotf_broker *broker, const char *topic, const void *payload, int len);
+
+void iotf_broker_get_stats(iotf_broker *broker, iotf_broker_stats *stats);
+void iotf_broker_stop(iotf_broker *broker);
+
+#endif
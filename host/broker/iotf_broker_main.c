@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Standalone runner for the broker stand-in
+ *******************************************************************************/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "iotf_broker.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+        (void)sig;
+        stop = 1;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -p port     MQTT port (1883)\n"
+                "  -t port     MQTT over TLS port, needs -c and -k (8883)\n"
+                "  -c file     server certificate\n"
+                "  -k file     server private key\n"
+                "  -D ms       delay added to everything the broker sends\n"
+                "  -W bytes    send rate cap per connection in bytes per second\n"
+                "  -L permille share of QoS0 deliveries to drop\n"
+                "  -R rate     scripted device management requests per second\n"
+                "  -M mask     request kinds, 1 observe, 2 reboot, 4 firmware download (7)\n"
+                "  -A          answer manage requests like the platform\n"
+                "  -N count    connections served at once (32)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        iotf_broker_config cfg = { 1883, 8883, NULL, NULL, 0, 0, 0, 0, 7, 0, 0 };
+        iotf_broker_stats st;
+        iotf_broker *broker;
+        int c;
+
+        while ((c = getopt(argc, argv, "p:t:c:k:D:W:L:R:M:AN:")) != -1) {
+                switch (c) {
+                case 'p': cfg.port = atoi(optarg); break;
+                case 't': cfg.tlsPort = atoi(optarg); break;
+                case 'c': cfg.certFile = optarg; break;
+                case 'k': cfg.keyFile = optarg; break;
+                case 'D': cfg.delayMs = atoi(optarg); break;
+                case 'W': cfg.bytesPerSecond = atoi(optarg); break;
+                case 'L': cfg.lossPermille = atoi(optarg); break;
+                case 'R': cfg.dmPerSecond = atoi(optarg); break;
+                case 'M': cfg.dmMask = strtoul(optarg, NULL, 0); break;
+                case 'A': cfg.answerManage = 1; break;
+                case 'N': cfg.maxConnections = strtoul(optarg, NULL, 0); break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        if ((broker = iotf_broker_start(&cfg)) == NULL) {
+                fprintf(stderr, "cannot start broker\n");
+                return 1;
+        }
+        printf("listening on 127.0.0.1:%d", iotf_broker_port(broker, 0));
+        if (iotf_broker_port(broker, 1) > 0)
+                printf(", TLS on 127.0.0.1:%d", iotf_broker_port(broker, 1));
+        printf("\n");
+
+        while (!stop) {
+                sleep(1);
+                iotf_broker_get_stats(broker, &st);
+                printf("connections %u in %u out %u dropped %u dm %u/%u bytes %llu/%llu\n",
+                       st.connections, st.publishesIn, st.publishesOut, st.dropped,
+                       st.dmResponses, st.dmInjected,
+                       (unsigned long long)st.bytesIn, (unsigned long long)st.bytesOut);
+                fflush(stdout);
+        }
+        iotf_broker_stop(broker);
+        return 0;
+}
@@ -0,0 +1,133 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Subset of the CMSIS-RTOS2 API implemented on POSIX threads
+ *                    for building the client library on a Linux host
+ *******************************************************************************/
+
+#ifndef CMSIS_OS2_H_
+#define CMSIS_OS2_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef  __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum {
+  osOK                      =  0,
+  osError                   = -1,
+  osErrorTimeout            = -2,
+  osErrorResource           = -3,
+  osErrorParameter          = -4,
+  osErrorNoMemory           = -5,
+  osErrorISR                = -6,
+  osStatusReserved          = 0x7FFFFFFF
+} osStatus_t;
+
+typedef enum {
+  osPriorityNone            =  0,
+  osPriorityIdle            =  1,
+  osPriorityLow             =  8,
+  osPriorityBelowNormal     = 16,
+  osPriorityNormal          = 24,
+  osPriorityAboveNormal     = 32,
+  osPriorityHigh            = 40,
+  osPriorityRealtime        = 48,
+  osPriorityISR             = 56,
+  osPriorityError           = -1,
+  osPriorityReserved        = 0x7FFFFFFF
+} osPriority_t;
+
+#define osWaitForever         0xFFFFFFFFU
+
+#define osThreadDetached      0x00000000U
+#define osThreadJoinable      0x00000001U
+#define osMutexRecursive      0x00000001U
+
+typedef void (*osThreadFunc_t) (void *argument);
+
+typedef void *osThreadId_t;
+typedef void *osMutexId_t;
+typedef void *osMessageQueueId_t;
+
+typedef struct {
+  const char                   *name;
+  uint32_t                 attr_bits;
+  void                      *cb_mem;
+  uint32_t                   cb_size;
+  void                   *stack_mem;
+  uint32_t                stack_size;
+  osPriority_t              priority;
+  uint32_t                 tz_module;
+  uint32_t                  reserved;
+} osThreadAttr_t;
+
+typedef struct {
+  const char                   *name;
+  uint32_t                 attr_bits;
+  void                      *cb_mem;
+  uint32_t                   cb_size;
+} osMutexAttr_t;
+
+typedef struct {
+  const char                   *name;
+  uint32_t                 attr_bits;
+  void                      *cb_mem;
+  uint32_t                   cb_size;
+  void                      *mq_mem;
+  uint32_t                   mq_size;
+} osMessageQueueAttr_t;
+
+//Kernel, one tick is one millisecond
+osStatus_t osKernelInitialize (void);
+osStatus_t osKernelStart (void);
+uint32_t osKernelGetTickCount (void);
+uint32_t osKernelGetTickFreq (void);
+
+//Scheduler lock, a process-wide lock that excludes the other lockers only
+int32_t osKernelLock (void);
+int32_t osKernelRestoreLock (int32_t lock);
+
+//Delay
+osStatus_t osDelay (uint32_t ticks);
+
+//Threads
+osThreadId_t osThreadNew (osThreadFunc_t func, void *argument, const osThreadAttr_t *attr);
+osThreadId_t osThreadGetId (void);
+osStatus_t osThreadYield (void);
+osStatus_t osThreadJoin (osThreadId_t thread_id);
+osStatus_t osThreadTerminate (osThreadId_t thread_id);
+void osThreadExit (void);
+
+//Mutexes, always recursive
+osMutexId_t osMutexNew (const osMutexAttr_t *attr);
+osStatus_t osMutexAcquire (osMutexId_t mutex_id, uint32_t timeout);
+osStatus_t osMutexRelease (osMutexId_t mutex_id);
+osStatus_t osMutexDelete (osMutexId_t mutex_id);
+
+//Message queues, message priority is ignored
+osMessageQueueId_t osMessageQueueNew (uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr);
+osStatus_t osMessageQueuePut (osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout);
+osStatus_t osMessageQueueGet (osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout);
+uint32_t osMessageQueueGetCount (osMessageQueueId_t mq_id);
+osStatus_t osMessageQueueDelete (osMessageQueueId_t mq_id);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
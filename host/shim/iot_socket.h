@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  IoT Socket API implemented on BSD sockets for building
+ *                    the client library on a Linux host
+ *******************************************************************************/
+
+#ifndef IOT_SOCKET_H
+#define IOT_SOCKET_H
+
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C"
+{
+#endif
+
+//Address family
+#define IOT_SOCKET_AF_INET              1
+#define IOT_SOCKET_AF_INET6             2
+
+//Socket type
+#define IOT_SOCKET_SOCK_STREAM          1
+#define IOT_SOCKET_SOCK_DGRAM           2
+
+//Protocol
+#define IOT_SOCKET_IPPROTO_TCP          1
+#define IOT_SOCKET_IPPROTO_UDP          2
+
+//Socket options
+#define IOT_SOCKET_IO_FIONBIO           1
+#define IOT_SOCKET_SO_RCVTIMEO          2
+#define IOT_SOCKET_SO_SNDTIMEO          3
+#define IOT_SOCKET_SO_KEEPALIVE         4
+#define IOT_SOCKET_SO_TYPE              5
+
+//Return codes
+#define IOT_SOCKET_ERROR                (-1)
+#define IOT_SOCKET_ESOCK                (-2)
+#define IOT_SOCKET_EINVAL               (-3)
+#define IOT_SOCKET_ENOTSUP              (-4)
+#define IOT_SOCKET_ENOMEM               (-5)
+#define IOT_SOCKET_EAGAIN               (-6)
+#define IOT_SOCKET_EINPROGRESS          (-7)
+#define IOT_SOCKET_ETIMEDOUT            (-8)
+#define IOT_SOCKET_EISCONN              (-9)
+#define IOT_SOCKET_ENOTCONN             (-10)
+#define IOT_SOCKET_ECONNREFUSED         (-11)
+#define IOT_SOCKET_ECONNRESET           (-12)
+#define IOT_SOCKET_ECONNABORTED         (-13)
+#define IOT_SOCKET_EALREADY             (-14)
+#define IOT_SOCKET_EADDRINUSE           (-15)
+#define IOT_SOCKET_EHOSTNOTFOUND        (-16)
+
+int32_t iotSocketCreate (int32_t af, int32_t type, int32_t protocol);
+int32_t iotSocketBind (int32_t socket, const uint8_t *ip, uint32_t ip_len, uint16_t port);
+int32_t iotSocketListen (int32_t socket, int32_t backlog);
+int32_t iotSocketAccept (int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port);
+int32_t iotSocketConnect (int32_t socket, const uint8_t *ip, uint32_t ip_len, uint16_t port);
+int32_t iotSocketRecv (int32_t socket, void *buf, uint32_t len);
+int32_t iotSocketRecvFrom (int32_t socket, void *buf, uint32_t len, uint8_t *ip, uint32_t *ip_len, uint16_t *port);
+int32_t iotSocketSend (int32_t socket, const void *buf, uint32_t len);
+int32_t iotSocketSendTo (int32_t socket, const void *buf, uint32_t len, const uint8_t *ip, uint32_t ip_len, uint16_t port);
+int32_t iotSocketGetSockName (int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port);
+int32_t iotSocketGetPeerName (int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port);
+int32_t iotSocketGetOpt (int32_t socket, int32_t opt_id, void *opt_val, uint32_t *opt_len);
+int32_t iotSocketSetOpt (int32_t socket, int32_t opt_id, const void *opt_val, uint32_t opt_len);
+int32_t iotSocketClose (int32_t socket);
+int32_t iotSocketGetHostByName (const char *name, int32_t af, uint8_t *ip, uint32_t *ip_len);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,365 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  IoT Socket API on BSD sockets. Setting the environment variable
+ *                    IOTF_HOST_OVERRIDE resolves every host name to the given address,
+ *                    which points the quickstart hostname at a local broker.
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "iot_socket.h"
+
+/** Function to map errno to an IoT Socket return code
+* @param - errno value
+* @return - IOT_SOCKET_* error code
+**/
+static int32_t sock_error(int err)
+{
+        switch (err) {
+        case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+                return IOT_SOCKET_EAGAIN;
+        case EINPROGRESS:  return IOT_SOCKET_EINPROGRESS;
+        case ETIMEDOUT:    return IOT_SOCKET_ETIMEDOUT;
+        case EISCONN:      return IOT_SOCKET_EISCONN;
+        case ENOTCONN:     return IOT_SOCKET_ENOTCONN;
+        case ECONNREFUSED: return IOT_SOCKET_ECONNREFUSED;
+        case ECONNRESET:
+        case EPIPE:        return IOT_SOCKET_ECONNRESET;
+        case ECONNABORTED: return IOT_SOCKET_ECONNABORTED;
+        case EALREADY:     return IOT_SOCKET_EALREADY;
+        case EADDRINUSE:   return IOT_SOCKET_EADDRINUSE;
+        case EBADF:
+        case ENOTSOCK:     return IOT_SOCKET_ESOCK;
+        case EINVAL:       return IOT_SOCKET_EINVAL;
+        case ENOMEM:
+        case ENOBUFS:      return IOT_SOCKET_ENOMEM;
+        case EOPNOTSUPP:   return IOT_SOCKET_ENOTSUP;
+        default:           return IOT_SOCKET_ERROR;
+        }
+}
+
+/** Function to build a socket address from an IoT Socket address
+* @param - Address bytes (4 for IPv4, 16 for IPv6)
+*        - Address length
+*        - Port
+*        - Address of storage to fill
+* @return - Length of the socket address or 0 for invalid input
+**/
+static socklen_t sock_addr(const uint8_t *ip, uint32_t ip_len, uint16_t port, struct sockaddr_storage *ss)
+{
+        memset(ss, 0, sizeof(*ss));
+        if (ip_len == 4) {
+                struct sockaddr_in *sa = (struct sockaddr_in *)ss;
+                sa->sin_family = AF_INET;
+                sa->sin_port = htons(port);
+                memcpy(&sa->sin_addr, ip, 4);
+                return sizeof(*sa);
+        }
+        if (ip_len == 16) {
+                struct sockaddr_in6 *sa = (struct sockaddr_in6 *)ss;
+                sa->sin6_family = AF_INET6;
+                sa->sin6_port = htons(port);
+                memcpy(&sa->sin6_addr, ip, 16);
+                return sizeof(*sa);
+        }
+        return 0;
+}
+
+/** Function to split a socket address into IoT Socket address and port
+* @param - Socket address
+*        - Buffer for the address bytes, may be NULL
+*        - In: buffer size, out: address length
+*        - Address to store the port, may be NULL
+* @return - 0 on SUCCESS, IOT_SOCKET_EINVAL if the buffer is too small
+**/
+static int32_t sock_split(const struct sockaddr_storage *ss, uint8_t *ip, uint32_t *ip_len, uint16_t *port)
+{
+        const void *addr;
+        uint32_t len;
+        uint16_t p;
+
+        if (ss->ss_family == AF_INET6) {
+                const struct sockaddr_in6 *sa = (const struct sockaddr_in6 *)ss;
+                addr = &sa->sin6_addr;
+                len = 16;
+                p = ntohs(sa->sin6_port);
+        } else {
+                const struct sockaddr_in *sa = (const struct sockaddr_in *)ss;
+                addr = &sa->sin_addr;
+                len = 4;
+                p = ntohs(sa->sin_port);
+        }
+        if (ip != NULL && ip_len != NULL) {
+                if (*ip_len < len)
+                        return IOT_SOCKET_EINVAL;
+                memcpy(ip, addr, len);
+                *ip_len = len;
+        }
+        if (port != NULL)
+                *port = p;
+        return 0;
+}
+
+int32_t iotSocketCreate(int32_t af, int32_t type, int32_t protocol)
+{
+        int domain = (af == IOT_SOCKET_AF_INET6) ? AF_INET6 : AF_INET;
+        int stype = (type == IOT_SOCKET_SOCK_DGRAM) ? SOCK_DGRAM : SOCK_STREAM;
+        int fd;
+
+        (void)protocol;
+        if (af != IOT_SOCKET_AF_INET && af != IOT_SOCKET_AF_INET6)
+                return IOT_SOCKET_EINVAL;
+        fd = socket(domain, stype | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return sock_error(errno);
+        if (stype == SOCK_STREAM) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+}
+
+int32_t iotSocketBind(int32_t socket, const uint8_t *ip, uint32_t ip_len, uint16_t port)
+{
+        struct sockaddr_storage ss;
+        socklen_t len = sock_addr(ip, ip_len, port, &ss);
+        int one = 1;
+
+        if (len == 0)
+                return IOT_SOCKET_EINVAL;
+        setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(socket, (struct sockaddr *)&ss, len) != 0)
+                return sock_error(errno);
+        return 0;
+}
+
+int32_t iotSocketListen(int32_t socket, int32_t backlog)
+{
+        if (listen(socket, backlog) != 0)
+                return sock_error(errno);
+        return 0;
+}
+
+int32_t iotSocketAccept(int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port)
+{
+        struct sockaddr_storage ss;
+        socklen_t len = sizeof(ss);
+        int fd = accept4(socket, (struct sockaddr *)&ss, &len, SOCK_CLOEXEC);
+
+        if (fd < 0)
+                return sock_error(errno);
+        sock_split(&ss, ip, ip_len, port);
+        return fd;
+}
+
+int32_t iotSocketConnect(int32_t socket, const uint8_t *ip, uint32_t ip_len, uint16_t port)
+{
+        struct sockaddr_storage ss;
+        socklen_t len = sock_addr(ip, ip_len, port, &ss);
+
+        if (len == 0)
+                return IOT_SOCKET_EINVAL;
+        if (connect(socket, (struct sockaddr *)&ss, len) != 0)
+                return sock_error(errno);
+        return 0;
+}
+
+int32_t iotSocketRecv(int32_t socket, void *buf, uint32_t len)
+{
+        ssize_t rc = recv(socket, buf, len, 0);
+
+        if (rc < 0)
+                return sock_error(errno);
+        //Orderly shutdown by the peer is reported as reset, 0 would mean "no data"
+        if (rc == 0 && len > 0)
+                return IOT_SOCKET_ECONNRESET;
+        return (int32_t)rc;
+}
+
+int32_t iotSocketRecvFrom(int32_t socket, void *buf, uint32_t len, uint8_t *ip, uint32_t *ip_len, uint16_t *port)
+{
+        struct sockaddr_storage ss;
+        socklen_t slen = sizeof(ss);
+        ssize_t rc = recvfrom(socket, buf, len, 0, (struct sockaddr *)&ss, &slen);
+
+        if (rc < 0)
+                return sock_error(errno);
+        sock_split(&ss, ip, ip_len, port);
+        return (int32_t)rc;
+}
+
+int32_t iotSocketSend(int32_t socket, const void *buf, uint32_t len)
+{
+        ssize_t rc = send(socket, buf, len, MSG_NOSIGNAL);
+
+        if (rc < 0)
+                return sock_error(errno);
+        return (int32_t)rc;
+}
+
+int32_t iotSocketSendTo(int32_t socket, const void *buf, uint32_t len, const uint8_t *ip, uint32_t ip_len, uint16_t port)
+{
+        struct sockaddr_storage ss;
+        socklen_t slen;
+        ssize_t rc;
+
+        if (ip == NULL)
+                return iotSocketSend(socket, buf, len);
+        slen = sock_addr(ip, ip_len, port, &ss);
+        if (slen == 0)
+                return IOT_SOCKET_EINVAL;
+        rc = sendto(socket, buf, len, MSG_NOSIGNAL, (struct sockaddr *)&ss, slen);
+        if (rc < 0)
+                return sock_error(errno);
+        return (int32_t)rc;
+}
+
+int32_t iotSocketGetSockName(int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port)
+{
+        struct sockaddr_storage ss;
+        socklen_t len = sizeof(ss);
+
+        if (getsockname(socket, (struct sockaddr *)&ss, &len) != 0)
+                return sock_error(errno);
+        return sock_split(&ss, ip, ip_len, port);
+}
+
+int32_t iotSocketGetPeerName(int32_t socket, uint8_t *ip, uint32_t *ip_len, uint16_t *port)
+{
+        struct sockaddr_storage ss;
+        socklen_t len = sizeof(ss);
+
+        if (getpeername(socket, (struct sockaddr *)&ss, &len) != 0)
+                return sock_error(errno);
+        return sock_split(&ss, ip, ip_len, port);
+}
+
+int32_t iotSocketGetOpt(int32_t socket, int32_t opt_id, void *opt_val, uint32_t *opt_len)
+{
+        struct timeval tv;
+        socklen_t len = sizeof(tv);
+        int value = 0;
+        uint32_t result;
+
+        if (opt_val == NULL || opt_len == NULL || *opt_len < sizeof(uint32_t))
+                return IOT_SOCKET_EINVAL;
+
+        switch (opt_id) {
+        case IOT_SOCKET_SO_RCVTIMEO:
+        case IOT_SOCKET_SO_SNDTIMEO:
+                if (getsockopt(socket, SOL_SOCKET, opt_id == IOT_SOCKET_SO_RCVTIMEO ? SO_RCVTIMEO : SO_SNDTIMEO, &tv, &len) != 0)
+                        return sock_error(errno);
+                result = (uint32_t)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+                break;
+        case IOT_SOCKET_SO_KEEPALIVE:
+                len = sizeof(value);
+                if (getsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &value, &len) != 0)
+                        return sock_error(errno);
+                result = (uint32_t)value;
+                break;
+        case IOT_SOCKET_SO_TYPE:
+                len = sizeof(value);
+                if (getsockopt(socket, SOL_SOCKET, SO_TYPE, &value, &len) != 0)
+                        return sock_error(errno);
+                result = (value == SOCK_DGRAM) ? IOT_SOCKET_SOCK_DGRAM : IOT_SOCKET_SOCK_STREAM;
+                break;
+        default:
+                return IOT_SOCKET_EINVAL;
+        }
+        memcpy(opt_val, &result, sizeof(result));
+        *opt_len = sizeof(result);
+        return 0;
+}
+
+int32_t iotSocketSetOpt(int32_t socket, int32_t opt_id, const void *opt_val, uint32_t opt_len)
+{
+        struct timeval tv;
+        uint32_t value;
+        int flags;
+
+        if (opt_val == NULL || opt_len < sizeof(uint32_t))
+                return IOT_SOCKET_EINVAL;
+        memcpy(&value, opt_val, sizeof(value));
+
+        switch (opt_id) {
+        case IOT_SOCKET_IO_FIONBIO:
+                flags = fcntl(socket, F_GETFL, 0);
+                if (flags < 0)
+                        return sock_error(errno);
+                flags = value ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+                if (fcntl(socket, F_SETFL, flags) != 0)
+                        return sock_error(errno);
+                return 0;
+        case IOT_SOCKET_SO_RCVTIMEO:
+        case IOT_SOCKET_SO_SNDTIMEO:
+                tv.tv_sec = value / 1000U;
+                tv.tv_usec = (value % 1000U) * 1000U;
+                if (setsockopt(socket, SOL_SOCKET, opt_id == IOT_SOCKET_SO_RCVTIMEO ? SO_RCVTIMEO : SO_SNDTIMEO, &tv, sizeof(tv)) != 0)
+                        return sock_error(errno);
+                return 0;
+        case IOT_SOCKET_SO_KEEPALIVE:
+                flags = value ? 1 : 0;
+                if (setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &flags, sizeof(flags)) != 0)
+                        return sock_error(errno);
+                return 0;
+        default:
+                return IOT_SOCKET_EINVAL;
+        }
+}
+
+int32_t iotSocketClose(int32_t socket)
+{
+        if (close(socket) != 0)
+                return sock_error(errno);
+        return 0;
+}
+
+int32_t iotSocketGetHostByName(const char *name, int32_t af, uint8_t *ip, uint32_t *ip_len)
+{
+        struct addrinfo hints, *res = NULL;
+        struct sockaddr_storage ss;
+        const char *override = getenv("IOTF_HOST_OVERRIDE");
+        int32_t rc;
+
+        if (name == NULL || ip == NULL || ip_len == NULL)
+                return IOT_SOCKET_EINVAL;
+        if (override != NULL && *override != '\0')
+                name = override;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = (af == IOT_SOCKET_AF_INET6) ? AF_INET6 : AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(name, NULL, &hints, &res) != 0 || res == NULL)
+                return IOT_SOCKET_EHOSTNOTFOUND;
+
+        memset(&ss, 0, sizeof(ss));
+        memcpy(&ss, res->ai_addr, res->ai_addrlen);
+        freeaddrinfo(res);
+        rc = sock_split(&ss, ip, ip_len, NULL);
+        return rc;
+}
@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  MQTTCLIENT_PLATFORM_HEADER for the host build. Upstream Paho
+ *                    MQTTClient-C names the timer functions differently from the
+ *                    Paho_MQTT pack, map them onto the wrapper implementation.
+ *******************************************************************************/
+
+#ifndef IOTF_HOST_PLATFORM_H_
+#define IOTF_HOST_PLATFORM_H_
+
+#include "iotf_network_tls_wrapper.h"
+
+#define TimerInit               InitTimer
+#define TimerIsExpired          expired
+#define TimerCountdownMS        countdown_ms
+#define TimerCountdown          countdown
+#define TimerLeftMS             left_ms
+
+#endif
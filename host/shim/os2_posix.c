@@ -0,0 +1,413 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  CMSIS-RTOS2 subset on POSIX threads
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cmsis_os2.h"
+
+typedef struct
+{
+        pthread_t thread;
+        osThreadFunc_t func;
+        void *argument;
+        int joinable;
+} os_thread;
+
+typedef struct
+{
+        pthread_mutex_t lock;
+        pthread_cond_t notEmpty;
+        pthread_cond_t notFull;
+        uint32_t msgCount;
+        uint32_t msgSize;
+        uint32_t head;
+        uint32_t used;
+        unsigned char *data;
+} os_queue;
+
+//Thread handle of the calling thread, the main thread uses osMainThread
+static __thread os_thread *osCurrent;
+static os_thread osMainThread;
+
+//Stands in for the scheduler lock, depth counts nested osKernelLock calls of a thread
+static pthread_mutex_t osKernelMutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread int32_t osKernelDepth;
+
+static struct timespec osStart;
+static pthread_once_t osStartOnce = PTHREAD_ONCE_INIT;
+
+static void os_init_start(void)
+{
+        clock_gettime(CLOCK_MONOTONIC, &osStart);
+}
+
+/** Function to convert a relative timeout in ticks (ms) to an absolute CLOCK_MONOTONIC time
+* @param - Timeout in ticks
+*        - Address to store the absolute time
+* @return - void
+**/
+static void os_deadline(uint32_t timeout, struct timespec *ts)
+{
+        clock_gettime(CLOCK_MONOTONIC, ts);
+        ts->tv_sec += timeout / 1000U;
+        ts->tv_nsec += (long)(timeout % 1000U) * 1000000L;
+        if (ts->tv_nsec >= 1000000000L) {
+                ts->tv_sec++;
+                ts->tv_nsec -= 1000000000L;
+        }
+}
+
+/** Function to wait on a condition variable with an RTOS2 style timeout
+* @param - Condition variable
+*        - Locked mutex
+*        - Absolute deadline or NULL to wait forever
+* @return - 0 when signalled, ETIMEDOUT on timeout
+**/
+static int os_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+        if (deadline == NULL)
+                return pthread_cond_wait(cond, lock);
+        return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+static int os_cond_init(pthread_cond_t *cond)
+{
+        pthread_condattr_t attr;
+        int rc;
+
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        rc = pthread_cond_init(cond, &attr);
+        pthread_condattr_destroy(&attr);
+        return rc;
+}
+
+osStatus_t osKernelInitialize(void)
+{
+        pthread_once(&osStartOnce, os_init_start);
+        return osOK;
+}
+
+osStatus_t osKernelStart(void)
+{
+        return osOK;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+        struct timespec now;
+
+        pthread_once(&osStartOnce, os_init_start);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint32_t)((now.tv_sec - osStart.tv_sec) * 1000 + (now.tv_nsec - osStart.tv_nsec) / 1000000L);
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+        return 1000U;
+}
+
+int32_t osKernelLock(void)
+{
+        if (osKernelDepth++ > 0)
+                return 1;
+        pthread_mutex_lock(&osKernelMutex);
+        return 0;
+}
+
+int32_t osKernelRestoreLock(int32_t lock)
+{
+        if (lock != 0 || osKernelDepth == 0)
+                return lock;
+        osKernelDepth = 0;
+        pthread_mutex_unlock(&osKernelMutex);
+        return 0;
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+        struct timespec ts;
+
+        if (ticks == 0)
+                return osErrorParameter;
+        ts.tv_sec = ticks / 1000U;
+        ts.tv_nsec = (long)(ticks % 1000U) * 1000000L;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+                ;
+        return osOK;
+}
+
+static void *os_thread_entry(void *arg)
+{
+        os_thread *t = (os_thread *)arg;
+
+        osCurrent = t;
+        t->func(t->argument);
+        if (!t->joinable)
+                free(t);
+        return NULL;
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr)
+{
+        pthread_attr_t pattr;
+        os_thread *t;
+
+        if (func == NULL)
+                return NULL;
+        t = calloc(1, sizeof(*t));
+        if (t == NULL)
+                return NULL;
+        t->func = func;
+        t->argument = argument;
+        t->joinable = (attr != NULL) && (attr->attr_bits & osThreadJoinable);
+
+        pthread_attr_init(&pattr);
+        pthread_attr_setdetachstate(&pattr, t->joinable ? PTHREAD_CREATE_JOINABLE : PTHREAD_CREATE_DETACHED);
+        if (attr != NULL && attr->stack_size != 0 && attr->stack_size >= PTHREAD_STACK_MIN)
+                pthread_attr_setstacksize(&pattr, attr->stack_size);
+        if (pthread_create(&t->thread, &pattr, os_thread_entry, t) != 0) {
+                pthread_attr_destroy(&pattr);
+                free(t);
+                return NULL;
+        }
+        pthread_attr_destroy(&pattr);
+        if (attr != NULL && attr->name != NULL) {
+                char name[16];
+                strncpy(name, attr->name, sizeof(name) - 1);
+                name[sizeof(name) - 1] = '\0';
+                pthread_setname_np(t->thread, name);
+        }
+        return (osThreadId_t)t;
+}
+
+osThreadId_t osThreadGetId(void)
+{
+        return (osThreadId_t)(osCurrent != NULL ? osCurrent : &osMainThread);
+}
+
+osStatus_t osThreadYield(void)
+{
+        sched_yield();
+        return osOK;
+}
+
+osStatus_t osThreadJoin(osThreadId_t thread_id)
+{
+        os_thread *t = (os_thread *)thread_id;
+
+        if (t == NULL || !t->joinable)
+                return osErrorParameter;
+        if (pthread_join(t->thread, NULL) != 0)
+                return osErrorResource;
+        free(t);
+        return osOK;
+}
+
+osStatus_t osThreadTerminate(osThreadId_t thread_id)
+{
+        os_thread *t = (os_thread *)thread_id;
+
+        if (t == NULL)
+                return osErrorParameter;
+        pthread_cancel(t->thread);
+        if (t->joinable)
+                return osThreadJoin(thread_id);
+        return osOK;
+}
+
+void osThreadExit(void)
+{
+        pthread_exit(NULL);
+}
+
+osMutexId_t osMutexNew(const osMutexAttr_t *attr)
+{
+        pthread_mutexattr_t mattr;
+        pthread_mutex_t *m = malloc(sizeof(*m));
+
+        (void)attr;
+        if (m == NULL)
+                return NULL;
+        pthread_mutexattr_init(&mattr);
+        pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(m, &mattr);
+        pthread_mutexattr_destroy(&mattr);
+        return (osMutexId_t)m;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout)
+{
+        pthread_mutex_t *m = (pthread_mutex_t *)mutex_id;
+        struct timespec deadline;
+        int rc;
+
+        if (m == NULL)
+                return osErrorParameter;
+        if (timeout == osWaitForever)
+                rc = pthread_mutex_lock(m);
+        else if (timeout == 0)
+                rc = pthread_mutex_trylock(m);
+        else {
+                //pthread_mutex_timedlock only supports CLOCK_REALTIME
+                struct timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+                deadline = now;
+                deadline.tv_sec += timeout / 1000U;
+                deadline.tv_nsec += (long)(timeout % 1000U) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                        deadline.tv_sec++;
+                        deadline.tv_nsec -= 1000000000L;
+                }
+                rc = pthread_mutex_timedlock(m, &deadline);
+        }
+        if (rc == 0)
+                return osOK;
+        return (timeout == 0) ? osErrorResource : osErrorTimeout;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id)
+{
+        if (mutex_id == NULL)
+                return osErrorParameter;
+        return pthread_mutex_unlock((pthread_mutex_t *)mutex_id) == 0 ? osOK : osErrorResource;
+}
+
+osStatus_t osMutexDelete(osMutexId_t mutex_id)
+{
+        if (mutex_id == NULL)
+                return osErrorParameter;
+        pthread_mutex_destroy((pthread_mutex_t *)mutex_id);
+        free(mutex_id);
+        return osOK;
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr)
+{
+        os_queue *q;
+
+        (void)attr;
+        if (msg_count == 0 || msg_size == 0)
+                return NULL;
+        q = calloc(1, sizeof(*q));
+        if (q == NULL)
+                return NULL;
+        q->data = malloc((size_t)msg_count * msg_size);
+        if (q->data == NULL) {
+                free(q);
+                return NULL;
+        }
+        q->msgCount = msg_count;
+        q->msgSize = msg_size;
+        pthread_mutex_init(&q->lock, NULL);
+        os_cond_init(&q->notEmpty);
+        os_cond_init(&q->notFull);
+        return (osMessageQueueId_t)q;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout)
+{
+        os_queue *q = (os_queue *)mq_id;
+        struct timespec deadline;
+        osStatus_t status = osOK;
+
+        (void)msg_prio;
+        if (q == NULL || msg_ptr == NULL)
+                return osErrorParameter;
+        if (timeout != 0 && timeout != osWaitForever)
+                os_deadline(timeout, &deadline);
+
+        pthread_mutex_lock(&q->lock);
+        while (q->used == q->msgCount) {
+                if (timeout == 0 ||
+                    os_cond_wait(&q->notFull, &q->lock, timeout == osWaitForever ? NULL : &deadline) == ETIMEDOUT) {
+                        status = (timeout == 0) ? osErrorResource : osErrorTimeout;
+                        break;
+                }
+        }
+        if (status == osOK) {
+                memcpy(&q->data[((q->head + q->used) % q->msgCount) * q->msgSize], msg_ptr, q->msgSize);
+                q->used++;
+                pthread_cond_signal(&q->notEmpty);
+        }
+        pthread_mutex_unlock(&q->lock);
+        return status;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout)
+{
+        os_queue *q = (os_queue *)mq_id;
+        struct timespec deadline;
+        osStatus_t status = osOK;
+
+        if (q == NULL || msg_ptr == NULL)
+                return osErrorParameter;
+        if (timeout != 0 && timeout != osWaitForever)
+                os_deadline(timeout, &deadline);
+
+        pthread_mutex_lock(&q->lock);
+        while (q->used == 0) {
+                if (timeout == 0 ||
+                    os_cond_wait(&q->notEmpty, &q->lock, timeout == osWaitForever ? NULL : &deadline) == ETIMEDOUT) {
+                        status = (timeout == 0) ? osErrorResource : osErrorTimeout;
+                        break;
+                }
+        }
+        if (status == osOK) {
+                memcpy(msg_ptr, &q->data[q->head * q->msgSize], q->msgSize);
+                q->head = (q->head + 1) % q->msgCount;
+                q->used--;
+                if (msg_prio != NULL)
+                        *msg_prio = 0;
+                pthread_cond_signal(&q->notFull);
+        }
+        pthread_mutex_unlock(&q->lock);
+        return status;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id)
+{
+        os_queue *q = (os_queue *)mq_id;
+        uint32_t count;
+
+        if (q == NULL)
+                return 0;
+        pthread_mutex_lock(&q->lock);
+        count = q->used;
+        pthread_mutex_unlock(&q->lock);
+        return count;
+}
+
+osStatus_t osMessageQueueDelete(osMessageQueueId_t mq_id)
+{
+        os_queue *q = (os_queue *)mq_id;
+
+        if (q == NULL)
+                return osErrorParameter;
+        pthread_cond_destroy(&q->notEmpty);
+        pthread_cond_destroy(&q->notFull);
+        pthread_mutex_destroy(&q->lock);
+        free(q->data);
+        free(q);
+        return osOK;
+}
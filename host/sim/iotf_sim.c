@@ -0,0 +1,1479 @@
+/*******************************************************************************
+ * Copyright (c) 2026 Arm Limited
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Arm Limited  -  Initial implementation
+ *                 -  Bulk device simulator, many light devices on one event loop
+ *******************************************************************************/
+
+/*
+ * An iotfclient owns a blocking socket, a full TLS context with its own entropy and
+ * DRBG and two 1 KB MQTT buffers, so a process holds a few hundred of them at most.
+ * Here a device is a small record on a single epoll loop: the configuration, resolved
+ * address, CA chain, client certificate, DRBG and MQTT scratch buffers are shared, a
+ * device only owns its socket, its mbedTLS session and, while it has a partial packet
+ * or unsent bytes, a buffer from a pool. Packets are built with the same Paho
+ * MQTTPacket serializers the library uses and reconnects follow backoff_next.
+ *
+ * The load is a list of phases (publish rate per device, payload size, QoS, command
+ * handling) that run after all devices have connected. The report has the connect
+ * times, per phase throughput and publish to PUBACK/PUBCOMP latency, and with the
+ * in-process broker the latency of injected commands.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#include "MQTTPacket.h"
+
+#include "iotfclient.h"
+#include "iotf_backoff.h"
+#include "iotf_telemetry.h"
+#include "iotf_broker.h"
+
+#define SIM_MAX_PHASES          16
+#define SIM_BUF_SIZE            1024            //pooled buffer for partial packets and unsent bytes
+#define SIM_SLAB                256             //pooled buffers allocated at once
+#define SIM_MAX_PAYLOAD         65536
+#define SIM_SCRATCH             (SIM_MAX_PAYLOAD + 512)
+#define SIM_SAMPLES             65536           //latency reservoir per series
+#define SIM_CONNECT_TIMEOUT_US  30000000U
+#define SIM_EVENTS              1024
+#define SIM_NEVER               (UINT64_MAX / 4)
+#define SIM_EVENT_TOPIC         "iot-2/evt/sim/fmt/json"
+#define SIM_REPLY_TOPIC         "iot-2/evt/cmdresp/fmt/json"
+#define SIM_CMD_FILTER          "iot-2/cmd/+/fmt/+"
+#define SIM_CMD_TOPIC           "iot-2/cmd/sim/fmt/json"
+
+enum { SIM_IDLE, SIM_CONNECTING, SIM_HANDSHAKE, SIM_CONNACK, SIM_SUBACK, SIM_READY };
+
+//Pooled buffer, cap is SIM_BUF_SIZE unless a single packet needs more
+typedef struct sim_buf
+{
+        struct sim_buf *next;
+        uint32_t cap;
+        uint32_t len;
+        uint32_t off;
+        unsigned char data[];
+} sim_buf;
+
+typedef struct
+{
+        mbedtls_net_context net;        //fd -1 while disconnected
+        mbedtls_ssl_context *ssl;       //only while a TLS connection is open
+        sim_buf *in;                    //start of a packet that is not complete yet
+        sim_buf *out;                   //bytes the socket did not take
+        uint32_t tlsChunk;              //length mbedtls_ssl_write must be retried with
+        uint64_t due;                   //time of the live timer entry, 0 if none
+        uint64_t started;               //start of the connect attempt
+        uint64_t nextPublish;
+        uint64_t lastSend;
+        uint64_t sentAt;                //of the QoS1/2 publish in flight
+        iotf_backoff backoff;
+        uint16_t nextId;
+        uint16_t inflightId;
+        uint8_t state;
+        uint8_t owed;                   //a publish fell due while another was in flight
+        uint8_t writable;               //EPOLLOUT is armed
+        uint8_t connectedOnce;
+} sim_device;
+
+typedef struct
+{
+        uint32_t *v;
+        uint32_t len;
+        uint64_t seen;
+} sim_samples;
+
+typedef struct
+{
+        //script
+        uint32_t durationMs;
+        double rate;                    //events per device per second
+        uint32_t size;
+        int qos;
+        int reply;                      //answer every command with an event
+        double inject;                  //commands per second sent by the in-process broker
+        //results
+        uint64_t started;
+        uint64_t ended;
+        uint64_t published;
+        uint64_t acked;
+        uint64_t deferred;
+        uint64_t blocked;
+        uint64_t injected;
+        uint64_t commands;
+        uint64_t replies;
+        uint64_t disconnects;
+        uint64_t bytesOut;
+        uint64_t bytesIn;
+        sim_samples ackLatency;
+        sim_samples cmdLatency;
+} sim_phase;
+
+typedef struct
+{
+        uint64_t t;
+        uint32_t dev;
+} sim_timer;
+
+static struct
+{
+        uint32_t devices;
+        double connectRate;
+        uint32_t keepalive;
+        const char *configFile;
+        const char *script;
+        const char *certDir;
+        int broker;
+        uint32_t seed;
+        const char *output;
+        sim_phase phase;                //defaults of every phase
+} opt = { 1000, 500.0, 60, NULL, NULL, NULL, 0, 1, NULL,
+          { 30000, 0.1, 64, 0, 0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, { NULL, 0, 0 }, { NULL, 0, 0 } } };
+
+//State shared by all devices
+static struct
+{
+        Config cfg;
+        char clientPrefix[128];         //d:<org>:<type>:<id>
+        int registered;
+        int tls;
+        struct sockaddr_storage addr;
+        socklen_t addrLen;
+        mbedtls_ssl_config conf;
+        mbedtls_x509_crt cacert;
+        mbedtls_x509_crt clicert;
+        mbedtls_pk_context pkey;
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context drbg;
+        int ep;
+        unsigned char rx[SIM_SCRATCH];
+        unsigned char tx[SIM_SCRATCH];
+        unsigned char payload[SIM_MAX_PAYLOAD];
+        uint64_t interval;              //between publishes of one device in the current phase
+        uint64_t keepaliveUs;
+        uint32_t rng;
+        iotf_broker *broker;
+        pthread_t injector;
+        uint64_t injectInterval;        //0 while no commands are injected, shared with the injector
+        uint64_t injected;              //by the injector
+        uint64_t injectedBefore;        //at the start of the current phase
+        int injectStop;
+} sim;
+
+static struct
+{
+        uint64_t attempts;
+        uint64_t tcpFailures;
+        uint64_t tlsFailures;
+        uint64_t refused;
+        uint64_t timeouts;
+        uint32_t connected;             //right now
+        uint32_t connectedOnce;
+        uint64_t allConnectedUs;
+        sim_samples latency;
+} conn;
+
+static sim_device *devs;
+static sim_phase phases[1 + SIM_MAX_PHASES];    //phases[0] is the connect ramp
+static int phaseCount;
+static sim_phase *cur;
+
+static sim_timer *heap;
+static uint32_t heapLen;
+static uint32_t heapCap;
+
+static sim_buf *bufFree;
+static uint32_t bufInUse;
+static uint32_t bufHighWater;
+static uint32_t bufLarge;
+
+static volatile sig_atomic_t stop;
+
+static uint64_t now_us(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+static uint32_t rng(void)
+{
+        uint32_t x = sim.rng;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return sim.rng = x;
+}
+
+static double rng_unit(void)
+{
+        return (double)rng() / 4294967296.0;
+}
+
+static void on_signal(int sig)
+{
+        (void)sig;
+        stop = 1;
+}
+
+//Reservoir sample, keeps SIM_SAMPLES values spread evenly over the whole run
+static void sample_add(sim_samples *s, uint64_t us)
+{
+        uint32_t v = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+        uint64_t j;
+
+        if (s->v == NULL && (s->v = malloc(SIM_SAMPLES * sizeof(uint32_t))) == NULL)
+                return;
+        if (s->len < SIM_SAMPLES) {
+                s->v[s->len++] = v;
+        }
+        else {
+                j = (((uint64_t)rng() << 32) | rng()) % (s->seen + 1);
+                if (j < SIM_SAMPLES)
+                        s->v[j] = v;
+        }
+        s->seen++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+        uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+        return (x > y) - (x < y);
+}
+
+//Adds <name>_p50_us, _p99_us, _p999_us and _max_us
+static void sample_report(tb_builder *tb, const char *name, sim_samples *s)
+{
+        static const struct { const char *suffix; uint32_t permille; } q[] = {
+                { "p50_us", 500 }, { "p99_us", 990 }, { "p999_us", 999 }, { "max_us", 1000 }
+        };
+        char key[48];
+        size_t i;
+
+        if (s->len == 0)
+                return;
+        qsort(s->v, s->len, sizeof(uint32_t), cmp_u32);
+        for (i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+                snprintf(key, sizeof(key), "%s_%s", name, q[i].suffix);
+                tb_add_u32(tb, key, s->v[(uint64_t)(s->len - 1) * q[i].permille / 1000U]);
+        }
+}
+
+static void heap_push(uint64_t t, uint32_t dev)
+{
+        uint32_t i;
+
+        if (heapLen == heapCap) {
+                sim_timer *h = realloc(heap, (heapCap ? heapCap * 2 : 1024) * sizeof(sim_timer));
+
+                if (h == NULL) {
+                        fprintf(stderr, "out of memory\n");
+                        exit(1);
+                }
+                heap = h;
+                heapCap = heapCap ? heapCap * 2 : 1024;
+        }
+        i = heapLen++;
+        while (i > 0 && heap[(i - 1) / 2].t > t) {
+                heap[i] = heap[(i - 1) / 2];
+                i = (i - 1) / 2;
+        }
+        heap[i].t = t;
+        heap[i].dev = dev;
+}
+
+static sim_timer heap_pop(void)
+{
+        sim_timer top = heap[0];
+        sim_timer last = heap[--heapLen];
+        uint32_t i = 0, c;
+
+        while ((c = 2 * i + 1) < heapLen) {
+                if (c + 1 < heapLen && heap[c + 1].t < heap[c].t)
+                        c++;
+                if (heap[c].t >= last.t)
+                        break;
+                heap[i] = heap[c];
+                i = c;
+        }
+        heap[i] = last;
+        return top;
+}
+
+//Runs the timer of a device at t unless it already runs earlier. Stale entries are skipped.
+static void arm(sim_device *d, uint64_t t)
+{
+        if (d->due != 0 && d->due <= t)
+                return;
+        d->due = t;
+        heap_push(t, (uint32_t)(d - devs));
+}
+
+static sim_buf *buf_get(size_t need)
+{
+        size_t stride = (sizeof(sim_buf) + SIM_BUF_SIZE + 7U) & ~(size_t)7U;
+        sim_buf *b;
+        int i;
+
+        if (need > SIM_BUF_SIZE) {
+                if ((b = malloc(sizeof(sim_buf) + need)) == NULL)
+                        return NULL;
+                b->cap = (uint32_t)need;
+                bufLarge++;
+        }
+        else {
+                if (bufFree == NULL) {
+                        unsigned char *slab = malloc(SIM_SLAB * stride);
+
+                        if (slab == NULL)
+                                return NULL;
+                        for (i = SIM_SLAB - 1; i >= 0; i--) {
+                                b = (sim_buf *)(slab + i * stride);
+                                b->cap = SIM_BUF_SIZE;
+                                b->next = bufFree;
+                                bufFree = b;
+                        }
+                }
+                b = bufFree;
+                bufFree = b->next;
+                if (++bufInUse > bufHighWater)
+                        bufHighWater = bufInUse;
+        }
+        b->next = NULL;
+        b->len = b->off = 0;
+        return b;
+}
+
+static void buf_put(sim_buf *b)
+{
+        if (b == NULL)
+                return;
+        if (b->cap > SIM_BUF_SIZE) {
+                free(b);
+                return;
+        }
+        b->next = bufFree;
+        bufFree = b;
+        bufInUse--;
+}
+
+static void want_write(sim_device *d, int on)
+{
+        struct epoll_event ev;
+
+        if (d->writable == on)
+                return;
+        ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+        ev.data.u32 = (uint32_t)(d - devs);
+        epoll_ctl(sim.ep, EPOLL_CTL_MOD, d->net.fd, &ev);
+        d->writable = (uint8_t)on;
+}
+
+static uint16_t next_id(sim_device *d)
+{
+        if (++d->nextId == 0)
+                d->nextId = 1;
+        return d->nextId;
+}
+
+/** Function to write to the socket of a device without blocking
+* @return - Bytes written, 0 if the socket is full or -1 on failure
+**/
+static int io_write(sim_device *d, const unsigned char *buf, size_t len)
+{
+        int rc;
+
+        if (d->ssl != NULL) {
+                rc = mbedtls_ssl_write(d->ssl, buf, len);
+                if (rc == MBEDTLS_ERR_SSL_WANT_WRITE || rc == MBEDTLS_ERR_SSL_WANT_READ) {
+                        //mbedTLS keeps the record and expects the same length again
+                        d->tlsChunk = (uint32_t)len;
+                        return 0;
+                }
+                return (rc > 0) ? rc : -1;
+        }
+        rc = (int)send(d->net.fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (rc < 0)
+                return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        return rc;
+}
+
+/** Function to read from the socket of a device without blocking
+* @return - Bytes read, 0 if nothing is available or -1 if the connection is gone
+**/
+static int io_read(sim_device *d, unsigned char *buf, size_t len)
+{
+        int rc;
+
+        if (d->ssl != NULL) {
+                rc = mbedtls_ssl_read(d->ssl, buf, len);
+                if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE)
+                        return 0;
+                return (rc > 0) ? rc : -1;
+        }
+        rc = (int)recv(d->net.fd, buf, len, MSG_DONTWAIT);
+        if (rc < 0)
+                return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        return (rc > 0) ? rc : -1;
+}
+
+//Writes pending bytes, returns 0 or -1 if the connection failed
+static int dev_flush(sim_device *d)
+{
+        sim_buf *out = d->out;
+        int rc;
+
+        while (out->off < out->len) {
+                uint32_t chunk = d->tlsChunk ? d->tlsChunk : out->len - out->off;
+
+                if ((rc = io_write(d, out->data + out->off, chunk)) < 0)
+                        return -1;
+                if (rc == 0) {
+                        want_write(d, 1);
+                        return 0;
+                }
+                out->off += (uint32_t)rc;
+                d->tlsChunk = 0;
+        }
+        buf_put(out);
+        d->out = NULL;
+        want_write(d, 0);
+        return 0;
+}
+
+//Sends a packet, what the socket does not take is kept in a pooled buffer
+static int dev_send(sim_device *d, const unsigned char *buf, size_t len, uint64_t now)
+{
+        sim_buf *out = d->out;
+        size_t off = 0;
+        int rc;
+
+        d->lastSend = now;
+        cur->bytesOut += len;
+        if (out == NULL) {
+                while (off < len) {
+                        if ((rc = io_write(d, buf + off, len - off)) < 0)
+                                return -1;
+                        if (rc == 0)
+                                break;
+                        off += (size_t)rc;
+                        d->tlsChunk = 0;
+                }
+                if (off == len)
+                        return 0;
+                if ((d->out = out = buf_get(len - off)) == NULL)
+                        return -1;
+                want_write(d, 1);
+        }
+        else if (out->cap - out->len < len) {
+                sim_buf *grown = buf_get(out->len - out->off + len);
+
+                if (grown == NULL)
+                        return -1;
+                grown->len = out->len - out->off;
+                memcpy(grown->data, out->data + out->off, grown->len);
+                buf_put(out);
+                d->out = out = grown;
+        }
+        memcpy(out->data + out->len, buf + off, len - off);
+        out->len += (uint32_t)(len - off);
+        return 0;
+}
+
+static void dev_close(sim_device *d)
+{
+        if (d->state == SIM_READY)
+                conn.connected--;
+        if (d->ssl != NULL) {
+                mbedtls_ssl_free(d->ssl);
+                free(d->ssl);
+                d->ssl = NULL;
+        }
+        if (d->net.fd >= 0)
+                close(d->net.fd);
+        d->net.fd = -1;
+        buf_put(d->in);
+        buf_put(d->out);
+        d->in = d->out = NULL;
+        d->tlsChunk = 0;
+        d->inflightId = 0;
+        d->owed = 0;
+        d->writable = 0;
+        d->due = 0;
+        d->state = SIM_IDLE;
+}
+
+//Drops the connection and schedules the next attempt after the library's backoff
+static void dev_fail(sim_device *d, uint64_t now)
+{
+        if (d->state == SIM_READY)
+                cur->disconnects++;
+        dev_close(d);
+        arm(d, now + (uint64_t)backoff_next(&d->backoff) * 1000U);
+}
+
+static void dev_connect(sim_device *d, uint64_t now)
+{
+        struct epoll_event ev;
+        int one = 1;
+        int fd;
+
+        conn.attempts++;
+        d->started = now;
+        if ((fd = socket(sim.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+                conn.tcpFailures++;
+                dev_fail(d, now);
+                return;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        d->net.fd = fd;
+        if (connect(fd, (struct sockaddr *)&sim.addr, sim.addrLen) != 0 && errno != EINPROGRESS) {
+                conn.tcpFailures++;
+                dev_fail(d, now);
+                return;
+        }
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = (uint32_t)(d - devs);
+        if (epoll_ctl(sim.ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                conn.tcpFailures++;
+                dev_fail(d, now);
+                return;
+        }
+        d->writable = 1;
+        d->state = SIM_CONNECTING;
+        arm(d, now + SIM_CONNECT_TIMEOUT_US);
+}
+
+static int dev_mqtt_connect(sim_device *d, uint64_t now)
+{
+        MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+        char clientId[160];
+        int len;
+
+        snprintf(clientId, sizeof(clientId), "%s-%06u", sim.clientPrefix, (unsigned int)(d - devs));
+        data.clientID.cstring = clientId;
+        data.keepAliveInterval = (unsigned short)opt.keepalive;
+        data.cleansession = 1;
+        data.MQTTVersion = 4;
+        if (sim.registered) {
+                data.username.cstring = "use-token-auth";
+                data.password.cstring = sim.cfg.authtoken;
+        }
+        if ((len = MQTTSerialize_connect(sim.tx, SIM_SCRATCH, &data)) <= 0)
+                return -1;
+        want_write(d, 0);
+        d->state = SIM_CONNACK;
+        return dev_send(d, sim.tx, (size_t)len, now);
+}
+
+static void dev_handshake(sim_device *d, uint64_t now)
+{
+        int rc = mbedtls_ssl_handshake(d->ssl);
+
+        if (rc == 0) {
+                if (dev_mqtt_connect(d, now) != 0)
+                        dev_fail(d, now);
+        }
+        else if (rc == MBEDTLS_ERR_SSL_WANT_READ) {
+                want_write(d, 0);
+        }
+        else if (rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                want_write(d, 1);
+        }
+        else {
+                conn.tlsFailures++;
+                dev_fail(d, now);
+        }
+}
+
+//TCP connect finished, starts TLS or MQTT
+static void dev_connected(sim_device *d, uint64_t now)
+{
+        socklen_t len = sizeof(int);
+        int err = 0;
+
+        if (getsockopt(d->net.fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+                conn.tcpFailures++;
+                dev_fail(d, now);
+                return;
+        }
+        if (!sim.tls) {
+                if (dev_mqtt_connect(d, now) != 0)
+                        dev_fail(d, now);
+                return;
+        }
+        if ((d->ssl = malloc(sizeof(mbedtls_ssl_context))) == NULL) {
+                dev_fail(d, now);
+                return;
+        }
+        mbedtls_ssl_init(d->ssl);
+        if (mbedtls_ssl_setup(d->ssl, &sim.conf) != 0 || mbedtls_ssl_set_hostname(d->ssl, sim.cfg.hostname) != 0) {
+                conn.tlsFailures++;
+                dev_fail(d, now);
+                return;
+        }
+        mbedtls_ssl_set_bio(d->ssl, &d->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+        d->state = SIM_HANDSHAKE;
+        dev_handshake(d, now);
+}
+
+static void dev_schedule(sim_device *d, uint64_t now)
+{
+        uint64_t t;
+
+        t = (d->nextPublish < d->lastSend + sim.keepaliveUs) ? d->nextPublish : d->lastSend + sim.keepaliveUs;
+        arm(d, t > now ? t : now);
+}
+
+static int dev_publish(sim_device *d, uint64_t now)
+{
+        MQTTString topic = MQTTString_initializer;
+        unsigned short id = 0;
+        int len;
+
+        if (d->out != NULL) {
+                cur->blocked++;
+                return 0;
+        }
+        if (d->inflightId != 0) {
+                //The library waits for the acknowledgement too, the event goes out late
+                if (d->owed)
+                        cur->blocked++;
+                else
+                        cur->deferred++;
+                d->owed = 1;
+                return 0;
+        }
+        if (cur->qos > 0) {
+                id = next_id(d);
+                d->inflightId = id;
+                d->sentAt = now;
+        }
+        topic.cstring = SIM_EVENT_TOPIC;
+        len = MQTTSerialize_publish(sim.tx, SIM_SCRATCH, 0, cur->qos, 0, id, topic, sim.payload, (int)cur->size);
+        if (len <= 0)
+                return -1;
+        cur->published++;
+        return dev_send(d, sim.tx, (size_t)len, now);
+}
+
+static int dev_ack(sim_device *d, unsigned char type, unsigned short id, uint64_t now)
+{
+        unsigned char ack[4];
+        int len = MQTTSerialize_ack(ack, sizeof(ack), type, 0, id);
+
+        return (len > 0) ? dev_send(d, ack, (size_t)len, now) : -1;
+}
+
+//Handles a command. Injected commands carry their send time as {"t":<us>}.
+static int dev_command(sim_device *d, unsigned char *pkt, int len, uint64_t now)
+{
+        MQTTString topic = MQTTString_initializer;
+        unsigned char dup, retained, *payload;
+        unsigned short id;
+        int qos, plen, i;
+        uint64_t t = 0;
+
+        if (MQTTDeserialize_publish(&dup, &qos, &retained, &id, &topic, &payload, &plen, pkt, len) != 1)
+                return -1;
+        cur->commands++;
+        if (plen > 5 && memcmp(payload, "{\"t\":", 5) == 0) {
+                for (i = 5; i < plen && payload[i] >= '0' && payload[i] <= '9'; i++)
+                        t = t * 10U + (uint64_t)(payload[i] - '0');
+                if (t > 0 && t <= now)
+                        sample_add(&cur->cmdLatency, now - t);
+        }
+        if (qos == 1 && dev_ack(d, PUBACK, id, now) != 0)
+                return -1;
+        if (qos == 2 && dev_ack(d, PUBREC, id, now) != 0)
+                return -1;
+        if (cur->reply && d->out == NULL) {
+                topic.cstring = SIM_REPLY_TOPIC;
+                topic.lenstring.len = 0;
+                topic.lenstring.data = NULL;
+                if ((len = MQTTSerialize_publish(sim.tx, SIM_SCRATCH, 0, 0, 0, 0, topic, payload, plen)) <= 0)
+                        return -1;
+                cur->replies++;
+                return dev_send(d, sim.tx, (size_t)len, now);
+        }
+        return 0;
+}
+
+/** Function to handle one packet received by a device
+* @return - 0 or -1 to drop the connection
+**/
+static int dev_packet(sim_device *d, unsigned char *pkt, int len, uint64_t now)
+{
+        MQTTString filter = MQTTString_initializer;
+        unsigned char type, dup, present, rc;
+        unsigned short id;
+        int qos = 1;
+
+        switch (pkt[0] >> 4) {
+        case CONNACK:
+                if (d->state != SIM_CONNACK || MQTTDeserialize_connack(&present, &rc, pkt, len) != 1 || rc != 0) {
+                        conn.refused++;
+                        return -1;
+                }
+                d->state = SIM_SUBACK;
+                filter.cstring = SIM_CMD_FILTER;
+                if ((len = MQTTSerialize_subscribe(sim.tx, SIM_SCRATCH, 0, next_id(d), 1, &filter, &qos)) <= 0)
+                        return -1;
+                return dev_send(d, sim.tx, (size_t)len, now);
+        case SUBACK:
+                if (d->state != SIM_SUBACK)
+                        return -1;
+                d->state = SIM_READY;
+                conn.connected++;
+                if (!d->connectedOnce) {
+                        d->connectedOnce = 1;
+                        if (++conn.connectedOnce == opt.devices)
+                                conn.allConnectedUs = now - phases[0].started;
+                }
+                sample_add(&conn.latency, now - d->started);
+                backoff_reset(&d->backoff);
+                d->nextPublish = (cur->rate > 0) ? now + (uint64_t)(rng_unit() * (double)sim.interval) : SIM_NEVER;
+                d->due = 0;
+                dev_schedule(d, now);
+                return 0;
+        case PUBACK:
+        case PUBCOMP:
+                if (MQTTDeserialize_ack(&type, &dup, &id, pkt, len) != 1)
+                        return -1;
+                if (id != d->inflightId || id == 0)
+                        return 0;
+                cur->acked++;
+                sample_add(&cur->ackLatency, now - d->sentAt);
+                d->inflightId = 0;
+                if (d->owed) {
+                        d->owed = 0;
+                        return dev_publish(d, now);
+                }
+                return 0;
+        case PUBREC:
+                if (MQTTDeserialize_ack(&type, &dup, &id, pkt, len) != 1)
+                        return -1;
+                return dev_ack(d, PUBREL, id, now);
+        case PUBREL:
+                if (MQTTDeserialize_ack(&type, &dup, &id, pkt, len) != 1)
+                        return -1;
+                return dev_ack(d, PUBCOMP, id, now);
+        case PUBLISH:
+                return (d->state == SIM_READY) ? dev_command(d, pkt, len, now) : -1;
+        case PINGRESP:
+                return 0;
+        default:
+                return -1;
+        }
+}
+
+/** Function to find the length of the packet at the start of a buffer
+* @return - 1 if a whole packet is available, 0 if more data is needed, -1 if malformed
+**/
+static int packet_length(const unsigned char *buf, size_t len, size_t *total)
+{
+        size_t value = 0, mult = 1, i;
+
+        for (i = 1; i < len && i <= 4; i++) {
+                value += (buf[i] & 0x7fU) * mult;
+                mult *= 128;
+                if ((buf[i] & 0x80) == 0) {
+                        *total = i + 1 + value;
+                        return (len >= *total) ? 1 : 0;
+                }
+        }
+        return (i > 4) ? -1 : 0;
+}
+
+//Reads until the socket is drained. Packets are parsed in the shared buffer.
+static void dev_read(sim_device *d, uint64_t now)
+{
+        unsigned char *rx = sim.rx;
+        size_t have = 0, used, total;
+        int rc, state;
+
+        if (d->in != NULL) {
+                have = d->in->len;
+                memcpy(rx, d->in->data, have);
+                buf_put(d->in);
+                d->in = NULL;
+        }
+        do {
+                if ((rc = io_read(d, rx + have, SIM_SCRATCH - have)) < 0) {
+                        dev_fail(d, now);
+                        return;
+                }
+                have += (size_t)rc;
+                cur->bytesIn += (uint64_t)rc;
+                used = 0;
+                while ((state = packet_length(rx + used, have - used, &total)) == 1) {
+                        if (dev_packet(d, rx + used, (int)total, now) != 0) {
+                                dev_fail(d, now);
+                                return;
+                        }
+                        used += total;
+                }
+                if (state < 0 || (used == 0 && have == SIM_SCRATCH)) {
+                        dev_fail(d, now);
+                        return;
+                }
+                memmove(rx, rx + used, have - used);
+                have -= used;
+        } while (rc > 0);
+
+        if (have > 0) {
+                if ((d->in = buf_get(have)) == NULL) {
+                        dev_fail(d, now);
+                        return;
+                }
+                memcpy(d->in->data, rx, have);
+                d->in->len = (uint32_t)have;
+        }
+}
+
+static void dev_event(sim_device *d, uint32_t events, uint64_t now)
+{
+        switch (d->state) {
+        case SIM_CONNECTING:
+                dev_connected(d, now);
+                return;
+        case SIM_HANDSHAKE:
+                dev_handshake(d, now);
+                return;
+        case SIM_IDLE:
+                return;
+        }
+        if ((events & EPOLLOUT) && d->out != NULL && dev_flush(d) != 0) {
+                dev_fail(d, now);
+                return;
+        }
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                dev_read(d, now);
+}
+
+static void dev_timer(sim_device *d, uint64_t now)
+{
+        unsigned char ping[2];
+        int len;
+
+        switch (d->state) {
+        case SIM_IDLE:
+                dev_connect(d, now);
+                return;
+        case SIM_READY:
+                break;
+        default:
+                if (now >= d->started + SIM_CONNECT_TIMEOUT_US) {
+                        conn.timeouts++;
+                        dev_fail(d, now);
+                }
+                else {
+                        arm(d, d->started + SIM_CONNECT_TIMEOUT_US);
+                }
+                return;
+        }
+
+        if (d->nextPublish <= now) {
+                d->nextPublish += sim.interval;
+                if (d->nextPublish <= now)
+                        d->nextPublish = now + sim.interval;
+                if (dev_publish(d, now) != 0) {
+                        dev_fail(d, now);
+                        return;
+                }
+        }
+        if (d->lastSend + sim.keepaliveUs <= now) {
+                len = MQTTSerialize_pingreq(ping, sizeof(ping));
+                if (len <= 0 || dev_send(d, ping, (size_t)len, now) != 0) {
+                        dev_fail(d, now);
+                        return;
+                }
+        }
+        dev_schedule(d, now);
+}
+
+//JSON-looking payload of exactly size bytes
+static void build_payload(uint32_t size)
+{
+        static const char head[] = "{\"d\":{\"sim\":\"";
+        static const char tail[] = "\"}}";
+
+        memset(sim.payload, 'x', size);
+        if (size >= sizeof(head) + sizeof(tail) - 2) {
+                memcpy(sim.payload, head, sizeof(head) - 1);
+                memcpy(sim.payload + size - (sizeof(tail) - 1), tail, sizeof(tail) - 1);
+        }
+}
+
+static void phase_end(uint64_t now)
+{
+        cur->ended = now;
+        cur->injected = __atomic_load_n(&sim.injected, __ATOMIC_RELAXED) - sim.injectedBefore;
+}
+
+static void phase_start(int i, uint64_t now)
+{
+        uint32_t n;
+
+        if (cur != NULL)
+                phase_end(now);
+        cur = &phases[i];
+        cur->started = now;
+        sim.interval = (cur->rate > 0) ? (uint64_t)(1e6 / cur->rate) : SIM_NEVER;
+        if (sim.interval == 0)
+                sim.interval = 1;
+        build_payload(cur->size);
+        sim.injectedBefore = __atomic_load_n(&sim.injected, __ATOMIC_RELAXED);
+        __atomic_store_n(&sim.injectInterval, (cur->inject > 0) ? (uint64_t)(1e6 / cur->inject) + 1U : 0U,
+                         __ATOMIC_RELAXED);
+
+        //Publishes of each device start at a random point of the first interval
+        for (n = 0; n < opt.devices; n++) {
+                sim_device *d = &devs[n];
+
+                if (d->state != SIM_READY)
+                        continue;
+                d->nextPublish = (cur->rate > 0) ? now + (uint64_t)(rng_unit() * (double)sim.interval) : SIM_NEVER;
+                d->due = 0;
+                dev_schedule(d, now);
+        }
+}
+
+/*
+ * Commands are injected from a thread of their own. The broker holds its lock while it
+ * writes to a device socket, so the event loop must never wait for it.
+ */
+static void *injector(void *arg)
+{
+        char payload[32];
+        uint64_t now, next = now_us(), interval;
+        int len;
+
+        (void)arg;
+        while (!__atomic_load_n(&sim.injectStop, __ATOMIC_RELAXED)) {
+                interval = __atomic_load_n(&sim.injectInterval, __ATOMIC_RELAXED);
+                now = now_us();
+                if (interval == 0 || now < next) {
+                        if (interval == 0)
+                                next = now;
+                        usleep((interval == 0 || next - now > 10000U) ? 10000U : (useconds_t)(next - now));
+                        continue;
+                }
+                len = snprintf(payload, sizeof(payload), "{\"t\":%llu}", (unsigned long long)now);
+                iotf_broker_inject(sim.broker, SIM_CMD_TOPIC, payload, len);
+                __atomic_fetch_add(&sim.injected, 1, __ATOMIC_RELAXED);
+                //Falling behind by more than a second drops the backlog instead of bursting
+                next = (next + interval + 1000000U < now) ? now : next + interval;
+        }
+        return NULL;
+}
+
+//Current resident set in kB
+static long rss_kb(void)
+{
+        char line[128];
+        long kb = -1;
+        FILE *f = fopen("/proc/self/status", "r");
+
+        if (f == NULL)
+                return -1;
+        while (fgets(line, sizeof(line), f) != NULL)
+                if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+                        break;
+        fclose(f);
+        return kb;
+}
+
+static int phase_key(sim_phase *p, const char *key, const char *value)
+{
+        char *end;
+        double v = strtod(value, &end);
+
+        if (strcmp(key, "commands") == 0) {
+                if (strcmp(value, "reply") == 0)
+                        p->reply = 1;
+                else if (strcmp(value, "ignore") == 0)
+                        p->reply = 0;
+                else
+                        return -1;
+                return 0;
+        }
+        if (end == value || *end != '\0' || v < 0)
+                return -1;
+        if (strcmp(key, "duration") == 0 && v > 0)
+                p->durationMs = (uint32_t)(v * 1000.0);
+        else if (strcmp(key, "rate") == 0)
+                p->rate = v;
+        else if (strcmp(key, "size") == 0 && v <= SIM_MAX_PAYLOAD)
+                p->size = (uint32_t)v;
+        else if (strcmp(key, "qos") == 0 && v <= 2)
+                p->qos = (int)v;
+        else if (strcmp(key, "inject") == 0)
+                p->inject = v;
+        else
+                return -1;
+        return 0;
+}
+
+/** Function to load the phases, one line of key=value pairs per phase. Keys that are
+* not given keep the values of the command line.
+* @return - 0 or -1 on error
+**/
+static int load_script(const char *path)
+{
+        char line[256], *save, *tok, *eq;
+        FILE *f = fopen(path, "r");
+        int lineNo = 0, any;
+
+        if (f == NULL) {
+                perror(path);
+                return -1;
+        }
+        while (fgets(line, sizeof(line), f) != NULL) {
+                sim_phase *p = &phases[1 + phaseCount];
+
+                lineNo++;
+                if ((tok = strchr(line, '#')) != NULL)
+                        *tok = '\0';
+                *p = opt.phase;
+                any = 0;
+                for (tok = strtok_r(line, " \t\r\n", &save); tok != NULL; tok = strtok_r(NULL, " \t\r\n", &save)) {
+                        if ((eq = strchr(tok, '=')) == NULL || phaseCount == SIM_MAX_PHASES)
+                                break;
+                        *eq = '\0';
+                        if (phase_key(p, tok, eq + 1) != 0)
+                                break;
+                        any = 1;
+                }
+                if (tok != NULL) {
+                        fprintf(stderr, "%s:%d: invalid phase\n", path, lineNo);
+                        fclose(f);
+                        return -1;
+                }
+                if (any)
+                        phaseCount++;
+        }
+        fclose(f);
+        return 0;
+}
+
+static int tls_setup(void)
+{
+        char caPath[512];
+        const char *ca = sim.cfg.serverCertPath;
+
+        mbedtls_ssl_config_init(&sim.conf);
+        mbedtls_x509_crt_init(&sim.cacert);
+        mbedtls_x509_crt_init(&sim.clicert);
+        mbedtls_pk_init(&sim.pkey);
+        mbedtls_entropy_init(&sim.entropy);
+        mbedtls_ctr_drbg_init(&sim.drbg);
+
+        if (opt.certDir != NULL) {
+                snprintf(caPath, sizeof(caPath), "%s/ca.pem", opt.certDir);
+                ca = caPath;
+        }
+        if (mbedtls_ctr_drbg_seed(&sim.drbg, mbedtls_entropy_func, &sim.entropy,
+                                  (const unsigned char *)"iotf_sim", 8) != 0)
+                return -1;
+        if (ca == NULL || mbedtls_x509_crt_parse_file(&sim.cacert, ca) != 0) {
+                fprintf(stderr, "cannot load server certificate %s\n", ca ? ca : "(none)");
+                return -1;
+        }
+        if (opt.certDir == NULL && sim.cfg.rootCACertPath != NULL &&
+            mbedtls_x509_crt_parse_file(&sim.cacert, sim.cfg.rootCACertPath) != 0) {
+                fprintf(stderr, "cannot load %s\n", sim.cfg.rootCACertPath);
+                return -1;
+        }
+        if (mbedtls_ssl_config_defaults(&sim.conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+                return -1;
+        //Same protocol settings as tls_connect
+        mbedtls_ssl_conf_max_version(&sim.conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        mbedtls_ssl_conf_min_version(&sim.conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        mbedtls_ssl_conf_authmode(&sim.conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&sim.conf, &sim.cacert, NULL);
+        mbedtls_ssl_conf_rng(&sim.conf, mbedtls_ctr_drbg_random, &sim.drbg);
+        if (sim.cfg.useClientCertificates) {
+                if (sim.cfg.clientCertPath == NULL || sim.cfg.clientKeyPath == NULL ||
+                    mbedtls_x509_crt_parse_file(&sim.clicert, sim.cfg.clientCertPath) != 0 ||
+                    mbedtls_pk_parse_keyfile(&sim.pkey, sim.cfg.clientKeyPath, "", mbedtls_ctr_drbg_random, &sim.drbg) != 0 ||
+                    mbedtls_ssl_conf_own_cert(&sim.conf, &sim.clicert, &sim.pkey) != 0) {
+                        fprintf(stderr, "cannot load the client certificate\n");
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+static void tls_cleanup(void)
+{
+        mbedtls_ssl_config_free(&sim.conf);
+        mbedtls_x509_crt_free(&sim.cacert);
+        mbedtls_x509_crt_free(&sim.clicert);
+        mbedtls_pk_free(&sim.pkey);
+        mbedtls_ctr_drbg_free(&sim.drbg);
+        mbedtls_entropy_free(&sim.entropy);
+}
+
+/** Function to load the device template and resolve the broker address once
+* @return - 0 or -1 on error
+**/
+static int setup(void)
+{
+        struct addrinfo hints, *res;
+        char port[8];
+        const char *host;
+        size_t len;
+        int rc;
+
+        config_init(&sim.cfg);
+        if (opt.configFile != NULL) {
+                disableLogging();
+                if ((rc = get_config((char *)opt.configFile, &sim.cfg)) != 0) {
+                        fprintf(stderr, "%s: invalid configuration (%d)\n", opt.configFile, rc);
+                        return -1;
+                }
+        }
+        else if (config_set_str(&sim.cfg, &sim.cfg.org, "quickstart") != 0 || config_finish(&sim.cfg) != 0) {
+                return -1;
+        }
+        if ((sim.cfg.type == NULL && config_set_str(&sim.cfg, &sim.cfg.type, "iotf-sim") != 0) ||
+            (sim.cfg.id == NULL && config_set_str(&sim.cfg, &sim.cfg.id, "sim") != 0))
+                return -1;
+        len = strlen(sim.cfg.org) + strlen(sim.cfg.domain) + 11;
+        if (config_reserve(&sim.cfg, &sim.cfg.hostname, len) == NULL)
+                return -1;
+        snprintf(sim.cfg.hostname, len + 1, "%s.messaging.%s", sim.cfg.org, sim.cfg.domain);
+        snprintf(sim.clientPrefix, sizeof(sim.clientPrefix), "d:%s:%s:%s", sim.cfg.org, sim.cfg.type, sim.cfg.id);
+        sim.registered = strcmp(sim.cfg.org, "quickstart") != 0;
+        sim.tls = sim.registered;
+
+        host = (sim.cfg.host != NULL) ? sim.cfg.host : sim.cfg.hostname;
+        snprintf(port, sizeof(port), "%d", sim.cfg.port);
+        if (sim.broker != NULL) {
+                host = "127.0.0.1";
+                snprintf(port, sizeof(port), "%d", iotf_broker_port(sim.broker, sim.tls));
+        }
+        if (sim.tls && tls_setup() != 0)
+                return -1;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if ((rc = getaddrinfo(host, port, &hints, &res)) != 0) {
+                fprintf(stderr, "%s: %s\n", host, gai_strerror(rc));
+                return -1;
+        }
+        memcpy(&sim.addr, res->ai_addr, res->ai_addrlen);
+        sim.addrLen = res->ai_addrlen;
+        freeaddrinfo(res);
+        return 0;
+}
+
+//Raises the descriptor limit to the hard limit, one descriptor per device plus the broker side
+static int raise_fd_limit(uint32_t need)
+{
+        struct rlimit rl;
+
+        if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+                return -1;
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur < need) {
+                fprintf(stderr, "open file limit %llu is below the %u needed\n",
+                        (unsigned long long)rl.rlim_cur, need);
+                return -1;
+        }
+        return 0;
+}
+
+static void report_phase(tb_builder *tb, sim_phase *p)
+{
+        double seconds = (double)(p->ended - p->started) / 1e6;
+
+        tb_begin_obj(tb, NULL);
+        tb_add_double(tb, "duration_s", seconds, 1);
+        tb_add_double(tb, "rate_per_device", p->rate, 3);
+        tb_add_u32(tb, "size", p->size);
+        tb_add_i32(tb, "qos", p->qos);
+        tb_add_str(tb, "command_mode", p->reply ? "reply" : "ignore");
+        tb_add_i64(tb, "published", (int64_t)p->published);
+        tb_add_double(tb, "events_per_s", seconds > 0 ? (double)p->published / seconds : 0.0, 1);
+        tb_add_double(tb, "mbit_out_per_s", seconds > 0 ? (double)p->bytesOut * 8.0 / seconds / 1e6 : 0.0, 2);
+        tb_add_double(tb, "mbit_in_per_s", seconds > 0 ? (double)p->bytesIn * 8.0 / seconds / 1e6 : 0.0, 2);
+        if (p->qos > 0) {
+                tb_add_i64(tb, "acked", (int64_t)p->acked);
+                sample_report(tb, "ack", &p->ackLatency);
+        }
+        tb_add_i64(tb, "deferred", (int64_t)p->deferred);
+        tb_add_i64(tb, "blocked", (int64_t)p->blocked);
+        if (p->inject > 0)
+                tb_add_i64(tb, "injected", (int64_t)p->injected);
+        tb_add_i64(tb, "commands", (int64_t)p->commands);
+        sample_report(tb, "command", &p->cmdLatency);
+        if (p->reply)
+                tb_add_i64(tb, "replies", (int64_t)p->replies);
+        tb_add_i64(tb, "disconnects", (int64_t)p->disconnects);
+        tb_end_obj(tb);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -n count    devices (1000)\n"
+                "  -r rate     connects per second while ramping up (500)\n"
+                "  -f file     device.cfg template, device ids are <id>-<n> (quickstart)\n"
+                "  -s file     phase script, one line of key=value pairs per phase:\n"
+                "              duration, rate, size, qos, commands (ignore|reply), inject\n"
+                "  -t s        duration of a phase (30)\n"
+                "  -e rate     events per device per second (0.1)\n"
+                "  -b bytes    event payload size (64)\n"
+                "  -q qos      event QoS (0)\n"
+                "  -c mode     command handling, ignore or reply (ignore)\n"
+                "  -i rate     commands per second injected by the broker stand-in (0)\n"
+                "  -k s        MQTT keepalive (60)\n"
+                "  -B          start the broker stand-in in-process, overrides host and port\n"
+                "  -K dir      ca.pem, server.pem and server.key for the broker's TLS listener\n"
+                "  -S seed     seed of publish phases and backoff (1)\n"
+                "  -o file     JSON output, stdout if omitted\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+        static char json[32768];
+        struct epoll_event events[SIM_EVENTS];
+        iotf_broker_config brokerCfg = { 0, -1, NULL, NULL, 0, 0, 0, 0, 0, 0, 0 };
+        iotf_broker_stats brokerStats;
+        char certPath[512], keyPath[512];
+        uint64_t now, next, phaseEnd, rampEnd;
+        long rssBefore, rssAfter;
+        tb_builder tb;
+        FILE *out = stdout;
+        uint32_t i;
+        int c, n, len, phase = 0;
+
+        while ((c = getopt(argc, argv, "n:r:f:s:t:e:b:q:c:i:k:BK:S:o:")) != -1) {
+                switch (c) {
+                case 'n': opt.devices = strtoul(optarg, NULL, 0); break;
+                case 'r': opt.connectRate = atof(optarg); break;
+                case 'f': opt.configFile = optarg; break;
+                case 's': opt.script = optarg; break;
+                case 'k': opt.keepalive = strtoul(optarg, NULL, 0); break;
+                case 'B': opt.broker = 1; break;
+                case 'K': opt.certDir = optarg; break;
+                case 'S': opt.seed = strtoul(optarg, NULL, 0); break;
+                case 'o': opt.output = optarg; break;
+                case 't': if (phase_key(&opt.phase, "duration", optarg) != 0) { usage(argv[0]); return 2; } break;
+                case 'e': if (phase_key(&opt.phase, "rate", optarg) != 0) { usage(argv[0]); return 2; } break;
+                case 'b': if (phase_key(&opt.phase, "size", optarg) != 0) { usage(argv[0]); return 2; } break;
+                case 'q': if (phase_key(&opt.phase, "qos", optarg) != 0) { usage(argv[0]); return 2; } break;
+                case 'c': if (phase_key(&opt.phase, "commands", optarg) != 0) { usage(argv[0]); return 2; } break;
+                case 'i': if (phase_key(&opt.phase, "inject", optarg) != 0) { usage(argv[0]); return 2; } break;
+                default: usage(argv[0]); return 2;
+                }
+        }
+        if (opt.devices == 0 || opt.connectRate <= 0 || opt.keepalive == 0 || opt.keepalive > 65535) {
+                usage(argv[0]);
+                return 2;
+        }
+        if (opt.script != NULL && load_script(opt.script) != 0)
+                return 2;
+        if (phaseCount == 0)
+                phases[++phaseCount] = opt.phase;
+        phases[0] = opt.phase;
+        phases[0].rate = 0;
+        phases[0].inject = 0;
+
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        //mbedtls_net_send writes with write(), a peer reset must not end the process
+        signal(SIGPIPE, SIG_IGN);
+        if (raise_fd_limit(opt.devices * (opt.broker ? 2U : 1U) + 64U) != 0)
+                return 1;
+
+        if (opt.broker) {
+                brokerCfg.maxConnections = opt.devices + 16U;
+                if (opt.certDir != NULL) {
+                        snprintf(certPath, sizeof(certPath), "%s/server.pem", opt.certDir);
+                        snprintf(keyPath, sizeof(keyPath), "%s/server.key", opt.certDir);
+                        brokerCfg.tlsPort = 0;
+                        brokerCfg.certFile = certPath;
+                        brokerCfg.keyFile = keyPath;
+                }
+                if ((sim.broker = iotf_broker_start(&brokerCfg)) == NULL) {
+                        fprintf(stderr, "cannot start broker\n");
+                        return 1;
+                }
+        }
+        sim.rng = opt.seed * 2654435761U + 1U;
+        if (sim.rng == 0)
+                sim.rng = 1;
+        sim.keepaliveUs = (uint64_t)opt.keepalive * 1000000U;
+        if (setup() != 0 || (sim.ep = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+                iotf_broker_stop(sim.broker);
+                return 1;
+        }
+        if (sim.broker != NULL && sim.tls && iotf_broker_port(sim.broker, 1) <= 0) {
+                fprintf(stderr, "%s is not a quickstart configuration, the broker needs -K\n", opt.configFile);
+                iotf_broker_stop(sim.broker);
+                return 1;
+        }
+
+        rssBefore = rss_kb();
+        if ((devs = calloc(opt.devices, sizeof(sim_device))) == NULL) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+        }
+        now = now_us();
+        phase_start(0, now);
+        for (i = 0; i < opt.devices; i++) {
+                devs[i].net.fd = -1;
+                backoff_init(&devs[i].backoff, BACKOFF_BASE_MS, BACKOFF_CAP_MS, opt.seed * 2654435761U + i * 40503U + 1U);
+                arm(&devs[i], now + (uint64_t)((double)i * 1e6 / opt.connectRate));
+        }
+        rampEnd = now + (uint64_t)((double)opt.devices * 1e6 / opt.connectRate) + SIM_CONNECT_TIMEOUT_US;
+        phaseEnd = rampEnd;
+        rssAfter = -1;
+        if (sim.broker != NULL && pthread_create(&sim.injector, NULL, injector, NULL) != 0) {
+                fprintf(stderr, "cannot start the command injector\n");
+                return 1;
+        }
+
+        while (!stop) {
+                now = now_us();
+                if (phase == 0 ? (conn.connectedOnce == opt.devices || now >= rampEnd) : now >= phaseEnd) {
+                        if (phase == 0)
+                                rssAfter = rss_kb();
+                        if (phase == phaseCount) {
+                                phase_end(now);
+                                break;
+                        }
+                        phase_start(++phase, now);
+                        phaseEnd = now + (uint64_t)cur->durationMs * 1000U;
+                }
+                while (heapLen > 0 && heap[0].t <= now) {
+                        sim_timer e = heap_pop();
+                        sim_device *d = &devs[e.dev];
+
+                        if (e.t != d->due)
+                                continue;
+                        d->due = 0;
+                        dev_timer(d, now);
+                }
+
+                next = phaseEnd;
+                if (heapLen > 0 && heap[0].t < next)
+                        next = heap[0].t;
+                if (next > now + 100000U)
+                        next = now + 100000U;
+                n = epoll_wait(sim.ep, events, SIM_EVENTS, next > now ? (int)((next - now + 999U) / 1000U) : 0);
+                now = now_us();
+                for (c = 0; c < n; c++)
+                        dev_event(&devs[events[c].data.u32], events[c].events, now);
+        }
+        if (cur->ended == 0)
+                phase_end(now_us());
+        if (rssAfter < 0)
+                rssAfter = rss_kb();
+
+        tb_begin(&tb, json, sizeof(json));
+        tb_begin_obj(&tb, "config");
+        tb_add_u32(&tb, "devices", opt.devices);
+        tb_add_double(&tb, "connect_rate", opt.connectRate, 1);
+        tb_add_bool(&tb, "tls", sim.tls);
+        tb_add_u32(&tb, "keepalive_s", opt.keepalive);
+        tb_add_bool(&tb, "broker", sim.broker != NULL);
+        tb_end_obj(&tb);
+        tb_begin_obj(&tb, "connect");
+        tb_add_i64(&tb, "attempts", (int64_t)conn.attempts);
+        tb_add_u32(&tb, "connected", conn.connectedOnce);
+        tb_add_u32(&tb, "connected_at_end", conn.connected);
+        if (conn.connectedOnce == opt.devices)
+                tb_add_i64(&tb, "all_connected_ms", (int64_t)(conn.allConnectedUs / 1000U));
+        sample_report(&tb, "connect", &conn.latency);
+        tb_add_i64(&tb, "tcp_failures", (int64_t)conn.tcpFailures);
+        tb_add_i64(&tb, "tls_failures", (int64_t)conn.tlsFailures);
+        tb_add_i64(&tb, "refused", (int64_t)conn.refused);
+        tb_add_i64(&tb, "timeouts", (int64_t)conn.timeouts);
+        tb_end_obj(&tb);
+        tb_begin_obj(&tb, "memory");
+        tb_add_i32(&tb, "rss_kb", (int32_t)rssAfter);
+        if (rssBefore >= 0 && rssAfter >= rssBefore)
+                tb_add_u32(&tb, "bytes_per_device", (uint32_t)((uint64_t)(rssAfter - rssBefore) * 1024U / opt.devices));
+        tb_add_u32(&tb, "device_record_bytes", (uint32_t)sizeof(sim_device));
+        tb_add_u32(&tb, "pool_buffers_high_water", bufHighWater);
+        tb_add_u32(&tb, "large_buffers", bufLarge);
+        tb_end_obj(&tb);
+        tb_begin_array(&tb, "phases");
+        for (c = 1; c <= phase && c <= phaseCount; c++)
+                report_phase(&tb, &phases[c]);
+        tb_end_array(&tb);
+        if (sim.broker != NULL) {
+                iotf_broker_get_stats(sim.broker, &brokerStats);
+                tb_begin_obj(&tb, "broker");
+                tb_add_u32(&tb, "connections", brokerStats.connections);
+                tb_add_u32(&tb, "publishes_in", brokerStats.publishesIn);
+                tb_add_u32(&tb, "publishes_out", brokerStats.publishesOut);
+                tb_end_obj(&tb);
+        }
+        len = tb_end(&tb);
+
+        if (sim.broker != NULL) {
+                __atomic_store_n(&sim.injectStop, 1, __ATOMIC_RELAXED);
+                pthread_join(sim.injector, NULL);
+        }
+        for (i = 0; i < opt.devices; i++)
+                dev_close(&devs[i]);
+        iotf_broker_stop(sim.broker);
+        if (sim.tls)
+                tls_cleanup();
+        config_release(&sim.cfg);
+        close(sim.ep);
+
+        if (len < 0) {
+                fprintf(stderr, "result buffer too small\n");
+                return 1;
+        }
+        if (opt.output != NULL && (out = fopen(opt.output, "w")) == NULL) {
+                perror(opt.output);
+                return 1;
+        }
+        fprintf(out, "%s\n", json);
+        if (out != stdout)
+                fclose(out);
+        return 0;
+}